@@ -0,0 +1,222 @@
+// Benchmarks for VGL's image code, reporting throughput in MB/s of
+// uncompressed source pixel data. This is a command line app, no gui involved.
+//
+// With no arguments a synthetic test image is used; otherwise each argument is
+// loaded and benchmarked in turn.
+
+#include "vgl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+
+static double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Smooth gradients with a bit of noise, so the encoders have something
+// realistic to compress.
+static vgl::RawImage* makeTestImage(unsigned int width, unsigned int height)
+{
+  vgl::RawImage* img = new vgl::RawImage(GL_RGBA, 4, width, height);
+  unsigned char* pixels = img->getPixels();
+  srand(1);
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      unsigned char* p = pixels + (size_t(y) * width + x) * 4;
+      float fx = x / float(width), fy = y / float(height);
+      p[0] = (unsigned char)(255 * fx);
+      p[1] = (unsigned char)(255 * fy);
+      p[2] = (unsigned char)(127.5f + 127.5f * std::sin(fx * 20.0f) * std::cos(fy * 13.0f));
+      p[3] = (unsigned char)(255 - (rand() & 15));
+    }
+  }
+  return img;
+}
+
+
+static void benchSave(vgl::RawImage* img, const char* label, const char* path,
+    const vgl::SaveOptions& options)
+{
+  const int kRuns = 3;
+  double best = 1e20;
+  for (int i = 0; i < kRuns; ++i) {
+    double start = now();
+    img->save(path, options);
+    best = std::min(best, now() - start);
+  }
+
+  struct stat info;
+  stat(path, &info);
+  double mb = double(img->getWidth()) * img->getHeight() * img->getBytesPerPixel() / (1024.0 * 1024.0);
+  printf("  %-26s %8.1f MB/s  %8.1f ms  %10ld bytes\n",
+      label, mb / best, best * 1000.0, (long)info.st_size);
+  remove(path);
+}
+
+
+static void benchLoad(vgl::RawImage* img, const char* label, const char* path,
+    const vgl::SaveOptions& options)
+{
+  img->save(path, options);
+
+  const int kRuns = 3;
+  double best = 1e20;
+  for (int i = 0; i < kRuns; ++i) {
+    double start = now();
+    vgl::RawImage loaded(path, img->getOrigin());
+    best = std::min(best, now() - start);
+  }
+
+  double mb = double(img->getWidth()) * img->getHeight() * img->getBytesPerPixel() / (1024.0 * 1024.0);
+  printf("  %-26s %8.1f MB/s  %8.1f ms\n", label, mb / best, best * 1000.0);
+  remove(path);
+}
+
+
+static void benchResize(vgl::RawImage* img, const char* label, unsigned int width,
+    unsigned int height, vgl::ResizeFilter filter)
+{
+  const int kRuns = 3;
+  double best = 1e20;
+  for (int i = 0; i < kRuns; ++i) {
+    double start = now();
+    vgl::RawImage* result = vgl::resize(img, width, height, filter);
+    best = std::min(best, now() - start);
+    delete result;
+  }
+
+  double mb = double(img->getWidth()) * img->getHeight() * img->getBytesPerPixel() / (1024.0 * 1024.0);
+  printf("  %-26s %8.1f MB/s  %8.1f ms  %5ux%u\n", label, mb / best, best * 1000.0, width, height);
+}
+
+
+// The naive loops that imageStats and histogram replace, for comparison.
+// Only handles 8 bit images.
+static void scalarStats(const vgl::RawImage* img, double* mean, size_t* counts)
+{
+  unsigned int channels = img->getBytesPerPixel();
+  size_t numPixels = size_t(img->getWidth()) * img->getHeight();
+  const unsigned char* pixels = img->getPixels();
+  for (unsigned int c = 0; c < channels; ++c) {
+    unsigned char lo = 255, hi = 0;
+    double sum = 0.0, sumSq = 0.0;
+    for (size_t i = 0; i < numPixels; ++i) {
+      unsigned char v = pixels[i * channels + c];
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      sum += v;
+      sumSq += double(v) * v;
+      ++counts[c * 256 + v];
+    }
+    mean[c] = sum / (numPixels * 255.0);
+  }
+}
+
+
+static void benchStats(vgl::RawImage* img, const char* label)
+{
+  const int kRuns = 3;
+  double best = 1e20;
+  vgl::ImageStats stats;
+  vgl::Histogram hist;
+  for (int i = 0; i < kRuns; ++i) {
+    double start = now();
+    stats = vgl::imageStats(*img);
+    hist = vgl::histogram(*img);
+    best = std::min(best, now() - start);
+  }
+
+  double mb = double(img->getWidth()) * img->getHeight() * img->getBytesPerPixel() / (1024.0 * 1024.0);
+  printf("  %-26s %8.1f MB/s  %8.1f ms\n", label, mb / best, best * 1000.0);
+  if (img->getPixelType() != GL_UNSIGNED_BYTE)
+    return;
+
+  double scalarBest = 1e20;
+  double mean[4];
+  std::vector<size_t> counts;
+  for (int i = 0; i < kRuns; ++i) {
+    counts.assign(img->getBytesPerPixel() * 256, 0);
+    double start = now();
+    scalarStats(img, mean, &counts[0]);
+    scalarBest = std::min(scalarBest, now() - start);
+  }
+  bool matches = (counts == hist.counts);
+  for (unsigned int c = 0; c < stats.numChannels; ++c)
+    matches = matches && std::fabs(mean[c] - stats.mean[c]) < 1e-9;
+  printf("  %-26s %8.1f MB/s  %8.1f ms  %s\n", "stats (scalar reference)",
+      mb / scalarBest, scalarBest * 1000.0, matches ? "results match" : "RESULTS DIFFER");
+}
+
+
+static void benchImage(vgl::RawImage* img)
+{
+  printf("%ux%u, %u bytes per pixel\n", img->getWidth(), img->getHeight(), img->getBytesPerPixel());
+
+  vgl::SaveOptions options;
+  options.pngParallel = false;
+  benchSave(img, "png (libpng)", "imagebench.png", options);
+  options.pngParallel = true;
+  benchSave(img, "png (parallel strips)", "imagebench.png", options);
+  options.pngCompressionLevel = 1;
+  benchSave(img, "png (parallel, level 1)", "imagebench.png", options);
+
+  benchSave(img, "jpeg", "imagebench.jpg", vgl::SaveOptions());
+
+  options = vgl::SaveOptions();
+  options.tgaRLE = false;
+  benchSave(img, "tga", "imagebench.tga", options);
+  options.tgaRLE = true;
+  benchSave(img, "tga (rle)", "imagebench.tga", options);
+  benchLoad(img, "tga load (rle)", "imagebench.tga", options);
+
+  benchSave(img, "ppm", "imagebench.ppm", vgl::SaveOptions());
+
+  benchStats(img, "stats + histogram");
+
+  unsigned int width = img->getWidth(), height = img->getHeight();
+  benchResize(img, "resize 0.47x (box)", width * 47 / 100, height * 47 / 100, vgl::FILTER_BOX);
+  benchResize(img, "resize 0.47x (mitchell)", width * 47 / 100, height * 47 / 100, vgl::FILTER_MITCHELL);
+  benchResize(img, "resize 0.47x (lanczos3)", width * 47 / 100, height * 47 / 100, vgl::FILTER_LANCZOS3);
+  benchResize(img, "resize 1.3x (lanczos3)", width * 13 / 10, height * 13 / 10, vgl::FILTER_LANCZOS3);
+
+  vgl::RawImage hdr(*img);
+  hdr.convertInPlace(hdr.getType(), GL_FLOAT);
+  benchResize(&hdr, "resize 0.47x (float)", width * 47 / 100, height * 47 / 100, vgl::FILTER_LANCZOS3);
+  benchStats(&hdr, "stats + histogram (float)");
+}
+
+
+int main(int argc, char** argv)
+{
+  try {
+    if (argc <= 1) {
+      vgl::RawImage* img = makeTestImage(4096, 4096);
+      benchImage(img);
+      delete img;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+      if (i > 1)
+        printf("---\n");
+      vgl::RawImage img(argv[i]);
+      printf("%s: ", argv[i]);
+      benchImage(&img);
+    }
+  } catch (vgl::ImageException& ex) {
+    fprintf(stderr, "%s\n", ex.what());
+    return 1;
+  }
+
+  return 0;
+}
+
@@ -0,0 +1,755 @@
+// Benchmarks for VGL's math code, comparing the SIMD versions of things with
+// the generic templates they replace. This is a command line app, no gui
+// involved.
+
+#include "vgl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+#include <vector>
+
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Stops the compiler from throwing away results that are never looked at.
+static volatile float gSink;
+
+
+static void report(const char* label, double seconds, size_t count, double baseline)
+{
+  printf("  %-34s %8.1f M/s  %8.1f ms", label, count / seconds * 1e-6, seconds * 1000.0);
+  if (baseline > 0.0)
+    printf("  %5.2fx", baseline / seconds);
+  printf("\n");
+}
+
+
+static vgl::Matrix4f randomMatrix()
+{
+  vgl::Matrix4f m;
+  for (unsigned int i = 0; i < 16; ++i)
+    m.data[i] = rand() / float(RAND_MAX) * 2.0f - 1.0f;
+  return m;
+}
+
+
+static void benchMultiply()
+{
+  const size_t kCount = 1 << 22;
+  std::vector<vgl::Matrix4f> mats(256);
+  for (size_t i = 0; i < mats.size(); ++i)
+    mats[i] = randomMatrix();
+
+  const int kRuns = 3;
+  double generic = 1e20, simd = 1e20;
+  for (int run = 0; run < kRuns; ++run) {
+    vgl::Matrix4f acc;
+    double start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = vgl::operator *<float>(mats[i & 255], mats[(i + 1) & 255]);
+    generic = std::min(generic, now() - start);
+    gSink = acc.m00;
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = mats[i & 255] * mats[(i + 1) & 255];
+    simd = std::min(simd, now() - start);
+    gSink = acc.m00;
+  }
+  report("matrix4f * matrix4f (template)", generic, kCount, 0.0);
+  report("matrix4f * matrix4f (sse)", simd, kCount, generic);
+}
+
+
+static void benchInverse()
+{
+  const size_t kCount = 1 << 22;
+  std::vector<vgl::Matrix4f> mats(256);
+  for (size_t i = 0; i < mats.size(); ++i) {
+    mats[i] = randomMatrix();
+    mats[i].m30 = mats[i].m31 = mats[i].m32 = 0.0f;
+    mats[i].m33 = 1.0f;
+  }
+
+  const int kRuns = 3;
+  double generic = 1e20, simd = 1e20, affineGeneric = 1e20, affine = 1e20;
+  double detGeneric = 1e20, det = 1e20;
+  for (int run = 0; run < kRuns; ++run) {
+    vgl::Matrix4f acc;
+    double start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = vgl::inverse<float>(mats[i & 255]);
+    generic = std::min(generic, now() - start);
+    gSink = acc.m00;
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = vgl::inverse(mats[i & 255]);
+    simd = std::min(simd, now() - start);
+    gSink = acc.m00;
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = vgl::affineInverse<float>(mats[i & 255]);
+    affineGeneric = std::min(affineGeneric, now() - start);
+    gSink = acc.m00;
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc = vgl::affineInverse(mats[i & 255]);
+    affine = std::min(affine, now() - start);
+    gSink = acc.m00;
+
+    float sum = 0.0f;
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      sum += vgl::determinant<float>(mats[i & 255]);
+    detGeneric = std::min(detGeneric, now() - start);
+    gSink = sum;
+
+    sum = 0.0f;
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      sum += vgl::determinant(mats[i & 255]);
+    det = std::min(det, now() - start);
+    gSink = sum;
+  }
+  report("inverse matrix4f (template)", generic, kCount, 0.0);
+  report("inverse matrix4f (sse)", simd, kCount, generic);
+  report("affineInverse matrix4f (template)", affineGeneric, kCount, 0.0);
+  report("affineInverse matrix4f (sse)", affine, kCount, affineGeneric);
+  report("affineInverse vs inverse (sse)", affine, kCount, simd);
+  report("determinant matrix4f (template)", detGeneric, kCount, 0.0);
+  report("determinant matrix4f (sse)", det, kCount, detGeneric);
+}
+
+
+// glibc's sinf and cosf are already very quick, so the difference is mostly
+// in doubles.
+template <typename Num>
+static void benchFastMath(const char* type)
+{
+  const size_t kCount = 1 << 22;
+  std::vector< vgl::Vec3<Num> > vecs(256);
+  for (size_t i = 0; i < vecs.size(); ++i)
+    vecs[i] = vgl::Vec3<Num>(rand() / Num(RAND_MAX) + Num(0.5), rand() / Num(RAND_MAX), rand() / Num(RAND_MAX));
+
+  const int kRuns = 3;
+  double normExact = 1e20, normFast = 1e20, rotateExact = 1e20, rotateFast = 1e20;
+  for (int run = 0; run < kRuns; ++run) {
+    vgl::Vec3<Num> acc;
+    double start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc += vgl::norm<vgl::ExactMath>(vecs[i & 255]);
+    normExact = std::min(normExact, now() - start);
+    gSink = float(acc.x);
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc += vgl::norm<vgl::FastMath>(vecs[i & 255]);
+    normFast = std::min(normFast, now() - start);
+    gSink = float(acc.x);
+
+    // A different angle every time, so the sin and cos can't be hoisted.
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc += vgl::rotateY<vgl::ExactMath>(vecs[i & 255], Num(int(i)) * Num(1e-3));
+    rotateExact = std::min(rotateExact, now() - start);
+    gSink = float(acc.x);
+
+    start = now();
+    for (size_t i = 0; i < kCount; ++i)
+      acc += vgl::rotateY<vgl::FastMath>(vecs[i & 255], Num(int(i)) * Num(1e-3));
+    rotateFast = std::min(rotateFast, now() - start);
+    gSink = float(acc.x);
+  }
+
+  char label[64];
+  snprintf(label, sizeof(label), "norm %s (exact)", type);
+  report(label, normExact, kCount, 0.0);
+  snprintf(label, sizeof(label), "norm %s (fast)", type);
+  report(label, normFast, kCount, normExact);
+  snprintf(label, sizeof(label), "rotateY %s (exact)", type);
+  report(label, rotateExact, kCount, 0.0);
+  snprintf(label, sizeof(label), "rotateY %s (fast)", type);
+  report(label, rotateFast, kCount, rotateExact);
+}
+
+
+// The arrays fit in cache, so this measures the arithmetic rather than memory
+// bandwidth; each pass goes over them kRepeats times.
+static void benchTransform()
+{
+  const size_t kCount = 1 << 14;
+  const int kRepeats = 256;
+  vgl::Matrix4f m = randomMatrix();
+  std::vector<vgl::Vec4f> src(kCount), dst(kCount);
+  std::vector<vgl::Vec3f> src3(kCount), dst3(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    src[i] = vgl::Vec4f(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX), 1.0f);
+    src3[i] = vgl::Vec3f(src[i].x, src[i].y, src[i].z);
+  }
+
+  const int kRuns = 3;
+  double generic = 1e20, single = 1e20, batch = 1e20;
+  double generic3 = 1e20, batch3 = 1e20, rotateSingle = 1e20, rotateBatch = 1e20;
+  vgl::Vec3f axis(0.2f, 1.0f, -0.4f);
+  for (int run = 0; run < kRuns; ++run) {
+    double start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst[i] = vgl::operator *<float>(m, src[i]);
+    }
+    generic = std::min(generic, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst[i] = m * src[i];
+    }
+    single = std::min(single, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::transform(m, &src[0], &dst[0], kCount);
+    batch = std::min(batch, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst3[i] = vgl::transformPoint(m, src3[i]);
+    }
+    generic3 = std::min(generic3, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::transformPoints(m, &src3[0], &dst3[0], kCount);
+    batch3 = std::min(batch3, now() - start);
+
+    // Rotating in place, so each repeat turns the points a bit further.
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst3[i] = vgl::rotate(dst3[i], axis, 0.01f);
+    }
+    rotateSingle = std::min(rotateSingle, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::rotate(&dst3[0], kCount, axis, 0.01f);
+    rotateBatch = std::min(rotateBatch, now() - start);
+  }
+  gSink = dst[kCount - 1].x + dst3[kCount - 1].x;
+
+  size_t total = kCount * kRepeats;
+  report("matrix4f * vec4f (template)", generic, total, 0.0);
+  report("matrix4f * vec4f (sse)", single, total, generic);
+  report("transform vec4f array", batch, total, generic);
+  report("transformPoint vec3f (template)", generic3, total, 0.0);
+  report("transformPoints vec3f array", batch3, total, generic3);
+  report("rotate vec3f around axis", rotateSingle, total, 0.0);
+  report("rotate vec3f array around axis", rotateBatch, total, rotateSingle);
+}
+
+
+// The same operations on an array of Vec3fs and on a Vec3Array holding the
+// same values, again small enough to stay in cache.
+static void benchVec3Array()
+{
+  const size_t kCount = 1 << 14;
+  const int kRepeats = 256;
+  vgl::Matrix4f m = randomMatrix();
+  std::vector<vgl::Vec3f> a(kCount), b(kCount), dst(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    a[i] = vgl::Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+    b[i] = vgl::Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+  }
+  vgl::Vec3Array sa(a), sb(b), sdst(kCount);
+
+  const int kRuns = 3;
+  double crossAoS = 1e20, crossSoA = 1e20;
+  double normAoS = 1e20, normSoA = 1e20;
+  double transformAoS = 1e20, transformSoA = 1e20;
+  double boundsAoS = 1e20, boundsSoA = 1e20;
+  vgl::Vec3f low, high;
+  for (int run = 0; run < kRuns; ++run) {
+    double start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst[i] = vgl::cross(a[i], b[i]);
+    }
+    crossAoS = std::min(crossAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::cross(sa, sb, sdst);
+    crossSoA = std::min(crossSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        dst[i] = vgl::norm(a[i]);
+    }
+    normAoS = std::min(normAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::norm(sa, sdst);
+    normSoA = std::min(normSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::transformPoints(m, &a[0], &dst[0], kCount);
+    transformAoS = std::min(transformAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::transformPoints(m, sa, sdst);
+    transformSoA = std::min(transformSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      low = high = a[0];
+      for (size_t i = 1; i < kCount; ++i) {
+        low = vgl::pairwiseMin(low, a[i]);
+        high = vgl::pairwiseMax(high, a[i]);
+      }
+    }
+    boundsAoS = std::min(boundsAoS, now() - start);
+    gSink = low.x + high.x;
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::reduceMinMax(sa, low, high);
+    boundsSoA = std::min(boundsSoA, now() - start);
+    gSink = low.x + high.x;
+  }
+  gSink = dst[kCount - 1].x + sdst.getX()[kCount - 1];
+
+  size_t total = kCount * kRepeats;
+  report("cross vec3f (template)", crossAoS, total, 0.0);
+  report("cross vec3array", crossSoA, total, crossAoS);
+  report("norm vec3f (template)", normAoS, total, 0.0);
+  report("norm vec3array", normSoA, total, normAoS);
+  report("transformPoints vec3f array", transformAoS, total, 0.0);
+  report("transformPoints vec3array", transformSoA, total, transformAoS);
+  report("min/max vec3f (template)", boundsAoS, total, 0.0);
+  report("reduceMinMax vec3array", boundsSoA, total, boundsAoS);
+}
+
+
+// Per-element quaternion operations, as an animation system would do them for
+// a whole pose at once.
+static void benchQuaternions()
+{
+  const size_t kCount = 1 << 14;
+  const int kRepeats = 64;
+  std::vector<vgl::Quaternionf> a(kCount), b(kCount), q(kCount);
+  std::vector<vgl::Vec3f> v(kCount), rotated(kCount);
+  std::vector<vgl::Matrix4f> mats(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    vgl::Vec3f axis(rand() / float(RAND_MAX) - 0.5f, rand() / float(RAND_MAX) - 0.5f, 1.0f);
+    a[i] = vgl::rotation(axis, rand() / float(RAND_MAX) * 3.0f);
+    b[i] = vgl::rotation(axis, rand() / float(RAND_MAX) * 3.0f);
+    v[i] = vgl::Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+  }
+  vgl::QuaternionArray qa(a), qb(b), qdst(kCount);
+  vgl::Vec3Array sv(v), sdst(kCount);
+
+  const int kRuns = 3;
+  double slerpAoS = 1e20, slerpSoA = 1e20, nlerpAoS = 1e20, nlerpSoA = 1e20;
+  double rotateAoS = 1e20, rotateSoA = 1e20, matsAoS = 1e20, matsSoA = 1e20;
+  for (int run = 0; run < kRuns; ++run) {
+    double start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        q[i] = vgl::slerp(a[i], b[i], 0.3f);
+    }
+    slerpAoS = std::min(slerpAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::slerp(qa, qb, 0.3f, qdst);
+    slerpSoA = std::min(slerpSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        q[i] = vgl::nlerp(a[i], b[i], 0.3f);
+    }
+    nlerpAoS = std::min(nlerpAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::nlerp(qa, qb, 0.3f, qdst);
+    nlerpSoA = std::min(nlerpSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        rotated[i] = vgl::rotate(a[i], v[i]);
+    }
+    rotateAoS = std::min(rotateAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::rotate(qa, sv, sdst);
+    rotateSoA = std::min(rotateSoA, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r) {
+      for (size_t i = 0; i < kCount; ++i)
+        mats[i] = vgl::rotationMatrix(a[i]);
+    }
+    matsAoS = std::min(matsAoS, now() - start);
+
+    start = now();
+    for (int r = 0; r < kRepeats; ++r)
+      vgl::rotationMatrices(qa, &mats[0]);
+    matsSoA = std::min(matsSoA, now() - start);
+  }
+  gSink = q[kCount - 1].s + qdst.getW()[kCount - 1] + rotated[kCount - 1].x + sdst.getX()[kCount - 1] + mats[kCount - 1].m00;
+
+  size_t total = kCount * kRepeats;
+  report("slerp quaternionf (template)", slerpAoS, total, 0.0);
+  report("slerp quaternionarray", slerpSoA, total, slerpAoS);
+  report("nlerp quaternionf (template)", nlerpAoS, total, 0.0);
+  report("nlerp quaternionarray", nlerpSoA, total, nlerpAoS);
+  report("rotate quaternionf (template)", rotateAoS, total, 0.0);
+  report("rotate quaternionarray", rotateSoA, total, rotateAoS);
+  report("rotationMatrix (template)", matsAoS, total, 0.0);
+  report("rotationMatrices quaternionarray", matsSoA, total, matsAoS);
+}
+
+
+// A point cloud much bigger than the cache, so this is a test of memory
+// bandwidth more than anything.
+static void benchBounds()
+{
+  const size_t kCount = 1 << 23;
+  std::vector<vgl::Vec3f> points(kCount);
+  for (size_t i = 0; i < kCount; ++i)
+    points[i] = vgl::Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+
+  const int kRuns = 3;
+  double generic = 1e20, simd = 1e20;
+  for (int run = 0; run < kRuns; ++run) {
+    double start = now();
+    vgl::Vec3f low = points[0], high = points[0];
+    for (size_t i = 1; i < kCount; ++i) {
+      low = vgl::pairwiseMin(low, points[i]);
+      high = vgl::pairwiseMax(high, points[i]);
+    }
+    generic = std::min(generic, now() - start);
+    gSink = low.x + high.x;
+
+    start = now();
+    vgl::AABB3f box = vgl::computeBounds(&points[0], kCount);
+    simd = std::min(simd, now() - start);
+    gSink = box.low.x + box.high.x;
+  }
+  report("bounds vec3f (template)", generic, kCount, 0.0);
+  report("computeBounds", simd, kCount, generic);
+  printf("  computeBounds reads %.1f GB/s\n", kCount * sizeof(vgl::Vec3f) / simd * 1e-9);
+}
+
+
+// Rays from a camera at (0,0,-3) through a 128x128 grid of pixels, like
+// primary rays.
+static std::vector<vgl::Ray3f> cameraRays()
+{
+  std::vector<vgl::Ray3f> rays(128 * 128);
+  for (size_t i = 0; i < rays.size(); ++i) {
+    size_t x = i % 128, y = i / 128;
+    vgl::Vec3f target(x / 64.0f - 1.0f, y / 64.0f - 1.0f, 0.0f);
+    rays[i] = vgl::Ray3f(vgl::Vec3f(0, 0, -3), target - vgl::Vec3f(0, 0, -3));
+  }
+  return rays;
+}
+
+
+// Small triangles scattered in front of the camera, three vertices each. The
+// first vertex doubles as a sphere center or box corner.
+static std::vector<vgl::Vec3f> smallTriangles(size_t count)
+{
+  std::vector<vgl::Vec3f> verts(count * 3);
+  for (size_t k = 0; k < count; ++k) {
+    vgl::Vec3f c(rand() / float(RAND_MAX) * 2.0f - 1.0f, rand() / float(RAND_MAX) * 2.0f - 1.0f,
+                 rand() / float(RAND_MAX));
+    verts[k * 3] = c;
+    verts[k * 3 + 1] = c + vgl::Vec3f(0.3f, 0.05f, 0.1f);
+    verts[k * 3 + 2] = c + vgl::Vec3f(0.1f, 0.3f, -0.05f);
+  }
+  return verts;
+}
+
+
+// What benchRayPackets is testing against.
+enum RayTest {
+  RAY_SPHERE,
+  RAY_BOX,
+  RAY_TRIANGLE,
+  RAY_WATERTIGHT
+};
+
+
+// Every ray against every object one at a time, keeping the nearest hit.
+static unsigned int singleRays(RayTest test, const std::vector<vgl::Ray3f>& rays,
+                               const std::vector<vgl::Vec3f>& verts)
+{
+  unsigned int hits = 0;
+  for (size_t r = 0; r < rays.size(); ++r) {
+    float tMax = HUGE_VALF;
+    for (size_t k = 0; k + 3 <= verts.size(); k += 3) {
+      float t, u, v, tFar;
+      bool hit = false;
+      switch (test) {
+        case RAY_SPHERE:
+          hit = vgl::intersectRaySphere(rays[r], verts[k], 0.1f, t);
+          break;
+        case RAY_BOX:
+          hit = vgl::intersectRayBox(rays[r], vgl::AABB3f(verts[k], verts[k] + vgl::Vec3f(0.2f)), t, tFar);
+          break;
+        case RAY_TRIANGLE:
+          hit = vgl::intersectRayTriangle(rays[r], verts[k], verts[k + 1], verts[k + 2], t, u, v);
+          break;
+        case RAY_WATERTIGHT:
+          hit = vgl::intersectRayTriangleWatertight(rays[r], verts[k], verts[k + 1], verts[k + 2], t, u, v);
+          break;
+      }
+      if (hit && t < tMax) {
+        if (test != RAY_BOX)
+          tMax = t;
+        ++hits;
+      }
+    }
+  }
+  return hits;
+}
+
+
+template <unsigned int N>
+static unsigned int packetRays(RayTest test, std::vector<vgl::RayPacket<N> >& packets,
+                               const std::vector<vgl::Vec3f>& verts)
+{
+  unsigned int hits = 0;
+  float u[N], v[N];
+  for (size_t p = 0; p < packets.size(); ++p) {
+    vgl::RayPacket<N>& packet = packets[p];
+    for (size_t k = 0; k + 3 <= verts.size(); k += 3) {
+      unsigned int mask = 0;
+      switch (test) {
+        case RAY_SPHERE:
+          mask = vgl::intersectPacketSphere(packet, packet.kAllActive, verts[k], 0.1f);
+          break;
+        case RAY_BOX:
+          mask = vgl::intersectPacketBox(packet, packet.kAllActive,
+                                         vgl::AABB3f(verts[k], verts[k] + vgl::Vec3f(0.2f)));
+          break;
+        case RAY_TRIANGLE:
+          mask = vgl::intersectPacketTriangle(packet, packet.kAllActive, verts[k], verts[k + 1], verts[k + 2], u, v);
+          break;
+        case RAY_WATERTIGHT:
+          mask = vgl::intersectPacketTriangleWatertight(packet, packet.kAllActive,
+                                                        verts[k], verts[k + 1], verts[k + 2], u, v);
+          break;
+      }
+      hits += mask != 0;
+    }
+  }
+  return hits;
+}
+
+
+template <unsigned int N>
+static double timePackets(RayTest test, const std::vector<vgl::Ray3f>& rays, const std::vector<vgl::Vec3f>& verts)
+{
+  std::vector<vgl::RayPacket<N> > packets(rays.size() / N);
+  for (size_t i = 0; i < rays.size(); ++i)
+    packets[i / N].set(i % N, rays[i]);
+
+  double best = 1e20;
+  for (int run = 0; run < 3; ++run) {
+    // Fresh copies, since the tests shrink tMax.
+    std::vector<vgl::RayPacket<N> > work(packets);
+    double start = now();
+    gSink = packetRays(test, work, verts);
+    best = std::min(best, now() - start);
+  }
+  return best;
+}
+
+
+// Rays from a camera through a 128x128 grid of pixels, like primary rays, so
+// the rays in each packet are neighbours. The scene is a few dozen small
+// objects and the rates are millions of ray/object tests per second.
+static void benchRayPackets()
+{
+  const size_t kObjects = 64;
+  std::vector<vgl::Ray3f> rays = cameraRays();
+  std::vector<vgl::Vec3f> verts = smallTriangles(kObjects);
+
+  const RayTest kTests[] = { RAY_SPHERE, RAY_BOX, RAY_TRIANGLE, RAY_WATERTIGHT };
+  const char* kNames[] = { "sphere", "box", "triangle", "watertight triangle" };
+  size_t total = rays.size() * kObjects;
+  for (unsigned int i = 0; i < 4; ++i) {
+    double single = 1e20;
+    for (int run = 0; run < 3; ++run) {
+      double start = now();
+      gSink = singleRays(kTests[i], rays, verts);
+      single = std::min(single, now() - start);
+    }
+    double packet4 = timePackets<4>(kTests[i], rays, verts);
+    double packet8 = timePackets<8>(kTests[i], rays, verts);
+    double packet16 = timePackets<16>(kTests[i], rays, verts);
+
+    char label[64];
+    sprintf(label, "ray/%s (single)", kNames[i]);
+    report(label, single, total, 0.0);
+    sprintf(label, "ray/%s packet4", kNames[i]);
+    report(label, packet4, total, single);
+    sprintf(label, "ray/%s packet8", kNames[i]);
+    report(label, packet8, total, single);
+    sprintf(label, "ray/%s packet16", kNames[i]);
+    report(label, packet16, total, single);
+  }
+}
+
+
+// The single ray tests, each with the objects stored the way it wants them.
+enum PrimitiveTest {
+  PRIM_TRIANGLE,
+  PRIM_WATERTIGHT,
+  PRIM_WOOP,
+  PRIM_PLUCKER,
+  PRIM_PLANE,
+  PRIM_PARALLELOGRAM,
+  PRIM_BOX,
+  PRIM_SLAB_BOX
+};
+
+
+struct PrimitiveScene {
+  std::vector<vgl::Vec3f> verts;
+  std::vector<vgl::TriangleWoopf> woop;
+  std::vector<vgl::TrianglePluckerf> plucker;
+  std::vector<vgl::Plane3f> planes;
+  std::vector<vgl::AABB3f> boxes;
+};
+
+
+static unsigned int primitiveRays(PrimitiveTest test, const std::vector<vgl::Ray3f>& rays,
+                                  const PrimitiveScene& scene)
+{
+  unsigned int hits = 0;
+  size_t count = scene.boxes.size();
+  for (size_t r = 0; r < rays.size(); ++r) {
+    // Set up once per ray, like a traversal would.
+    vgl::SlabRay3f slab;
+    if (test == PRIM_SLAB_BOX)
+      slab = vgl::SlabRay3f(rays[r]);
+    for (size_t k = 0; k < count; ++k) {
+      const vgl::Vec3f* v = &scene.verts[k * 3];
+      float t, u, w, tFar;
+      bool hit = false;
+      switch (test) {
+        case PRIM_TRIANGLE:
+          hit = vgl::intersectRayTriangle(rays[r], v[0], v[1], v[2], t, u, w);
+          break;
+        case PRIM_WATERTIGHT:
+          hit = vgl::intersectRayTriangleWatertight(rays[r], v[0], v[1], v[2], t, u, w);
+          break;
+        case PRIM_WOOP:
+          hit = vgl::intersectRayTriangle(rays[r], scene.woop[k], t, u, w);
+          break;
+        case PRIM_PLUCKER:
+          hit = vgl::intersectRayTriangle(rays[r], scene.plucker[k], t, u, w);
+          break;
+        case PRIM_PLANE:
+          hit = vgl::intersectRayPlane(rays[r], scene.planes[k], t, u, w);
+          break;
+        case PRIM_PARALLELOGRAM:
+          hit = vgl::intersectRayParallelogram(rays[r], scene.planes[k], t, u, w);
+          break;
+        case PRIM_BOX:
+          hit = vgl::intersectRayBox(rays[r], scene.boxes[k], t, tFar);
+          break;
+        case PRIM_SLAB_BOX:
+          hit = vgl::intersectRayBox(slab, scene.boxes[k], t, tFar);
+          break;
+      }
+      hits += hit;
+    }
+  }
+  return hits;
+}
+
+
+// One ray at a time against the same scene as benchRayPackets, comparing
+// the precomputed triangle layouts with Moller-Trumbore on the raw vertices
+// and the slab test with and without SlabRay3. The plane and parallelogram
+// use the triangles' edges, so are against Moller-Trumbore as well.
+static void benchRayPrimitives()
+{
+  const size_t kObjects = 64;
+  std::vector<vgl::Ray3f> rays = cameraRays();
+  PrimitiveScene scene;
+  scene.verts = smallTriangles(kObjects);
+  for (size_t k = 0; k < kObjects; ++k) {
+    const vgl::Vec3f* v = &scene.verts[k * 3];
+    scene.woop.push_back(vgl::TriangleWoopf(v[0], v[1], v[2]));
+    scene.plucker.push_back(vgl::TrianglePluckerf(v[0], v[1], v[2]));
+    scene.planes.push_back(vgl::Plane3f(v[0], v[1] - v[0], v[2] - v[0]));
+    scene.boxes.push_back(vgl::AABB3f(v[0], v[0] + vgl::Vec3f(0.2f)));
+  }
+
+  const PrimitiveTest kTests[] = { PRIM_TRIANGLE, PRIM_WATERTIGHT, PRIM_WOOP, PRIM_PLUCKER,
+                                   PRIM_PLANE, PRIM_PARALLELOGRAM, PRIM_BOX, PRIM_SLAB_BOX };
+  const char* kNames[] = { "ray/triangle (moller-trumbore)", "ray/triangle watertight", "ray/triangle woop",
+                           "ray/triangle plucker", "ray/plane", "ray/parallelogram", "ray/box",
+                           "ray/box SlabRay3" };
+  size_t total = rays.size() * kObjects;
+  double triangle = 0.0, box = 0.0;
+  for (unsigned int i = 0; i < 8; ++i) {
+    double best = 1e20;
+    for (int run = 0; run < 3; ++run) {
+      double start = now();
+      gSink = primitiveRays(kTests[i], rays, scene);
+      best = std::min(best, now() - start);
+    }
+    if (kTests[i] == PRIM_TRIANGLE)
+      triangle = best;
+    if (kTests[i] == PRIM_BOX)
+      box = best;
+    double baseline = kTests[i] == PRIM_TRIANGLE || kTests[i] == PRIM_BOX ? 0.0 :
+                      kTests[i] == PRIM_SLAB_BOX ? box : triangle;
+    report(kNames[i], best, total, baseline);
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  printf("AVX: %s\n", vgl::cpuHasAVX() ? "yes" : "no");
+  printf("AVX2: %s, AVX-512: %s\n", vgl::cpuHasAVX2() ? "yes" : "no", vgl::cpuHasAVX512F() ? "yes" : "no");
+  benchMultiply();
+  benchInverse();
+  benchFastMath<float>("vec3f");
+  benchFastMath<double>("vec3d");
+  benchTransform();
+  benchVec3Array();
+  benchQuaternions();
+  benchBounds();
+  benchRayPackets();
+  benchRayPrimitives();
+  return 0;
+}
@@ -16,7 +16,7 @@ public:
     _totalFaces(0), _triangles(0), _quads(0), _polygons(0),
     _totalVertices(0), _totalNormals(0), _totalTexCoords(0),
     _totalMaterials(0), _totalTextures(0),
-    _low(1e20, 1e20, 1e20), _high(-1e20, -1e20, -1e20),
+    _bounds(),
     _vertsForCurrentFace(0), _maxVertsPerFace(0)
   {
   }
@@ -65,8 +65,7 @@ public:
   {
     if (attr == ParserCallbacks::kCoord) {
       ++_totalVertices;
-      _low = pairwiseMin(_low, value);
-      _high = pairwiseMax(_low, value);
+      _bounds = merge(_bounds, value);
     }
     else if (attr == ParserCallbacks::kNormal) {
       ++_totalNormals;
@@ -85,9 +84,9 @@ private:
   void printStats()
   {
     printf("%s\n", _filename.c_str());
-    printf("x = %f - %f\n", _low.x, _high.x);
-    printf("y = %f - %f\n", _low.x, _high.x);
-    printf("z = %f - %f\n", _low.x, _high.x);
+    printf("x = %f - %f\n", _bounds.low.x, _bounds.high.x);
+    printf("y = %f - %f\n", _bounds.low.y, _bounds.high.y);
+    printf("z = %f - %f\n", _bounds.low.z, _bounds.high.z);
     printf("\n");
     printf("%lu faces of up to %lu vertices\n", _totalFaces, _maxVertsPerFace);
     printf("- %lu triangles\n", _triangles);
@@ -117,8 +116,7 @@ private:
   size_t _totalMaterials;
   size_t _totalTextures;
 
-  vgl::Vec3f _low;
-  vgl::Vec3f _high;
+  vgl::AABB3f _bounds;
 
   size_t _vertsForCurrentFace;
   size_t _maxVertsPerFace;
@@ -6,14 +6,20 @@
 // compile times down, though.
 
 // Maths
+#include "vgl_aabb3.h"
+#include "vgl_fastmath.h"
 #include "vgl_matrix3.h"
 #include "vgl_matrix4.h"
 #include "vgl_plane3.h"
 #include "vgl_ray3.h"
+#include "vgl_raypacket.h"
+#include "vgl_triangle3.h"
 #include "vgl_vec2.h"
 #include "vgl_vec3.h"
+#include "vgl_vec3array.h"
 #include "vgl_vec4.h"
 #include "vgl_quaternion.h"
+#include "vgl_quaternionarray.h"
 
 // Cameras
 #include "vgl_arcballcamera.h"
@@ -22,7 +28,16 @@
 #include "vgl_orthocamera.h"
 
 // Image files
+#include "vgl_atlas.h"
+#include "vgl_compressedimage.h"
+#include "vgl_convert.h"
 #include "vgl_image.h"
+#include "vgl_imagecache.h"
+#include "vgl_imagestats.h"
+#include "vgl_mipchain.h"
+#include "vgl_pixelpool.h"
+#include "vgl_resize.h"
+#include "vgl_tiledimage.h"
 
 // Model files
 #include "vgl_parser.h"
@@ -35,6 +50,7 @@
 
 // Miscellaneous
 #include "vgl_funcs.h"
+#include "vgl_simd.h"
 #include "vgl_utils.h"
 
 // OpenGL
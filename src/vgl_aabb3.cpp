@@ -0,0 +1,210 @@
+#include "vgl_aabb3.h"
+
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef VGL_SIMD_SSE2
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+// Points are processed in blocks of this many, one block per OpenMP
+// iteration.
+static const size_t kBlockSize = 1 << 16;
+
+
+//
+// TYPES
+//
+
+// Which kernel computeBounds uses.
+enum BoundsKernel {
+  KERNEL_SCALAR,
+  KERNEL_SSE,
+  KERNEL_AVX,
+  KERNEL_AVX512
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static BoundsKernel pickKernel()
+{
+#ifdef VGL_SIMD_SSE2
+  if (cpuHasAVX512F())
+    return KERNEL_AVX512;
+  if (cpuHasAVX())
+    return KERNEL_AVX;
+  return KERNEL_SSE;
+#else
+  return KERNEL_SCALAR;
+#endif
+}
+
+
+static AABB3f scalarBounds(const Vec3f* points, size_t count)
+{
+  AABB3f box;
+  for (size_t i = 0; i < count; ++i)
+    box = merge(box, points[i]);
+  return box;
+}
+
+
+#ifdef VGL_SIMD_SSE2
+
+// The SIMD kernels treat the points as one long array of floats, x y z x y z
+// and so on, and load them three registers at a time. Since a register holds
+// a whole number of points in either 4, 8 or 16 floats, every lane always
+// sees the same component of the points (e.g. with SSE: x y z x, y z x y,
+// z x y z) and can keep its own running min and max, with no shuffling.
+// Sorting out which lane had which component is left until the end.
+
+// lows and highs are the lanes of the three min and max registers, stored
+// one after another: lane j holds component j % 3.
+static AABB3f foldLanes(const float* lows, const float* highs, size_t lanes)
+{
+  AABB3f box;
+  for (size_t j = 0; j < lanes; ++j) {
+    box.low[j % 3] = std::min(box.low[j % 3], lows[j]);
+    box.high[j % 3] = std::max(box.high[j % 3], highs[j]);
+  }
+  return box;
+}
+
+
+static AABB3f sseBounds(const Vec3f* points, size_t count)
+{
+  const float* f = reinterpret_cast<const float*>(points);
+  __m128 low[3], high[3];
+  for (unsigned int k = 0; k < 3; ++k) {
+    low[k] = _mm_set1_ps(HUGE_VALF);
+    high[k] = _mm_set1_ps(-HUGE_VALF);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4, f += 12) {
+    for (unsigned int k = 0; k < 3; ++k) {
+      __m128 v = _mm_loadu_ps(f + k * 4);
+      low[k] = _mm_min_ps(low[k], v);
+      high[k] = _mm_max_ps(high[k], v);
+    }
+  }
+
+  float lows[12], highs[12];
+  for (unsigned int k = 0; k < 3; ++k) {
+    _mm_storeu_ps(lows + k * 4, low[k]);
+    _mm_storeu_ps(highs + k * 4, high[k]);
+  }
+  return merge(foldLanes(lows, highs, 12), scalarBounds(points + i, count - i));
+}
+
+
+VGL_TARGET("avx")
+static AABB3f avxBounds(const Vec3f* points, size_t count)
+{
+  const float* f = reinterpret_cast<const float*>(points);
+  __m256 low[3], high[3];
+  for (unsigned int k = 0; k < 3; ++k) {
+    low[k] = _mm256_set1_ps(HUGE_VALF);
+    high[k] = _mm256_set1_ps(-HUGE_VALF);
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8, f += 24) {
+    for (unsigned int k = 0; k < 3; ++k) {
+      __m256 v = _mm256_loadu_ps(f + k * 8);
+      low[k] = _mm256_min_ps(low[k], v);
+      high[k] = _mm256_max_ps(high[k], v);
+    }
+  }
+
+  float lows[24], highs[24];
+  for (unsigned int k = 0; k < 3; ++k) {
+    _mm256_storeu_ps(lows + k * 8, low[k]);
+    _mm256_storeu_ps(highs + k * 8, high[k]);
+  }
+  return merge(foldLanes(lows, highs, 24), sseBounds(points + i, count - i));
+}
+
+
+VGL_TARGET("avx512f")
+static AABB3f avx512Bounds(const Vec3f* points, size_t count)
+{
+  const float* f = reinterpret_cast<const float*>(points);
+  __m512 low[3], high[3];
+  for (unsigned int k = 0; k < 3; ++k) {
+    low[k] = _mm512_set1_ps(HUGE_VALF);
+    high[k] = _mm512_set1_ps(-HUGE_VALF);
+  }
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16, f += 48) {
+    for (unsigned int k = 0; k < 3; ++k) {
+      // The masked forms only because gcc 12 warns about the plain ones.
+      __m512 v = _mm512_loadu_ps(f + k * 16);
+      low[k] = _mm512_mask_min_ps(low[k], 0xFFFF, low[k], v);
+      high[k] = _mm512_mask_max_ps(high[k], 0xFFFF, high[k], v);
+    }
+  }
+
+  float lows[48], highs[48];
+  for (unsigned int k = 0; k < 3; ++k) {
+    _mm512_storeu_ps(lows + k * 16, low[k]);
+    _mm512_storeu_ps(highs + k * 16, high[k]);
+  }
+  return merge(foldLanes(lows, highs, 48), avxBounds(points + i, count - i));
+}
+
+#endif // VGL_SIMD_SSE2
+
+
+static AABB3f blockBounds(BoundsKernel kernel, const Vec3f* points, size_t count)
+{
+#ifdef VGL_SIMD_SSE2
+  switch (kernel) {
+    case KERNEL_AVX512: return avx512Bounds(points, count);
+    case KERNEL_AVX:    return avxBounds(points, count);
+    case KERNEL_SSE:    return sseBounds(points, count);
+    default: break;
+  }
+#endif
+  return scalarBounds(points, count);
+}
+
+
+//
+// FUNCTIONS
+//
+
+AABB3f computeBounds(const Vec3f* points, size_t count)
+{
+  BoundsKernel kernel = pickKernel();
+  int blocks = int((count + kBlockSize - 1) / kBlockSize);
+  std::vector<AABB3f> boxes(blocks);
+
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    boxes[block] = blockBounds(kernel, points + first, std::min(kBlockSize, count - first));
+  }
+
+  AABB3f box;
+  for (int block = 0; block < blocks; ++block)
+    box = merge(box, boxes[block]);
+  return box;
+}
+
+
+} // namespace vgl
@@ -0,0 +1,203 @@
+#ifndef vgl_aabb3_h
+#define vgl_aabb3_h
+
+#include "vgl_matrix4.h"
+#include "vgl_ray3.h"
+#include "vgl_vec3.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// An axis-aligned bounding box. The default constructor gives an empty box,
+// with low above high, which merging anything into replaces entirely.
+template <typename Num>
+struct AABB3 {
+  Vec3<Num> low, high;
+
+  AABB3() : low(std::numeric_limits<Num>::max()), high(-std::numeric_limits<Num>::max()) {}
+  AABB3(const Vec3<Num>& iLow, const Vec3<Num>& iHigh) : low(iLow), high(iHigh) {}
+  AABB3(const AABB3& a) : low(a.low), high(a.high) {}
+};
+
+
+typedef AABB3<float> AABB3f;
+typedef AABB3<double> AABB3d;
+
+
+// A ray set up for testing against lots of boxes: the reciprocal of the
+// direction and which of each pair of slabs the ray reaches first are
+// worked out once, instead of in every intersectRayBox call (Williams et al,
+// "An Efficient and Robust Ray-Box Intersection Algorithm", 2005).
+template <typename Num>
+struct SlabRay3 {
+  Vec3<Num> o, invD;
+  unsigned int sign[3]; // 1 where the direction is negative, i.e. high comes first.
+
+  SlabRay3() {}
+  explicit SlabRay3(const Ray3<Num>& ray) : o(ray.o), invD(Vec3<Num>(1) / ray.d)
+  {
+    for (unsigned int i = 0; i < 3; ++i)
+      sign[i] = (invD[i] < 0) ? 1 : 0;
+  }
+};
+
+
+typedef SlabRay3<float> SlabRay3f;
+typedef SlabRay3<double> SlabRay3d;
+
+
+//
+// FUNCTIONS
+//
+
+template <typename Num>
+bool isEmpty(const AABB3<Num>& box)
+{
+  return box.low.x > box.high.x || box.low.y > box.high.y || box.low.z > box.high.z;
+}
+
+
+template <typename Num>
+Vec3<Num> center(const AABB3<Num>& box)
+{
+  return (box.low + box.high) / Num(2);
+}
+
+
+// The size along each axis.
+template <typename Num>
+Vec3<Num> extent(const AABB3<Num>& box)
+{
+  return box.high - box.low;
+}
+
+
+// Zero for an empty box.
+template <typename Num>
+Num surfaceArea(const AABB3<Num>& box)
+{
+  if (isEmpty(box))
+    return 0;
+  Vec3<Num> d = extent(box);
+  return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+
+template <typename Num>
+bool contains(const AABB3<Num>& box, const Vec3<Num>& p)
+{
+  return p.x >= box.low.x && p.y >= box.low.y && p.z >= box.low.z &&
+         p.x <= box.high.x && p.y <= box.high.y && p.z <= box.high.z;
+}
+
+
+// The smallest box containing both arguments.
+template <typename Num>
+AABB3<Num> merge(const AABB3<Num>& box, const Vec3<Num>& p)
+{
+  return AABB3<Num>(pairwiseMin(box.low, p), pairwiseMax(box.high, p));
+}
+
+
+template <typename Num>
+AABB3<Num> merge(const AABB3<Num>& a, const AABB3<Num>& b)
+{
+  return AABB3<Num>(pairwiseMin(a.low, b.low), pairwiseMax(a.high, b.high));
+}
+
+
+// The region inside both boxes, which is empty if they don't overlap.
+template <typename Num>
+AABB3<Num> intersection(const AABB3<Num>& a, const AABB3<Num>& b)
+{
+  return AABB3<Num>(pairwiseMax(a.low, b.low), pairwiseMin(a.high, b.high));
+}
+
+
+template <typename Num>
+bool overlaps(const AABB3<Num>& a, const AABB3<Num>& b)
+{
+  return !isEmpty(intersection(a, b));
+}
+
+
+// The bounds of the transformed box, found without transforming all eight
+// corners (Arvo's method): each entry of the matrix scales either the low or
+// the high side of the box, whichever gives the smaller or larger result.
+// Like transformPoint, the bottom row of the matrix is ignored.
+template <typename Num>
+AABB3<Num> transformBox(const Matrix4<Num>& m, const AABB3<Num>& box)
+{
+  if (isEmpty(box))
+    return box;
+
+  AABB3<Num> result;
+  for (unsigned int row = 0; row < 3; ++row) {
+    Num low = m[row][3], high = m[row][3];
+    for (unsigned int col = 0; col < 3; ++col) {
+      Num a = m[row][col] * box.low[col];
+      Num b = m[row][col] * box.high[col];
+      low += std::min(a, b);
+      high += std::max(a, b);
+    }
+    result.low[row] = low;
+    result.high[row] = high;
+  }
+  return result;
+}
+
+
+// Slab test. On a hit, tNear and tFar are where the ray enters and leaves the
+// box; tNear is negative if the ray starts inside it. Hits behind the origin
+// don't count. Zero components in the ray direction are fine, except that a
+// ray lying exactly in the plane of a face may or may not hit.
+template <typename Num>
+bool intersectRayBox(const Ray3<Num>& ray, const AABB3<Num>& box, Num& tNear, Num& tFar)
+{
+  Vec3<Num> invD = Vec3<Num>(1) / ray.d;
+  Vec3<Num> t0 = (box.low - ray.o) * invD;
+  Vec3<Num> t1 = (box.high - ray.o) * invD;
+  Vec3<Num> tMin = pairwiseMin(t0, t1);
+  Vec3<Num> tMax = pairwiseMax(t0, t1);
+  tNear = std::max(tMin.x, std::max(tMin.y, tMin.z));
+  tFar = std::min(tMax.x, std::min(tMax.y, tMax.z));
+  return tNear <= tFar && tFar >= 0;
+}
+
+
+// The same test with the per-ray work done up front. Knowing which slab
+// comes first means no min/max per axis, and there's no division.
+template <typename Num>
+bool intersectRayBox(const SlabRay3<Num>& ray, const AABB3<Num>& box, Num& tNear, Num& tFar)
+{
+  const Vec3<Num>* bounds[2] = { &box.low, &box.high };
+  Num txNear = ((*bounds[ray.sign[0]]).x - ray.o.x) * ray.invD.x;
+  Num txFar = ((*bounds[1 - ray.sign[0]]).x - ray.o.x) * ray.invD.x;
+  Num tyNear = ((*bounds[ray.sign[1]]).y - ray.o.y) * ray.invD.y;
+  Num tyFar = ((*bounds[1 - ray.sign[1]]).y - ray.o.y) * ray.invD.y;
+  Num tzNear = ((*bounds[ray.sign[2]]).z - ray.o.z) * ray.invD.z;
+  Num tzFar = ((*bounds[1 - ray.sign[2]]).z - ray.o.z) * ray.invD.z;
+  tNear = std::max(txNear, std::max(tyNear, tzNear));
+  tFar = std::min(txFar, std::min(tyFar, tzFar));
+  return tNear <= tFar && tFar >= 0;
+}
+
+
+// The bounds of an array of points, using SSE, AVX or AVX-512 depending on
+// what the CPU supports; big arrays are split into blocks which are processed
+// in parallel with OpenMP. This only reads each point once, so for arrays
+// larger than the cache it runs at the speed of memory. Returns an empty box
+// if count is zero.
+AABB3f computeBounds(const Vec3f* points, size_t count);
+
+
+} // namespace vgl
+
+#endif // vgl_aabb3_h
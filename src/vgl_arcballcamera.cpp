@@ -37,8 +37,11 @@ void ArcballCamera::roll(int prevX, int prevY, int currX, int currY)
   prevY = (_pixelHeight - 1) - prevY;
   currY = (_pixelHeight - 1) - currY;
 
-  Vec3f prev = unproject(prevX, prevY);
-  Vec3f curr = unproject(currX, currY);
+  Matrix4f modelView = getModelViewMatrix();
+  Matrix4f projection = getProjectionMatrix();
+  Vec4i viewport = getViewport();
+  Vec3f prev = unproject(Vec3f(prevX, prevY, 0.5f), modelView, projection, viewport);
+  Vec3f curr = unproject(Vec3f(currX, currY, 0.5f), modelView, projection, viewport);
 
   const float kSphereRadius = 1;
 
@@ -69,8 +72,11 @@ void ArcballCamera::move(int prevX, int prevY, int currX, int currY)
   prevY = (_pixelHeight - 1) - prevY;
   currY = (_pixelHeight - 1) - currY;
 
-  Vec3f prev = unproject(prevX, prevY, 0.6);
-  Vec3f curr = unproject(currX, currY, 0.6);
+  Matrix4f modelView = getModelViewMatrix();
+  Matrix4f projection = getProjectionMatrix();
+  Vec4i viewport = getViewport();
+  Vec3f prev = unproject(Vec3f(prevX, prevY, 0.6f), modelView, projection, viewport);
+  Vec3f curr = unproject(Vec3f(currX, currY, 0.6f), modelView, projection, viewport);
   Vec3f delta = curr - prev;
 
   // Because we're moving the camera not the scene, we need to do the
@@ -0,0 +1,272 @@
+#include "vgl_atlas.h"
+
+#include "vgl_convert.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace vgl {
+
+//
+// HELPER FUNCTIONS
+//
+
+// Sorts image indexes tallest first, then widest first.
+struct TallerFirst {
+  RawImage* const* images;
+
+  TallerFirst(RawImage* const* images) : images(images) {}
+
+  bool operator () (unsigned int a, unsigned int b) const
+  {
+    if (images[a]->getHeight() != images[b]->getHeight())
+      return images[a]->getHeight() > images[b]->getHeight();
+    if (images[a]->getWidth() != images[b]->getWidth())
+      return images[a]->getWidth() > images[b]->getWidth();
+    return a < b;
+  }
+};
+
+
+//
+// TextureAtlas::Skyline
+//
+
+// The top edge of everything placed on a page so far, as a list of horizontal
+// segments ordered from left to right. New rectangles are placed resting on
+// the skyline at the lowest point they'll fit, leftmost on ties.
+struct TextureAtlas::Skyline {
+  struct Segment {
+    unsigned int x, y, width;
+  };
+
+  unsigned int pageWidth, pageHeight;
+  std::vector<Segment> segments;
+
+  Skyline(unsigned int w, unsigned int h) : pageWidth(w), pageHeight(h)
+  {
+    Segment s = { 0, 0, w };
+    segments.push_back(s);
+  }
+
+  // The height a w x h rectangle would rest at if its left edge was at the
+  // start of segment i, or false if it doesn't fit there.
+  bool fitAt(size_t i, unsigned int w, unsigned int h, unsigned int& y) const
+  {
+    unsigned int x = segments[i].x;
+    if (x + w > pageWidth)
+      return false;
+    y = 0;
+    unsigned int covered = 0;
+    for (size_t j = i; covered < w; ++j) {
+      y = std::max(y, segments[j].y);
+      if (y + h > pageHeight)
+        return false;
+      covered += segments[j].width;
+    }
+    return true;
+  }
+
+  bool find(unsigned int w, unsigned int h, unsigned int& x, unsigned int& y) const
+  {
+    bool found = false;
+    for (size_t i = 0; i < segments.size(); ++i) {
+      unsigned int fitY;
+      if (fitAt(i, w, h, fitY) && (!found || fitY < y)) {
+        found = true;
+        x = segments[i].x;
+        y = fitY;
+      }
+    }
+    return found;
+  }
+
+  void add(unsigned int x, unsigned int y, unsigned int w, unsigned int h)
+  {
+    size_t i = 0;
+    while (segments[i].x != x)
+      ++i;
+
+    // Trim or remove the segments which are now underneath the new one.
+    unsigned int right = x + w;
+    size_t j = i;
+    while (j < segments.size() && segments[j].x + segments[j].width <= right)
+      ++j;
+    if (j < segments.size() && segments[j].x < right) {
+      segments[j].width -= right - segments[j].x;
+      segments[j].x = right;
+    }
+    Segment s = { x, y + h, w };
+    segments.erase(segments.begin() + i, segments.begin() + j);
+    segments.insert(segments.begin() + i, s);
+
+    // Merge with neighbours at the same height.
+    if (i + 1 < segments.size() && segments[i + 1].y == segments[i].y) {
+      segments[i].width += segments[i + 1].width;
+      segments.erase(segments.begin() + i + 1);
+    }
+    if (i > 0 && segments[i - 1].y == segments[i].y) {
+      segments[i - 1].width += segments[i].width;
+      segments.erase(segments.begin() + i);
+    }
+  }
+};
+
+
+//
+// TextureAtlas METHODS
+//
+
+TextureAtlas::TextureAtlas(unsigned int pageWidth, unsigned int pageHeight,
+    unsigned int padding, int pageType, int pagePixelType) :
+  _pageWidth(pageWidth),
+  _pageHeight(pageHeight),
+  _padding(padding),
+  _pageType(pageType),
+  _pagePixelType(pagePixelType),
+  _pages(),
+  _rects()
+{
+}
+
+
+TextureAtlas::~TextureAtlas()
+{
+  for (size_t i = 0; i < _pages.size(); ++i)
+    delete _pages[i];
+}
+
+
+void TextureAtlas::build(RawImage* const* images, unsigned int count) throw(ImageException)
+{
+  const unsigned int pad2 = 2 * _padding;
+  for (unsigned int i = 0; i < count; ++i) {
+    if (images[i]->getWidth() + pad2 > _pageWidth || images[i]->getHeight() + pad2 > _pageHeight)
+      throw ImageException("Image %u (%ux%u) is too big for a %ux%u atlas page with %u pixels of padding.",
+          i, images[i]->getWidth(), images[i]->getHeight(), _pageWidth, _pageHeight, _padding);
+  }
+
+  for (size_t i = 0; i < _pages.size(); ++i)
+    delete _pages[i];
+  _pages.clear();
+  _rects.assign(count, AtlasRect());
+
+  // Pack. This is cheap compared to the blitting, so it's done serially.
+  std::vector<unsigned int> order(count);
+  for (unsigned int i = 0; i < count; ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), TallerFirst(images));
+
+  std::vector<Skyline> skylines;
+  for (unsigned int k = 0; k < count; ++k) {
+    unsigned int i = order[k];
+    unsigned int w = images[i]->getWidth();
+    unsigned int h = images[i]->getHeight();
+    unsigned int x = 0, y = 0;
+    size_t page = 0;
+    while (page < skylines.size() && !skylines[page].find(w + pad2, h + pad2, x, y))
+      ++page;
+    if (page == skylines.size()) {
+      skylines.push_back(Skyline(_pageWidth, _pageHeight));
+      x = y = 0;
+    }
+    skylines[page].add(x, y, w + pad2, h + pad2);
+
+    AtlasRect& r = _rects[i];
+    r.page = (unsigned int)page;
+    r.x = x + _padding;
+    r.y = y + _padding;
+    r.width = w;
+    r.height = h;
+    r.u0 = float(r.x) / _pageWidth;
+    r.v0 = float(r.y) / _pageHeight;
+    r.u1 = float(r.x + w) / _pageWidth;
+    r.v1 = float(r.y + h) / _pageHeight;
+  }
+
+  unsigned int bpp = channelsForType(_pageType) * bytesPerChannelForPixelType(_pagePixelType);
+  for (size_t page = 0; page < skylines.size(); ++page) {
+    RawImage* img = new RawImage(_pageType, bpp, _pageWidth, _pageHeight, _pagePixelType);
+    memset(img->getPixels(), 0, size_t(bpp) * _pageWidth * _pageHeight);
+    _pages.push_back(img);
+  }
+
+  // Every image owns its own padded rectangle, so they can all be blitted at
+  // once.
+  #pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < (int)count; ++i)
+    blit(images[i], _rects[i]);
+}
+
+
+unsigned int TextureAtlas::getNumPages() const
+{
+  return (unsigned int)_pages.size();
+}
+
+
+RawImage* TextureAtlas::getPage(unsigned int page)
+{
+  return _pages[page];
+}
+
+
+const AtlasRect& TextureAtlas::getRect(unsigned int image) const
+{
+  return _rects[image];
+}
+
+
+void TextureAtlas::remapUV(unsigned int image, float& u, float& v) const
+{
+  const AtlasRect& r = _rects[image];
+  u = r.u0 + u * (r.u1 - r.u0);
+  v = r.v0 + v * (r.v1 - r.v0);
+}
+
+
+void TextureAtlas::uploadTextures()
+{
+  for (size_t i = 0; i < _pages.size(); ++i)
+    _pages[i]->uploadTexture();
+}
+
+
+// Copies src into its rectangle on the page, converting it to the page format,
+// then fills the padding around it by extending the edge pixels outwards.
+void TextureAtlas::blit(RawImage* src, const AtlasRect& rect)
+{
+  if (rect.width == 0 || rect.height == 0)
+    return;
+
+  RawImage* page = _pages[rect.page];
+  const unsigned int bpp = page->getBytesPerPixel();
+  const size_t pageStride = size_t(_pageWidth) * bpp;
+  const size_t srcStride = size_t(src->getWidth()) * src->getBytesPerPixel();
+  const bool flip = src->getOrigin() != page->getOrigin();
+  unsigned char* dst = page->getPixels() + rect.y * pageStride + size_t(rect.x) * bpp;
+
+  for (unsigned int y = 0; y < rect.height; ++y) {
+    unsigned int srcRow = flip ? rect.height - 1 - y : y;
+    unsigned char* row = dst + y * pageStride;
+    convertPixels(src->getPixels() + srcRow * srcStride, src->getType(), row, _pageType,
+        rect.width, 1, src->getPixelType(), _pagePixelType);
+    for (unsigned int p = 1; p <= _padding; ++p) {
+      memcpy(row - size_t(p) * bpp, row, bpp);
+      memcpy(row + size_t(rect.width - 1 + p) * bpp, row + size_t(rect.width - 1) * bpp, bpp);
+    }
+  }
+
+  const size_t paddedBytes = size_t(rect.width + 2 * _padding) * bpp;
+  unsigned char* bottom = dst - size_t(_padding) * bpp;
+  unsigned char* top = bottom + (rect.height - 1) * pageStride;
+  for (unsigned int p = 1; p <= _padding; ++p) {
+    memcpy(bottom - p * pageStride, bottom, paddedBytes);
+    memcpy(top + p * pageStride, top, paddedBytes);
+  }
+}
+
+
+} // namespace vgl
+
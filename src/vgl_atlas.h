@@ -0,0 +1,80 @@
+#ifndef vgl_atlas_h
+#define vgl_atlas_h
+
+#include "vgl_image.h"
+
+#include <vector>
+
+namespace vgl {
+
+//
+// Types
+//
+
+// Where one of the source images ended up in the atlas. x, y, width and
+// height are in pixels within the page, excluding the padding; u0, v0, u1 and
+// v1 are the same rectangle as texture coordinates.
+struct AtlasRect {
+  unsigned int page;
+  unsigned int x, y, width, height;
+  float u0, v0, u1, v1;
+};
+
+
+// Packs lots of small images into a few large pages, so they can share a
+// texture (and a texture bind).
+//
+// Images are placed using a skyline bottom-left packer, tallest first, and
+// then blitted into the pages in parallel. Each image gets a border of
+// padding pixels, filled by extending its edge pixels, so that bilinear
+// filtering and mipmapping don't bleed neighbouring images into it. Anything
+// which relies on texture coordinates wrapping around can't be atlased.
+//
+// Images of any type get converted to the page type as they're copied in.
+class TextureAtlas {
+public:
+  TextureAtlas(unsigned int pageWidth, unsigned int pageHeight,
+      unsigned int padding = 2, int pageType = GL_RGBA,
+      int pagePixelType = GL_UNSIGNED_BYTE);
+  ~TextureAtlas();
+
+  //! Pack and blit the images. Throws an ImageException if any of them is
+  //! too big to fit on a page. Calling it again replaces the old pages.
+  void build(RawImage* const* images, unsigned int count) throw(ImageException);
+
+  unsigned int getNumPages() const;
+  RawImage* getPage(unsigned int page);
+
+  //! Where the image with the given index (as passed to build) ended up.
+  const AtlasRect& getRect(unsigned int image) const;
+
+  //! Rewrite a texture coordinate for the original image so that it refers
+  //! to the same point in the atlas page.
+  void remapUV(unsigned int image, float& u, float& v) const;
+
+  //! Upload all the pages. Each gets a new texture ID, see getPage(i)->getTexID().
+  void uploadTextures();
+
+private:
+  struct Skyline;
+
+  // Not copyable.
+  TextureAtlas(const TextureAtlas& other);
+  TextureAtlas& operator = (const TextureAtlas& other);
+
+  void blit(RawImage* src, const AtlasRect& rect);
+
+private:
+  unsigned int _pageWidth, _pageHeight;
+  unsigned int _padding;
+  int _pageType;
+  int _pagePixelType;
+  std::vector<RawImage*> _pages;
+  std::vector<AtlasRect> _rects;
+};
+
+
+} // namespace vgl
+
+#endif // vgl_atlas_h
+
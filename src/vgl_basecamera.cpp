@@ -193,17 +193,40 @@ float BaseCamera::distanceFrom(float highU, float lowU, float highV, float lowV)
 }
 
 
+// These load the same matrices that get*Matrix() return, rather than calling
+// gluPerspective and gluLookAt, so that unprojecting on the CPU always matches
+// what was drawn. GL wants them column by column, hence the transposes.
 void BaseCamera::setupProjectionMatrix()
 {
-  float distance = length(_target - _pos);
-  gluPerspective(_aperture, float(_pixelWidth) / float(_pixelHeight),
-      distance * 0.1, distance * 2.0);
+  Matrix4f m = transpose(getProjectionMatrix());
+  glMultMatrixf(m.data);
 }
 
 
 void BaseCamera::setupModelViewMatrix()
 {
-  gluLookAt(_pos.x, _pos.y, _pos.z, _target.x, _target.y, _target.z, _up.x, _up.y, _up.z);
+  Matrix4f m = transpose(getModelViewMatrix());
+  glMultMatrixf(m.data);
+}
+
+
+Matrix4f BaseCamera::getProjectionMatrix() const
+{
+  float distance = length(_target - _pos);
+  return perspective(_aperture, float(_pixelWidth) / float(_pixelHeight),
+      distance * 0.1f, distance * 2.0f);
+}
+
+
+Matrix4f BaseCamera::getModelViewMatrix() const
+{
+  return lookAt(_pos, _target, _up);
+}
+
+
+Vec4i BaseCamera::getViewport() const
+{
+  return Vec4i(0, 0, _pixelWidth, _pixelHeight);
 }
 
 
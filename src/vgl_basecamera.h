@@ -32,6 +32,10 @@ public:
   virtual void setupProjectionMatrix();
   virtual void setupModelViewMatrix();
 
+  virtual Matrix4f getProjectionMatrix() const;
+  virtual Matrix4f getModelViewMatrix() const;
+  virtual Vec4i getViewport() const;
+
 protected:
   float distanceFrom(float highU, float lowU, float highV, float lowV) const;
 
@@ -1,7 +1,9 @@
 #ifndef vgl_camera_h
 #define vgl_camera_h
 
+#include "vgl_matrix4.h"
 #include "vgl_vec3.h"
+#include "vgl_vec4.h"
 
 namespace vgl {
 
@@ -24,6 +26,13 @@ public:
 
   virtual void setupProjectionMatrix() = 0;
   virtual void setupModelViewMatrix() = 0;
+
+  // The matrices and viewport the camera sets up, worked out on the CPU so
+  // they can be used with project() and unproject() without touching GL.
+  // The viewport is (x, y, width, height) as for glViewport.
+  virtual Matrix4f getProjectionMatrix() const = 0;
+  virtual Matrix4f getModelViewMatrix() const = 0;
+  virtual Vec4i getViewport() const = 0;
 };
 
 
@@ -0,0 +1,1374 @@
+#include "vgl_compressedimage.h"
+
+#include "vgl_convert.h"
+#include "vgl_mipchain.h"
+#include "vgl_pixelpool.h"
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <libgen.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef VGL_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RED_RGTC1
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+// std::min takes its arguments by reference, so this needs a definition.
+const unsigned int CompressedImage::kMaxLevels;
+
+// BC7 interpolation weights for 4 bit indices, out of 64.
+static const int kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const unsigned char kKTXIdentifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const unsigned char kKTX2Identifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// Mapping from the format codes used in DDS, KTX and KTX2 files to ours.
+struct FileFormat {
+  unsigned int code;
+  BlockFormat format;
+  int glFormat;
+};
+
+// DXGI_FORMAT values, from the DX10 extension to the DDS header.
+static const FileFormat kDXGIFormats[] = {
+  { 71, BLOCK_BC1,  GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+  { 72, BLOCK_BC1,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+  { 74, BLOCK_BC2,  GL_COMPRESSED_RGBA_S3TC_DXT3_EXT },
+  { 75, BLOCK_BC2,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT },
+  { 77, BLOCK_BC3,  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+  { 78, BLOCK_BC3,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+  { 80, BLOCK_BC4,  GL_COMPRESSED_RED_RGTC1 },
+  { 83, BLOCK_BC5,  GL_COMPRESSED_RG_RGTC2 },
+  { 95, BLOCK_BC6H, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT },
+  { 96, BLOCK_BC6H, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT },
+  { 98, BLOCK_BC7,  GL_COMPRESSED_RGBA_BPTC_UNORM },
+  { 99, BLOCK_BC7,  GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM },
+  { 0, BLOCK_BC1, 0 }
+};
+
+// VkFormat values, used by KTX2.
+static const FileFormat kVkFormats[] = {
+  { 131, BLOCK_BC1,  GL_COMPRESSED_RGB_S3TC_DXT1_EXT },
+  { 132, BLOCK_BC1,  GL_COMPRESSED_SRGB_S3TC_DXT1_EXT },
+  { 133, BLOCK_BC1,  GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+  { 134, BLOCK_BC1,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+  { 135, BLOCK_BC2,  GL_COMPRESSED_RGBA_S3TC_DXT3_EXT },
+  { 136, BLOCK_BC2,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT },
+  { 137, BLOCK_BC3,  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+  { 138, BLOCK_BC3,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+  { 139, BLOCK_BC4,  GL_COMPRESSED_RED_RGTC1 },
+  { 141, BLOCK_BC5,  GL_COMPRESSED_RG_RGTC2 },
+  { 143, BLOCK_BC6H, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT },
+  { 144, BLOCK_BC6H, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT },
+  { 145, BLOCK_BC7,  GL_COMPRESSED_RGBA_BPTC_UNORM },
+  { 146, BLOCK_BC7,  GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM },
+  { 0, BLOCK_BC1, 0 }
+};
+
+// GL internal formats, used by KTX.
+static const FileFormat kGLFormats[] = {
+  { GL_COMPRESSED_RGB_S3TC_DXT1_EXT,         BLOCK_BC1,  0 },
+  { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,        BLOCK_BC1,  0 },
+  { GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,        BLOCK_BC1,  0 },
+  { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,  BLOCK_BC1,  0 },
+  { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,        BLOCK_BC2,  0 },
+  { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,  BLOCK_BC2,  0 },
+  { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,        BLOCK_BC3,  0 },
+  { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,  BLOCK_BC3,  0 },
+  { GL_COMPRESSED_RED_RGTC1,                 BLOCK_BC4,  0 },
+  { GL_COMPRESSED_RG_RGTC2,                  BLOCK_BC5,  0 },
+  { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,   BLOCK_BC6H, 0 },
+  { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,     BLOCK_BC6H, 0 },
+  { GL_COMPRESSED_RGBA_BPTC_UNORM,           BLOCK_BC7,  0 },
+  { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,     BLOCK_BC7,  0 },
+  { 0, BLOCK_BC1, 0 }
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+// Blocks are worked on as 16 pixels stored channel by channel, as floats:
+// px[c * 16 + i] is channel c of pixel i. Channels that a format doesn't
+// encode are zeroed, both in the pixels and the palettes, so the same search
+// works for every format.
+//
+
+// Finds the nearest of numEntries palette entries (stored like the pixels,
+// pal[c * 16 + j]) for each pixel, returning the total squared error.
+static float selectIndices(const float* px, const float* pal, unsigned int numEntries,
+    unsigned char* indices)
+{
+#ifdef VGL_SIMD_X86
+  // Four pixels at a time.
+  float total = 0.0f;
+  for (unsigned int i = 0; i < 16; i += 4) {
+    __m128 r = _mm_loadu_ps(px + i);
+    __m128 g = _mm_loadu_ps(px + 16 + i);
+    __m128 b = _mm_loadu_ps(px + 32 + i);
+    __m128 a = _mm_loadu_ps(px + 48 + i);
+    __m128 best = _mm_set1_ps(FLT_MAX);
+    __m128i bestIndex = _mm_setzero_si128();
+    for (unsigned int j = 0; j < numEntries; ++j) {
+      __m128 dr = _mm_sub_ps(r, _mm_set1_ps(pal[j]));
+      __m128 dg = _mm_sub_ps(g, _mm_set1_ps(pal[16 + j]));
+      __m128 db = _mm_sub_ps(b, _mm_set1_ps(pal[32 + j]));
+      __m128 da = _mm_sub_ps(a, _mm_set1_ps(pal[48 + j]));
+      __m128 err = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                              _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+      __m128i closer = _mm_castps_si128(_mm_cmplt_ps(err, best));
+      best = _mm_min_ps(err, best);
+      bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(j)),
+                               _mm_andnot_si128(closer, bestIndex));
+    }
+    float errs[4];
+    int idx[4];
+    _mm_storeu_ps(errs, best);
+    _mm_storeu_si128((__m128i*)idx, bestIndex);
+    for (unsigned int k = 0; k < 4; ++k) {
+      total += errs[k];
+      indices[i + k] = (unsigned char)idx[k];
+    }
+  }
+  return total;
+#else
+  float total = 0.0f;
+  for (unsigned int i = 0; i < 16; ++i) {
+    float best = FLT_MAX;
+    unsigned int bestIndex = 0;
+    for (unsigned int j = 0; j < numEntries; ++j) {
+      float dr = px[i] - pal[j];
+      float dg = px[16 + i] - pal[16 + j];
+      float db = px[32 + i] - pal[32 + j];
+      float da = px[48 + i] - pal[48 + j];
+      float err = (dr * dr + dg * dg) + (db * db + da * da);
+      if (err < best) {
+        best = err;
+        bestIndex = j;
+      }
+    }
+    total += best;
+    indices[i] = (unsigned char)bestIndex;
+  }
+  return total;
+#endif
+}
+
+
+// Fits a line through the pixels (over the first numChannels channels) and
+// returns the points where the pixels' projections onto it start and end.
+static void principalEndpoints(const float* px, unsigned int numChannels, float* lo, float* hi)
+{
+  float mean[4] = { 0, 0, 0, 0 };
+  for (unsigned int c = 0; c < numChannels; ++c) {
+    for (unsigned int i = 0; i < 16; ++i)
+      mean[c] += px[c * 16 + i];
+    mean[c] /= 16.0f;
+  }
+
+  float cov[4][4];
+  for (unsigned int c = 0; c < numChannels; ++c) {
+    for (unsigned int d = c; d < numChannels; ++d) {
+      float sum = 0.0f;
+      for (unsigned int i = 0; i < 16; ++i)
+        sum += (px[c * 16 + i] - mean[c]) * (px[d * 16 + i] - mean[d]);
+      cov[c][d] = cov[d][c] = sum;
+    }
+  }
+
+  // Power iteration, starting from the diagonal of the bounding box.
+  float axis[4] = { 0, 0, 0, 0 };
+  for (unsigned int c = 0; c < numChannels; ++c) {
+    float mn = px[c * 16], mx = px[c * 16];
+    for (unsigned int i = 1; i < 16; ++i) {
+      mn = std::min(mn, px[c * 16 + i]);
+      mx = std::max(mx, px[c * 16 + i]);
+    }
+    axis[c] = mx - mn + 1e-3f;
+  }
+  for (unsigned int iter = 0; iter < 8; ++iter) {
+    float next[4] = { 0, 0, 0, 0 };
+    float len = 0.0f;
+    for (unsigned int c = 0; c < numChannels; ++c) {
+      for (unsigned int d = 0; d < numChannels; ++d)
+        next[c] += cov[c][d] * axis[d];
+      len = std::max(len, std::fabs(next[c]));
+    }
+    if (len < 1e-6f)
+      break;
+    for (unsigned int c = 0; c < numChannels; ++c)
+      axis[c] = next[c] / len;
+  }
+  float lenSqr = 0.0f;
+  for (unsigned int c = 0; c < numChannels; ++c)
+    lenSqr += axis[c] * axis[c];
+
+  float tMin = 0.0f, tMax = 0.0f;
+  for (unsigned int i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (unsigned int c = 0; c < numChannels; ++c)
+      t += (px[c * 16 + i] - mean[c]) * axis[c];
+    t /= lenSqr;
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  for (unsigned int c = 0; c < numChannels; ++c) {
+    lo[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMin));
+    hi[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMax));
+  }
+}
+
+
+// Least squares fit of a pair of endpoints to the pixels, given each pixel's
+// weight towards the first endpoint. Returns false if the weights are
+// degenerate (e.g. all the same).
+static bool fitEndpoints(const float* px, unsigned int numChannels, const float* weights,
+    float* e0, float* e1)
+{
+  float a = 0.0f, b = 0.0f, c = 0.0f;
+  float x[4] = { 0, 0, 0, 0 }, y[4] = { 0, 0, 0, 0 };
+  for (unsigned int i = 0; i < 16; ++i) {
+    float w = weights[i];
+    a += w * w;
+    b += w * (1.0f - w);
+    c += (1.0f - w) * (1.0f - w);
+    for (unsigned int ch = 0; ch < numChannels; ++ch) {
+      x[ch] += w * px[ch * 16 + i];
+      y[ch] += (1.0f - w) * px[ch * 16 + i];
+    }
+  }
+  float det = a * c - b * b;
+  if (std::fabs(det) < 1e-6f)
+    return false;
+  for (unsigned int ch = 0; ch < numChannels; ++ch) {
+    e0[ch] = std::min(255.0f, std::max(0.0f, (c * x[ch] - b * y[ch]) / det));
+    e1[ch] = std::min(255.0f, std::max(0.0f, (a * y[ch] - b * x[ch]) / det));
+  }
+  return true;
+}
+
+
+static void boundingBox(const float* px, unsigned int numChannels, float* lo, float* hi)
+{
+  for (unsigned int c = 0; c < numChannels; ++c) {
+    lo[c] = hi[c] = px[c * 16];
+    for (unsigned int i = 1; i < 16; ++i) {
+      lo[c] = std::min(lo[c], px[c * 16 + i]);
+      hi[c] = std::max(hi[c], px[c * 16 + i]);
+    }
+  }
+}
+
+
+static void putLE16(unsigned char* dst, unsigned int value)
+{
+  dst[0] = (unsigned char)(value & 0xFF);
+  dst[1] = (unsigned char)(value >> 8);
+}
+
+
+//
+// BC1 colour blocks
+//
+
+static unsigned int to565(const float* rgb)
+{
+  unsigned int r = (unsigned int)(rgb[0] * (31.0f / 255.0f) + 0.5f);
+  unsigned int g = (unsigned int)(rgb[1] * (63.0f / 255.0f) + 0.5f);
+  unsigned int b = (unsigned int)(rgb[2] * (31.0f / 255.0f) + 0.5f);
+  return (r << 11) | (g << 5) | b;
+}
+
+
+static void from565(unsigned int c, int* rgb)
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+// The four colour palette for c0 > c1. Used for scoring whatever order the
+// endpoints are in, since they get swapped into that order when written.
+static void bc1Palette(unsigned int c0, unsigned int c1, int pal[4][3])
+{
+  from565(c0, pal[0]);
+  from565(c1, pal[1]);
+  for (unsigned int c = 0; c < 3; ++c) {
+    pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+    pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+  }
+}
+
+
+static float evaluateBC1(const float* px, unsigned int c0, unsigned int c1, unsigned char* indices)
+{
+  int colors[4][3];
+  bc1Palette(c0, c1, colors);
+  float pal[64];
+  memset(pal, 0, sizeof(pal));
+  for (unsigned int j = 0; j < 4; ++j) {
+    for (unsigned int c = 0; c < 3; ++c)
+      pal[c * 16 + j] = float(colors[j][c]);
+  }
+  return selectIndices(px, pal, 4, indices);
+}
+
+
+// px must have its alpha channel zeroed.
+static void encodeBC1Block(const float* px, unsigned char* out)
+{
+  static const float kWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+  float lo[3], hi[3], boxLo[3], boxHi[3];
+  principalEndpoints(px, 3, lo, hi);
+  boundingBox(px, 3, boxLo, boxHi);
+
+  unsigned int candidates[2][2] = {
+    { to565(hi), to565(lo) },
+    { to565(boxHi), to565(boxLo) }
+  };
+  unsigned int c0 = 0, c1 = 0;
+  unsigned char indices[16], tmp[16];
+  float bestErr = FLT_MAX;
+  for (unsigned int k = 0; k < 2; ++k) {
+    float err = evaluateBC1(px, candidates[k][0], candidates[k][1], tmp);
+    if (err < bestErr) {
+      bestErr = err;
+      c0 = candidates[k][0];
+      c1 = candidates[k][1];
+      memcpy(indices, tmp, 16);
+    }
+  }
+
+  for (unsigned int iter = 0; iter < 2 && bestErr > 0.0f; ++iter) {
+    float weights[16], e0[3], e1[3];
+    for (unsigned int i = 0; i < 16; ++i)
+      weights[i] = kWeights[indices[i]];
+    if (!fitEndpoints(px, 3, weights, e0, e1))
+      break;
+    unsigned int n0 = to565(e0), n1 = to565(e1);
+    float err = evaluateBC1(px, n0, n1, tmp);
+    if (err >= bestErr)
+      break;
+    bestErr = err;
+    c0 = n0;
+    c1 = n1;
+    memcpy(indices, tmp, 16);
+  }
+
+  // c0 > c1 selects the four colour mode. Swapping the endpoints swaps
+  // indices 0 with 1 and 2 with 3.
+  if (c0 < c1) {
+    std::swap(c0, c1);
+    for (unsigned int i = 0; i < 16; ++i)
+      indices[i] ^= 1;
+  } else if (c0 == c1) {
+    memset(indices, 0, 16);
+  }
+
+  unsigned int bits = 0;
+  for (unsigned int i = 0; i < 16; ++i)
+    bits |= (unsigned int)indices[i] << (2 * i);
+  putLE16(out, c0);
+  putLE16(out + 2, c1);
+  putLE16(out + 4, bits & 0xFFFF);
+  putLE16(out + 6, bits >> 16);
+}
+
+
+static void decodeBC1Block(const unsigned char* in, unsigned char* rgba, bool forceFourColors)
+{
+  unsigned int c0 = in[0] | (in[1] << 8);
+  unsigned int c1 = in[2] | (in[3] << 8);
+  unsigned int bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int)in[7] << 24);
+
+  int pal[4][4];
+  from565(c0, pal[0]);
+  from565(c1, pal[1]);
+  pal[0][3] = pal[1][3] = pal[2][3] = pal[3][3] = 255;
+  for (unsigned int c = 0; c < 3; ++c) {
+    if (c0 > c1 || forceFourColors) {
+      pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+      pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+    } else {
+      pal[2][c] = (pal[0][c] + pal[1][c]) / 2;
+      pal[3][c] = 0;
+    }
+  }
+  if (c0 <= c1 && !forceFourColors)
+    pal[3][3] = 0;
+
+  for (unsigned int i = 0; i < 16; ++i) {
+    unsigned int idx = (bits >> (2 * i)) & 3;
+    for (unsigned int c = 0; c < 4; ++c)
+      rgba[i * 4 + c] = (unsigned char)pal[idx][c];
+  }
+}
+
+
+static void decodeBC2Alpha(const unsigned char* in, unsigned char* rgba)
+{
+  for (unsigned int i = 0; i < 16; ++i) {
+    unsigned int a = (in[i / 2] >> ((i & 1) * 4)) & 0xF;
+    rgba[i * 4 + 3] = (unsigned char)(a * 17);
+  }
+}
+
+
+//
+// BC4 single channel blocks
+//
+
+static void bc4Palette(int e0, int e1, int* pal)
+{
+  pal[0] = e0;
+  pal[1] = e1;
+  if (e0 > e1) {
+    for (int i = 1; i <= 6; ++i)
+      pal[1 + i] = ((7 - i) * e0 + i * e1) / 7;
+  } else {
+    for (int i = 1; i <= 4; ++i)
+      pal[1 + i] = ((5 - i) * e0 + i * e1) / 5;
+    pal[6] = 0;
+    pal[7] = 255;
+  }
+}
+
+
+// px holds the values in channel 0, with the other channels zeroed.
+static float evaluateBC4(const float* px, int e0, int e1, unsigned char* indices)
+{
+  int values[8];
+  bc4Palette(e0, e1, values);
+  float pal[64];
+  memset(pal, 0, sizeof(pal));
+  for (unsigned int j = 0; j < 8; ++j)
+    pal[j] = float(values[j]);
+  return selectIndices(px, pal, 8, indices);
+}
+
+
+static void encodeBC4Block(const float* px, unsigned char* out)
+{
+  int mn = 255, mx = 0, innerMin = 255, innerMax = 0;
+  for (unsigned int i = 0; i < 16; ++i) {
+    int v = int(px[i] + 0.5f);
+    mn = std::min(mn, v);
+    mx = std::max(mx, v);
+    if (v > 0 && v < 255) {
+      innerMin = std::min(innerMin, v);
+      innerMax = std::max(innerMax, v);
+    }
+  }
+
+  int e0 = mx, e1 = mn;
+  unsigned char indices[16], tmp[16];
+  float bestErr = evaluateBC4(px, e0, e1, indices);
+
+  // Pulling the endpoints in slightly often fits the values in between
+  // better than the extremes do.
+  for (int d0 = 0; d0 <= 2 && bestErr > 0.0f; ++d0) {
+    for (int d1 = 0; d1 <= 2; ++d1) {
+      int a = mx - d0, b = mn + d1;
+      if (a <= b || (d0 == 0 && d1 == 0))
+        continue;
+      float err = evaluateBC4(px, a, b, tmp);
+      if (err < bestErr) {
+        bestErr = err;
+        e0 = a;
+        e1 = b;
+        memcpy(indices, tmp, 16);
+      }
+    }
+  }
+
+  // The six value mode has exact 0 and 255 entries, which helps blocks with
+  // both extremes and something in between.
+  if (innerMin <= innerMax && bestErr > 0.0f) {
+    float err = evaluateBC4(px, innerMin, innerMax, tmp);
+    if (err < bestErr) {
+      e0 = innerMin;
+      e1 = innerMax;
+      memcpy(indices, tmp, 16);
+    }
+  }
+
+  out[0] = (unsigned char)e0;
+  out[1] = (unsigned char)e1;
+  unsigned long long bits = 0;
+  for (unsigned int i = 0; i < 16; ++i)
+    bits |= (unsigned long long)indices[i] << (3 * i);
+  for (unsigned int i = 0; i < 6; ++i)
+    out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+
+// Decodes into every stride'th byte of dst.
+static void decodeBC4Block(const unsigned char* in, unsigned char* dst, unsigned int stride)
+{
+  int pal[8];
+  bc4Palette(in[0], in[1], pal);
+  unsigned long long bits = 0;
+  for (unsigned int i = 0; i < 6; ++i)
+    bits |= (unsigned long long)in[2 + i] << (8 * i);
+  for (unsigned int i = 0; i < 16; ++i)
+    dst[i * stride] = (unsigned char)pal[(bits >> (3 * i)) & 7];
+}
+
+
+//
+// BC7 mode 6 blocks
+//
+
+// Endpoints are 7 bits per channel plus a p-bit shared by all the channels of
+// the endpoint.
+struct BC7Endpoint {
+  int q[4];
+  int p;
+
+  int value(unsigned int c) const { return (q[c] << 1) | p; }
+};
+
+
+static BC7Endpoint quantizeBC7(const float* e, int p)
+{
+  BC7Endpoint ep;
+  ep.p = p;
+  for (unsigned int c = 0; c < 4; ++c)
+    ep.q[c] = std::min(127, std::max(0, int((e[c] - p) * 0.5f + 0.5f)));
+  return ep;
+}
+
+
+static float evaluateBC7(const float* px, const BC7Endpoint& e0, const BC7Endpoint& e1,
+    unsigned char* indices)
+{
+  float pal[64];
+  for (unsigned int c = 0; c < 4; ++c) {
+    int a = e0.value(c), b = e1.value(c);
+    for (unsigned int j = 0; j < 16; ++j)
+      pal[c * 16 + j] = float(((64 - kBC7Weights[j]) * a + kBC7Weights[j] * b + 32) >> 6);
+  }
+  return selectIndices(px, pal, 16, indices);
+}
+
+
+// Tries all four p-bit combinations for a pair of endpoints, keeping the best
+// result if it beats bestErr.
+static void tryBC7Endpoints(const float* px, const float* lo, const float* hi,
+    BC7Endpoint& best0, BC7Endpoint& best1, unsigned char* indices, float& bestErr)
+{
+  unsigned char tmp[16];
+  for (int p0 = 0; p0 < 2; ++p0) {
+    for (int p1 = 0; p1 < 2; ++p1) {
+      BC7Endpoint e0 = quantizeBC7(lo, p0), e1 = quantizeBC7(hi, p1);
+      float err = evaluateBC7(px, e0, e1, tmp);
+      if (err < bestErr) {
+        bestErr = err;
+        best0 = e0;
+        best1 = e1;
+        memcpy(indices, tmp, 16);
+      }
+    }
+  }
+}
+
+
+// Appends bits to a 128 bit block, least significant first.
+static void putBits(unsigned char* out, unsigned int& pos, unsigned int value, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; ++i, ++pos) {
+    if (value & (1u << i))
+      out[pos >> 3] |= (unsigned char)(1u << (pos & 7));
+  }
+}
+
+
+static unsigned int getBits(const unsigned char* in, unsigned int& pos, unsigned int count)
+{
+  unsigned int value = 0;
+  for (unsigned int i = 0; i < count; ++i, ++pos)
+    value |= (unsigned int)((in[pos >> 3] >> (pos & 7)) & 1) << i;
+  return value;
+}
+
+
+static void encodeBC7Block(const float* px, unsigned char* out)
+{
+  float lo[4], hi[4], boxLo[4], boxHi[4];
+  principalEndpoints(px, 4, lo, hi);
+  boundingBox(px, 4, boxLo, boxHi);
+
+  BC7Endpoint e0, e1;
+  unsigned char indices[16];
+  float bestErr = FLT_MAX;
+  tryBC7Endpoints(px, lo, hi, e0, e1, indices, bestErr);
+  tryBC7Endpoints(px, boxLo, boxHi, e0, e1, indices, bestErr);
+
+  for (unsigned int iter = 0; iter < 2 && bestErr > 0.0f; ++iter) {
+    float weights[16], a[4], b[4];
+    for (unsigned int i = 0; i < 16; ++i)
+      weights[i] = (64 - kBC7Weights[indices[i]]) / 64.0f;
+    if (!fitEndpoints(px, 4, weights, a, b))
+      break;
+    float before = bestErr;
+    tryBC7Endpoints(px, a, b, e0, e1, indices, bestErr);
+    if (bestErr >= before)
+      break;
+  }
+
+  // The first pixel's index is stored with an implicit 0 top bit, so swap
+  // the endpoints if it needs that bit set.
+  if (indices[0] & 8) {
+    std::swap(e0, e1);
+    for (unsigned int i = 0; i < 16; ++i)
+      indices[i] = (unsigned char)(15 - indices[i]);
+  }
+
+  memset(out, 0, 16);
+  unsigned int pos = 0;
+  putBits(out, pos, 1u << 6, 7); // Mode 6.
+  for (unsigned int c = 0; c < 4; ++c) {
+    putBits(out, pos, e0.q[c], 7);
+    putBits(out, pos, e1.q[c], 7);
+  }
+  putBits(out, pos, e0.p, 1);
+  putBits(out, pos, e1.p, 1);
+  putBits(out, pos, indices[0], 3);
+  for (unsigned int i = 1; i < 16; ++i)
+    putBits(out, pos, indices[i], 4);
+}
+
+
+static void decodeBC7Block(const unsigned char* in, unsigned char* rgba)
+{
+  if ((in[0] & 0x7F) != 0x40) {
+    memset(rgba, 0, 64); // Not mode 6.
+    return;
+  }
+
+  unsigned int pos = 7;
+  BC7Endpoint e0, e1;
+  for (unsigned int c = 0; c < 4; ++c) {
+    e0.q[c] = getBits(in, pos, 7);
+    e1.q[c] = getBits(in, pos, 7);
+  }
+  e0.p = getBits(in, pos, 1);
+  e1.p = getBits(in, pos, 1);
+  for (unsigned int i = 0; i < 16; ++i) {
+    unsigned int w = kBC7Weights[getBits(in, pos, i == 0 ? 3 : 4)];
+    for (unsigned int c = 0; c < 4; ++c)
+      rgba[i * 4 + c] = (unsigned char)(((64 - w) * e0.value(c) + w * e1.value(c) + 32) >> 6);
+  }
+}
+
+
+// Gathers the 4x4 block at (bx, by) into px, repeating the last row and
+// column for blocks which hang off the edge of the image. Channels not in
+// keep are zeroed.
+static void loadBlock(const unsigned char* rgba, unsigned int width, unsigned int height,
+    unsigned int bx, unsigned int by, unsigned int keep, float* px)
+{
+  for (unsigned int i = 0; i < 16; ++i) {
+    unsigned int x = std::min(bx * 4 + (i & 3), width - 1);
+    unsigned int y = std::min(by * 4 + (i >> 2), height - 1);
+    const unsigned char* p = rgba + (size_t(y) * width + x) * 4;
+    for (unsigned int c = 0; c < 4; ++c)
+      px[c * 16 + i] = (keep & (1u << c)) ? float(p[c]) : 0.0f;
+  }
+}
+
+
+// Moves channel c of px into channel 0, zeroing the rest.
+static void isolateChannel(const float* px, unsigned int c, float* out)
+{
+  memset(out, 0, 64 * sizeof(float));
+  memcpy(out, px + c * 16, 16 * sizeof(float));
+}
+
+
+//
+// Container files
+//
+
+static unsigned int getLE32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+
+static unsigned int getBE32(const unsigned char* p)
+{
+  return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+static unsigned long long getLE64(const unsigned char* p)
+{
+  return getLE32(p) | ((unsigned long long)getLE32(p + 4) << 32);
+}
+
+
+static const FileFormat* findFileFormat(const FileFormat* formats, unsigned int code)
+{
+  for (; formats->code != 0; ++formats) {
+    if (formats->code == code)
+      return formats;
+  }
+  return NULL;
+}
+
+
+// Looks for the KTXorientation key in KTX or KTX2 key/value data and returns
+// the image origin it describes. Both formats store each pair as a 32 bit
+// size followed by a null terminated key, the value and padding to a multiple
+// of 4 bytes.
+static ImageOrigin ktxOrientation(const unsigned char* kvd, size_t size, bool bigEndian)
+{
+  const char* kKey = "KTXorientation";
+  const size_t kKeyLen = strlen(kKey) + 1;
+  size_t pos = 0;
+  while (pos + 4 <= size) {
+    size_t len = bigEndian ? getBE32(kvd + pos) : getLE32(kvd + pos);
+    const char* pair = (const char*)kvd + pos + 4;
+    if (len > size - pos - 4)
+      break;
+    if (len > kKeyLen && memcmp(pair, kKey, kKeyLen) == 0) {
+      // The value is "S=r,T=u" style for KTX and "ru" style for KTX2.
+      const char* value = pair + kKeyLen;
+      size_t valueLen = len - kKeyLen;
+      for (size_t i = 0; i < valueLen && value[i] != '\0'; ++i) {
+        if (value[i] == 'u')
+          return ORIGIN_BOTTOM_LEFT;
+      }
+      return ORIGIN_TOP_LEFT;
+    }
+    pos += 4 + ((len + 3) & ~size_t(3));
+  }
+  return ORIGIN_TOP_LEFT;
+}
+
+
+//
+// CompressedImage METHODS
+//
+
+CompressedImage::CompressedImage(const char* path) throw(ImageException) :
+  _format(BLOCK_BC1),
+  _glFormat(0),
+  _origin(ORIGIN_TOP_LEFT),
+  _texId(0),
+  _numLevels(0),
+  _data(NULL),
+  _dataSize(0),
+  _mapped(false)
+{
+  const char* filename = basename(const_cast<char*>(path));
+  const char* ext = strrchr(filename, '.');
+  if (ext == NULL)
+    throw ImageException("Unknown compressed image format.");
+  if (strcasecmp(ext, ".dds") != 0 && strcasecmp(ext, ".ktx") != 0 && strcasecmp(ext, ".ktx2") != 0)
+    throw ImageException("Unknown compressed image format: %s", ext);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    throw ImageException("File not found: %s.", filename);
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    throw ImageException("Unable to read %s.", filename);
+  }
+
+  // A private writable mapping, so that writes through getLevelData() only
+  // ever touch our copy of a page and never the file.
+  void* mapping = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  int mapError = errno;
+  close(fd);
+  if (mapping == MAP_FAILED)
+    throw ImageException("Unable to map %s: %s", filename, strerror(mapError));
+  _data = (unsigned char*)mapping;
+  _dataSize = info.st_size;
+  _mapped = true;
+
+  try {
+    if (strcasecmp(ext, ".dds") == 0)
+      loadDDS();
+    else if (strcasecmp(ext, ".ktx") == 0)
+      loadKTX();
+    else
+      loadKTX2();
+  } catch (ImageException& ex) {
+    munmap(_data, _dataSize);
+    throw ex;
+  }
+}
+
+
+CompressedImage::CompressedImage(RawImage* src, BlockFormat format) throw(ImageException) :
+  _format(format),
+  _glFormat(0),
+  _origin(src->getOrigin()),
+  _texId(0),
+  _numLevels(0),
+  _data(NULL),
+  _dataSize(0),
+  _mapped(false)
+{
+  if (format == BLOCK_BC2 || format == BLOCK_BC6H)
+    throw ImageException("Compressing to BC2 and BC6H isn't supported.");
+  allocate(src->getWidth(), src->getHeight(), 1);
+  compressLevel(0, src);
+}
+
+
+CompressedImage::CompressedImage(MipChain* src, BlockFormat format) throw(ImageException) :
+  _format(format),
+  _glFormat(0),
+  _origin(ORIGIN_BOTTOM_LEFT),
+  _texId(0),
+  _numLevels(0),
+  _data(NULL),
+  _dataSize(0),
+  _mapped(false)
+{
+  if (format == BLOCK_BC2 || format == BLOCK_BC6H)
+    throw ImageException("Compressing to BC2 and BC6H isn't supported.");
+  allocate(src->getLevelWidth(0), src->getLevelHeight(0), src->getNumLevels());
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    RawImage img(src->getType(), src->getBytesPerPixel(),
+        src->getLevelWidth(level), src->getLevelHeight(level), src->getPixelType());
+    memcpy(img.getPixels(), src->getLevelPixels(level),
+        size_t(src->getBytesPerPixel()) * img.getWidth() * img.getHeight());
+    compressLevel(level, &img);
+  }
+}
+
+
+CompressedImage::CompressedImage(BlockFormat format, unsigned int width, unsigned int height,
+    unsigned int numLevels, ImageOrigin origin) :
+  _format(format),
+  _glFormat(0),
+  _origin(origin),
+  _texId(0),
+  _numLevels(0),
+  _data(NULL),
+  _dataSize(0),
+  _mapped(false)
+{
+  allocate(width, height, numLevels);
+}
+
+
+CompressedImage::~CompressedImage()
+{
+  if (_mapped)
+    munmap(_data, _dataSize);
+  else
+    freePixels(_data);
+}
+
+
+BlockFormat CompressedImage::getFormat() const
+{
+  return _format;
+}
+
+
+int CompressedImage::getGLFormat() const
+{
+  if (_glFormat != 0)
+    return _glFormat;
+  switch (_format) {
+    case BLOCK_BC1:  return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_BC2:  return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case BLOCK_BC3:  return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC4:  return GL_COMPRESSED_RED_RGTC1;
+    case BLOCK_BC5:  return GL_COMPRESSED_RG_RGTC2;
+    case BLOCK_BC6H: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+    default:         return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+}
+
+
+unsigned int CompressedImage::getBytesPerBlock() const
+{
+  return bytesPerBlock(_format);
+}
+
+
+ImageOrigin CompressedImage::getOrigin() const
+{
+  return _origin;
+}
+
+
+unsigned int CompressedImage::getWidth() const
+{
+  return _widths[0];
+}
+
+
+unsigned int CompressedImage::getHeight() const
+{
+  return _heights[0];
+}
+
+
+unsigned int CompressedImage::getNumLevels() const
+{
+  return _numLevels;
+}
+
+
+unsigned int CompressedImage::getLevelWidth(unsigned int level) const
+{
+  return _widths[level];
+}
+
+
+unsigned int CompressedImage::getLevelHeight(unsigned int level) const
+{
+  return _heights[level];
+}
+
+
+size_t CompressedImage::getLevelSize(unsigned int level) const
+{
+  return _sizes[level];
+}
+
+
+unsigned char* CompressedImage::getLevelData(unsigned int level)
+{
+  return _data + _offsets[level];
+}
+
+
+const unsigned char* CompressedImage::getLevelData(unsigned int level) const
+{
+  return _data + _offsets[level];
+}
+
+
+size_t CompressedImage::getSize() const
+{
+  size_t size = 0;
+  for (unsigned int level = 0; level < _numLevels; ++level)
+    size += _sizes[level];
+  return size;
+}
+
+
+RawImage* CompressedImage::decompress(unsigned int level) const throw(ImageException)
+{
+  if (_format == BLOCK_BC6H)
+    throw ImageException("Decompressing BC6H isn't supported.");
+
+  const unsigned int width = _widths[level];
+  const unsigned int height = _heights[level];
+  const unsigned int blocksX = (width + 3) / 4;
+  const unsigned int blocksY = (height + 3) / 4;
+  const unsigned int blockBytes = getBytesPerBlock();
+  const unsigned char* data = getLevelData(level);
+
+  RawImage* img = new RawImage(GL_RGBA, 4, width, height, GL_UNSIGNED_BYTE, _origin);
+  unsigned char* pixels = img->getPixels();
+
+  #pragma omp parallel for
+  for (int by = 0; by < (int)blocksY; ++by) {
+    for (unsigned int bx = 0; bx < blocksX; ++bx) {
+      const unsigned char* in = data + (size_t(by) * blocksX + bx) * blockBytes;
+      unsigned char rgba[64];
+      for (unsigned int i = 0; i < 16; ++i) {
+        rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+        rgba[i * 4 + 3] = 255;
+      }
+      switch (_format) {
+        case BLOCK_BC1: decodeBC1Block(in, rgba, false); break;
+        case BLOCK_BC2: decodeBC1Block(in + 8, rgba, true); decodeBC2Alpha(in, rgba); break;
+        case BLOCK_BC3: decodeBC1Block(in + 8, rgba, true); decodeBC4Block(in, rgba + 3, 4); break;
+        case BLOCK_BC4: decodeBC4Block(in, rgba, 4); break;
+        case BLOCK_BC5: decodeBC4Block(in, rgba, 4); decodeBC4Block(in + 8, rgba + 1, 4); break;
+        case BLOCK_BC7: decodeBC7Block(in, rgba); break;
+        default: break;
+      }
+      for (unsigned int i = 0; i < 16; ++i) {
+        unsigned int x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+        if (x < width && y < height)
+          memcpy(pixels + (size_t(y) * width + x) * 4, rgba + i * 4, 4);
+      }
+    }
+  }
+  return img;
+}
+
+
+unsigned int CompressedImage::getTexID() const
+{
+  return _texId;
+}
+
+
+void CompressedImage::uploadTexture(unsigned int texId)
+{
+  if (texId == 0)
+    glGenTextures(1, &_texId);
+  else
+    _texId = texId;
+
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, _texId);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+      (_numLevels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _numLevels - 1);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, getGLFormat(),
+        _widths[level], _heights[level], 0, getLevelSize(level), getLevelData(level));
+  }
+}
+
+
+void CompressedImage::allocate(unsigned int width, unsigned int height, unsigned int numLevels)
+{
+  setLevels(width, height, numLevels);
+  size_t offset = 0;
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    _offsets[level] = offset;
+    offset += _sizes[level];
+  }
+  _data = allocPixels(offset);
+  _dataSize = offset;
+}
+
+
+// Fills in the dimensions and sizes of each level, but not their offsets.
+void CompressedImage::setLevels(unsigned int width, unsigned int height, unsigned int numLevels)
+{
+  numLevels = std::max(1u, std::min(numLevels, kMaxLevels));
+  const unsigned int blockBytes = getBytesPerBlock();
+  for (_numLevels = 0; _numLevels < numLevels; ++_numLevels) {
+    _widths[_numLevels] = width;
+    _heights[_numLevels] = height;
+    _sizes[_numLevels] = size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+}
+
+
+void CompressedImage::loadDDS() throw(ImageException)
+{
+  // The magic number, then a 124 byte header.
+  const size_t kHeaderSize = 4 + 124;
+  const unsigned int kFourCC = 0x4;
+  const unsigned int kMipMapCount = 0x20000;
+  const unsigned int kCubeMap = 0x200;
+  const unsigned int kVolume = 0x200000;
+
+  const unsigned char* header = _data;
+  if (_dataSize < kHeaderSize || memcmp(header, "DDS ", 4) != 0)
+    throw ImageException("Invalid DDS file.");
+
+  const unsigned int flags = getLE32(header + 8);
+  const unsigned int height = getLE32(header + 12);
+  const unsigned int width = getLE32(header + 16);
+  const unsigned int mipMapCount = getLE32(header + 28);
+  const unsigned int pixelFormatFlags = getLE32(header + 80);
+  const unsigned char* fourCC = header + 84;
+  const unsigned int caps2 = getLE32(header + 112);
+
+  if (caps2 & (kCubeMap | kVolume))
+    throw ImageException("DDS cube maps and volume textures aren't supported.");
+  if (!(pixelFormatFlags & kFourCC))
+    throw ImageException("Uncompressed DDS files aren't supported.");
+
+  size_t offset = kHeaderSize;
+  if (memcmp(fourCC, "DXT1", 4) == 0) {
+    // DXT1 blocks may use the punch through alpha mode, so upload them as
+    // RGBA to keep it.
+    _format = BLOCK_BC1;
+    _glFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+  } else if (memcmp(fourCC, "DXT2", 4) == 0 || memcmp(fourCC, "DXT3", 4) == 0) {
+    _format = BLOCK_BC2;
+  } else if (memcmp(fourCC, "DXT4", 4) == 0 || memcmp(fourCC, "DXT5", 4) == 0) {
+    _format = BLOCK_BC3;
+  } else if (memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0) {
+    _format = BLOCK_BC4;
+  } else if (memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0) {
+    _format = BLOCK_BC5;
+  } else if (memcmp(fourCC, "DX10", 4) == 0) {
+    // A 20 byte extension header follows the main one.
+    const size_t kDX10Size = 20;
+    const unsigned int kTexture2D = 3;
+    const unsigned int kTextureCube = 0x4;
+    if (_dataSize < kHeaderSize + kDX10Size)
+      throw ImageException("Invalid DDS file.");
+    const unsigned char* dx10 = _data + kHeaderSize;
+    const FileFormat* format = findFileFormat(kDXGIFormats, getLE32(dx10));
+    if (format == NULL)
+      throw ImageException("Unsupported DDS format: DXGI format %u.", getLE32(dx10));
+    if (getLE32(dx10 + 4) != kTexture2D || (getLE32(dx10 + 8) & kTextureCube) || getLE32(dx10 + 12) > 1)
+      throw ImageException("Only 2D DDS textures are supported.");
+    _format = format->format;
+    _glFormat = format->glFormat;
+    offset += kDX10Size;
+  } else {
+    throw ImageException("Unsupported DDS format: %.4s.", (const char*)fourCC);
+  }
+
+  setLevels(width, height, (flags & kMipMapCount) ? mipMapCount : 1);
+
+  // The levels are stored back to back.
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    _offsets[level] = offset;
+    offset += _sizes[level];
+  }
+  if (offset > _dataSize)
+    throw ImageException("Truncated DDS file.");
+  _origin = ORIGIN_TOP_LEFT;
+}
+
+
+void CompressedImage::loadKTX() throw(ImageException)
+{
+  const size_t kHeaderSize = 64;
+  const unsigned char* header = _data;
+  if (_dataSize < kHeaderSize || memcmp(header, kKTXIdentifier, sizeof(kKTXIdentifier)) != 0)
+    throw ImageException("Invalid KTX file.");
+
+  // The file is in the writer's byte order, which the endianness field tells
+  // us. Block data is just bytes, so only the header needs to care.
+  const bool bigEndian = (getLE32(header + 12) != 0x04030201);
+  unsigned int fields[12];
+  for (unsigned int i = 0; i < 12; ++i)
+    fields[i] = bigEndian ? getBE32(header + 16 + i * 4) : getLE32(header + 16 + i * 4);
+  const unsigned int glType = fields[0];
+  const unsigned int glInternalFormat = fields[3];
+  const unsigned int width = fields[5];
+  const unsigned int height = fields[6];
+  const unsigned int depth = fields[7];
+  const unsigned int numArrayElements = fields[8];
+  const unsigned int numFaces = fields[9];
+  const unsigned int numLevels = fields[10];
+  const unsigned int keyValueBytes = fields[11];
+
+  if (glType != 0)
+    throw ImageException("Uncompressed KTX files aren't supported.");
+  const FileFormat* format = findFileFormat(kGLFormats, glInternalFormat);
+  if (format == NULL)
+    throw ImageException("Unsupported KTX format: 0x%x.", glInternalFormat);
+  if (depth > 1 || numArrayElements > 0 || numFaces > 1)
+    throw ImageException("Only 2D KTX textures are supported.");
+  if (keyValueBytes > _dataSize - kHeaderSize)
+    throw ImageException("Invalid KTX file.");
+  _format = format->format;
+  _glFormat = glInternalFormat;
+  _origin = ktxOrientation(_data + kHeaderSize, keyValueBytes, bigEndian);
+
+  // Each level is its size, then its data padded to a multiple of 4 bytes.
+  setLevels(width, height, numLevels);
+  size_t offset = kHeaderSize + keyValueBytes;
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    if (offset + 4 > _dataSize)
+      throw ImageException("Truncated KTX file.");
+    size_t imageSize = bigEndian ? getBE32(_data + offset) : getLE32(_data + offset);
+    offset += 4;
+    if (imageSize < _sizes[level] || imageSize > _dataSize - offset)
+      throw ImageException("Truncated KTX file.");
+    _offsets[level] = offset;
+    offset += (imageSize + 3) & ~size_t(3);
+  }
+}
+
+
+void CompressedImage::loadKTX2() throw(ImageException)
+{
+  const size_t kHeaderSize = 80;
+  const size_t kLevelIndexSize = 24;
+  const unsigned char* header = _data;
+  if (_dataSize < kHeaderSize || memcmp(header, kKTX2Identifier, sizeof(kKTX2Identifier)) != 0)
+    throw ImageException("Invalid KTX2 file.");
+
+  // KTX2 is always little endian.
+  const unsigned int vkFormat = getLE32(header + 12);
+  const unsigned int width = getLE32(header + 20);
+  const unsigned int height = getLE32(header + 24);
+  const unsigned int depth = getLE32(header + 28);
+  const unsigned int numLayers = getLE32(header + 32);
+  const unsigned int numFaces = getLE32(header + 36);
+  const unsigned int numLevels = std::max(1u, getLE32(header + 40));
+  const unsigned int supercompression = getLE32(header + 44);
+  const unsigned int kvdOffset = getLE32(header + 56);
+  const unsigned int kvdSize = getLE32(header + 60);
+
+  const FileFormat* format = findFileFormat(kVkFormats, vkFormat);
+  if (format == NULL)
+    throw ImageException("Unsupported KTX2 format: VkFormat %u.", vkFormat);
+  if (supercompression != 0)
+    throw ImageException("Supercompressed KTX2 files aren't supported.");
+  if (depth > 1 || numLayers > 0 || numFaces > 1)
+    throw ImageException("Only 2D KTX2 textures are supported.");
+  if (numLevels > (_dataSize - kHeaderSize) / kLevelIndexSize || kvdOffset > _dataSize ||
+      kvdSize > _dataSize - kvdOffset)
+    throw ImageException("Invalid KTX2 file.");
+  _format = format->format;
+  _glFormat = format->glFormat;
+  _origin = ktxOrientation(_data + kvdOffset, kvdSize, false);
+
+  // The level index gives the offset and size of each level, largest first.
+  setLevels(width, height, numLevels);
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    const unsigned char* index = header + kHeaderSize + level * kLevelIndexSize;
+    unsigned long long offset = getLE64(index);
+    unsigned long long size = getLE64(index + 8);
+    if (size < _sizes[level] || offset > _dataSize || size > _dataSize - offset)
+      throw ImageException("Truncated KTX2 file.");
+    _offsets[level] = size_t(offset);
+  }
+}
+
+
+void CompressedImage::compressLevel(unsigned int level, const RawImage* src)
+{
+  const unsigned int width = src->getWidth();
+  const unsigned int height = src->getHeight();
+  if (width == 0 || height == 0)
+    return;
+
+  // Everything gets encoded from 8 bit RGBA.
+  unsigned char* scratch = NULL;
+  const unsigned char* rgba = src->getPixels();
+  if (src->getType() != GL_RGBA || src->getPixelType() != GL_UNSIGNED_BYTE) {
+    scratch = allocPixels(size_t(width) * height * 4);
+    convertPixels(src->getPixels(), src->getType(), scratch, GL_RGBA,
+        width, height, src->getPixelType(), GL_UNSIGNED_BYTE);
+    rgba = scratch;
+  }
+
+  const unsigned int blocksX = (width + 3) / 4;
+  const unsigned int blocksY = (height + 3) / 4;
+  const unsigned int blockBytes = getBytesPerBlock();
+  unsigned char* data = getLevelData(level);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int by = 0; by < (int)blocksY; ++by) {
+    float px[64], channel[64];
+    for (unsigned int bx = 0; bx < blocksX; ++bx) {
+      unsigned char* out = data + (size_t(by) * blocksX + bx) * blockBytes;
+      switch (_format) {
+        case BLOCK_BC1:
+          loadBlock(rgba, width, height, bx, by, 0x7, px);
+          encodeBC1Block(px, out);
+          break;
+        case BLOCK_BC3:
+          loadBlock(rgba, width, height, bx, by, 0xF, px);
+          isolateChannel(px, 3, channel);
+          encodeBC4Block(channel, out);
+          memset(px + 48, 0, 16 * sizeof(float));
+          encodeBC1Block(px, out + 8);
+          break;
+        case BLOCK_BC4:
+          loadBlock(rgba, width, height, bx, by, 0x1, px);
+          encodeBC4Block(px, out);
+          break;
+        case BLOCK_BC5:
+          loadBlock(rgba, width, height, bx, by, 0x3, px);
+          isolateChannel(px, 0, channel);
+          encodeBC4Block(channel, out);
+          isolateChannel(px, 1, channel);
+          encodeBC4Block(channel, out + 8);
+          break;
+        case BLOCK_BC7:
+          loadBlock(rgba, width, height, bx, by, 0xF, px);
+          encodeBC7Block(px, out);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  freePixels(scratch);
+}
+
+
+//
+// FUNCTIONS
+//
+
+unsigned int bytesPerBlock(BlockFormat format)
+{
+  return (format == BLOCK_BC1 || format == BLOCK_BC4) ? 8 : 16;
+}
+
+
+double computePSNR(const RawImage* a, const RawImage* b, unsigned int numChannels)
+{
+  const size_t numPixels = size_t(a->getWidth()) * a->getHeight();
+  const unsigned char* pa = a->getPixels();
+  const unsigned char* pb = b->getPixels();
+  double sum = 0.0;
+  for (size_t i = 0; i < numPixels; ++i) {
+    for (unsigned int c = 0; c < numChannels; ++c) {
+      double d = double(pa[i * 4 + c]) - double(pb[i * 4 + c]);
+      sum += d * d;
+    }
+  }
+  if (sum == 0.0)
+    return HUGE_VAL;
+  double mse = sum / (double(numPixels) * numChannels);
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,139 @@
+#ifndef vgl_compressedimage_h
+#define vgl_compressedimage_h
+
+#include "vgl_image.h"
+
+#include <cstddef>
+
+namespace vgl {
+
+//
+// Forward declarations
+//
+
+class MipChain;
+
+
+//
+// Types
+//
+
+// Block compressed texture formats. Each one stores a 4x4 block of pixels in a
+// fixed number of bytes. BC2 and BC6H can be loaded from files and uploaded,
+// but not encoded; they come last so the other formats keep their values.
+enum BlockFormat {
+  BLOCK_BC1,  //!< RGB, 8 bytes per block (DXT1).
+  BLOCK_BC3,  //!< RGBA, 16 bytes per block (DXT5).
+  BLOCK_BC4,  //!< Red only, 8 bytes per block (RGTC1).
+  BLOCK_BC5,  //!< Red and green, 16 bytes per block (RGTC2).
+  BLOCK_BC7,  //!< RGBA, 16 bytes per block (BPTC).
+  BLOCK_BC2,  //!< RGBA with 4 bit alpha, 16 bytes per block (DXT3).
+  BLOCK_BC6H  //!< HDR RGB, 16 bytes per block (BPTC float).
+};
+
+
+// Block compressed pixel data for an image and, optionally, its mip levels,
+// in the layout that glCompressedTexImage2D expects.
+//
+// DDS, KTX and KTX2 files are memory mapped rather than read, and their
+// blocks are uploaded straight from the mapping without any decoding. Only
+// plain 2D textures are supported, not cube maps, arrays or volumes. The
+// blocks can't be flipped without decoding them, so getOrigin() reports the
+// file's orientation instead: top left for DDS, and whatever the
+// KTXorientation key says for KTX (top left if it's missing).
+//
+// Compressing converts the source to 8 bit RGBA first. BC4 takes the red
+// channel and BC5 the red and green channels, so greyscale images work with
+// either. Blocks are encoded in parallel. Endpoints are found by fitting the
+// principal axis of each block's colours, then refined by least squares, with
+// candidate endpoints scored by a SIMD nearest-palette-entry search.
+//
+// The BC7 encoder only uses mode 6 (one subset, 7 bit RGBA endpoints with
+// p-bits and 4 bit indices), which suits smooth images and is fast to
+// search; decompress() likewise only understands mode 6 blocks.
+class CompressedImage {
+public:
+  static const unsigned int kMaxLevels = 32;
+
+  //! Load a .dds, .ktx or .ktx2 file.
+  CompressedImage(const char* path) throw(ImageException);
+  CompressedImage(RawImage* src, BlockFormat format) throw(ImageException);
+  //! Compress every level of a mip chain.
+  CompressedImage(MipChain* src, BlockFormat format) throw(ImageException);
+  //! Uninitialised storage for numLevels levels, for filling in directly.
+  CompressedImage(BlockFormat format, unsigned int width, unsigned int height,
+      unsigned int numLevels = 1, ImageOrigin origin = ORIGIN_BOTTOM_LEFT);
+  ~CompressedImage();
+
+  BlockFormat getFormat() const;
+  //! The GL internal format enum, e.g. GL_COMPRESSED_RGB_S3TC_DXT1_EXT. For
+  //! loaded files this also tells sRGB and linear data apart.
+  int getGLFormat() const;
+  unsigned int getBytesPerBlock() const;
+  ImageOrigin getOrigin() const;
+
+  unsigned int getWidth() const;
+  unsigned int getHeight() const;
+  unsigned int getNumLevels() const;
+  unsigned int getLevelWidth(unsigned int level) const;
+  unsigned int getLevelHeight(unsigned int level) const;
+  size_t getLevelSize(unsigned int level) const;
+  unsigned char* getLevelData(unsigned int level);
+  const unsigned char* getLevelData(unsigned int level) const;
+
+  //! The total size, in bytes, of all the levels together.
+  size_t getSize() const;
+
+  //! Decode a level back to 8 bit RGBA, e.g. to measure its quality. BC4
+  //! and BC5 decode the way GL samples them, with the missing colour channels
+  //! set to 0 and alpha to 255. BC6H isn't supported.
+  RawImage* decompress(unsigned int level = 0) const throw(ImageException);
+
+  unsigned int getTexID() const;
+  void uploadTexture(unsigned int texID = 0);
+
+private:
+  // Not copyable.
+  CompressedImage(const CompressedImage& other);
+  CompressedImage& operator = (const CompressedImage& other);
+
+  void allocate(unsigned int width, unsigned int height, unsigned int numLevels);
+  void compressLevel(unsigned int level, const RawImage* src);
+  void setLevels(unsigned int width, unsigned int height, unsigned int numLevels);
+
+  void loadDDS() throw(ImageException);
+  void loadKTX() throw(ImageException);
+  void loadKTX2() throw(ImageException);
+
+private:
+  BlockFormat _format;
+  int _glFormat;
+  ImageOrigin _origin;
+  unsigned int _texId;
+  unsigned int _numLevels;
+  unsigned int _widths[kMaxLevels];
+  unsigned int _heights[kMaxLevels];
+  size_t _offsets[kMaxLevels];
+  size_t _sizes[kMaxLevels];
+  unsigned char* _data;
+  size_t _dataSize;
+  bool _mapped; // Whether _data is a mapped file rather than from allocPixels.
+};
+
+
+//
+// Functions
+//
+
+unsigned int bytesPerBlock(BlockFormat format);
+
+//! Peak signal to noise ratio, in dB, between two 8 bit RGBA images of the
+//! same size, over the first numChannels channels. Infinite for identical
+//! images.
+double computePSNR(const RawImage* a, const RawImage* b, unsigned int numChannels = 4);
+
+
+} // namespace vgl
+
+#endif // vgl_compressedimage_h
+
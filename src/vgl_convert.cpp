@@ -0,0 +1,704 @@
+#include "vgl_convert.h"
+
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef VGL_SIMD_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// Where each channel lives within a pixel. Greyscale layouts have r, g and b
+// all pointing at the same channel; a is -1 if there's no alpha channel.
+struct Layout {
+  unsigned int channels;
+  int r, g, b, a;
+
+  bool isGrey() const { return channels <= 2; }
+};
+
+
+typedef void (*RowFunc)(const unsigned char* src, unsigned char* dst, unsigned int width);
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static bool describe(int type, Layout& layout)
+{
+  switch (type) {
+    case GL_RGB:             layout.channels = 3; layout.r = 0; layout.g = 1; layout.b = 2; layout.a = -1; return true;
+    case GL_BGR:             layout.channels = 3; layout.r = 2; layout.g = 1; layout.b = 0; layout.a = -1; return true;
+    case GL_RGBA:            layout.channels = 4; layout.r = 0; layout.g = 1; layout.b = 2; layout.a = 3;  return true;
+    case GL_BGRA:            layout.channels = 4; layout.r = 2; layout.g = 1; layout.b = 0; layout.a = 3;  return true;
+    case GL_ALPHA:
+    case GL_LUMINANCE:       layout.channels = 1; layout.r = 0; layout.g = 0; layout.b = 0; layout.a = -1; return true;
+    case GL_LUMINANCE_ALPHA: layout.channels = 2; layout.r = 0; layout.g = 0; layout.b = 0; layout.a = 1;  return true;
+    default:                 return false;
+  }
+}
+
+
+// Half floats are stored as raw 16 bit patterns; this wrapper just gives them
+// a distinct type for the templates below.
+struct Half {
+  unsigned short bits;
+};
+
+
+template <typename T> inline float toFloat(T v);
+template <> inline float toFloat(unsigned char v)  { return v * (1.0f / 255.0f); }
+template <> inline float toFloat(unsigned short v) { return v * (1.0f / 65535.0f); }
+template <> inline float toFloat(float v)          { return v; }
+template <> inline float toFloat(Half v)           { return halfToFloat(v.bits); }
+
+template <typename T> inline T fromFloat(float v);
+template <> inline unsigned char fromFloat(float v)  { return (unsigned char)(std::max(0.0f, std::min(1.0f, v)) * 255.0f + 0.5f); }
+template <> inline unsigned short fromFloat(float v) { return (unsigned short)(std::max(0.0f, std::min(1.0f, v)) * 65535.0f + 0.5f); }
+template <> inline float fromFloat(float v)          { return v; }
+template <> inline Half fromFloat(float v)           { Half h = { floatToHalf(v) }; return h; }
+
+// Integer to integer conversions are done exactly; anything involving floats
+// goes via float.
+template <typename Src, typename Dst> inline Dst convertChannel(Src v) { return fromFloat<Dst>(toFloat(v)); }
+template <> inline unsigned char convertChannel(unsigned char v) { return v; }
+template <> inline unsigned short convertChannel(unsigned short v) { return v; }
+template <> inline float convertChannel(float v) { return v; }
+template <> inline Half convertChannel(Half v) { return v; }
+template <> inline unsigned short convertChannel(unsigned char v) { return (unsigned short)(v * 257); }
+template <> inline unsigned char convertChannel(unsigned short v) { return (unsigned char)((v * 255u + 32895u) >> 16); }
+
+template <typename T> inline T opaque();
+template <> inline unsigned char opaque()  { return 0xFF; }
+template <> inline unsigned short opaque() { return 0xFFFF; }
+template <> inline float opaque()          { return 1.0f; }
+template <> inline Half opaque()           { Half h = { 0x3C00 }; return h; }
+
+// Rec. 601 luma. Integer types use fixed point weights.
+template <typename T> inline T luma(T r, T g, T b) { return fromFloat<T>(0.299f * toFloat(r) + 0.587f * toFloat(g) + 0.114f * toFloat(b)); }
+template <> inline unsigned char luma(unsigned char r, unsigned char g, unsigned char b) { return (unsigned char)((r * 77u + g * 150u + b * 29u + 128u) >> 8); }
+template <> inline unsigned short luma(unsigned short r, unsigned short g, unsigned short b) { return (unsigned short)((r * 77u + g * 150u + b * 29u + 128u) >> 8); }
+template <> inline float luma(float r, float g, float b) { return 0.299f * r + 0.587f * g + 0.114f * b; }
+
+
+// Converts one pixel. All channels are read before any are written, so this
+// is safe to use when src and dst are the same pixel.
+template <typename Src, typename Dst>
+inline void convertPixel(const Src* s, const Layout& sl, Dst* d, const Layout& dl)
+{
+  Src r = s[sl.r];
+  Src g = s[sl.g];
+  Src b = s[sl.b];
+  Src a = (sl.a >= 0) ? s[sl.a] : opaque<Src>();
+
+  if (dl.isGrey()) {
+    if (!sl.isGrey())
+      r = luma(r, g, b);
+    d[0] = convertChannel<Src, Dst>(r);
+  } else {
+    d[dl.r] = convertChannel<Src, Dst>(r);
+    d[dl.g] = convertChannel<Src, Dst>(g);
+    d[dl.b] = convertChannel<Src, Dst>(b);
+  }
+  if (dl.a >= 0)
+    d[dl.a] = convertChannel<Src, Dst>(a);
+}
+
+
+template <typename Src, typename Dst>
+static void convertRowForwards(const void* src, const Layout& sl, void* dst, const Layout& dl, unsigned int width)
+{
+  const Src* s = (const Src*)src;
+  Dst* d = (Dst*)dst;
+  for (unsigned int x = 0; x < width; ++x, s += sl.channels, d += dl.channels)
+    convertPixel(s, sl, d, dl);
+}
+
+
+template <typename Src, typename Dst>
+static void convertRowBackwards(const void* src, const Layout& sl, void* dst, const Layout& dl, unsigned int width)
+{
+  const Src* s = (const Src*)src + size_t(width) * sl.channels;
+  Dst* d = (Dst*)dst + size_t(width) * dl.channels;
+  for (unsigned int x = 0; x < width; ++x) {
+    s -= sl.channels;
+    d -= dl.channels;
+    convertPixel(s, sl, d, dl);
+  }
+}
+
+
+template <typename Src, typename Dst>
+static void convertRowAs(const void* src, const Layout& sl, void* dst, const Layout& dl, unsigned int width, bool backwards)
+{
+  if (backwards)
+    convertRowBackwards<Src, Dst>(src, sl, dst, dl, width);
+  else
+    convertRowForwards<Src, Dst>(src, sl, dst, dl, width);
+}
+
+
+template <typename Src>
+static void convertRowFrom(const void* src, const Layout& sl,
+    void* dst, const Layout& dl, int dstPixelType, unsigned int width, bool backwards)
+{
+  switch (dstPixelType) {
+    case GL_UNSIGNED_BYTE:  convertRowAs<Src, unsigned char>(src, sl, dst, dl, width, backwards); break;
+    case GL_UNSIGNED_SHORT: convertRowAs<Src, unsigned short>(src, sl, dst, dl, width, backwards); break;
+    case GL_FLOAT:          convertRowAs<Src, float>(src, sl, dst, dl, width, backwards); break;
+    case GL_HALF_FLOAT:     convertRowAs<Src, Half>(src, sl, dst, dl, width, backwards); break;
+  }
+}
+
+
+static void convertRow(const void* src, const Layout& sl, int srcPixelType,
+    void* dst, const Layout& dl, int dstPixelType, unsigned int width, bool backwards)
+{
+  switch (srcPixelType) {
+    case GL_UNSIGNED_BYTE:  convertRowFrom<unsigned char>(src, sl, dst, dl, dstPixelType, width, backwards); break;
+    case GL_UNSIGNED_SHORT: convertRowFrom<unsigned short>(src, sl, dst, dl, dstPixelType, width, backwards); break;
+    case GL_FLOAT:          convertRowFrom<float>(src, sl, dst, dl, dstPixelType, width, backwards); break;
+    case GL_HALF_FLOAT:     convertRowFrom<Half>(src, sl, dst, dl, dstPixelType, width, backwards); break;
+  }
+}
+
+
+template <typename T>
+static void premultiplyRow(T* row, const Layout& layout, unsigned int width)
+{
+  for (unsigned int x = 0; x < width; ++x, row += layout.channels) {
+    float a = toFloat(row[layout.a]);
+    for (unsigned int c = 0; c < layout.channels; ++c) {
+      if ((int)c != layout.a)
+        row[c] = fromFloat<T>(toFloat(row[c]) * a);
+    }
+  }
+}
+
+
+template <>
+void premultiplyRow(float* row, const Layout& layout, unsigned int width)
+{
+  for (unsigned int x = 0; x < width; ++x, row += layout.channels) {
+    float a = row[layout.a];
+    for (unsigned int c = 0; c < layout.channels; ++c) {
+      if ((int)c != layout.a)
+        row[c] *= a;
+    }
+  }
+}
+
+
+template <>
+void premultiplyRow(unsigned char* row, const Layout& layout, unsigned int width)
+{
+  for (unsigned int x = 0; x < width; ++x, row += layout.channels) {
+    unsigned int a = row[layout.a];
+    for (unsigned int c = 0; c < layout.channels; ++c) {
+      if ((int)c == layout.a)
+        continue;
+      unsigned int t = row[c] * a + 128;
+      row[c] = (unsigned char)((t + (t >> 8)) >> 8);
+    }
+  }
+}
+
+
+template <>
+void premultiplyRow(unsigned short* row, const Layout& layout, unsigned int width)
+{
+  for (unsigned int x = 0; x < width; ++x, row += layout.channels) {
+    unsigned int a = row[layout.a];
+    for (unsigned int c = 0; c < layout.channels; ++c) {
+      if ((int)c != layout.a)
+        row[c] = (unsigned short)(((unsigned int)row[c] * a + 32767u) / 65535u);
+    }
+  }
+}
+
+
+//
+// SIMD ROW KERNELS
+//
+// Each of these does as much of the row as it can with vector instructions
+// and finishes off with the generic code. They're all safe to use in place
+// when the pixel size doesn't change.
+//
+
+#ifdef VGL_SIMD_X86
+
+static const Layout kRGB  = { 3, 0, 1, 2, -1 };
+static const Layout kBGR  = { 3, 2, 1, 0, -1 };
+static const Layout kRGBA = { 4, 0, 1, 2, 3 };
+static const Layout kBGRA = { 4, 2, 1, 0, 3 };
+static const Layout kGrey = { 1, 0, 0, 0, -1 };
+
+
+// RGBA <-> BGRA. Plain SSE2: swap bytes 0 and 2 of every 32 bit word.
+static void swapRB4(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  const __m128i keep = _mm_set1_epi32(0xFF00FF00);
+  const __m128i low = _mm_set1_epi32(0x000000FF);
+  unsigned int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+    __m128i r = _mm_or_si128(_mm_and_si128(v, keep),
+        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low),
+                     _mm_slli_epi32(_mm_and_si128(v, low), 16)));
+    _mm_storeu_si128((__m128i*)(dst + x * 4), r);
+  }
+  convertRowForwards<unsigned char, unsigned char>(src + x * 4, kRGBA, dst + x * 4, kBGRA, width - x);
+}
+
+
+// RGB <-> BGR, five pixels at a time. The 16th byte belongs to the next pixel
+// and is passed through unchanged.
+VGL_TARGET("ssse3")
+static void swapRB3(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+  unsigned int x = 0;
+  for (; x + 6 <= width; x += 5) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 3));
+    _mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(v, shuffle));
+  }
+  convertRowForwards<unsigned char, unsigned char>(src + x * 3, kRGB, dst + x * 3, kBGR, width - x);
+}
+
+
+// RGB/BGR -> RGBA/BGRA, four pixels at a time. swap says whether the red and
+// blue channels change places as well.
+VGL_TARGET("ssse3")
+static void expand3To4(const unsigned char* src, unsigned char* dst, unsigned int width, bool swap)
+{
+  const __m128i shuffle = swap ?
+      _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+      _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32(0xFF000000);
+  unsigned int x = 0;
+  for (; x + 6 <= width; x += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 3));
+    _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+  }
+  convertRowForwards<unsigned char, unsigned char>(src + x * 3, kRGB, dst + x * 4, swap ? kBGRA : kRGBA, width - x);
+}
+
+
+VGL_TARGET("ssse3")
+static void rgbToRGBA(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  expand3To4(src, dst, width, false);
+}
+
+
+VGL_TARGET("ssse3")
+static void rgbToBGRA(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  expand3To4(src, dst, width, true);
+}
+
+
+// RGBA/BGRA -> RGB/BGR, four pixels at a time.
+VGL_TARGET("ssse3")
+static void shrink4To3(const unsigned char* src, unsigned char* dst, unsigned int width, bool swap)
+{
+  const __m128i shuffle = swap ?
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+      _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  unsigned int x = 0;
+  for (; x + 6 <= width; x += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+    _mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(v, shuffle));
+  }
+  convertRowForwards<unsigned char, unsigned char>(src + x * 4, kRGBA, dst + x * 3, swap ? kBGR : kRGB, width - x);
+}
+
+
+VGL_TARGET("ssse3")
+static void rgbaToRGB(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  shrink4To3(src, dst, width, false);
+}
+
+
+VGL_TARGET("ssse3")
+static void rgbaToBGR(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  shrink4To3(src, dst, width, true);
+}
+
+
+// Grey -> RGBA (or BGRA, which is the same thing here). Plain SSE2.
+static void greyToRGBA(const unsigned char* src, unsigned char* dst, unsigned int width)
+{
+  const __m128i opaque = _mm_set1_epi8((char)0xFF);
+  unsigned int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i g = _mm_loadu_si128((const __m128i*)(src + x));
+    __m128i gg0 = _mm_unpacklo_epi8(g, g);
+    __m128i gg1 = _mm_unpackhi_epi8(g, g);
+    __m128i ga0 = _mm_unpacklo_epi8(g, opaque);
+    __m128i ga1 = _mm_unpackhi_epi8(g, opaque);
+    _mm_storeu_si128((__m128i*)(dst + x * 4),      _mm_unpacklo_epi16(gg0, ga0));
+    _mm_storeu_si128((__m128i*)(dst + x * 4 + 16), _mm_unpackhi_epi16(gg0, ga0));
+    _mm_storeu_si128((__m128i*)(dst + x * 4 + 32), _mm_unpacklo_epi16(gg1, ga1));
+    _mm_storeu_si128((__m128i*)(dst + x * 4 + 48), _mm_unpackhi_epi16(gg1, ga1));
+  }
+  convertRowForwards<unsigned char, unsigned char>(src + x, kGrey, dst + x * 4, kRGBA, width - x);
+}
+
+
+// 16 bit -> 8 bit for any layout, since the channel order doesn't change.
+// Computes round(v / 257) exactly as (v - ((v + 128) >> 8) + 128) >> 8, using
+// a rounding average to get (v + 128) >> 8 without overflowing.
+static void narrow16To8(const unsigned short* src, unsigned char* dst, size_t count)
+{
+  const __m128i k127 = _mm_set1_epi16(127);
+  const __m128i k128 = _mm_set1_epi16(128);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+    a = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(a, _mm_srli_epi16(_mm_avg_epu16(a, k127), 7)), k128), 8);
+    b = _mm_srli_epi16(_mm_add_epi16(_mm_sub_epi16(b, _mm_srli_epi16(_mm_avg_epu16(b, k127), 7)), k128), 8);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+  }
+  for (; i < count; ++i)
+    dst[i] = convertChannel<unsigned short, unsigned char>(src[i]);
+}
+
+
+// Returns a SIMD kernel for an 8 bit conversion, or NULL if there isn't one.
+static RowFunc simdRowFunc(int srcType, int dstType)
+{
+  bool ssse3 = cpuHasSSSE3();
+  if ((srcType == GL_RGBA && dstType == GL_BGRA) || (srcType == GL_BGRA && dstType == GL_RGBA))
+    return swapRB4;
+  if (ssse3 && ((srcType == GL_RGB && dstType == GL_BGR) || (srcType == GL_BGR && dstType == GL_RGB)))
+    return swapRB3;
+  if (ssse3 && ((srcType == GL_RGB && dstType == GL_RGBA) || (srcType == GL_BGR && dstType == GL_BGRA)))
+    return rgbToRGBA;
+  if (ssse3 && ((srcType == GL_RGB && dstType == GL_BGRA) || (srcType == GL_BGR && dstType == GL_RGBA)))
+    return rgbToBGRA;
+  if (ssse3 && ((srcType == GL_RGBA && dstType == GL_RGB) || (srcType == GL_BGRA && dstType == GL_BGR)))
+    return rgbaToRGB;
+  if (ssse3 && ((srcType == GL_RGBA && dstType == GL_BGR) || (srcType == GL_BGRA && dstType == GL_RGB)))
+    return rgbaToBGR;
+  if ((srcType == GL_ALPHA || srcType == GL_LUMINANCE) && (dstType == GL_RGBA || dstType == GL_BGRA))
+    return greyToRGBA;
+  return NULL;
+}
+
+
+// Premultiplies four RGBA or BGRA pixels at a time: c = round(c * a / 255),
+// computed as (t + (t >> 8)) >> 8 where t = c * a + 128.
+static void premultiplyRow4(unsigned char* pixels, unsigned int width)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k128 = _mm_set1_epi16(128);
+  const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+  unsigned int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(pixels + x * 4));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+    __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+    lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), k128);
+    hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), k128);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    __m128i r = _mm_packus_epi16(lo, hi);
+    r = _mm_or_si128(_mm_andnot_si128(alphaMask, r), _mm_and_si128(alphaMask, v));
+    _mm_storeu_si128((__m128i*)(pixels + x * 4), r);
+  }
+  for (; x < width; ++x) {
+    unsigned char* p = pixels + x * 4;
+    for (unsigned int c = 0; c < 3; ++c) {
+      unsigned int t = p[c] * p[3] + 128;
+      p[c] = (unsigned char)((t + (t >> 8)) >> 8);
+    }
+  }
+}
+
+
+// Float -> half for any layout, eight channels at a time.
+VGL_TARGET("avx,f16c")
+static void floatToHalfRow(const float* src, unsigned short* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_loadu_ps(src + i);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+  }
+  for (; i < count; ++i)
+    dst[i] = floatToHalf(src[i]);
+}
+
+
+// Half -> float for any layout, eight channels at a time.
+VGL_TARGET("avx,f16c")
+static void halfToFloatRow(const unsigned short* src, float* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(v));
+  }
+  for (; i < count; ++i)
+    dst[i] = halfToFloat(src[i]);
+}
+
+
+// Float -> 8 bit for any layout. Clamps to [0, 1] and rounds the same way as
+// the scalar code.
+static void floatTo8Row(const float* src, unsigned char* dst, size_t count)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i v[4];
+    for (int j = 0; j < 4; ++j) {
+      __m128 f = _mm_loadu_ps(src + i + j * 4);
+      f = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(f, zero), one), scale), half);
+      v[j] = _mm_cvttps_epi32(f);
+    }
+    __m128i lo = _mm_packs_epi32(v[0], v[1]);
+    __m128i hi = _mm_packs_epi32(v[2], v[3]);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  for (; i < count; ++i)
+    dst[i] = fromFloat<unsigned char>(src[i]);
+}
+
+#endif // VGL_SIMD_X86
+
+
+//
+// FUNCTIONS
+//
+
+unsigned short floatToHalf(float f)
+{
+  union { float f; unsigned int u; } v;
+  v.f = f;
+  unsigned int sign = (v.u >> 16) & 0x8000;
+  unsigned int bits = v.u & 0x7FFFFFFF;
+
+  if (bits >= 0x7F800000) // Inf or NaN.
+    return (unsigned short)(sign | 0x7C00 | ((bits > 0x7F800000) ? 0x200 : 0));
+  if (bits >= 0x477FF000) // Rounds up past the largest half, 65504.
+    return (unsigned short)(sign | 0x7C00);
+
+  if (bits < 0x38800000) {
+    // Denormal (or zero) as a half.
+    if (bits < 0x33000000)
+      return (unsigned short)sign;
+    unsigned int mantissa = (bits & 0x7FFFFF) | 0x800000;
+    unsigned int shift = 126 - (bits >> 23);
+    unsigned int h = mantissa >> shift;
+    unsigned int rest = mantissa & ((1u << shift) - 1);
+    unsigned int halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1)))
+      ++h;
+    return (unsigned short)(sign | h);
+  }
+
+  // Normal: rebias the exponent and round the mantissa to nearest even. A
+  // carry out of the mantissa correctly bumps the exponent.
+  unsigned int h = (bits - 0x38000000) >> 13;
+  unsigned int rest = bits & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+    ++h;
+  return (unsigned short)(sign | h);
+}
+
+
+float halfToFloat(unsigned short h)
+{
+  unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+  unsigned int exponent = (h >> 10) & 0x1F;
+  unsigned int mantissa = h & 0x3FF;
+
+  union { float f; unsigned int u; } v;
+  if (exponent == 0) {
+    // Zero or denormal: mantissa * 2^-24.
+    v.f = mantissa * 5.9604644775390625e-8f;
+    v.u |= sign;
+  } else if (exponent == 31) {
+    v.u = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    v.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  return v.f;
+}
+
+
+unsigned int channelsForType(int type)
+{
+  Layout layout;
+  return describe(type, layout) ? layout.channels : 0;
+}
+
+
+unsigned int bytesPerChannelForPixelType(int pixelType)
+{
+  switch (pixelType) {
+    case GL_UNSIGNED_BYTE:
+      return 1;
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      return 2;
+    case GL_FLOAT:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+
+void convertPixels(const void* src, int srcType, void* dst, int dstType,
+    unsigned int width, unsigned int height, int srcPixelType, int dstPixelType)
+{
+  Layout sl, dl;
+  if (!describe(srcType, sl) || !describe(dstType, dl))
+    return;
+  unsigned int srcBytes = bytesPerChannelForPixelType(srcPixelType);
+  unsigned int dstBytes = bytesPerChannelForPixelType(dstPixelType);
+  if (srcBytes == 0 || dstBytes == 0)
+    return;
+
+  const size_t srcStride = size_t(width) * sl.channels * srcBytes;
+  const size_t dstStride = size_t(width) * dl.channels * dstBytes;
+  const unsigned char* s = (const unsigned char*)src;
+  unsigned char* d = (unsigned char*)dst;
+  const int rows = (int)height;
+
+  if (src == dst && srcStride != dstStride) {
+    // In place with a change of pixel size: the rows overlap, so they have to
+    // be done one at a time in an order which never overwrites data that
+    // hasn't been read yet.
+    if (dstStride < srcStride) {
+      for (int y = 0; y < rows; ++y)
+        convertRow(s + y * srcStride, sl, srcPixelType, d + y * dstStride, dl, dstPixelType, width, false);
+    } else {
+      for (int y = rows - 1; y >= 0; --y)
+        convertRow(s + y * srcStride, sl, srcPixelType, d + y * dstStride, dl, dstPixelType, width, true);
+    }
+    return;
+  }
+
+  if (srcType == dstType && srcPixelType == dstPixelType) {
+    if (src != dst)
+      memcpy(dst, src, srcStride * height);
+    return;
+  }
+
+#ifdef VGL_SIMD_X86
+  if (srcType == dstType) {
+    // Only the channel size is changing, so whole rows can be treated as flat
+    // arrays of channels.
+    const size_t count = size_t(width) * sl.channels;
+    if (srcPixelType == GL_UNSIGNED_SHORT && dstPixelType == GL_UNSIGNED_BYTE) {
+      #pragma omp parallel for
+      for (int y = 0; y < rows; ++y)
+        narrow16To8((const unsigned short*)(s + y * srcStride), d + y * dstStride, count);
+      return;
+    }
+    if (srcPixelType == GL_FLOAT && dstPixelType == GL_UNSIGNED_BYTE) {
+      #pragma omp parallel for
+      for (int y = 0; y < rows; ++y)
+        floatTo8Row((const float*)(s + y * srcStride), d + y * dstStride, count);
+      return;
+    }
+    if (srcPixelType == GL_FLOAT && dstPixelType == GL_HALF_FLOAT && cpuHasF16C()) {
+      #pragma omp parallel for
+      for (int y = 0; y < rows; ++y)
+        floatToHalfRow((const float*)(s + y * srcStride), (unsigned short*)(d + y * dstStride), count);
+      return;
+    }
+    if (srcPixelType == GL_HALF_FLOAT && dstPixelType == GL_FLOAT && cpuHasF16C()) {
+      #pragma omp parallel for
+      for (int y = 0; y < rows; ++y)
+        halfToFloatRow((const unsigned short*)(s + y * srcStride), (float*)(d + y * dstStride), count);
+      return;
+    }
+  }
+
+  RowFunc func = (srcPixelType == GL_UNSIGNED_BYTE && dstPixelType == GL_UNSIGNED_BYTE) ?
+      simdRowFunc(srcType, dstType) : NULL;
+  if (func != NULL) {
+    #pragma omp parallel for
+    for (int y = 0; y < rows; ++y)
+      func(s + y * srcStride, d + y * dstStride, width);
+    return;
+  }
+#endif
+
+  #pragma omp parallel for
+  for (int y = 0; y < rows; ++y)
+    convertRow(s + y * srcStride, sl, srcPixelType, d + y * dstStride, dl, dstPixelType, width, false);
+}
+
+
+void premultiplyAlpha(void* pixels, int type, unsigned int width,
+    unsigned int height, int pixelType)
+{
+  Layout layout;
+  if (!describe(type, layout) || layout.a < 0)
+    return;
+
+  const int rows = (int)height;
+  const size_t stride = size_t(width) * layout.channels * bytesPerChannelForPixelType(pixelType);
+  unsigned char* p = (unsigned char*)pixels;
+
+#ifdef VGL_SIMD_X86
+  if (pixelType == GL_UNSIGNED_BYTE && layout.channels == 4) {
+    #pragma omp parallel for
+    for (int y = 0; y < rows; ++y)
+      premultiplyRow4(p + y * stride, width);
+    return;
+  }
+#endif
+
+  #pragma omp parallel for
+  for (int y = 0; y < rows; ++y) {
+    switch (pixelType) {
+      case GL_UNSIGNED_BYTE:  premultiplyRow((unsigned char*)(p + y * stride), layout, width); break;
+      case GL_UNSIGNED_SHORT: premultiplyRow((unsigned short*)(p + y * stride), layout, width); break;
+      case GL_FLOAT:          premultiplyRow((float*)(p + y * stride), layout, width); break;
+      case GL_HALF_FLOAT:     premultiplyRow((Half*)(p + y * stride), layout, width); break;
+    }
+  }
+}
+
+
+void flipRowsInPlace(void* pixels, size_t rowBytes, unsigned int height)
+{
+  unsigned char* p = (unsigned char*)pixels;
+  const int pairs = (int)(height / 2);
+  #pragma omp parallel for
+  for (int y = 0; y < pairs; ++y) {
+    unsigned char* top = p + size_t(y) * rowBytes;
+    unsigned char* bottom = p + size_t(height - 1 - y) * rowBytes;
+    std::swap_ranges(top, top + rowBytes, bottom);
+  }
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,69 @@
+#ifndef vgl_convert_h
+#define vgl_convert_h
+
+#include <cstddef>
+
+#define GL_GLEXT_PROTOTYPES 1
+#ifdef linux
+#include <GL/gl.h>
+#include <GL/glext.h>
+#else
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#endif
+
+namespace vgl {
+
+//
+// FUNCTIONS
+//
+
+// Convert a block of pixels from one layout to another. The types are the
+// same GL format enums that RawImage uses (GL_RGB, GL_BGR, GL_RGBA, GL_BGRA,
+// GL_ALPHA, GL_LUMINANCE, GL_LUMINANCE_ALPHA) and the pixel types give the
+// type of each channel (GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_HALF_FLOAT or
+// GL_FLOAT). Everything is expected in native byte order. Integer channels
+// are treated as covering [0, 1]; floats are clamped to that range when
+// converted to integers, but are otherwise left alone.
+//
+// Single channel images are treated as greyscale: the loaders use GL_ALPHA
+// for greyscale data, so it's expanded to (g, g, g, 1) rather than (1, 1, 1,
+// a). Converting colour to a single channel gives the Rec. 601 luma. Missing
+// alpha channels are filled in as fully opaque.
+//
+// Rows are converted in parallel and the common 8 bit, 16 bit to 8 bit and
+// float to 8 bit or half conversions have SIMD kernels. src and dst may be the same buffer, in which case the conversion
+// happens in place; that's only parallel when the pixel size doesn't change.
+// The buffer must be large enough to hold the result.
+void convertPixels(const void* src, int srcType, void* dst, int dstType,
+    unsigned int width, unsigned int height,
+    int srcPixelType = GL_UNSIGNED_BYTE, int dstPixelType = GL_UNSIGNED_BYTE);
+
+// Multiply the colour channels of each pixel by its alpha, in place. Does
+// nothing for types which don't have an alpha channel.
+void premultiplyAlpha(void* pixels, int type, unsigned int width,
+    unsigned int height, int pixelType = GL_UNSIGNED_BYTE);
+
+// Reverse the order of the rows in a block of pixels, in place. Each pair of
+// rows is swapped in a single pass over both, and the pairs are shared out
+// between threads.
+void flipRowsInPlace(void* pixels, size_t rowBytes, unsigned int height);
+
+// Convert between 32 bit floats and the raw bits of a 16 bit half float,
+// rounding to nearest even.
+unsigned short floatToHalf(float f);
+float halfToFloat(unsigned short h);
+
+// The number of channels for a GL format enum, or 0 if it isn't one we know
+// how to convert.
+unsigned int channelsForType(int type);
+
+// The number of bytes for a GL pixel type enum, or 0 if it isn't one we know
+// how to convert.
+unsigned int bytesPerChannelForPixelType(int pixelType);
+
+
+} // namespace vgl
+
+#endif // vgl_convert_h
+
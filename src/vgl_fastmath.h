@@ -0,0 +1,171 @@
+#ifndef vgl_fastmath_h
+#define vgl_fastmath_h
+
+// Math policies for the vector functions. Functions like norm and rotateX
+// have a second form taking one of these as an explicit template parameter,
+// e.g. norm<FastMath>(v) or rotateX<ExactMath>(v, radians), so the choice
+// between speed and accuracy is made at compile time with no runtime cost.
+//
+// Each policy provides:
+//
+//   Num rsqrt(Num x)                      1 / sqrt(x)
+//   Num sin(Num x), cos(Num x)
+//   void sincos(Num x, Num& s, Num& c)    both at once
+//
+// for Num = float or double.
+
+#include "vgl_simd.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef VGL_SIMD_SSE2
+#include <xmmintrin.h>
+#endif
+
+namespace vgl {
+
+//
+// Types
+//
+
+// Uses the standard library, so results are as accurate as std::sqrt,
+// std::sin and std::cos.
+struct ExactMath {
+  template <typename Num>
+  static Num rsqrt(Num x)
+  {
+    return Num(1) / std::sqrt(x);
+  }
+
+  template <typename Num>
+  static Num sin(Num x)
+  {
+    return std::sin(x);
+  }
+
+  template <typename Num>
+  static Num cos(Num x)
+  {
+    return std::cos(x);
+  }
+
+  template <typename Num>
+  static void sincos(Num x, Num& s, Num& c)
+  {
+    s = std::sin(x);
+    c = std::cos(x);
+  }
+};
+
+
+// Approximations which trade a little accuracy for speed. The error bounds
+// below are checked by test_fastmath.
+//
+// rsqrt: the SSE estimate (rsqrtss) refined by one Newton-Raphson step, or the
+// integer bit trick refined by two where SSE isn't available. Relative error
+// is under 5e-7 (5e-6 without SSE) for any positive normal float; doubles are
+// done in float too. Zero gives NaN rather than +inf.
+//
+// sin, cos and sincos: reduced to [-pi/4, pi/4] by subtracting the nearest
+// multiple of pi/2 (in three parts, so the subtraction stays exact), then
+// evaluated with Taylor polynomials up to degree 9 for sin and 8 for cos.
+// Absolute error is under 2e-7 for floats and 5e-8 for doubles, for |x| up
+// to 8192. Anything bigger, infinite or NaN goes to std::sin and std::cos
+// instead, since the reduction loses accuracy past that and would eventually
+// overflow.
+struct FastMath {
+  static float rsqrt(float x)
+  {
+#ifdef VGL_SIMD_SSE2
+    float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return y * (1.5f - 0.5f * x * y * y);
+#else
+    unsigned int i;
+    std::memcpy(&i, &x, sizeof(i));
+    i = 0x5F375A86u - (i >> 1);
+    float y;
+    std::memcpy(&y, &i, sizeof(y));
+    y = y * (1.5f - 0.5f * x * y * y);
+    return y * (1.5f - 0.5f * x * y * y);
+#endif
+  }
+
+  // Only as accurate as the float version, and only for values in float range.
+  static double rsqrt(double x)
+  {
+    return rsqrt(float(x));
+  }
+
+  template <typename Num>
+  static Num sin(Num x)
+  {
+    Num s, c;
+    sincos(x, s, c);
+    return s;
+  }
+
+  template <typename Num>
+  static Num cos(Num x)
+  {
+    Num s, c;
+    sincos(x, s, c);
+    return c;
+  }
+
+  template <typename Num>
+  static void sincos(Num x, Num& s, Num& c)
+  {
+    // Written so that NaN fails the test too.
+    if (!(std::fabs(x) <= Num(8192))) {
+      s = std::sin(x);
+      c = std::cos(x);
+      return;
+    }
+
+    // x = k * pi/2 + r, with the k rounded to nearest.
+    int k = int(x * Num(0.636619772367581343) + (x >= 0 ? Num(0.5) : Num(-0.5)));
+    Num kf = Num(k);
+    Num r = x - kf * Num(1.5703125);
+    r -= kf * Num(4.837512969970703125e-4);
+    r -= kf * Num(7.54978995489188216e-8);
+
+    Num r2 = r * r;
+    Num sr = r + r * r2 * (Num(-1.0 / 6.0) + r2 * (Num(1.0 / 120.0) +
+             r2 * (Num(-1.0 / 5040.0) + r2 * Num(1.0 / 362880.0))));
+    Num cr = Num(1) + r2 * (Num(-0.5) + r2 * (Num(1.0 / 24.0) +
+             r2 * (Num(-1.0 / 720.0) + r2 * Num(1.0 / 40320.0))));
+
+    // Odd quadrants swap sin and cos; sin is negated in quadrants 2 and 3,
+    // cos in 1 and 2. Written as selects rather than a switch so they can be
+    // compiled without branches.
+    Num sq = (k & 1) ? cr : sr;
+    Num cq = (k & 1) ? sr : cr;
+    s = (k & 2) ? -sq : sq;
+    c = ((k + 1) & 2) ? -cq : cq;
+  }
+};
+
+
+// Only defines Type for the two policies above, so the functions which take
+// a policy use typename MathPolicy<Math, ReturnType>::Type as their return
+// type and drop out of overload resolution for anything else. Otherwise a
+// call like norm<float>(v) would be ambiguous: float could be either the
+// policy or the number type.
+template <typename Math, typename Result>
+struct MathPolicy {};
+
+template <typename Result>
+struct MathPolicy<ExactMath, Result> {
+  typedef Result Type;
+};
+
+template <typename Result>
+struct MathPolicy<FastMath, Result> {
+  typedef Result Type;
+};
+
+
+} // namespace vgl
+
+#endif // vgl_fastmath_h
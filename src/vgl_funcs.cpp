@@ -18,6 +18,46 @@
 
 namespace vgl {
 
+//
+// HELPER FUNCTIONS
+//
+
+// Clip space to window space and back again are a scale and offset, which
+// these fold into the matrix so each point is just one multiply and a divide.
+static Matrix4f windowFromNDC(const Vec4i& viewport)
+{
+  Matrix4f m;
+  m.m00 = viewport.z * 0.5f;
+  m.m03 = viewport.x + viewport.z * 0.5f;
+  m.m11 = viewport.w * 0.5f;
+  m.m13 = viewport.y + viewport.w * 0.5f;
+  m.m22 = 0.5f;
+  m.m23 = 0.5f;
+  return m;
+}
+
+
+static Matrix4f projectMatrix(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport)
+{
+  return windowFromNDC(viewport) * (projection * modelView);
+}
+
+
+static Matrix4f unprojectMatrix(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport)
+{
+  return inverse(projectMatrix(modelView, projection, viewport));
+}
+
+
+static inline Vec3f transformAndDivide(const Matrix4f& m, const Vec3f& p)
+{
+  Vec4f v = m * Vec4f(p.x, p.y, p.z, 1.0f);
+  float invW = 1.0f / v.w;
+  return Vec3f(v.x * invW, v.y * invW, v.z * invW);
+}
+
 
 //
 // OpenGL helper functions.
@@ -42,5 +82,41 @@ Vec3f unproject(double x, double y, double z)
 }
 
 
+//
+// Projection without GL state.
+//
+
+Vec3f project(const Vec3f& p, const Matrix4f& modelView,
+    const Matrix4f& projection, const Vec4i& viewport)
+{
+  return transformAndDivide(projectMatrix(modelView, projection, viewport), p);
+}
+
+
+Vec3f unproject(const Vec3f& win, const Matrix4f& modelView,
+    const Matrix4f& projection, const Vec4i& viewport)
+{
+  return transformAndDivide(unprojectMatrix(modelView, projection, viewport), win);
+}
+
+
+void project(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport, const Vec3f* src, Vec3f* dst, size_t count)
+{
+  Matrix4f m = projectMatrix(modelView, projection, viewport);
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = transformAndDivide(m, src[i]);
+}
+
+
+void unproject(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport, const Vec3f* src, Vec3f* dst, size_t count)
+{
+  Matrix4f m = unprojectMatrix(modelView, projection, viewport);
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = transformAndDivide(m, src[i]);
+}
+
+
 } // namespace vgl
 
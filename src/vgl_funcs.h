@@ -1,7 +1,11 @@
 #ifndef vgl_funcs_h
 #define vgl_funcs_h
 
+#include "vgl_matrix4.h"
 #include "vgl_vec3.h"
+#include "vgl_vec4.h"
+
+#include <cstddef>
 
 namespace vgl {
 
@@ -10,10 +14,34 @@ namespace vgl {
 // OpenGL helper functions.
 //
 
+// Reads the current matrices and viewport back from GL, so it stalls the
+// pipeline. Prefer the versions below where the matrices are already known,
+// e.g. from Camera::getProjectionMatrix() and friends.
 Vec3f unproject(double x, double y, double z = 0.5);
 
 
+//
+// Projection without GL state.
+//
+
+// These work like gluProject and gluUnProject, but take the matrices in
+// Matrix4's row-major layout. The viewport is (x, y, width, height). Window
+// coordinates have y increasing upwards and z running from 0 at the near
+// plane to 1 at the far plane.
+Vec3f project(const Vec3f& p, const Matrix4f& modelView,
+    const Matrix4f& projection, const Vec4i& viewport);
+Vec3f unproject(const Vec3f& win, const Matrix4f& modelView,
+    const Matrix4f& projection, const Vec4i& viewport);
+
+// Whole arrays at a time. The matrices are combined (and for unproject,
+// inverted) once up front. src and dst may be the same array, but mustn't
+// otherwise overlap.
+void project(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport, const Vec3f* src, Vec3f* dst, size_t count);
+void unproject(const Matrix4f& modelView, const Matrix4f& projection,
+    const Vec4i& viewport, const Vec3f* src, Vec3f* dst, size_t count);
+
+
 } // namespace vgl
 
 #endif // vgl_funcs_h
-
@@ -1,22 +1,584 @@
 #include "vgl_image.h"
 
+#include "vgl_convert.h"
+#include "vgl_pixelpool.h"
+#include "vgl_simd.h"
+
 #include <libgen.h>
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <cstdarg>
 #include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 #include <jpeglib.h>  // Required for jpeg support.
 #include <png.h>      // Required for png support.
 #include <tiffio.h>   // Required for tiff support.
+#include <zlib.h>     // Required for parallel png compression.
+
+#ifdef VGL_USE_OPENEXR
+#include <ImfChannelList.h>  // Required for exr support.
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfThreading.h>
+#include <string>
+#endif
 
-#ifdef linux
-#include <GL/gl.h>
-#else
-#include <OpenGL/gl.h>
+#ifdef VGL_SIMD_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
 #endif
 
 
 namespace vgl {
 
+//
+// CONSTANTS
+//
+
+// RLE TGAs with at least this many pixels are decoded in parallel.
+static const size_t kTGAParallelPixels = 512 * 512;
+
+
+//
+// TYPES
+//
+
+// A position within run length encoded TGA data: the offset of a packet
+// header and how many of the packet's pixels have already been used up.
+struct TGARunPos {
+  size_t offset;
+  unsigned int used;
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+// Point samples every downsampleX'th pixel of every downsampleY'th row of src
+// into dst.
+static void downsamplePixels(const unsigned char* src, unsigned int srcWidth,
+    unsigned int bpp, unsigned int downsampleX, unsigned int downsampleY,
+    unsigned char* dst, unsigned int dstWidth, unsigned int dstHeight)
+{
+  const size_t srcStride = size_t(srcWidth) * bpp;
+  const size_t dstStride = size_t(dstWidth) * bpp;
+  const size_t xStride = size_t(downsampleX) * bpp;
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)dstHeight; ++y) {
+    const unsigned char* from = src + size_t(y) * downsampleY * srcStride;
+    unsigned char* to = dst + size_t(y) * dstStride;
+    for (unsigned int x = 0; x < dstWidth; ++x) {
+      memcpy(to, from, bpp);
+      to += bpp;
+      from += xStride;
+    }
+  }
+}
+
+
+// Owns a buffer from the pixel pool until it goes out of scope.
+struct ScopedPixels {
+  unsigned char* pixels;
+
+  ScopedPixels() : pixels(NULL) {}
+  ~ScopedPixels() { freePixels(pixels); }
+};
+
+
+// A read only mapping of a whole file, unmapped when it goes out of scope.
+struct ScopedMapping {
+  const unsigned char* data;
+  size_t size;
+
+  ScopedMapping() : data(NULL), size(0) {}
+  ~ScopedMapping() { if (data != NULL) munmap((void*)data, size); }
+
+  bool map(FILE* file)
+  {
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0 || info.st_size <= 0)
+      return false;
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (mapping == MAP_FAILED)
+      return false;
+    data = (const unsigned char*)mapping;
+    size = info.st_size;
+    return true;
+  }
+};
+
+
+// Returns the pixels in the requested format, converting them into scratch
+// if they aren't already.
+static const unsigned char* pixelsAs(const unsigned char* pixels, int type, int pixelType,
+    unsigned int width, unsigned int height, int dstType, int dstPixelType,
+    ScopedPixels& scratch) throw(ImageException)
+{
+  if (type == dstType && pixelType == dstPixelType)
+    return pixels;
+  if (channelsForType(type) == 0 || bytesPerChannelForPixelType(pixelType) == 0)
+    throw ImageException("Unable to save images with this pixel format.");
+
+  size_t bpp = channelsForType(dstType) * bytesPerChannelForPixelType(dstPixelType);
+  scratch.pixels = allocPixels(bpp * width * height);
+  convertPixels(pixels, type, scratch.pixels, dstType, width, height, pixelType, dstPixelType);
+  return scratch.pixels;
+}
+
+
+static bool isLittleEndian()
+{
+  unsigned short endianTest = 1;
+  return *(unsigned char*)&endianTest == 1;
+}
+
+
+// Copies 16 bit samples, swapping the byte order.
+static void swapBytes16(const unsigned char* src, unsigned char* dst, size_t count)
+{
+  const unsigned short* in = (const unsigned short*)src;
+  unsigned short* out = (unsigned short*)dst;
+  for (size_t i = 0; i < count; ++i)
+    out[i] = (unsigned short)((in[i] >> 8) | (in[i] << 8));
+}
+
+
+static inline unsigned char paethPredictor(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return (unsigned char)a;
+  return (unsigned char)((pb <= pc) ? b : c);
+}
+
+
+// Applies whichever PNG filter gives the smallest sum of absolute differences
+// for the row (the usual libpng heuristic), writing the filter type byte
+// followed by the filtered bytes to out. prev is NULL for the first row.
+static void pngFilterRow(const unsigned char* row, const unsigned char* prev,
+    size_t rowBytes, unsigned int bpp, unsigned char* out)
+{
+  unsigned long sums[5] = { 0, 0, 0, 0, 0 };
+  for (size_t i = 0; i < rowBytes; ++i) {
+    int x = row[i];
+    int a = (i >= bpp) ? row[i - bpp] : 0;
+    int b = prev ? prev[i] : 0;
+    int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+    sums[0] += abs((signed char)x);
+    sums[1] += abs((signed char)(x - a));
+    sums[2] += abs((signed char)(x - b));
+    sums[3] += abs((signed char)(x - ((a + b) >> 1)));
+    sums[4] += abs((signed char)(x - paethPredictor(a, b, c)));
+  }
+  int filter = int(std::min_element(sums, sums + 5) - sums);
+
+  out[0] = (unsigned char)filter;
+  ++out;
+  for (size_t i = 0; i < rowBytes; ++i) {
+    int x = row[i];
+    int a = (i >= bpp) ? row[i - bpp] : 0;
+    int b = prev ? prev[i] : 0;
+    int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+    switch (filter) {
+      case 0: out[i] = (unsigned char)x; break;
+      case 1: out[i] = (unsigned char)(x - a); break;
+      case 2: out[i] = (unsigned char)(x - b); break;
+      case 3: out[i] = (unsigned char)(x - ((a + b) >> 1)); break;
+      default: out[i] = (unsigned char)(x - paethPredictor(a, b, c)); break;
+    }
+  }
+}
+
+
+// Raw deflates data[begin, end), primed with up to 32 KiB of the data before
+// it as the dictionary. Every strip but the last ends with a sync flush so the
+// strips can simply be concatenated into a single stream.
+static bool deflateStrip(const unsigned char* data, size_t begin, size_t end,
+    int level, bool last, std::vector<unsigned char>& out)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  size_t dictStart = (begin > 32768) ? begin - 32768 : 0;
+  if (begin > dictStart)
+    deflateSetDictionary(&zs, data + dictStart, uInt(begin - dictStart));
+
+  out.resize(deflateBound(&zs, uLong(end - begin)) + 16);
+  zs.next_in = const_cast<Bytef*>(data + begin);
+  zs.avail_in = uInt(end - begin);
+  int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  size_t used = 0;
+  bool done = false;
+  while (!done) {
+    zs.next_out = &out[used];
+    zs.avail_out = uInt(out.size() - used);
+    int result = deflate(&zs, flush);
+    used = out.size() - zs.avail_out;
+    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+      break;
+    // A flush is only complete once deflate stops filling the whole buffer.
+    done = last ? (result == Z_STREAM_END) : (zs.avail_in == 0 && zs.avail_out != 0);
+    if (!done)
+      out.resize(out.size() * 2);
+  }
+  out.resize(used);
+  deflateEnd(&zs);
+  return done;
+}
+
+
+static void putBigEndian32(unsigned char* dst, unsigned long value)
+{
+  dst[0] = (unsigned char)(value >> 24);
+  dst[1] = (unsigned char)(value >> 16);
+  dst[2] = (unsigned char)(value >> 8);
+  dst[3] = (unsigned char)value;
+}
+
+
+static bool writePNGChunk(FILE* file, const char* type, const unsigned char* data, size_t size)
+{
+  unsigned char header[8];
+  putBigEndian32(header, (unsigned long)size);
+  memcpy(header + 4, type, 4);
+  uLong crc = crc32(0, header + 4, 4);
+  if (size > 0)
+    crc = crc32(crc, data, uInt(size));
+  unsigned char trailer[4];
+  putBigEndian32(trailer, crc);
+  return fwrite(header, 1, 8, file) == 8 &&
+         (size == 0 || fwrite(data, 1, size, file) == size) &&
+         fwrite(trailer, 1, 4, file) == 4;
+}
+
+
+// Writes a complete PNG file from top-down rows, without going through
+// libpng. The rows are filtered in parallel, then split into strips which are
+// deflated in parallel and stitched back together into one zlib stream.
+static void writePNGStrips(FILE* file, const unsigned char* const* rows,
+    unsigned int width, unsigned int height, unsigned int bpp, int bitDepth, int colorType,
+    int level, unsigned int stripRows) throw(ImageException)
+{
+  const size_t rowBytes = size_t(width) * bpp;
+  const size_t filteredRowBytes = rowBytes + 1;
+  const unsigned int filterBpp = std::max(1u, bpp);
+  std::vector<unsigned char> filtered(filteredRowBytes * height);
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)height; ++y)
+    pngFilterRow(rows[y], y > 0 ? rows[y - 1] : NULL, rowBytes, filterBpp, &filtered[y * filteredRowBytes]);
+
+  // Aim for strips of about 256 KiB, which is big enough that priming each one
+  // with the previous 32 KiB costs very little compression.
+  if (stripRows == 0)
+    stripRows = std::max(1u, (unsigned int)((256 * 1024) / filteredRowBytes));
+  const int numStrips = std::max(1, (int)((height + stripRows - 1) / stripRows));
+  std::vector< std::vector<unsigned char> > strips(numStrips);
+  std::vector<uLong> adlers(numStrips);
+  bool ok = true;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int s = 0; s < numStrips; ++s) {
+    size_t begin = std::min(size_t(s) * stripRows, size_t(height)) * filteredRowBytes;
+    size_t end = std::min(size_t(s + 1) * stripRows, size_t(height)) * filteredRowBytes;
+    const unsigned char* data = filtered.empty() ? NULL : &filtered[0];
+    adlers[s] = adler32(adler32(0, NULL, 0), data + begin, uInt(end - begin));
+    if (!deflateStrip(data, begin, end, level, s == numStrips - 1, strips[s])) {
+      #pragma omp critical (vgl_pngstrips)
+      ok = false;
+    }
+  }
+  if (!ok)
+    throw ImageException("Error compressing PNG data.");
+
+  // zlib header, the strips, then the Adler-32 of all the uncompressed data.
+  unsigned int flevel = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+  unsigned int cmf = 0x78, flg = flevel << 6;
+  flg += 31 - ((cmf << 8) + flg) % 31;
+
+  std::vector<unsigned char> idat;
+  idat.push_back((unsigned char)cmf);
+  idat.push_back((unsigned char)flg);
+  uLong adler = adler32(0, NULL, 0);
+  for (int s = 0; s < numStrips; ++s) {
+    idat.insert(idat.end(), strips[s].begin(), strips[s].end());
+    size_t begin = std::min(size_t(s) * stripRows, size_t(height)) * filteredRowBytes;
+    size_t end = std::min(size_t(s + 1) * stripRows, size_t(height)) * filteredRowBytes;
+    adler = adler32_combine(adler, adlers[s], z_off_t(end - begin));
+  }
+  unsigned char trailer[4];
+  putBigEndian32(trailer, adler);
+  idat.insert(idat.end(), trailer, trailer + 4);
+
+  static const unsigned char kSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  unsigned char ihdr[13];
+  putBigEndian32(ihdr, width);
+  putBigEndian32(ihdr + 4, height);
+  ihdr[8] = (unsigned char)bitDepth;
+  ihdr[9] = (unsigned char)colorType;
+  ihdr[10] = 0; // Compression method.
+  ihdr[11] = 0; // Filter method.
+  ihdr[12] = 0; // Interlace method.
+
+  const size_t kMaxChunk = 1 << 20;
+  ok = fwrite(kSignature, 1, 8, file) == 8 && writePNGChunk(file, "IHDR", ihdr, 13);
+  for (size_t pos = 0; ok && pos < idat.size(); pos += kMaxChunk)
+    ok = writePNGChunk(file, "IDAT", &idat[pos], std::min(kMaxChunk, idat.size() - pos));
+  ok = ok && writePNGChunk(file, "IEND", NULL, 0);
+  if (!ok)
+    throw ImageException("Error writing PNG data.");
+}
+
+
+// Writes a PNG file from top-down rows through libpng. This is kept apart
+// from savePNG so that none of savePNG's locals are live across the setjmp,
+// where libpng's longjmp could clobber them.
+static void writePNGWithLibPNG(FILE* file, const unsigned char* const* rows,
+    unsigned int width, unsigned int height, int bitDepth, int colorType, int level)
+  throw(ImageException)
+{
+  png_structp pngData = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop pngInfo = png_create_info_struct(pngData);
+  if (setjmp(png_jmpbuf(pngData))) {
+    png_destroy_write_struct(&pngData, &pngInfo);
+    throw ImageException("PNG library error.");
+  }
+
+  png_init_io(pngData, file);
+  png_set_compression_level(pngData, level);
+  png_set_IHDR(pngData, pngInfo, width, height, bitDepth, colorType,
+      PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(pngData, pngInfo);
+  if (bitDepth == 16 && isLittleEndian())
+    png_set_swap(pngData);
+  png_write_image(pngData, const_cast<png_bytepp>(rows));
+  png_write_end(pngData, NULL);
+  png_destroy_write_struct(&pngData, &pngInfo);
+}
+
+
+// libjpeg's default error handler exits the program. This one jumps back to
+// the setjmp in writeJPEGWithLibJPEG instead.
+struct JPEGErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+  longjmp(((JPEGErrorManager*)cinfo->err)->jump, 1);
+}
+
+
+// Writes a JPEG file from top-down rows through libjpeg, kept apart from
+// saveJPG for the same reason as writePNGWithLibPNG.
+static void writeJPEGWithLibJPEG(FILE* file, const unsigned char* const* rows,
+    unsigned int width, unsigned int height, bool grey, int quality)
+  throw(ImageException)
+{
+  jpeg_compress_struct cinfo;
+  JPEGErrorManager jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = jpegErrorExit;
+  if (setjmp(jerr.jump)) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo.err->format_message)((j_common_ptr)&cinfo, message);
+    jpeg_destroy_compress(&cinfo);
+    throw ImageException("JPEG library error: %s", message);
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, file);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = grey ? 1 : 3;
+  cinfo.in_color_space = grey ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<JSAMPROW>(rows[cinfo.next_scanline]);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+}
+
+
+// Run length encodes one row of TGA pixels, returning the number of bytes
+// written to out. Packets never cross the end of a row.
+static size_t tgaEncodeRow(const unsigned char* row, unsigned int width, unsigned int bpp,
+    unsigned char* out)
+{
+  unsigned char* start = out;
+  unsigned int x = 0;
+  while (x < width) {
+    // Count how many times this pixel repeats.
+    unsigned int run = 1;
+    while (x + run < width && run < 128 &&
+           memcmp(row + (x + run) * bpp, row + x * bpp, bpp) == 0)
+      ++run;
+    if (run > 1) {
+      *out++ = (unsigned char)(0x80 | (run - 1));
+      memcpy(out, row + x * bpp, bpp);
+      out += bpp;
+      x += run;
+      continue;
+    }
+
+    // Otherwise gather up pixels until the next run of at least two.
+    unsigned int count = 1;
+    while (x + count < width && count < 128 &&
+           (x + count + 1 >= width ||
+            memcmp(row + (x + count) * bpp, row + (x + count + 1) * bpp, bpp) != 0))
+      ++count;
+    *out++ = (unsigned char)(count - 1);
+    memcpy(out, row + x * bpp, size_t(count) * bpp);
+    out += size_t(count) * bpp;
+    x += count;
+  }
+  return size_t(out - start);
+}
+
+
+// Expands the next count pixels of run length encoded TGA data into out,
+// starting from pos and leaving pos just after them. With a NULL out it only
+// steps over the packets. Returns false if the data runs out first.
+static bool tgaDecodeRLE(const unsigned char* data, size_t size, TGARunPos& pos,
+    unsigned char* out, unsigned int count, unsigned int bpp)
+{
+  while (count > 0) {
+    if (pos.offset >= size)
+      return false;
+    unsigned int header = data[pos.offset];
+    bool isEncoded = header > 127;
+    unsigned int packetPixels = (header & 0x7F) + 1;
+    size_t packetBytes = 1 + (isEncoded ? 1 : packetPixels) * size_t(bpp);
+    if (packetBytes > size - pos.offset)
+      return false;
+
+    unsigned int n = std::min(packetPixels - pos.used, count);
+    if (out != NULL) {
+      const unsigned char* src = data + pos.offset + 1;
+      if (isEncoded) {
+        for (unsigned int i = 0; i < n; ++i, out += bpp)
+          memcpy(out, src, bpp);
+      } else {
+        memcpy(out, src + size_t(pos.used) * bpp, size_t(n) * bpp);
+        out += size_t(n) * bpp;
+      }
+    }
+    count -= n;
+    pos.used += n;
+    if (pos.used == packetPixels) {
+      pos.offset += packetBytes;
+      pos.used = 0;
+    }
+  }
+  return true;
+}
+
+
+// Reads a 16 or 32 bit value stored in either byte order.
+static unsigned int getU16(const unsigned char* p, bool bigEndian)
+{
+  return bigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+
+static unsigned int getU32(const unsigned char* p, bool bigEndian)
+{
+  return bigEndian ?
+      ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3] :
+      p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+
+// Scales 10 and 12 bit values up to the full 16 bit range.
+static inline unsigned short widen10(unsigned int v)
+{
+  return (unsigned short)((v << 6) | (v >> 4));
+}
+
+
+static inline unsigned short widen12(unsigned int v)
+{
+  return (unsigned short)((v << 4) | (v >> 8));
+}
+
+
+#ifdef VGL_SIMD_X86
+// The SSSE3 version of unpack10, doing four words (12 samples) at a time.
+// Returns the number of samples it unpacked; the caller does the rest.
+VGL_TARGET("ssse3")
+static unsigned int unpack10SSSE3(const unsigned char* src, unsigned short* dst,
+    unsigned int count, bool bigEndian, bool methodB)
+{
+  const __m128i swap = bigEndian ?
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i shift = _mm_cvtsi32_si128(methodB ? 0 : 2);
+  const __m128i mask = _mm_set1_epi32(0x3FF);
+
+  // With a, b and c as the first, second and third samples of each word, the
+  // output is a0 b0 c0 a1 b1 c1 a2 b2 | c2 a3 b3 c3.
+  const __m128i abLo = _mm_setr_epi8(0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11);
+  const __m128i cLo  = _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1);
+  const __m128i abHi = _mm_setr_epi8(-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i cHi  = _mm_setr_epi8(8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+
+  unsigned int i = 0;
+  for (; i + 12 <= count; i += 12) {
+    __m128i w = _mm_loadu_si128((const __m128i*)(src + i / 3 * 4));
+    w = _mm_srl_epi32(_mm_shuffle_epi8(w, swap), shift);
+    __m128i a = _mm_and_si128(_mm_srli_epi32(w, 20), mask);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(w, 10), mask);
+    __m128i c = _mm_and_si128(w, mask);
+    a = _mm_or_si128(_mm_slli_epi32(a, 6), _mm_srli_epi32(a, 4));
+    b = _mm_or_si128(_mm_slli_epi32(b, 6), _mm_srli_epi32(b, 4));
+    c = _mm_or_si128(_mm_slli_epi32(c, 6), _mm_srli_epi32(c, 4));
+    __m128i ab = _mm_or_si128(a, _mm_slli_epi32(b, 16));
+    _mm_storeu_si128((__m128i*)(dst + i),
+        _mm_or_si128(_mm_shuffle_epi8(ab, abLo), _mm_shuffle_epi8(c, cLo)));
+    _mm_storel_epi64((__m128i*)(dst + i + 8),
+        _mm_or_si128(_mm_shuffle_epi8(ab, abHi), _mm_shuffle_epi8(c, cHi)));
+  }
+  return i;
+}
+#endif
+
+
+// Unpacks 10 bit samples stored three to a 32 bit word, as DPX and Cineon
+// files do, widening them to 16 bits. The first sample is in the most
+// significant bits; method A leaves the two unused bits at the bottom of the
+// word and method B at the top.
+static void unpack10(const unsigned char* src, unsigned short* dst, unsigned int count,
+    bool bigEndian, bool methodB)
+{
+  unsigned int i = 0;
+#ifdef VGL_SIMD_X86
+  if (cpuHasSSSE3())
+    i = unpack10SSSE3(src, dst, count, bigEndian, methodB);
+#endif
+  const unsigned int shift = methodB ? 0 : 2;
+  for (; i < count; ++i) {
+    unsigned int word = getU32(src + i / 3 * 4, bigEndian);
+    dst[i] = widen10((word >> (shift + 10 * (2 - i % 3))) & 0x3FF);
+  }
+}
+
+
 //
 // ImageException METHODS
 //
@@ -37,16 +599,32 @@ const char* ImageException::what() const throw()
 }
 
 
+//
+// SaveOptions METHODS
+//
+
+SaveOptions::SaveOptions() :
+  jpegQuality(90),
+  pngCompressionLevel(6),
+  pngParallel(true),
+  pngStripRows(0),
+  tgaRLE(true)
+{
+}
+
+
 //
 // Image METHODS
 //
 
-RawImage::RawImage(const char *path) throw(ImageException) :
+RawImage::RawImage(const char *path, ImageOrigin origin) throw(ImageException) :
   _type(GL_RGB),
+  _pixelType(GL_UNSIGNED_BYTE),
   _texId(0),
   _bytesPerPixel(0),
   _width(0),
   _height(0),
+  _origin(origin),
   _pixels(NULL)
 {
   const char *filename = basename(const_cast<char *>(path));
@@ -74,6 +652,12 @@ RawImage::RawImage(const char *path) throw(ImageException) :
       loadPNG(file);
     } else if (strcasecmp(ext, ".tif") == 0 || strcasecmp(ext, ".tiff") == 0) {
       loadTIFF(path);
+    } else if (strcasecmp(ext, ".exr") == 0) {
+      loadEXR(path);
+    } else if (strcasecmp(ext, ".dpx") == 0) {
+      loadDPX(file);
+    } else if (strcasecmp(ext, ".cin") == 0) {
+      loadCIN(file);
     } else {
       throw ImageException("Unknown image format: %s", ext);
     }
@@ -81,53 +665,132 @@ RawImage::RawImage(const char *path) throw(ImageException) :
   } catch (ImageException& ex) {
     fclose(file);
     if (_pixels != NULL)
-      delete _pixels;
+      freePixels(_pixels);
     throw ex;
   }
 }
 
 
-RawImage::RawImage(int type, int bytesPerPixel, int width, int height) :
+RawImage::RawImage(int type, int bytesPerPixel, int width, int height,
+    int pixelType, ImageOrigin origin) :
   _type(type),
+  _pixelType(pixelType),
   _texId(0),
   _bytesPerPixel(bytesPerPixel),
   _width(width),
   _height(height),
+  _origin(origin),
   _pixels(NULL)
 {
-  unsigned int size = _bytesPerPixel * _width * _height;
-  _pixels = new unsigned char[size];
-  for (unsigned int i = 0; i < size; ++i)
-    _pixels[i] = 0xFF;
+  size_t size = size_t(_bytesPerPixel) * _width * _height;
+  _pixels = allocPixels(size);
+  if (_pixelType == GL_FLOAT) {
+    float* pixels = (float*)_pixels;
+    std::fill(pixels, pixels + size / sizeof(float), 1.0f);
+  } else if (_pixelType == GL_HALF_FLOAT) {
+    unsigned short* pixels = (unsigned short*)_pixels;
+    std::fill(pixels, pixels + size / sizeof(unsigned short), (unsigned short)0x3C00); // 1.0
+  } else {
+    memset(_pixels, 0xFF, size);
+  }
 }
 
 
 RawImage::RawImage(const RawImage& img) :
   _type(img._type),
+  _pixelType(img._pixelType),
   _texId(0),
   _bytesPerPixel(img._bytesPerPixel),
   _width(img._width),
   _height(img._height),
+  _origin(img._origin),
   _pixels(NULL)
 {
-  unsigned int size = _bytesPerPixel * _width * _height;
-  _pixels = new unsigned char[size];
+  size_t size = size_t(_bytesPerPixel) * _width * _height;
+  _pixels = allocPixels(size);
   memcpy(_pixels, img._pixels, size);
 }
 
 
+#if __cplusplus >= 201103L
+RawImage::RawImage(RawImage&& img) :
+  _type(img._type),
+  _pixelType(img._pixelType),
+  _texId(img._texId),
+  _bytesPerPixel(img._bytesPerPixel),
+  _width(img._width),
+  _height(img._height),
+  _origin(img._origin),
+  _pixels(img._pixels)
+{
+  img._texId = 0;
+  img._pixels = NULL;
+}
+#endif
+
+
 RawImage::~RawImage()
 {
-  delete[] _pixels;
+  freePixels(_pixels);
 }
 
 
+RawImage& RawImage::operator = (const RawImage& img)
+{
+  if (&img != this) {
+    size_t size = size_t(img._bytesPerPixel) * img._width * img._height;
+    unsigned char* pixels = allocPixels(size);
+    memcpy(pixels, img._pixels, size);
+    freePixels(_pixels);
+
+    _type = img._type;
+    _pixelType = img._pixelType;
+    _texId = 0;
+    _bytesPerPixel = img._bytesPerPixel;
+    _width = img._width;
+    _height = img._height;
+    _origin = img._origin;
+    _pixels = pixels;
+  }
+  return *this;
+}
+
+
+#if __cplusplus >= 201103L
+RawImage& RawImage::operator = (RawImage&& img)
+{
+  if (&img != this) {
+    freePixels(_pixels);
+
+    _type = img._type;
+    _pixelType = img._pixelType;
+    _texId = img._texId;
+    _bytesPerPixel = img._bytesPerPixel;
+    _width = img._width;
+    _height = img._height;
+    _origin = img._origin;
+    _pixels = img._pixels;
+
+    img._texId = 0;
+    img._pixels = NULL;
+  }
+  return *this;
+}
+#endif
+
+
 int RawImage::getType() const
 {
   return _type;
 }
 
 
+int RawImage::getPixelType() const
+{
+  return _pixelType;
+}
+
+
 unsigned int RawImage::getBytesPerPixel() const
 {
   return _bytesPerPixel;
@@ -146,12 +809,24 @@ unsigned int RawImage::getHeight() const
 }
 
 
+ImageOrigin RawImage::getOrigin() const
+{
+  return _origin;
+}
+
+
 unsigned char* RawImage::getPixels()
 {
   return _pixels;
 }
 
 
+const unsigned char* RawImage::getPixels() const
+{
+  return _pixels;
+}
+
+
 unsigned int RawImage::getTexID() const
 {
   return _texId;
@@ -192,22 +867,103 @@ void RawImage::uploadTextureAs(int targetType, unsigned int texId)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
   glTexImage2D(GL_TEXTURE_2D, 0, targetType,
-      _width, _height, 0, _type, GL_UNSIGNED_BYTE, _pixels);
+      _width, _height, 0, _type, _pixelType, _pixels);
 }
 
 
 void RawImage::downsampleInPlace(unsigned int downsampleX, unsigned int downsampleY)
 {
-  RawImage* tmp = downsample(this, downsampleX, downsampleY);
+  unsigned int width = _width / downsampleX;
+  unsigned int height = _height / downsampleY;
+  unsigned char* pixels = allocPixels(size_t(_bytesPerPixel) * width * height);
+  downsamplePixels(_pixels, _width, _bytesPerPixel, downsampleX, downsampleY,
+      pixels, width, height);
+
+  freePixels(_pixels);
+  _width = width;
+  _height = height;
+  _pixels = pixels;
+}
 
-  deletePixels();
-  _type = tmp->getType();
-  _bytesPerPixel = tmp->getBytesPerPixel();
-  _width = tmp->getWidth();
-  _height = tmp->getHeight();
-  _pixels = tmp->takePixels();
 
-  delete tmp;
+void RawImage::convertInPlace(int targetType, bool premultiply)
+{
+  convertInPlace(targetType, _pixelType, premultiply);
+}
+
+
+void RawImage::convertInPlace(int targetType, int targetPixelType, bool premultiply)
+{
+  unsigned int dstBytesPerPixel = channelsForType(targetType) * bytesPerChannelForPixelType(targetPixelType);
+  if (channelsForType(_type) == 0 || bytesPerChannelForPixelType(_pixelType) == 0 || dstBytesPerPixel == 0)
+    throw ImageException("Unsupported pixel format conversion.");
+
+  if (targetType != _type || targetPixelType != _pixelType) {
+    // Converting in place is only parallel when the pixel size stays the
+    // same, so use a new buffer otherwise.
+    if (dstBytesPerPixel == _bytesPerPixel) {
+      convertPixels(_pixels, _type, _pixels, targetType, _width, _height, _pixelType, targetPixelType);
+    } else {
+      unsigned char* pixels = allocPixels(size_t(dstBytesPerPixel) * _width * _height);
+      convertPixels(_pixels, _type, pixels, targetType, _width, _height, _pixelType, targetPixelType);
+      freePixels(_pixels);
+      _pixels = pixels;
+    }
+    _type = targetType;
+    _pixelType = targetPixelType;
+    _bytesPerPixel = dstBytesPerPixel;
+  }
+
+  if (premultiply)
+    premultiplyAlpha(_pixels, _type, _width, _height, _pixelType);
+}
+
+
+void RawImage::flipVerticalInPlace()
+{
+  flipRowsInPlace(_pixels, size_t(_width) * _bytesPerPixel, _height);
+  _origin = (_origin == ORIGIN_BOTTOM_LEFT) ? ORIGIN_TOP_LEFT : ORIGIN_BOTTOM_LEFT;
+}
+
+
+void RawImage::save(const char* path, const SaveOptions& options) const throw(ImageException)
+{
+  if (_pixels == NULL)
+    throw ImageException("No pixels to save.");
+
+  const char* ext = strrchr(path, '.');
+  if (ext == NULL)
+    throw ImageException("Unknown image format.");
+  enum { kPNG, kJPG, kTGA, kPPM } format;
+  if (strcasecmp(ext, ".png") == 0)
+    format = kPNG;
+  else if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0)
+    format = kJPG;
+  else if (strcasecmp(ext, ".tga") == 0)
+    format = kTGA;
+  else if (strcasecmp(ext, ".ppm") == 0)
+    format = kPPM;
+  else
+    throw ImageException("Unknown image format: %s", ext);
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+    throw ImageException("Unable to open %s for writing.", path);
+
+  try {
+    switch (format) {
+      case kPNG: savePNG(file, options); break;
+      case kJPG: saveJPG(file, options); break;
+      case kTGA: saveTGA(file, options); break;
+      case kPPM: savePPM(file); break;
+    }
+    if (fclose(file) != 0)
+      throw ImageException("Error writing %s.", path);
+  } catch (ImageException& ex) {
+    fclose(file);
+    remove(path);
+    throw ex;
+  }
 }
 
 
@@ -221,7 +977,7 @@ unsigned char* RawImage::takePixels()
 
 void RawImage::deletePixels()
 {
-  delete _pixels;
+  freePixels(_pixels);
   _pixels = NULL;
 }
 
@@ -243,16 +999,32 @@ void RawImage::loadBMP(FILE *file) throw(ImageException)
            (unsigned int)info_header[5] << 8 |
            (unsigned int)info_header[6] << 16 |
            (unsigned int)info_header[7] << 24;
-  _height = (unsigned int)info_header[8] |
-            (unsigned int)info_header[9] << 8 |
-            (unsigned int)info_header[10] << 16 |
-            (unsigned int)info_header[11] << 24;
-
-  // Read the texture data.
-  unsigned int numBytes = _width * _height * _bytesPerPixel;
-  _pixels = new unsigned char[numBytes];
-  if (fread(_pixels, sizeof(unsigned char), numBytes, file) < numBytes)
+  int height = (int)((unsigned int)info_header[8] |
+                     (unsigned int)info_header[9] << 8 |
+                     (unsigned int)info_header[10] << 16 |
+                     (unsigned int)info_header[11] << 24);
+  // BMP rows are stored bottom-up, unless the height is negative.
+  bool fileIsTopDown = height < 0;
+  _height = fileIsTopDown ? -height : height;
+
+  unsigned int dataOffset = (unsigned int)file_header[10] |
+                            (unsigned int)file_header[11] << 8 |
+                            (unsigned int)file_header[12] << 16 |
+                            (unsigned int)file_header[13] << 24;
+  if (dataOffset != 0 && fseek(file, dataOffset, SEEK_SET) != 0)
     throw ImageException("Invalid or missing texture data.");
+
+  // Read the texture data. Each row in the file is padded out to a multiple
+  // of 4 bytes.
+  unsigned int rowBytes = _width * _bytesPerPixel;
+  unsigned int padding = (4 - rowBytes % 4) % 4;
+  _pixels = allocPixels(rowBytes * _height);
+  for (unsigned int row = 0; row < _height; ++row) {
+    if (fread(rowForFile(row, fileIsTopDown), sizeof(unsigned char), rowBytes, file) < rowBytes)
+      throw ImageException("Invalid or missing texture data.");
+    if (padding > 0 && fseek(file, padding, SEEK_CUR) != 0)
+      throw ImageException("Invalid or missing texture data.");
+  }
   // Note that the data from the file is in BGR order.
 }
 
@@ -260,9 +1032,12 @@ void RawImage::loadBMP(FILE *file) throw(ImageException)
 void RawImage::loadTGA(FILE *file) throw(ImageException)
 {
   unsigned char header[18];
-  fread(header, sizeof(unsigned char), 18, file);
+  if (fread(header, sizeof(unsigned char), 18, file) < 18)
+    throw ImageException("Missing TGA header data.");
   if (header[1] != 0) // The colormap byte.
     throw ImageException("Colormap TGA files aren't supported.");
+  if (header[0] > 0 && fseek(file, header[0], SEEK_CUR) != 0) // Skip the image ID field.
+    throw ImageException("Missing or invalid TGA image data.");
 
   _width = header[0xC] + header[0xD] * 256; 
   _height = header[0xE] + header[0xF] * 256;
@@ -271,17 +1046,20 @@ void RawImage::loadTGA(FILE *file) throw(ImageException)
   if (bitDepth != 32 && bitDepth != 24 && bitDepth != 8)
     throw ImageException("TGA files with a bit depth of %d aren't supported.", bitDepth);
 
+  // Bit 5 of the image descriptor byte is set if the rows are stored top-down.
+  bool fileIsTopDown = (header[0x11] & 0x20) != 0;
+
   unsigned int numPixels = _width * _height;
   _bytesPerPixel = bitDepth / 8;
-  _pixels = new unsigned char[numPixels * _bytesPerPixel];
+  _pixels = allocPixels(numPixels * _bytesPerPixel);
   switch (header[2]) { // The image type byte
     case 2: // TrueColor, uncompressed
     case 3: // Monochrome, uncompressed
-      tgaLoadUncompressed(file, numPixels, _bytesPerPixel, _pixels);
+      tgaLoadUncompressed(file, fileIsTopDown);
       break;
     case 10: // TrueColor, RLE compressed
     case 11: // Monochrome, RLE compressed
-      tgaLoadRLECompressed(file, numPixels, _bytesPerPixel, _pixels);
+      tgaLoadRLECompressed(file, fileIsTopDown);
       break;
     // Unsupported image types.
     default:
@@ -297,48 +1075,54 @@ void RawImage::loadTGA(FILE *file) throw(ImageException)
 }
 
 
-void RawImage::tgaLoadUncompressed(FILE *file, unsigned int numPixels,
-    unsigned int bytesPerPixel, unsigned char *pixels)
+void RawImage::tgaLoadUncompressed(FILE *file, bool fileIsTopDown)
   throw(ImageException)
 {
-  unsigned int numBytes = numPixels * bytesPerPixel;
-  if (fread(pixels, sizeof(unsigned char), numBytes, file) < numBytes)
-    throw ImageException("Missing or invalid TGA image data.");
+  unsigned int rowBytes = _width * _bytesPerPixel;
+  for (unsigned int row = 0; row < _height; ++row) {
+    if (fread(rowForFile(row, fileIsTopDown), sizeof(unsigned char), rowBytes, file) < rowBytes)
+      throw ImageException("Missing or invalid TGA image data.");
+  }
 }
 
 
-void RawImage::tgaLoadRLECompressed(FILE *file, unsigned int numPixels,
-    unsigned int bytesPerPixel, unsigned char *pixels)
+void RawImage::tgaLoadRLECompressed(FILE *file, bool fileIsTopDown)
   throw(ImageException)
 {
-  const int MAX_BYTES_PER_PIXEL = 4;
-
-  int pixelCount;
-  bool isEncoded;
+  // Decode straight out of a mapping of the file rather than going through
+  // stdio a packet at a time. Any footer after the pixel data is ignored.
+  ScopedMapping mapping;
+  long start = ftell(file);
+  if (start < 0 || !mapping.map(file) || size_t(start) >= mapping.size)
+    throw ImageException("Missing or invalid TGA image data.");
+  const unsigned char* data = mapping.data + start;
+  size_t size = mapping.size - start;
 
-  unsigned int pixelsRead = 0;
-  unsigned char pixel[MAX_BYTES_PER_PIXEL];
-  while (pixelsRead < numPixels) {
-    pixelCount = fgetc(file);
-    if (pixelCount == EOF)
-      throw ImageException("Missing or invalid TGA image data.");
+  TGARunPos pos = { 0, 0 };
 
-    isEncoded = pixelCount > 127;
-    pixelCount = (pixelCount & 0x7F) + 1;
-    if (isEncoded) {
-      if (fread(pixel, sizeof(unsigned char), bytesPerPixel, file) < bytesPerPixel)
+  if (size_t(_width) * _height < kTGAParallelPixels) {
+    for (unsigned int row = 0; row < _height; ++row) {
+      if (!tgaDecodeRLE(data, size, pos, rowForFile(row, fileIsTopDown), _width, _bytesPerPixel))
         throw ImageException("Missing or invalid TGA image data.");
-      for (int i = 0; i < pixelCount; ++i) {
-        memcpy(pixels, pixel, bytesPerPixel);
-        pixels += bytesPerPixel;
-      }
-    } else {
-      unsigned int numBytes = pixelCount * bytesPerPixel;
-      if (fread(pixels, sizeof(unsigned char), numBytes, file) < numBytes)
-        throw ImageException("Missing or invalid TGA image data.");
-      pixels += numBytes;
     }
-    pixelsRead += pixelCount;
+    return;
+  }
+
+  // For big images, first walk the packet headers to find where each row
+  // starts, which also checks that the data is all there. Packets can run
+  // across the end of a row, so a row may start part way through one. Then
+  // the rows can be expanded independently.
+  std::vector<TGARunPos> rowStarts(_height);
+  for (unsigned int row = 0; row < _height; ++row) {
+    rowStarts[row] = pos;
+    if (!tgaDecodeRLE(data, size, pos, NULL, _width, _bytesPerPixel))
+      throw ImageException("Missing or invalid TGA image data.");
+  }
+
+  #pragma omp parallel for
+  for (int row = 0; row < (int)_height; ++row) {
+    TGARunPos rowPos = rowStarts[row];
+    tgaDecodeRLE(data, size, rowPos, rowForFile(row, fileIsTopDown), _width, _bytesPerPixel);
   }
 }
 
@@ -356,23 +1140,61 @@ void RawImage::loadPPM(FILE* file) throw(ImageException)
   _height = ppmGetNextInt(file);
 
   int maxValue = ppmGetNextInt(file);
+  if (maxValue <= 0 || maxValue > 65535)
+    throw ImageException("Invalid PPM maximum value: %d.", maxValue);
+
+  // Files with a maximum value over 255 use two bytes per sample.
+  if (maxValue > 255) {
+    _pixelType = GL_UNSIGNED_SHORT;
+    _bytesPerPixel = 6;
+  }
 
-  unsigned int numBytes = _width * _height * _bytesPerPixel;
-  _pixels = new unsigned char[numBytes];
+  // PPM rows are stored top-down. Samples are rescaled to the full range of
+  // the pixel type, in unsigned arithmetic since 65535 * 65535 doesn't fit in
+  // an int; anything over the maximum value counts as the maximum.
+  const unsigned int maxSample = (unsigned int)maxValue;
+  unsigned int rowSamples = _width * 3;
+  unsigned int rowBytes = _width * _bytesPerPixel;
+  _pixels = allocPixels(rowBytes * _height);
   if (fileType == 3) {
-    for (int row = _height - 1; row >= 0; --row) {
-      long start = row * _width * _bytesPerPixel;
-      long end = start + _width * _bytesPerPixel;
-      for (long i = start; i < end; ++i)
-        _pixels[i] = ppmGetNextInt(file) * 255 / maxValue;
+    for (unsigned int row = 0; row < _height; ++row) {
+      unsigned char* pixels = rowForFile(row, true);
+      if (_pixelType == GL_UNSIGNED_SHORT) {
+        unsigned short* samples = (unsigned short*)pixels;
+        for (unsigned int i = 0; i < rowSamples; ++i) {
+          unsigned int v = std::min((unsigned int)ppmGetNextInt(file), maxSample);
+          samples[i] = (unsigned short)(v * 65535u / maxSample);
+        }
+      } else {
+        for (unsigned int i = 0; i < rowSamples; ++i) {
+          unsigned int v = std::min((unsigned int)ppmGetNextInt(file), maxSample);
+          pixels[i] = (unsigned char)(v * 255u / maxSample);
+        }
+      }
     }
   } else {
     int ch = fgetc(file);
     if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
       ungetc(ch, file);
 
-    if (fread(_pixels, sizeof(unsigned char), numBytes, file) < numBytes)
-      throw ImageException("Invalid or missing texture data.");
+    for (unsigned int row = 0; row < _height; ++row) {
+      unsigned char* pixels = rowForFile(row, true);
+      if (fread(pixels, sizeof(unsigned char), rowBytes, file) < rowBytes)
+        throw ImageException("Invalid or missing texture data.");
+
+      // Two byte samples are big-endian in the file, and get rescaled to use
+      // the full 16 bit range.
+      if (_pixelType == GL_UNSIGNED_SHORT) {
+        unsigned short* samples = (unsigned short*)pixels;
+        for (unsigned int i = 0; i < rowSamples; ++i) {
+          unsigned int v = std::min((unsigned int)pixels[i * 2] << 8 | pixels[i * 2 + 1], maxSample);
+          samples[i] = (unsigned short)(v * 65535u / maxSample);
+        }
+      } else if (maxSample != 255) {
+        for (unsigned int i = 0; i < rowSamples; ++i)
+          pixels[i] = (unsigned char)(std::min((unsigned int)pixels[i], maxSample) * 255u / maxSample);
+      }
+    }
   }
 }
 
@@ -398,6 +1220,13 @@ int RawImage::ppmGetNextInt(FILE* file) throw(ImageException)
 }
 
 
+unsigned char* RawImage::rowForFile(unsigned int fileRow, bool fileIsTopDown)
+{
+  unsigned int row = (fileIsTopDown == (_origin == ORIGIN_TOP_LEFT)) ? fileRow : _height - fileRow - 1;
+  return _pixels + size_t(row) * _width * _bytesPerPixel;
+}
+
+
 void RawImage::loadJPG(FILE* file) throw(ImageException)
 {
   jpeg_decompress_struct cinfo;
@@ -429,11 +1258,12 @@ void RawImage::loadJPG(FILE* file) throw(ImageException)
     }
     _width = cinfo.output_width;
     _height = cinfo.output_height;
-    _pixels = new unsigned char[_bytesPerPixel * _width * _height];
+    _pixels = allocPixels(_bytesPerPixel * _width * _height);
     unsigned char *p;
 
+    // JPEG scanlines are stored top-down.
     while (cinfo.output_scanline < cinfo.output_height) {
-      p = _pixels + (sizeof(JSAMPLE) * _bytesPerPixel * _width * (_height - cinfo.output_scanline - 1));
+      p = rowForFile(cinfo.output_scanline, true);
       jpeg_read_scanlines(&cinfo, &p, 1);
     }
 
@@ -479,9 +1309,15 @@ void RawImage::loadPNG(FILE* file) throw(ImageException)
     png_get_IHDR(pngData, pngInfo, &width, &height, &bitDepth, &colorType,
         &iMethod, &cMethod, &fMethod);
 
-    int bytesPerChannel = (bitDepth / 8);
-    if (bitDepth % 8 != 0)
-      ++bytesPerChannel;
+    // 16 bit channels are kept at full precision, but libpng gives them to us
+    // big-endian unless we ask it to swap them.
+    int bytesPerChannel = (bitDepth == 16) ? 2 : 1;
+    if (bitDepth == 16) {
+      _pixelType = GL_UNSIGNED_SHORT;
+      unsigned short endianTest = 1;
+      if (*(unsigned char*)&endianTest == 1)
+        png_set_swap(pngData);
+    }
 
     _width = width;
     _height = height;
@@ -501,18 +1337,22 @@ void RawImage::loadPNG(FILE* file) throw(ImageException)
         break;
       case PNG_COLOR_TYPE_GRAY:
         if (bitDepth < 8)
-          png_set_gray_1_2_4_to_8(pngData);
+          png_set_expand_gray_1_2_4_to_8(pngData);
         _type = GL_ALPHA;
         _bytesPerPixel = bytesPerChannel;
         break;
+      case PNG_COLOR_TYPE_GRAY_ALPHA:
+        _type = GL_LUMINANCE_ALPHA;
+        _bytesPerPixel = bytesPerChannel * 2;
+        break;
       default:
         throw ImageException("Unknown PNG type.");
     }
 
-    _pixels = new unsigned char[_bytesPerPixel * _width * _height];
+    _pixels = allocPixels(_bytesPerPixel * _width * _height);
     rowPtrs = new unsigned char*[_height];
-    for (size_t i = 0; i < _height; ++i)
-      rowPtrs[i] = &_pixels[_bytesPerPixel * _width * (_height - i - 1)];
+    for (unsigned int i = 0; i < _height; ++i)
+      rowPtrs[i] = rowForFile(i, true); // PNG rows are stored top-down.
     png_read_image(pngData, rowPtrs);
 
     png_destroy_read_struct(&pngData, &pngInfo, NULL);
@@ -532,40 +1372,504 @@ void RawImage::loadTIFF(const char* filename) throw(ImageException)
   if (!tiff)
     throw ImageException("Unable to open TIFF file.");
 
-  _type = GL_RGBA;
-  _bytesPerPixel = 4;
   TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &_width);
   TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &_height);
 
+  // 16 bit and floating point images are read directly to keep their full
+  // precision. Anything else gets converted to 8 bit RGBA by libtiff.
+  uint16 bitsPerSample = 8, samplesPerPixel = 1, sampleFormat = SAMPLEFORMAT_UINT;
+  uint16 planarConfig = PLANARCONFIG_CONTIG, orientation = ORIENTATION_TOPLEFT;
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planarConfig);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation);
+  bool highPrecision =
+      ((bitsPerSample == 16 && sampleFormat == SAMPLEFORMAT_UINT) ||
+       (bitsPerSample == 16 && sampleFormat == SAMPLEFORMAT_IEEEFP) ||
+       (bitsPerSample == 32 && sampleFormat == SAMPLEFORMAT_IEEEFP)) &&
+      (samplesPerPixel == 1 || samplesPerPixel == 3 || samplesPerPixel == 4) &&
+      planarConfig == PLANARCONFIG_CONTIG && !TIFFIsTiled(tiff) &&
+      (orientation == ORIENTATION_TOPLEFT || orientation == ORIENTATION_BOTLEFT);
+  if (highPrecision) {
+    static const int kTypes[] = { 0, GL_ALPHA, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+    _type = kTypes[samplesPerPixel];
+    if (sampleFormat == SAMPLEFORMAT_UINT)
+      _pixelType = GL_UNSIGNED_SHORT;
+    else
+      _pixelType = (bitsPerSample == 16) ? GL_HALF_FLOAT : GL_FLOAT;
+    _bytesPerPixel = samplesPerPixel * bitsPerSample / 8;
+    _pixels = allocPixels(size_t(_bytesPerPixel) * _width * _height);
+
+    bool fileIsTopDown = (orientation == ORIENTATION_TOPLEFT);
+    for (unsigned int row = 0; row < _height; ++row) {
+      if (TIFFReadScanline(tiff, rowForFile(row, fileIsTopDown), row, 0) < 0) {
+        TIFFClose(tiff);
+        throw ImageException("Error reading TIFF data.");
+      }
+    }
+    TIFFClose(tiff);
+    return;
+  }
+
+  _type = GL_RGBA;
+  _bytesPerPixel = 4;
   size_t numPixels = _width * _height;
-  _pixels = new unsigned char[_bytesPerPixel * numPixels];
-  bool readOK = TIFFReadRGBAImage(tiff, _width, _height, (uint32*)_pixels, 0);
+  _pixels = allocPixels(_bytesPerPixel * numPixels);
+  int rgbaOrientation = (_origin == ORIGIN_TOP_LEFT) ? ORIENTATION_TOPLEFT : ORIENTATION_BOTLEFT;
+  bool readOK = TIFFReadRGBAImageOriented(tiff, _width, _height, (uint32*)_pixels, rgbaOrientation, 0);
   TIFFClose(tiff);
   if (!readOK)
     throw ImageException("Error reading TIFF data.");
 }
 
 
-RawImage* downsample(RawImage* src, unsigned int downsampleX, unsigned int downsampleY)
+void RawImage::loadEXR(const char* filename) throw(ImageException)
 {
-  RawImage* result = new RawImage(src->getType(), src->getBytesPerPixel(),
-      src->getWidth() / downsampleX, src->getHeight() / downsampleY);
-  
-  size_t bpp = result->getBytesPerPixel();
-  size_t xStride = (downsampleX - 1) * bpp;
-  for (size_t y = 0; y < result->getHeight(); ++y) {
-    size_t from = y * downsampleY * src->getWidth() * bpp;
-    size_t to = y * result->getWidth() * bpp;
-    for (size_t x = 0; x < result->getWidth(); ++x) {
-      for (size_t b = 0; b < bpp; ++b) {
-        result->getPixels()[to] = src->getPixels()[from];
-        ++to;
-        ++from;
+#ifdef VGL_USE_OPENEXR
+  // OpenEXR decompresses scanline blocks and tiles on its global thread
+  // pool, which is empty until somebody sizes it. Leave it alone if the
+  // application already has.
+  #pragma omp critical(vgl_exrthreads)
+  {
+    if (Imf::globalThreadCount() == 0)
+      Imf::setGlobalThreadCount(std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN)));
+  }
+
+  try {
+    Imf::InputFile file(filename);
+    const Imf::Header& header = file.header();
+    const Imf::ChannelList& channels = header.channels();
+    const Imath::Box2i& dataWindow = header.dataWindow();
+    _width = dataWindow.max.x - dataWindow.min.x + 1;
+    _height = dataWindow.max.y - dataWindow.min.y + 1;
+
+    // Use the unnamed layer if it has colour or luminance channels, otherwise
+    // the first layer with colour channels (e.g. "diffuse.R"), otherwise just
+    // the first channel on its own.
+    std::string layer;
+    if (!channels.findChannel("R") && !channels.findChannel("G") &&
+        !channels.findChannel("B") && !channels.findChannel("Y")) {
+      for (Imf::ChannelList::ConstIterator it = channels.begin(); it != channels.end(); ++it) {
+        std::string name = it.name();
+        size_t dot = name.rfind('.');
+        if (dot != std::string::npos && dot + 2 == name.size() &&
+            (name[dot + 1] == 'R' || name[dot + 1] == 'G' || name[dot + 1] == 'B')) {
+          layer = name.substr(0, dot + 1);
+          break;
+        }
       }
-      from += xStride;
     }
+
+    std::vector<std::string> names;
+    if (channels.findChannel((layer + "R").c_str()) || channels.findChannel((layer + "G").c_str()) ||
+        channels.findChannel((layer + "B").c_str())) {
+      names.push_back(layer + "R");
+      names.push_back(layer + "G");
+      names.push_back(layer + "B");
+      _type = GL_RGB;
+    } else if (channels.findChannel("Y")) {
+      names.push_back("Y");
+      _type = GL_LUMINANCE;
+    } else if (channels.begin() != channels.end()) {
+      names.push_back(channels.begin().name());
+      _type = GL_LUMINANCE;
+    } else {
+      throw ImageException("EXR file has no channels.");
+    }
+    if (channels.findChannel((layer + "A").c_str())) {
+      names.push_back(layer + "A");
+      _type = (_type == GL_RGB) ? GL_RGBA : GL_LUMINANCE_ALPHA;
+    }
+
+    // Half channels stay half unless one of the channels needs more.
+    Imf::PixelType pixelType = Imf::HALF;
+    for (size_t i = 0; i < names.size(); ++i) {
+      const Imf::Channel* channel = channels.findChannel(names[i].c_str());
+      if (channel != NULL && channel->type != Imf::HALF)
+        pixelType = Imf::FLOAT;
+    }
+    const size_t channelBytes = (pixelType == Imf::HALF) ? 2 : 4;
+    _pixelType = (pixelType == Imf::HALF) ? GL_HALF_FLOAT : GL_FLOAT;
+    _bytesPerPixel = names.size() * channelBytes;
+    _pixels = allocPixels(size_t(_bytesPerPixel) * _width * _height);
+
+    // EXR rows are stored top-down. A negative y stride writes them straight
+    // into place for a bottom left origin; the slice takes strides as size_t,
+    // but OpenEXR's address arithmetic wraps around to the right place.
+    const size_t xStride = _bytesPerPixel;
+    const ptrdiff_t rowBytes = ptrdiff_t(_bytesPerPixel) * _width;
+    const ptrdiff_t yStride = (_origin == ORIGIN_TOP_LEFT) ? rowBytes : -rowBytes;
+    char* firstRow = (char*)rowForFile(0, true);
+    char* base = firstRow - dataWindow.min.y * yStride - dataWindow.min.x * ptrdiff_t(xStride);
+    Imf::FrameBuffer frameBuffer;
+    for (size_t i = 0; i < names.size(); ++i) {
+      frameBuffer.insert(names[i].c_str(),
+          Imf::Slice(pixelType, base + i * channelBytes, xStride, size_t(yStride), 1, 1, 0.0));
+    }
+    file.setFrameBuffer(frameBuffer);
+    file.readPixels(dataWindow.min.y, dataWindow.max.y);
+  } catch (ImageException& ex) {
+    throw ex;
+  } catch (std::exception& ex) {
+    throw ImageException("Error reading EXR file: %s", ex.what());
+  }
+#else
+  throw ImageException("Unable to load %s: VGL was built without OpenEXR.", filename);
+#endif
+}
+
+
+void RawImage::loadDPX(FILE* file) throw(ImageException)
+{
+  // The parts of the file and image headers we need, up to the end of the
+  // first image element.
+  unsigned char header[832];
+  if (fread(header, 1, sizeof(header), file) < sizeof(header))
+    throw ImageException("Invalid DPX file.");
+
+  bool bigEndian;
+  if (memcmp(header, "SDPX", 4) == 0)
+    bigEndian = true;
+  else if (memcmp(header, "XPDS", 4) == 0)
+    bigEndian = false;
+  else
+    throw ImageException("Invalid DPX file.");
+
+  unsigned int dataOffset = getU32(header + 4, bigEndian);
+  unsigned int orientation = getU16(header + 768, bigEndian);
+  _width = getU32(header + 772, bigEndian);
+  _height = getU32(header + 776, bigEndian);
+
+  // Only the first image element is loaded.
+  unsigned int descriptor = header[800];
+  unsigned int bitSize = header[803];
+  unsigned int packing = getU16(header + 804, bigEndian);
+  unsigned int encoding = getU16(header + 806, bigEndian);
+  unsigned int elementOffset = getU32(header + 808, bigEndian);
+  unsigned int eolPadding = getU32(header + 812, bigEndian);
+  if (elementOffset != 0 && elementOffset != 0xFFFFFFFF)
+    dataOffset = elementOffset;
+  if (eolPadding == 0xFFFFFFFF)
+    eolPadding = 0;
+
+  unsigned int channels;
+  switch (descriptor) {
+    case 6:  _type = GL_LUMINANCE; channels = 1; break;
+    case 50: _type = GL_RGB;       channels = 3; break;
+    case 51: _type = GL_RGBA;      channels = 4; break;
+    default: throw ImageException("Unsupported DPX descriptor: %u.", descriptor);
+  }
+  if (encoding != 0)
+    throw ImageException("Run length encoded DPX files aren't supported.");
+  if (orientation != 0 && orientation != 2)
+    throw ImageException("Unsupported DPX orientation: %u.", orientation);
+
+  // Rows start on a 32 bit boundary unless the data is packed, which only
+  // makes a difference for 8 and 16 bit samples.
+  const size_t rowSamples = size_t(_width) * channels;
+  size_t rowBytes;
+  if (bitSize == 8 || bitSize == 16) {
+    rowBytes = rowSamples * bitSize / 8;
+    if (packing != 0)
+      rowBytes = (rowBytes + 3) & ~size_t(3);
+  } else if ((bitSize == 10 || bitSize == 12) && (packing == 1 || packing == 2)) {
+    rowBytes = (bitSize == 10) ? (rowSamples + 2) / 3 * 4 : (rowSamples * 2 + 3) & ~size_t(3);
+  } else {
+    throw ImageException("Unsupported DPX bit depth and packing: %u bits, packing %u.", bitSize, packing);
   }
 
+  _pixelType = (bitSize == 8) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+  _bytesPerPixel = channels * ((bitSize == 8) ? 1 : 2);
+  filmLoadRows(file, dataOffset, rowBytes + eolPadding, bitSize, packing == 2, bigEndian,
+      orientation == 0);
+}
+
+
+void RawImage::loadCIN(FILE* file) throw(ImageException)
+{
+  // The file and image headers, up to the data format information.
+  unsigned char header[692];
+  if (fread(header, 1, sizeof(header), file) < sizeof(header))
+    throw ImageException("Invalid Cineon file.");
+
+  bool bigEndian;
+  if (getU32(header, true) == 0x802A5FD7)
+    bigEndian = true;
+  else if (getU32(header, false) == 0x802A5FD7)
+    bigEndian = false;
+  else
+    throw ImageException("Invalid Cineon file.");
+
+  unsigned int dataOffset = getU32(header + 4, bigEndian);
+  unsigned int orientation = header[192];
+  unsigned int channels = header[193];
+  unsigned int bitSize = header[198];
+  _width = getU32(header + 200, bigEndian);
+  _height = getU32(header + 204, bigEndian);
+  unsigned int interleave = header[680];
+  unsigned int packing = header[681];
+  unsigned int eolPadding = getU32(header + 684, bigEndian);
+  if (eolPadding == 0xFFFFFFFF)
+    eolPadding = 0;
+
+  if (channels == 1)
+    _type = GL_LUMINANCE;
+  else if (channels == 3)
+    _type = GL_RGB;
+  else
+    throw ImageException("Unsupported number of Cineon channels: %u.", channels);
+  for (unsigned int i = 1; i < channels; ++i) {
+    if (header[198 + i * 28] != bitSize)
+      throw ImageException("Cineon channels with different bit depths aren't supported.");
+  }
+  if (interleave != 0)
+    throw ImageException("Only pixel interleaved Cineon files are supported.");
+  if (orientation != 0 && orientation != 1)
+    throw ImageException("Unsupported Cineon orientation: %u.", orientation);
+
+  // Cineon files are nearly always 10 bit, three samples to a 32 bit word
+  // (packing 5). The samples are log encoded, which is left for the caller
+  // to deal with.
+  const size_t rowSamples = size_t(_width) * channels;
+  size_t rowBytes;
+  if (bitSize == 10 && packing == 5)
+    rowBytes = (rowSamples + 2) / 3 * 4;
+  else if (bitSize == 8 && packing == 0)
+    rowBytes = rowSamples;
+  else
+    throw ImageException("Unsupported Cineon bit depth and packing: %u bits, packing %u.", bitSize, packing);
+
+  _pixelType = (bitSize == 8) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+  _bytesPerPixel = channels * ((bitSize == 8) ? 1 : 2);
+  filmLoadRows(file, dataOffset, rowBytes + eolPadding, bitSize, false, bigEndian,
+      orientation == 0);
+}
+
+
+// Reads the pixel data of a DPX or Cineon file, then unpacks the rows in
+// parallel. 8 bit samples are copied as they are; everything else is widened
+// to 16 bits. The pixels are allocated here, once the sizes from the header
+// have been checked against the size of the file.
+void RawImage::filmLoadRows(FILE* file, size_t dataOffset, size_t rowStride,
+    unsigned int bitSize, bool methodB, bool bigEndian, bool fileIsTopDown)
+  throw(ImageException)
+{
+  struct stat info;
+  if (_width == 0 || _height == 0 || fstat(fileno(file), &info) != 0 ||
+      dataOffset > size_t(info.st_size) || rowStride > (size_t(info.st_size) - dataOffset) / _height)
+    throw ImageException("Invalid or missing image data.");
+
+  _pixels = allocPixels(size_t(_bytesPerPixel) * _width * _height);
+  std::vector<unsigned char> data(rowStride * _height + 16);
+  if (fseek(file, dataOffset, SEEK_SET) != 0 ||
+      fread(&data[0], 1, rowStride * _height, file) < rowStride * _height)
+    throw ImageException("Invalid or missing image data.");
+
+  const unsigned int rowSamples = _width * _bytesPerPixel / ((bitSize == 8) ? 1 : 2);
+  const bool swap = (bigEndian == isLittleEndian());
+
+  #pragma omp parallel for
+  for (int row = 0; row < (int)_height; ++row) {
+    const unsigned char* src = &data[0] + size_t(row) * rowStride;
+    unsigned char* dst = rowForFile(row, fileIsTopDown);
+    unsigned short* samples = (unsigned short*)dst;
+    switch (bitSize) {
+      case 8:
+        memcpy(dst, src, rowSamples);
+        break;
+      case 10:
+        unpack10(src, samples, rowSamples, bigEndian, methodB);
+        break;
+      case 12:
+        // One sample in each 16 bits, padded at the bottom for method A.
+        for (unsigned int i = 0; i < rowSamples; ++i) {
+          unsigned int v = getU16(src + i * 2, bigEndian);
+          samples[i] = widen12(methodB ? (v & 0xFFF) : (v >> 4));
+        }
+        break;
+      case 16:
+        if (swap)
+          swapBytes16(src, dst, rowSamples);
+        else
+          memcpy(dst, src, size_t(rowSamples) * 2);
+        break;
+    }
+  }
+}
+
+
+const unsigned char* RawImage::rowForSaving(const unsigned char* pixels, size_t rowBytes,
+    unsigned int fileRow) const
+{
+  unsigned int row = (_origin == ORIGIN_TOP_LEFT) ? fileRow : _height - 1 - fileRow;
+  return pixels + size_t(row) * rowBytes;
+}
+
+
+void RawImage::savePNG(FILE* file, const SaveOptions& options) const throw(ImageException)
+{
+  int type, colorType;
+  switch (channelsForType(_type)) {
+    case 1: type = _type; colorType = PNG_COLOR_TYPE_GRAY; break;
+    case 2: type = GL_LUMINANCE_ALPHA; colorType = PNG_COLOR_TYPE_GRAY_ALPHA; break;
+    case 3: type = GL_RGB; colorType = PNG_COLOR_TYPE_RGB; break;
+    case 4: type = GL_RGBA; colorType = PNG_COLOR_TYPE_RGBA; break;
+    default: throw ImageException("Unable to save images with this pixel format as PNG.");
+  }
+  int pixelType = (_pixelType == GL_UNSIGNED_SHORT) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+  int bitDepth = (pixelType == GL_UNSIGNED_SHORT) ? 16 : 8;
+  unsigned int bpp = channelsForType(type) * bitDepth / 8;
+  size_t rowBytes = size_t(_width) * bpp;
+  int level = std::max(0, std::min(9, options.pngCompressionLevel));
+
+  ScopedPixels scratch;
+  const unsigned char* pixels = pixelsAs(_pixels, _type, _pixelType, _width, _height, type, pixelType, scratch);
+
+  std::vector<const unsigned char*> rows(_height);
+  for (unsigned int i = 0; i < _height; ++i)
+    rows[i] = rowForSaving(pixels, rowBytes, i);
+
+  if (options.pngParallel) {
+    // PNG samples are big-endian.
+    ScopedPixels swapped;
+    if (bitDepth == 16 && isLittleEndian()) {
+      swapped.pixels = allocPixels(rowBytes * _height);
+      #pragma omp parallel for
+      for (int i = 0; i < (int)_height; ++i) {
+        unsigned char* row = swapped.pixels + i * rowBytes;
+        swapBytes16(rows[i], row, rowBytes / 2);
+        rows[i] = row;
+      }
+    }
+    writePNGStrips(file, rows.empty() ? NULL : &rows[0], _width, _height, bpp,
+        bitDepth, colorType, level, options.pngStripRows);
+    return;
+  }
+
+  writePNGWithLibPNG(file, rows.empty() ? NULL : &rows[0], _width, _height,
+      bitDepth, colorType, level);
+}
+
+
+void RawImage::saveJPG(FILE* file, const SaveOptions& options) const throw(ImageException)
+{
+  bool grey = channelsForType(_type) <= 2;
+  int type = grey ? GL_LUMINANCE : GL_RGB;
+  if (grey && channelsForType(_type) == 1)
+    type = _type;
+
+  ScopedPixels scratch;
+  const unsigned char* pixels = pixelsAs(_pixels, _type, _pixelType, _width, _height,
+      type, GL_UNSIGNED_BYTE, scratch);
+  size_t rowBytes = size_t(_width) * (grey ? 1 : 3);
+
+  // JPEG scanlines are stored top-down.
+  std::vector<const unsigned char*> rows(_height);
+  for (unsigned int i = 0; i < _height; ++i)
+    rows[i] = rowForSaving(pixels, rowBytes, i);
+
+  writeJPEGWithLibJPEG(file, rows.empty() ? NULL : &rows[0], _width, _height, grey,
+      std::max(0, std::min(100, options.jpegQuality)));
+}
+
+
+void RawImage::saveTGA(FILE* file, const SaveOptions& options) const throw(ImageException)
+{
+  if (_width > 65535 || _height > 65535)
+    throw ImageException("Image is too big to save as a TGA.");
+
+  int type;
+  switch (channelsForType(_type)) {
+    case 1: type = _type; break;
+    case 3: type = GL_BGR; break;
+    case 2:
+    case 4: type = GL_BGRA; break;
+    default: throw ImageException("Unable to save images with this pixel format as TGA.");
+  }
+  unsigned int bpp = channelsForType(type);
+
+  ScopedPixels scratch;
+  const unsigned char* pixels = pixelsAs(_pixels, _type, _pixelType, _width, _height,
+      type, GL_UNSIGNED_BYTE, scratch);
+  size_t rowBytes = size_t(_width) * bpp;
+
+  // TGA rows are bottom-up unless bit 5 of the descriptor is set, so they can
+  // go out in memory order whichever way up the image is.
+  unsigned char header[18];
+  memset(header, 0, sizeof(header));
+  header[2] = (bpp == 1 ? 3 : 2) + (options.tgaRLE ? 8 : 0);
+  header[0xC] = (unsigned char)(_width & 0xFF);
+  header[0xD] = (unsigned char)(_width >> 8);
+  header[0xE] = (unsigned char)(_height & 0xFF);
+  header[0xF] = (unsigned char)(_height >> 8);
+  header[0x10] = (unsigned char)(bpp * 8);
+  header[0x11] = (unsigned char)((bpp == 4 ? 8 : 0) | (_origin == ORIGIN_TOP_LEFT ? 0x20 : 0));
+  if (fwrite(header, 1, 18, file) != 18)
+    throw ImageException("Error writing TGA data.");
+
+  if (!options.tgaRLE) {
+    if (fwrite(pixels, 1, rowBytes * _height, file) != rowBytes * _height)
+      throw ImageException("Error writing TGA data.");
+    return;
+  }
+
+  // Rows are encoded independently, so do them in parallel into buffers big
+  // enough for the worst case, then write them out in order. The worst case
+  // is single pixels alternating with runs of two, which needs a packet
+  // header for two pixels out of every three.
+  size_t maxRowBytes = rowBytes + _width;
+  ScopedPixels encoded;
+  encoded.pixels = allocPixels(maxRowBytes * _height);
+  std::vector<size_t> sizes(_height);
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)_height; ++y)
+    sizes[y] = tgaEncodeRow(pixels + y * rowBytes, _width, bpp, encoded.pixels + y * maxRowBytes);
+
+  for (unsigned int y = 0; y < _height; ++y) {
+    if (fwrite(encoded.pixels + y * maxRowBytes, 1, sizes[y], file) != sizes[y])
+      throw ImageException("Error writing TGA data.");
+  }
+}
+
+
+void RawImage::savePPM(FILE* file) const throw(ImageException)
+{
+  int pixelType = (_pixelType == GL_UNSIGNED_SHORT) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+  ScopedPixels scratch;
+  const unsigned char* pixels = pixelsAs(_pixels, _type, _pixelType, _width, _height,
+      GL_RGB, pixelType, scratch);
+  size_t rowBytes = size_t(_width) * 3 * bytesPerChannelForPixelType(pixelType);
+
+  fprintf(file, "P6\n%u %u\n%d\n", _width, _height, pixelType == GL_UNSIGNED_SHORT ? 65535 : 255);
+
+  // PPM rows are stored top-down, with 16 bit samples big-endian.
+  bool swap = pixelType == GL_UNSIGNED_SHORT && isLittleEndian();
+  std::vector<unsigned char> swapped(swap ? rowBytes : 0);
+  for (unsigned int y = 0; y < _height; ++y) {
+    const unsigned char* row = rowForSaving(pixels, rowBytes, y);
+    if (swap) {
+      swapBytes16(row, &swapped[0], rowBytes / 2);
+      row = &swapped[0];
+    }
+    if (fwrite(row, 1, rowBytes, file) != rowBytes)
+      throw ImageException("Error writing PPM data.");
+  }
+}
+
+
+//
+// FUNCTIONS
+//
+
+RawImage* downsample(RawImage* src, unsigned int downsampleX, unsigned int downsampleY)
+{
+  RawImage* result = new RawImage(src->getType(), src->getBytesPerPixel(),
+      src->getWidth() / downsampleX, src->getHeight() / downsampleY,
+      src->getPixelType(), src->getOrigin());
+  downsamplePixels(src->getPixels(), src->getWidth(), src->getBytesPerPixel(),
+      downsampleX, downsampleY, result->getPixels(), result->getWidth(), result->getHeight());
   return result;
 }
 
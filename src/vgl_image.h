@@ -1,9 +1,20 @@
 #ifndef vgl_image_h
 #define vgl_image_h
 
+#include "vgl_pixelpool.h"
+
 #include <cstdio>
 #include <stdexcept>
 
+#define GL_GLEXT_PROTOTYPES 1
+#ifdef linux
+#include <GL/gl.h>
+#include <GL/glext.h>
+#else
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#endif
+
 namespace vgl {
 
 
@@ -18,27 +29,88 @@ public:
 };
 
 
+// Which corner of the image the first row of pixels starts at. OpenGL
+// expects ORIGIN_BOTTOM_LEFT, which is the default for loading.
+enum ImageOrigin {
+  ORIGIN_BOTTOM_LEFT,
+  ORIGIN_TOP_LEFT
+};
+
+
+// Settings for RawImage::save. The defaults are reasonable for everything.
+struct SaveOptions {
+  int jpegQuality;            //!< 0 to 100.
+  int pngCompressionLevel;    //!< zlib compression level, 0 to 9.
+  bool pngParallel;           //!< Compress strips of rows in parallel.
+  unsigned int pngStripRows;  //!< Rows per parallel strip, or 0 to pick automatically.
+  bool tgaRLE;                //!< Run length encode TGA files.
+
+  SaveOptions();
+};
+
+
+// The pixel type says how each channel is stored: GL_UNSIGNED_BYTE,
+// GL_UNSIGNED_SHORT, GL_HALF_FLOAT or GL_FLOAT. Loaders keep the full
+// precision of the file (e.g. 16 bit PNGs stay 16 bit); use convertInPlace to
+// reduce it.
+//
+// Pixel memory comes from the pool in vgl_pixelpool.h, so it's 64 byte aligned
+// and gets recycled as images are created and destroyed.
 class RawImage {
 public:
-  RawImage(const char* path) throw(ImageException);
-  RawImage(int type, int bytesPerPixel, int width, int height);
+  //! Every loader writes its rows straight into place for the requested
+  //! origin as it decodes, whichever way round the file stores them.
+  RawImage(const char* path, ImageOrigin origin = ORIGIN_BOTTOM_LEFT) throw(ImageException);
+  RawImage(int type, int bytesPerPixel, int width, int height,
+      int pixelType = GL_UNSIGNED_BYTE, ImageOrigin origin = ORIGIN_BOTTOM_LEFT);
   RawImage(const RawImage& img);
   ~RawImage();
 
+  RawImage& operator = (const RawImage& img);
+
+#if __cplusplus >= 201103L
+  //! Moving takes over the pixels (and texture ID) without copying them,
+  //! leaving the other image empty.
+  RawImage(RawImage&& img);
+  RawImage& operator = (RawImage&& img);
+#endif
+
   int getType() const;
+  int getPixelType() const;
   unsigned int getBytesPerPixel() const;
   unsigned int getWidth() const;
   unsigned int getHeight() const;
+  ImageOrigin getOrigin() const;
   unsigned char* getPixels();
+  const unsigned char* getPixels() const;
 
   unsigned int getTexID() const;
   void uploadTexture(unsigned int texID = 0);
   void uploadTextureAs(int targetType, unsigned int texID = 0);
 
+  //! The result goes into a new buffer from the pixel pool and the old one is
+  //! returned to it.
   void downsampleInPlace(unsigned int downsampleX, unsigned int downsampleY);
 
+  //! Convert the pixels to a different layout and/or pixel type (see
+  //! convertPixels in vgl_convert.h), optionally premultiplying the alpha.
+  //! Useful for normalising everything to a single format at load time. The
+  //! first form keeps the current pixel type.
+  void convertInPlace(int targetType, bool premultiply = false);
+  void convertInPlace(int targetType, int targetPixelType, bool premultiply = false);
+
+  //! Flip the image upside down, switching it to the other origin.
+  void flipVerticalInPlace();
+
+  //! Write the image out as a PNG, JPEG, TGA or PPM file, chosen by the file
+  //! extension. Pixels are converted to something the format can hold where
+  //! necessary: 16 bit images stay 16 bit in PNG and PPM files, everything
+  //! else is written with 8 bit channels.
+  void save(const char* path, const SaveOptions& options = SaveOptions()) const
+    throw(ImageException);
+
   //! Like getPixels, but this transfers ownership of the pixel memory to the
-  //! caller.
+  //! caller, who must release it with freePixels.
   unsigned char* takePixels();
 
   //! Call this if you want to free up the memory used to store the pixels,
@@ -53,23 +125,44 @@ private:
   void loadJPG(FILE* file) throw(ImageException);
   void loadPNG(FILE* file) throw(ImageException);
   void loadTIFF(const char* filename) throw(ImageException);
+  void loadEXR(const char* filename) throw(ImageException);
+  void loadDPX(FILE* file) throw(ImageException);
+  void loadCIN(FILE* file) throw(ImageException);
 
-  void tgaLoadUncompressed(FILE* file, unsigned int numPixels,
-      unsigned int bytesPerPixel, unsigned char *pixels)
+  void tgaLoadUncompressed(FILE* file, bool fileIsTopDown)
     throw(ImageException);
 
-  void tgaLoadRLECompressed(FILE* file, unsigned int numPixels,
-      unsigned int bytesPerPixel, unsigned char *pixels)
+  void tgaLoadRLECompressed(FILE* file, bool fileIsTopDown)
     throw(ImageException);
 
   int ppmGetNextInt(FILE* file) throw(ImageException);
 
+  void filmLoadRows(FILE* file, size_t dataOffset, size_t rowStride,
+      unsigned int bitSize, bool methodB, bool bigEndian, bool fileIsTopDown)
+    throw(ImageException);
+
+  void savePNG(FILE* file, const SaveOptions& options) const throw(ImageException);
+  void saveJPG(FILE* file, const SaveOptions& options) const throw(ImageException);
+  void saveTGA(FILE* file, const SaveOptions& options) const throw(ImageException);
+  void savePPM(FILE* file) const throw(ImageException);
+
+  // Where the given row of the file comes from, for a format which stores its
+  // rows top-down.
+  const unsigned char* rowForSaving(const unsigned char* pixels, size_t rowBytes,
+      unsigned int fileRow) const;
+
+  // Where the pixels for the given row of the file should go, given the
+  // order the file stores its rows in and the origin we're loading for.
+  unsigned char* rowForFile(unsigned int fileRow, bool fileIsTopDown);
+
 private:
   int _type;
+  int _pixelType;
   unsigned int _texId;
   unsigned int _bytesPerPixel;
   unsigned int _width;
   unsigned int _height;
+  ImageOrigin _origin;
   unsigned char* _pixels;
 };
 
@@ -0,0 +1,354 @@
+#include "vgl_imagecache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+struct ImageCache::Entry {
+  // One reference for the cache while the entry is in it, plus one for each
+  // handle and each thread waiting for it to load.
+  int refs;
+  RawImage* image;
+  bool loading;
+  std::string error;
+  size_t bytes;
+
+  // Only meaningful while the entry is in the cache.
+  bool cached;
+  EntryMap::iterator mapPos;
+  std::list<Entry*>::iterator lruPos;
+
+  Entry() : refs(1), image(NULL), loading(true), error(), bytes(0), cached(false) {}
+  ~Entry() { delete image; }
+};
+
+
+// Holds a mutex for the lifetime of a scope.
+class ScopedLock {
+public:
+  ScopedLock(pthread_mutex_t* mutex) : _mutex(mutex) { pthread_mutex_lock(_mutex); }
+  ~ScopedLock() { pthread_mutex_unlock(_mutex); }
+
+private:
+  pthread_mutex_t* _mutex;
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static RawImage* loadImage(const char* path, const ImageLoadOptions& options)
+  throw(ImageException)
+{
+  RawImage* image = new RawImage(path, options.origin);
+  try {
+    if (options.downsampleX > 1 || options.downsampleY > 1)
+      image->downsampleInPlace(std::max(1u, options.downsampleX), std::max(1u, options.downsampleY));
+    if (options.targetType != 0 || options.targetPixelType != 0 || options.premultiply) {
+      image->convertInPlace(
+          options.targetType != 0 ? options.targetType : image->getType(),
+          options.targetPixelType != 0 ? options.targetPixelType : image->getPixelType(),
+          options.premultiply);
+    }
+  } catch (ImageException& ex) {
+    delete image;
+    throw ex;
+  }
+  return image;
+}
+
+
+//
+// ImageLoadOptions METHODS
+//
+
+ImageLoadOptions::ImageLoadOptions() :
+  origin(ORIGIN_BOTTOM_LEFT),
+  downsampleX(1),
+  downsampleY(1),
+  targetType(0),
+  targetPixelType(0),
+  premultiply(false)
+{
+}
+
+
+bool ImageLoadOptions::operator < (const ImageLoadOptions& other) const
+{
+  if (origin != other.origin)
+    return origin < other.origin;
+  if (downsampleX != other.downsampleX)
+    return downsampleX < other.downsampleX;
+  if (downsampleY != other.downsampleY)
+    return downsampleY < other.downsampleY;
+  if (targetType != other.targetType)
+    return targetType < other.targetType;
+  if (targetPixelType != other.targetPixelType)
+    return targetPixelType < other.targetPixelType;
+  return premultiply < other.premultiply;
+}
+
+
+//
+// ImageCache::Key METHODS
+//
+
+bool ImageCache::Key::operator < (const Key& other) const
+{
+  int cmp = path.compare(other.path);
+  if (cmp != 0)
+    return cmp < 0;
+  if (mtime != other.mtime)
+    return mtime < other.mtime;
+  return options < other.options;
+}
+
+
+//
+// ImageCache METHODS
+//
+
+ImageCache::ImageCache(size_t maxBytes) :
+  _maxBytes(maxBytes),
+  _entries(),
+  _lru()
+{
+  memset(&_stats, 0, sizeof(_stats));
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_loaded, NULL);
+}
+
+
+ImageCache::~ImageCache()
+{
+  clear();
+  pthread_cond_destroy(&_loaded);
+  pthread_mutex_destroy(&_mutex);
+}
+
+
+ImageHandle ImageCache::get(const char* path, const ImageLoadOptions& options)
+  throw(ImageException)
+{
+  struct stat info;
+  if (stat(path, &info) != 0)
+    throw ImageException("File not found: %s.", path);
+
+  Key key;
+  key.path = path;
+  key.mtime = info.st_mtime;
+  key.options = options;
+
+  Entry* entry = NULL;
+  bool mustLoad = false;
+  {
+    ScopedLock lock(&_mutex);
+    EntryMap::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+      entry = it->second;
+      addRef(entry);
+      if (entry->loading) {
+        ++_stats.coalesced;
+        while (entry->loading)
+          pthread_cond_wait(&_loaded, &_mutex);
+      } else {
+        ++_stats.hits;
+        _lru.splice(_lru.end(), _lru, entry->lruPos);
+      }
+    } else {
+      ++_stats.misses;
+      mustLoad = true;
+      entry = new Entry();
+      addRef(entry); // For the handle we'll return.
+      entry->cached = true;
+      entry->mapPos = _entries.insert(std::make_pair(key, entry)).first;
+      entry->lruPos = _lru.insert(_lru.end(), entry);
+    }
+  }
+
+  if (mustLoad) {
+    // Nobody else touches the entry until loading is cleared.
+    try {
+      entry->image = loadImage(path, options);
+      entry->bytes = size_t(entry->image->getBytesPerPixel()) *
+          entry->image->getWidth() * entry->image->getHeight();
+    } catch (ImageException& ex) {
+      entry->error = ex.what();
+    }
+
+    ScopedLock lock(&_mutex);
+    entry->loading = false;
+    if (entry->image != NULL) {
+      _stats.bytes += entry->bytes;
+      evictDownTo(_maxBytes);
+    } else {
+      ++_stats.failures;
+      remove(entry);
+    }
+    pthread_cond_broadcast(&_loaded);
+  }
+
+  if (entry->image == NULL) {
+    std::string error = entry->error;
+    release(entry);
+    throw ImageException("%s", error.c_str());
+  }
+  return ImageHandle(entry);
+}
+
+
+size_t ImageCache::getMaxBytes() const
+{
+  ScopedLock lock(&_mutex);
+  return _maxBytes;
+}
+
+
+void ImageCache::setMaxBytes(size_t maxBytes)
+{
+  ScopedLock lock(&_mutex);
+  _maxBytes = maxBytes;
+  evictDownTo(_maxBytes);
+}
+
+
+void ImageCache::clear()
+{
+  ScopedLock lock(&_mutex);
+  evictDownTo(0);
+}
+
+
+ImageCacheStats ImageCache::getStats() const
+{
+  ScopedLock lock(&_mutex);
+  ImageCacheStats stats = _stats;
+  stats.entries = _entries.size();
+  return stats;
+}
+
+
+void ImageCache::resetStats()
+{
+  ScopedLock lock(&_mutex);
+  size_t bytes = _stats.bytes;
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.bytes = bytes;
+}
+
+
+// Removes least recently used entries until the images in the cache take up
+// no more than the given number of bytes. Entries which are still loading are
+// skipped. Must be called with the mutex held.
+void ImageCache::evictDownTo(size_t bytes)
+{
+  std::list<Entry*>::iterator it = _lru.begin();
+  while (_stats.bytes > bytes && it != _lru.end()) {
+    Entry* entry = *it;
+    ++it;
+    if (!entry->loading) {
+      ++_stats.evictions;
+      remove(entry);
+    }
+  }
+}
+
+
+// Takes an entry out of the cache and drops the cache's reference to it. Must
+// be called with the mutex held.
+void ImageCache::remove(Entry* entry)
+{
+  if (!entry->cached)
+    return;
+  _entries.erase(entry->mapPos);
+  _lru.erase(entry->lruPos);
+  if (entry->image != NULL)
+    _stats.bytes -= entry->bytes;
+  entry->cached = false;
+  release(entry);
+}
+
+
+void ImageCache::addRef(Entry* entry)
+{
+  __sync_add_and_fetch(&entry->refs, 1);
+}
+
+
+void ImageCache::release(Entry* entry)
+{
+  if (__sync_sub_and_fetch(&entry->refs, 1) == 0)
+    delete entry;
+}
+
+
+//
+// ImageHandle METHODS
+//
+
+ImageHandle::ImageHandle() :
+  _entry(NULL)
+{
+}
+
+
+ImageHandle::ImageHandle(ImageCache::Entry* entry) :
+  _entry(entry)
+{
+}
+
+
+ImageHandle::ImageHandle(const ImageHandle& other) :
+  _entry(other._entry)
+{
+  if (_entry != NULL)
+    ImageCache::addRef(_entry);
+}
+
+
+ImageHandle::~ImageHandle()
+{
+  if (_entry != NULL)
+    ImageCache::release(_entry);
+}
+
+
+ImageHandle& ImageHandle::operator = (const ImageHandle& other)
+{
+  if (other._entry != NULL)
+    ImageCache::addRef(other._entry);
+  if (_entry != NULL)
+    ImageCache::release(_entry);
+  _entry = other._entry;
+  return *this;
+}
+
+
+const RawImage* ImageHandle::get() const
+{
+  return (_entry != NULL) ? _entry->image : NULL;
+}
+
+
+const RawImage* ImageHandle::operator -> () const
+{
+  return _entry->image;
+}
+
+
+const RawImage& ImageHandle::operator * () const
+{
+  return *_entry->image;
+}
+
+
+} // namespace vgl
+
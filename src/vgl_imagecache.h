@@ -0,0 +1,147 @@
+#ifndef vgl_imagecache_h
+#define vgl_imagecache_h
+
+#include "vgl_image.h"
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <string>
+
+namespace vgl {
+
+//
+// Forward declarations
+//
+
+class ImageHandle;
+
+
+//
+// Types
+//
+
+// Everything that affects what ImageCache::get gives back for a path, other
+// than the file itself.
+struct ImageLoadOptions {
+  ImageOrigin origin;
+  unsigned int downsampleX;   //!< 1 for no downsampling.
+  unsigned int downsampleY;   //!< 1 for no downsampling.
+  int targetType;             //!< Pixel layout to convert to, or 0 to keep the file's.
+  int targetPixelType;        //!< Pixel type to convert to, or 0 to keep the file's.
+  bool premultiply;
+
+  ImageLoadOptions();
+
+  bool operator < (const ImageLoadOptions& other) const;
+};
+
+
+struct ImageCacheStats {
+  unsigned long hits;       //!< Found already decoded.
+  unsigned long misses;     //!< Had to be decoded.
+  unsigned long coalesced;  //!< Waited for another thread's decode of the same image.
+  unsigned long failures;   //!< Decodes which threw an exception.
+  unsigned long evictions;
+  unsigned long entries;    //!< Images currently in the cache.
+  size_t bytes;             //!< Pixel memory used by those images.
+};
+
+
+// A thread safe cache of decoded images, bounded by the total size of their
+// pixels and evicting the least recently used image first.
+//
+// Images are keyed by path, the file's modification time and the load
+// options, so editing a file on disk gets it decoded again. When several
+// threads ask for the same image at once only one decodes it; the others
+// wait for it to finish and share the result.
+class ImageCache {
+public:
+  static const size_t kDefaultMaxBytes = size_t(512) << 20;
+
+  ImageCache(size_t maxBytes = kDefaultMaxBytes);
+  ~ImageCache();
+
+  //! Throws an ImageException if the file can't be loaded. Failed loads
+  //! aren't cached, so asking again will try again.
+  ImageHandle get(const char* path, const ImageLoadOptions& options = ImageLoadOptions())
+    throw(ImageException);
+
+  size_t getMaxBytes() const;
+  void setMaxBytes(size_t maxBytes);
+
+  //! Drop every image from the cache. Images still referenced by handles stay
+  //! alive until the handles go away.
+  void clear();
+
+  ImageCacheStats getStats() const;
+  void resetStats();
+
+private:
+  friend class ImageHandle;
+
+  struct Entry;
+
+  struct Key {
+    std::string path;
+    time_t mtime;
+    ImageLoadOptions options;
+
+    bool operator < (const Key& other) const;
+  };
+
+  typedef std::map<Key, Entry*> EntryMap;
+
+  // Not copyable.
+  ImageCache(const ImageCache& other);
+  ImageCache& operator = (const ImageCache& other);
+
+  void evictDownTo(size_t bytes);
+  void remove(Entry* entry);
+
+  static void addRef(Entry* entry);
+  static void release(Entry* entry);
+
+private:
+  size_t _maxBytes;
+  EntryMap _entries;
+  std::list<Entry*> _lru; // Least recently used first.
+  ImageCacheStats _stats;
+
+  mutable pthread_mutex_t _mutex;
+  pthread_cond_t _loaded;
+};
+
+
+// A reference to an image in an ImageCache. Handles are cheap to copy and
+// share ownership of the image, which stays alive for as long as any handle
+// refers to it, even after the cache has evicted it or been destroyed. The
+// image is shared, so it's only available as const.
+class ImageHandle {
+public:
+  ImageHandle();
+  ImageHandle(const ImageHandle& other);
+  ~ImageHandle();
+
+  ImageHandle& operator = (const ImageHandle& other);
+
+  //! NULL for a default constructed handle.
+  const RawImage* get() const;
+  const RawImage* operator -> () const;
+  const RawImage& operator * () const;
+
+private:
+  friend class ImageCache;
+
+  explicit ImageHandle(ImageCache::Entry* entry);
+
+private:
+  ImageCache::Entry* _entry;
+};
+
+
+} // namespace vgl
+
+#endif // vgl_imagecache_h
+
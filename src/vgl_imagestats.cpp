@@ -0,0 +1,590 @@
+#include "vgl_imagestats.h"
+
+#include "vgl_convert.h"
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef VGL_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// Running totals for one channel, in the channel's own units.
+struct ChannelStats {
+  double min, max;
+  double sum, sumSq;
+};
+
+
+//
+// CONSTANTS
+//
+
+// Stats blocks are this many groups of vectors long. It also keeps the 32 bit
+// lane totals in the 8 and 16 bit kernels from overflowing.
+static const size_t kStatsBlockGroups = 4096;
+
+static const size_t kHistogramBlockPixels = 16384;
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static void initStats(ChannelStats* stats)
+{
+  for (unsigned int c = 0; c < 4; ++c) {
+    stats[c].min = HUGE_VAL;
+    stats[c].max = -HUGE_VAL;
+    stats[c].sum = 0.0;
+    stats[c].sumSq = 0.0;
+  }
+}
+
+
+static void mergeStats(ChannelStats* dst, const ChannelStats* src, unsigned int channels)
+{
+  for (unsigned int c = 0; c < channels; ++c) {
+    dst[c].min = std::min(dst[c].min, src[c].min);
+    dst[c].max = std::max(dst[c].max, src[c].max);
+    dst[c].sum += src[c].sum;
+    dst[c].sumSq += src[c].sumSq;
+  }
+}
+
+
+// Adds one lane's totals to the stats for the channel it holds.
+static inline void addLane(ChannelStats& stats, double min, double max, double sum, double sumSq)
+{
+  stats.min = std::min(stats.min, min);
+  stats.max = std::max(stats.max, max);
+  stats.sum += sum;
+  stats.sumSq += sumSq;
+}
+
+
+// The scalar version, for the samples left over at the end of the image and
+// for builds without SIMD. numSamples must be a whole number of pixels.
+template <typename T>
+static void statsScalar(const T* samples, size_t numSamples, unsigned int channels,
+    ChannelStats* stats)
+{
+  for (size_t i = 0; i < numSamples; i += channels) {
+    for (unsigned int c = 0; c < channels; ++c) {
+      double v = samples[i + c];
+      if (v < stats[c].min)
+        stats[c].min = v;
+      if (v > stats[c].max)
+        stats[c].max = v;
+      stats[c].sum += v;
+      stats[c].sumSq += v * v;
+    }
+  }
+}
+
+
+// The stats kernels each work through numGroups groups of period vectors. The
+// period is 3 for 3 channel images and 1 otherwise, so each lane of each
+// vector in a group always holds the same channel.
+static void statsBlockU8(const unsigned char* samples, size_t numGroups,
+    unsigned int channels, unsigned int period, ChannelStats* stats)
+{
+#ifdef VGL_SIMD_X86
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo[3], hi[3], sum[3][4], sumSq[3][4];
+  for (unsigned int j = 0; j < period; ++j) {
+    lo[j] = _mm_set1_epi8(-1);
+    hi[j] = zero;
+    for (unsigned int k = 0; k < 4; ++k)
+      sum[j][k] = sumSq[j][k] = zero;
+  }
+
+  const __m128i* in = (const __m128i*)samples;
+  for (size_t g = 0; g < numGroups; ++g) {
+    for (unsigned int j = 0; j < period; ++j) {
+      __m128i v = _mm_loadu_si128(in++);
+      lo[j] = _mm_min_epu8(lo[j], v);
+      hi[j] = _mm_max_epu8(hi[j], v);
+
+      __m128i v0 = _mm_unpacklo_epi8(v, zero);
+      __m128i v1 = _mm_unpackhi_epi8(v, zero);
+      sum[j][0] = _mm_add_epi32(sum[j][0], _mm_unpacklo_epi16(v0, zero));
+      sum[j][1] = _mm_add_epi32(sum[j][1], _mm_unpackhi_epi16(v0, zero));
+      sum[j][2] = _mm_add_epi32(sum[j][2], _mm_unpacklo_epi16(v1, zero));
+      sum[j][3] = _mm_add_epi32(sum[j][3], _mm_unpackhi_epi16(v1, zero));
+
+      // Squares of 8 bit values still fit in 16 bits.
+      __m128i s0 = _mm_mullo_epi16(v0, v0);
+      __m128i s1 = _mm_mullo_epi16(v1, v1);
+      sumSq[j][0] = _mm_add_epi32(sumSq[j][0], _mm_unpacklo_epi16(s0, zero));
+      sumSq[j][1] = _mm_add_epi32(sumSq[j][1], _mm_unpackhi_epi16(s0, zero));
+      sumSq[j][2] = _mm_add_epi32(sumSq[j][2], _mm_unpacklo_epi16(s1, zero));
+      sumSq[j][3] = _mm_add_epi32(sumSq[j][3], _mm_unpackhi_epi16(s1, zero));
+    }
+  }
+
+  for (unsigned int j = 0; j < period; ++j) {
+    unsigned char los[16], his[16];
+    unsigned int sums[16], sumSqs[16];
+    _mm_storeu_si128((__m128i*)los, lo[j]);
+    _mm_storeu_si128((__m128i*)his, hi[j]);
+    for (unsigned int k = 0; k < 4; ++k) {
+      _mm_storeu_si128((__m128i*)(sums + k * 4), sum[j][k]);
+      _mm_storeu_si128((__m128i*)(sumSqs + k * 4), sumSq[j][k]);
+    }
+    for (unsigned int i = 0; i < 16; ++i)
+      addLane(stats[(j * 16 + i) % channels], los[i], his[i], sums[i], sumSqs[i]);
+  }
+#else
+  statsScalar(samples, numGroups * period * 16, channels, stats);
+#endif
+}
+
+
+static void statsBlockU16(const unsigned short* samples, size_t numGroups,
+    unsigned int channels, unsigned int period, ChannelStats* stats)
+{
+#ifdef VGL_SIMD_X86
+  // SSE2 only has signed 16 bit min and max, so flip the top bit first.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi16(short(0x8000));
+  __m128i lo[3], hi[3], sum[3][2], sumSq[3][4];
+  for (unsigned int j = 0; j < period; ++j) {
+    lo[j] = _mm_set1_epi16(0x7FFF);
+    hi[j] = bias;
+    sum[j][0] = sum[j][1] = zero;
+    for (unsigned int k = 0; k < 4; ++k)
+      sumSq[j][k] = zero;
+  }
+
+  const __m128i* in = (const __m128i*)samples;
+  for (size_t g = 0; g < numGroups; ++g) {
+    for (unsigned int j = 0; j < period; ++j) {
+      __m128i v = _mm_loadu_si128(in++);
+      __m128i biased = _mm_xor_si128(v, bias);
+      lo[j] = _mm_min_epi16(lo[j], biased);
+      hi[j] = _mm_max_epi16(hi[j], biased);
+
+      sum[j][0] = _mm_add_epi32(sum[j][0], _mm_unpacklo_epi16(v, zero));
+      sum[j][1] = _mm_add_epi32(sum[j][1], _mm_unpackhi_epi16(v, zero));
+
+      // Squares need the full 32 bits, so they're totalled in 64 bit lanes.
+      __m128i sqLo = _mm_mullo_epi16(v, v);
+      __m128i sqHi = _mm_mulhi_epu16(v, v);
+      __m128i s0 = _mm_unpacklo_epi16(sqLo, sqHi);
+      __m128i s1 = _mm_unpackhi_epi16(sqLo, sqHi);
+      sumSq[j][0] = _mm_add_epi64(sumSq[j][0], _mm_unpacklo_epi32(s0, zero));
+      sumSq[j][1] = _mm_add_epi64(sumSq[j][1], _mm_unpackhi_epi32(s0, zero));
+      sumSq[j][2] = _mm_add_epi64(sumSq[j][2], _mm_unpacklo_epi32(s1, zero));
+      sumSq[j][3] = _mm_add_epi64(sumSq[j][3], _mm_unpackhi_epi32(s1, zero));
+    }
+  }
+
+  for (unsigned int j = 0; j < period; ++j) {
+    unsigned short los[8], his[8];
+    unsigned int sums[8];
+    unsigned long long sumSqs[8];
+    _mm_storeu_si128((__m128i*)los, _mm_xor_si128(lo[j], bias));
+    _mm_storeu_si128((__m128i*)his, _mm_xor_si128(hi[j], bias));
+    _mm_storeu_si128((__m128i*)sums, sum[j][0]);
+    _mm_storeu_si128((__m128i*)(sums + 4), sum[j][1]);
+    for (unsigned int k = 0; k < 4; ++k)
+      _mm_storeu_si128((__m128i*)(sumSqs + k * 2), sumSq[j][k]);
+    for (unsigned int i = 0; i < 8; ++i)
+      addLane(stats[(j * 8 + i) % channels], los[i], his[i], sums[i], double(sumSqs[i]));
+  }
+#else
+  statsScalar(samples, numGroups * period * 8, channels, stats);
+#endif
+}
+
+
+static void statsBlockF32(const float* samples, size_t numGroups,
+    unsigned int channels, unsigned int period, ChannelStats* stats)
+{
+#ifdef VGL_SIMD_X86
+  // The totals are kept as doubles, so big images don't lose precision. The
+  // new value goes first in min and max so that NaNs are passed over.
+  __m128 lo[3], hi[3];
+  __m128d sum[3][2], sumSq[3][2];
+  for (unsigned int j = 0; j < period; ++j) {
+    lo[j] = _mm_set1_ps(HUGE_VALF);
+    hi[j] = _mm_set1_ps(-HUGE_VALF);
+    sum[j][0] = sum[j][1] = sumSq[j][0] = sumSq[j][1] = _mm_setzero_pd();
+  }
+
+  const float* in = samples;
+  for (size_t g = 0; g < numGroups; ++g) {
+    for (unsigned int j = 0; j < period; ++j, in += 4) {
+      __m128 v = _mm_loadu_ps(in);
+      lo[j] = _mm_min_ps(v, lo[j]);
+      hi[j] = _mm_max_ps(v, hi[j]);
+
+      __m128d d0 = _mm_cvtps_pd(v);
+      __m128d d1 = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+      sum[j][0] = _mm_add_pd(sum[j][0], d0);
+      sum[j][1] = _mm_add_pd(sum[j][1], d1);
+      sumSq[j][0] = _mm_add_pd(sumSq[j][0], _mm_mul_pd(d0, d0));
+      sumSq[j][1] = _mm_add_pd(sumSq[j][1], _mm_mul_pd(d1, d1));
+    }
+  }
+
+  for (unsigned int j = 0; j < period; ++j) {
+    float los[4], his[4];
+    double sums[4], sumSqs[4];
+    _mm_storeu_ps(los, lo[j]);
+    _mm_storeu_ps(his, hi[j]);
+    _mm_storeu_pd(sums, sum[j][0]);
+    _mm_storeu_pd(sums + 2, sum[j][1]);
+    _mm_storeu_pd(sumSqs, sumSq[j][0]);
+    _mm_storeu_pd(sumSqs + 2, sumSq[j][1]);
+    for (unsigned int i = 0; i < 4; ++i)
+      addLane(stats[(j * 4 + i) % channels], los[i], his[i], sums[i], sumSqs[i]);
+  }
+#else
+  statsScalar(samples, numGroups * period * 4, channels, stats);
+#endif
+}
+
+
+static void halfsToFloats(const unsigned short* src, float* dst, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = halfToFloat(src[i]);
+}
+
+
+// Which bin a value falls into; the float path of histogram() does exactly
+// the same sums with SSE2.
+static inline unsigned int binFor(float v, float low, float scale, unsigned int numBins)
+{
+  float f = (v - low) * scale;
+  if (!(f > 0.0f)) // Also catches NaNs.
+    return 0;
+  return (unsigned int)std::min(f, float(numBins - 1));
+}
+
+
+// Bins numPixels pixels of integer or half samples through the lookup table,
+// adding them to counts. Alternate pixels go to two separate sets of 32 bit
+// counters, so runs of the same value don't have to wait on each other's
+// increments; blocks are small enough that they can't overflow.
+template <typename T, unsigned int C>
+static void histogramLUTBlock(const T* samples, size_t numPixels, const unsigned int* lut,
+    unsigned int numBins, unsigned int* scratch, size_t* counts)
+{
+  unsigned int* even = scratch;
+  unsigned int* odd = scratch + C * numBins;
+  std::fill(scratch, scratch + 2 * C * numBins, 0u);
+
+  size_t i = 0;
+  for (; i + 2 <= numPixels; i += 2, samples += 2 * C) {
+    for (unsigned int c = 0; c < C; ++c) {
+      ++even[c * numBins + lut[samples[c]]];
+      ++odd[c * numBins + lut[samples[C + c]]];
+    }
+  }
+  if (i < numPixels) {
+    for (unsigned int c = 0; c < C; ++c)
+      ++even[c * numBins + lut[samples[c]]];
+  }
+
+  for (size_t b = 0; b < C * numBins; ++b)
+    counts[b] += even[b] + odd[b];
+}
+
+
+// For 8 bit samples it's quicker to count each value and only look up the
+// bins once per block.
+template <unsigned int C>
+static void histogramU8Block(const unsigned char* samples, size_t numPixels, const unsigned int* lut,
+    unsigned int numBins, unsigned int* scratch, size_t* counts)
+{
+  unsigned int* even = scratch;
+  unsigned int* odd = scratch + C * 256;
+  std::fill(scratch, scratch + 2 * C * 256, 0u);
+
+  size_t i = 0;
+  for (; i + 2 <= numPixels; i += 2, samples += 2 * C) {
+    for (unsigned int c = 0; c < C; ++c) {
+      ++even[c * 256 + samples[c]];
+      ++odd[c * 256 + samples[C + c]];
+    }
+  }
+  if (i < numPixels) {
+    for (unsigned int c = 0; c < C; ++c)
+      ++even[c * 256 + samples[c]];
+  }
+
+  for (unsigned int c = 0; c < C; ++c) {
+    for (unsigned int v = 0; v < 256; ++v)
+      counts[c * numBins + lut[v]] += even[c * 256 + v] + odd[c * 256 + v];
+  }
+}
+
+
+template <typename T>
+static void histogramLUT(const T* samples, size_t numPixels, unsigned int channels,
+    const unsigned int* lut, unsigned int numBins, unsigned int* scratch, size_t* counts)
+{
+  switch (channels) {
+    case 1: histogramLUTBlock<T, 1>(samples, numPixels, lut, numBins, scratch, counts); break;
+    case 2: histogramLUTBlock<T, 2>(samples, numPixels, lut, numBins, scratch, counts); break;
+    case 3: histogramLUTBlock<T, 3>(samples, numPixels, lut, numBins, scratch, counts); break;
+    default: histogramLUTBlock<T, 4>(samples, numPixels, lut, numBins, scratch, counts); break;
+  }
+}
+
+
+static void histogramLUT(const unsigned char* samples, size_t numPixels, unsigned int channels,
+    const unsigned int* lut, unsigned int numBins, unsigned int* scratch, size_t* counts)
+{
+  switch (channels) {
+    case 1: histogramU8Block<1>(samples, numPixels, lut, numBins, scratch, counts); break;
+    case 2: histogramU8Block<2>(samples, numPixels, lut, numBins, scratch, counts); break;
+    case 3: histogramU8Block<3>(samples, numPixels, lut, numBins, scratch, counts); break;
+    default: histogramU8Block<4>(samples, numPixels, lut, numBins, scratch, counts); break;
+  }
+}
+
+
+static void histogramF32(const float* samples, size_t numPixels, unsigned int channels,
+    float low, float scale, unsigned int numBins, unsigned int* bins, size_t* counts)
+{
+  size_t numSamples = numPixels * channels;
+  size_t i = 0;
+#ifdef VGL_SIMD_X86
+  const __m128 lowV = _mm_set1_ps(low);
+  const __m128 scaleV = _mm_set1_ps(scale);
+  const __m128 lastBin = _mm_set1_ps(float(numBins - 1));
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= numSamples; i += 4) {
+    __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(samples + i), lowV), scaleV);
+    f = _mm_min_ps(_mm_max_ps(f, zero), lastBin); // max() turns NaNs into 0.
+    _mm_storeu_si128((__m128i*)(bins + i), _mm_cvttps_epi32(f));
+  }
+#endif
+  for (; i < numSamples; ++i)
+    bins[i] = binFor(samples[i], low, scale, numBins);
+
+  for (size_t p = 0; p < numPixels; ++p, bins += channels) {
+    for (unsigned int c = 0; c < channels; ++c)
+      ++counts[c * numBins + bins[c]];
+  }
+}
+
+
+//
+// FUNCTIONS
+//
+
+ImageStats imageStats(const RawImage& img) throw(ImageException)
+{
+  const int pixelType = img.getPixelType();
+  const unsigned int bytesPerChannel = bytesPerChannelForPixelType(pixelType);
+  if (bytesPerChannel == 0)
+    throw ImageException("Unsupported pixel type for image stats: %d", pixelType);
+
+  const unsigned int channels = img.getBytesPerPixel() / bytesPerChannel;
+  if (channels == 0 || channels > 4)
+    throw ImageException("Unsupported number of channels for image stats: %u", channels);
+
+  const size_t numSamples = size_t(img.getWidth()) * img.getHeight() * channels;
+  const unsigned char* pixels = img.getPixels();
+
+  // Half floats are converted a block at a time and then use the float kernel.
+  const unsigned int lanes = (pixelType == GL_UNSIGNED_BYTE) ? 16 :
+                             (pixelType == GL_UNSIGNED_SHORT) ? 8 : 4;
+  const unsigned int period = (channels == 3) ? 3 : 1;
+  const size_t groupSamples = size_t(lanes) * period;
+  const size_t numGroups = (pixels != NULL) ? numSamples / groupSamples : 0;
+  const int numBlocks = int((numGroups + kStatsBlockGroups - 1) / kStatsBlockGroups);
+
+  ChannelStats stats[4];
+  initStats(stats);
+
+  #pragma omp parallel
+  {
+    ChannelStats local[4];
+    initStats(local);
+    std::vector<float> floats;
+    if (pixelType == GL_HALF_FLOAT)
+      floats.resize(kStatsBlockGroups * groupSamples);
+
+    #pragma omp for
+    for (int block = 0; block < numBlocks; ++block) {
+      size_t firstGroup = size_t(block) * kStatsBlockGroups;
+      size_t blockGroups = std::min(kStatsBlockGroups, numGroups - firstGroup);
+      size_t first = firstGroup * groupSamples;
+      switch (pixelType) {
+        case GL_UNSIGNED_BYTE:
+          statsBlockU8(pixels + first, blockGroups, channels, period, local);
+          break;
+        case GL_UNSIGNED_SHORT:
+          statsBlockU16((const unsigned short*)pixels + first, blockGroups, channels, period, local);
+          break;
+        case GL_HALF_FLOAT:
+          halfsToFloats((const unsigned short*)pixels + first, &floats[0], blockGroups * groupSamples);
+          statsBlockF32(&floats[0], blockGroups, channels, period, local);
+          break;
+        default:
+          statsBlockF32((const float*)pixels + first, blockGroups, channels, period, local);
+          break;
+      }
+    }
+
+    #pragma omp critical (vgl_imagestats)
+    mergeStats(stats, local, channels);
+  }
+
+  // The samples that don't fill a whole group. Groups are a whole number of
+  // pixels, so these start on the first channel.
+  if (pixels != NULL) {
+    size_t first = numGroups * groupSamples;
+    size_t count = numSamples - first;
+    switch (pixelType) {
+      case GL_UNSIGNED_BYTE:
+        statsScalar(pixels + first, count, channels, stats);
+        break;
+      case GL_UNSIGNED_SHORT:
+        statsScalar((const unsigned short*)pixels + first, count, channels, stats);
+        break;
+      case GL_HALF_FLOAT: {
+        std::vector<float> floats(count + 1);
+        halfsToFloats((const unsigned short*)pixels + first, &floats[0], count);
+        statsScalar(&floats[0], count, channels, stats);
+        break;
+      }
+      default:
+        statsScalar((const float*)pixels + first, count, channels, stats);
+        break;
+    }
+  }
+
+  const double scale = (pixelType == GL_UNSIGNED_BYTE) ? 1.0 / 255.0 :
+                       (pixelType == GL_UNSIGNED_SHORT) ? 1.0 / 65535.0 : 1.0;
+  const double n = double(numSamples / channels);
+
+  ImageStats result;
+  result.numChannels = channels;
+  for (unsigned int c = 0; c < 4; ++c) {
+    if (c >= channels || n == 0.0) {
+      result.min[c] = result.max[c] = result.mean[c] = result.stdDev[c] = 0.0;
+      continue;
+    }
+    double mean = stats[c].sum / n;
+    double variance = std::max(0.0, stats[c].sumSq / n - mean * mean);
+    result.min[c] = stats[c].min * scale;
+    result.max[c] = stats[c].max * scale;
+    result.mean[c] = mean * scale;
+    result.stdDev[c] = std::sqrt(variance) * scale;
+  }
+  return result;
+}
+
+
+Histogram histogram(const RawImage& img, unsigned int numBins, double low, double high)
+  throw(ImageException)
+{
+  if (numBins == 0 || numBins > 65536)
+    throw ImageException("Invalid number of histogram bins: %u", numBins);
+  if (!(high > low))
+    throw ImageException("Invalid histogram range: [%g, %g]", low, high);
+
+  const int pixelType = img.getPixelType();
+  const unsigned int bytesPerChannel = bytesPerChannelForPixelType(pixelType);
+  if (bytesPerChannel == 0)
+    throw ImageException("Unsupported pixel type for histogram: %d", pixelType);
+
+  const unsigned int channels = img.getBytesPerPixel() / bytesPerChannel;
+  if (channels == 0 || channels > 4)
+    throw ImageException("Unsupported number of channels for histogram: %u", channels);
+
+  Histogram result;
+  result.numChannels = channels;
+  result.numBins = numBins;
+  result.low = low;
+  result.high = high;
+  result.counts.assign(size_t(channels) * numBins, 0);
+
+  const unsigned char* pixels = img.getPixels();
+  if (pixels == NULL)
+    return result;
+
+  const float lowF = float(low);
+  const float scale = float(numBins / (high - low));
+
+  // Every other pixel type has few enough values to bin them all up front.
+  std::vector<unsigned int> lut;
+  switch (pixelType) {
+    case GL_UNSIGNED_BYTE:
+      lut.resize(256);
+      for (unsigned int v = 0; v < 256; ++v)
+        lut[v] = binFor(v / 255.0f, lowF, scale, numBins);
+      break;
+    case GL_UNSIGNED_SHORT:
+      lut.resize(65536);
+      for (unsigned int v = 0; v < 65536; ++v)
+        lut[v] = binFor(v / 65535.0f, lowF, scale, numBins);
+      break;
+    case GL_HALF_FLOAT:
+      lut.resize(65536);
+      for (unsigned int v = 0; v < 65536; ++v)
+        lut[v] = binFor(halfToFloat((unsigned short)v), lowF, scale, numBins);
+      break;
+    default:
+      break;
+  }
+
+  const size_t numPixels = size_t(img.getWidth()) * img.getHeight();
+  const int numBlocks = int((numPixels + kHistogramBlockPixels - 1) / kHistogramBlockPixels);
+
+  #pragma omp parallel
+  {
+    std::vector<size_t> local(result.counts.size(), 0);
+    std::vector<unsigned int> bins;
+    if (pixelType == GL_FLOAT)
+      bins.resize(kHistogramBlockPixels * channels);
+    else
+      bins.resize(2 * channels * std::max(numBins, 256u));
+
+    #pragma omp for
+    for (int block = 0; block < numBlocks; ++block) {
+      size_t first = size_t(block) * kHistogramBlockPixels * channels;
+      size_t count = std::min(kHistogramBlockPixels, numPixels - size_t(block) * kHistogramBlockPixels);
+      switch (pixelType) {
+        case GL_UNSIGNED_BYTE:
+          histogramLUT(pixels + first, count, channels, &lut[0], numBins, &bins[0], &local[0]);
+          break;
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+          histogramLUT((const unsigned short*)pixels + first, count, channels, &lut[0], numBins, &bins[0], &local[0]);
+          break;
+        default:
+          histogramF32((const float*)pixels + first, count, channels, lowF, scale, numBins, &bins[0], &local[0]);
+          break;
+      }
+    }
+
+    #pragma omp critical (vgl_histogram)
+    {
+      for (size_t i = 0; i < local.size(); ++i)
+        result.counts[i] += local[i];
+    }
+  }
+
+  return result;
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,65 @@
+#ifndef vgl_imagestats_h
+#define vgl_imagestats_h
+
+#include "vgl_image.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace vgl {
+
+//
+// Types
+//
+
+// Per channel statistics for an image. Channels are in the order they're
+// stored, so a GL_BGR image reports blue first. Integer channels are scaled
+// to [0, 1], as elsewhere in VGL; float channels are left as they are.
+struct ImageStats {
+  unsigned int numChannels;
+  double min[4];
+  double max[4];
+  double mean[4];
+  double stdDev[4];   //!< Population standard deviation.
+};
+
+
+// Per channel histograms, all with the same bins spread evenly over
+// [low, high]. Values below the range are counted in the first bin and values
+// above it in the last one.
+struct Histogram {
+  unsigned int numChannels;
+  unsigned int numBins;
+  double low, high;
+  std::vector<size_t> counts; //!< numBins counts for each channel in turn.
+
+  size_t count(unsigned int channel, unsigned int bin) const
+    { return counts[channel * numBins + bin]; }
+};
+
+
+//
+// Functions
+//
+
+// Both of these work on any pixel layout and pixel type. The image is split
+// into blocks which are shared out between threads, each of which keeps its
+// own partial results, and those are merged once all the blocks are done.
+//
+// imageStats accumulates each block with SSE2, keeping separate lanes for
+// every channel. NaNs are skipped by min and max, but make the mean and
+// standard deviation NaN.
+ImageStats imageStats(const RawImage& img) throw(ImageException);
+
+// 8 bit, 16 bit and half float pixels are binned through a lookup table of
+// every possible value; float pixels have their bins worked out four at a
+// time with SSE2. NaNs are counted in the first bin. numBins must be between
+// 1 and 65536, and high must be greater than low.
+Histogram histogram(const RawImage& img, unsigned int numBins = 256,
+    double low = 0.0, double high = 1.0) throw(ImageException);
+
+
+} // namespace vgl
+
+#endif // vgl_imagestats_h
+
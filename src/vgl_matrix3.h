@@ -1,6 +1,8 @@
 #ifndef vgl_matrix3_h
 #define vgl_matrix3_h
 
+#include "vgl_vec3.h"
+
 namespace vgl {
 
 //
@@ -43,14 +45,67 @@ Matrix3<Num> operator * (const Matrix3<Num>& a, const Matrix3<Num>& b)
   for (int row = 0; row < 3; ++row) {
     for (int col = 0; col < 3; ++col) {
       m[row][col] = 0;
-      for (int k = 0; k < 3; ++col)
-        m[row][col] += a[row][k] + b[k][col];
+      for (int k = 0; k < 3; ++k)
+        m[row][col] += a[row][k] * b[k][col];
     }
   }
   return m;
 }
 
 
+template <typename Num>
+Vec3<Num> operator * (const Matrix3<Num>& m, const Vec3<Num>& v)
+{
+  return Vec3<Num>(m.m00 * v.x + m.m01 * v.y + m.m02 * v.z,
+                   m.m10 * v.x + m.m11 * v.y + m.m12 * v.z,
+                   m.m20 * v.x + m.m21 * v.y + m.m22 * v.z);
+}
+
+
+template <typename Num>
+Matrix3<Num> transpose(const Matrix3<Num>& a)
+{
+  Matrix3<Num> m;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col)
+      m[row][col] = a[col][row];
+  }
+  return m;
+}
+
+
+template <typename Num>
+Num determinant(const Matrix3<Num>& a)
+{
+  return a.m00 * (a.m11 * a.m22 - a.m12 * a.m21) -
+         a.m01 * (a.m10 * a.m22 - a.m12 * a.m20) +
+         a.m02 * (a.m10 * a.m21 - a.m11 * a.m20);
+}
+
+
+// The rows of the inverse are the cross products of pairs of columns, divided
+// by the determinant. A singular matrix gives infinities or NaNs.
+template <typename Num>
+Matrix3<Num> inverse(const Matrix3<Num>& a)
+{
+  Vec3<Num> c0(a.m00, a.m10, a.m20);
+  Vec3<Num> c1(a.m01, a.m11, a.m21);
+  Vec3<Num> c2(a.m02, a.m12, a.m22);
+  Vec3<Num> r0 = cross(c1, c2);
+  Vec3<Num> r1 = cross(c2, c0);
+  Vec3<Num> r2 = cross(c0, c1);
+  Num invDet = Num(1) / dot(c0, r0);
+
+  Matrix3<Num> m;
+  for (int col = 0; col < 3; ++col) {
+    m[0][col] = r0[col] * invDet;
+    m[1][col] = r1[col] * invDet;
+    m[2][col] = r2[col] * invDet;
+  }
+  return m;
+}
+
+
 } // namespace vgl
 
 #endif // vgl_matrix3_h
@@ -0,0 +1,391 @@
+#include "vgl_matrix4.h"
+
+#ifdef VGL_SIMD_SSE2
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// HELPER FUNCTIONS
+//
+
+#ifdef VGL_SIMD_SSE2
+
+// Shuffles with the lanes listed in order, which reads more easily than
+// _MM_SHUFFLE for the swizzles in the inverse code below.
+#define SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define SWIZZLE(a, x, y, z, w)    _mm_shuffle_ps(a, a, _MM_SHUFFLE(w, z, y, x))
+
+
+// The 4x4 inverse and determinant work on the matrix as 2x2 blocks
+//   | A B |
+//   | C D |
+// with each block held in a register as (m00, m01, m10, m11). A# below is the
+// adjugate of A, so A * A# = |A| I.
+
+// A * B
+static inline __m128 mul2x2(__m128 a, __m128 b)
+{
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+
+// A# * B
+static inline __m128 adjMul2x2(__m128 a, __m128 b)
+{
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+                    _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+
+// A * B#
+static inline __m128 mulAdj2x2(__m128 a, __m128 b)
+{
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+
+// Every lane gets the sum of all four.
+static inline __m128 horizontalSum(__m128 v)
+{
+  v = _mm_add_ps(v, SWIZZLE(v, 1, 0, 3, 2));
+  return _mm_add_ps(v, SWIZZLE(v, 2, 3, 0, 1));
+}
+
+
+// Splits the matrix into its blocks and works out the parts that both the
+// determinant and inverse need. On return detSub holds (|A|, |B|, |C|, |D|)
+// and det holds |M| = |A||D| + |B||C| - tr((A#B)(D#C)) in every lane.
+static inline void blocks4x4(const Matrix4f& m, __m128& a, __m128& b, __m128& c, __m128& d,
+                             __m128& detSub, __m128& aB, __m128& dC, __m128& det)
+{
+  __m128 r0 = _mm_loadu_ps(m.rows[0]);
+  __m128 r1 = _mm_loadu_ps(m.rows[1]);
+  __m128 r2 = _mm_loadu_ps(m.rows[2]);
+  __m128 r3 = _mm_loadu_ps(m.rows[3]);
+  a = _mm_movelh_ps(r0, r1);
+  b = _mm_movehl_ps(r1, r0);
+  c = _mm_movelh_ps(r2, r3);
+  d = _mm_movehl_ps(r3, r2);
+
+  detSub = _mm_sub_ps(_mm_mul_ps(SHUFFLE(r0, r2, 0, 2, 0, 2), SHUFFLE(r1, r3, 1, 3, 1, 3)),
+                      _mm_mul_ps(SHUFFLE(r0, r2, 1, 3, 1, 3), SHUFFLE(r1, r3, 0, 2, 0, 2)));
+  aB = adjMul2x2(a, b);
+  dC = adjMul2x2(d, c);
+
+  __m128 ad = _mm_mul_ps(SWIZZLE(detSub, 0, 0, 0, 0), SWIZZLE(detSub, 3, 3, 3, 3));
+  __m128 bc = _mm_mul_ps(SWIZZLE(detSub, 1, 1, 1, 1), SWIZZLE(detSub, 2, 2, 2, 2));
+  __m128 tr = horizontalSum(_mm_mul_ps(aB, SWIZZLE(dC, 0, 2, 1, 3)));
+  det = _mm_sub_ps(_mm_add_ps(ad, bc), tr);
+}
+
+
+static float determinantSSE(const Matrix4f& m)
+{
+  __m128 a, b, c, d, detSub, aB, dC, det;
+  blocks4x4(m, a, b, c, d, detSub, aB, dC, det);
+  return _mm_cvtss_f32(det);
+}
+
+
+// If the inverse is | X Y |
+//                   | Z W | / |M|
+// then X# = |D|A - B(D#C), W# = |A|D - C(A#B), Y# = |B|C - D(A#B)# and
+// Z# = |C|B - A(D#C)#. Taking the adjugates of those again is folded into the
+// signs and the final shuffles.
+static Matrix4f inverseSSE(const Matrix4f& m)
+{
+  __m128 a, b, c, d, detSub, aB, dC, det;
+  blocks4x4(m, a, b, c, d, detSub, aB, dC, det);
+
+  __m128 x = _mm_sub_ps(_mm_mul_ps(SWIZZLE(detSub, 3, 3, 3, 3), a), mul2x2(b, dC));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(SWIZZLE(detSub, 0, 0, 0, 0), d), mul2x2(c, aB));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(SWIZZLE(detSub, 1, 1, 1, 1), c), mulAdj2x2(d, aB));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(SWIZZLE(detSub, 2, 2, 2, 2), b), mulAdj2x2(a, dC));
+
+  __m128 invDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+  x = _mm_mul_ps(x, invDet);
+  y = _mm_mul_ps(y, invDet);
+  z = _mm_mul_ps(z, invDet);
+  w = _mm_mul_ps(w, invDet);
+
+  Matrix4f result;
+  _mm_storeu_ps(result.rows[0], SHUFFLE(x, y, 3, 1, 3, 1));
+  _mm_storeu_ps(result.rows[1], SHUFFLE(x, y, 2, 0, 2, 0));
+  _mm_storeu_ps(result.rows[2], SHUFFLE(z, w, 3, 1, 3, 1));
+  _mm_storeu_ps(result.rows[3], SHUFFLE(z, w, 2, 0, 2, 0));
+  return result;
+}
+
+
+static inline __m128 cross3(__m128 a, __m128 b)
+{
+  __m128 c = _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 1, 2, 0, 3)), _mm_mul_ps(SWIZZLE(a, 1, 2, 0, 3), b));
+  return SWIZZLE(c, 1, 2, 0, 3);
+}
+
+
+// The same method as the affineInverse template: the rows of the inverse 3x3
+// are cross products of the columns, then the translation goes through it.
+static Matrix4f affineInverseSSE(const Matrix4f& m)
+{
+  __m128 c0 = _mm_loadu_ps(m.rows[0]);
+  __m128 c1 = _mm_loadu_ps(m.rows[1]);
+  __m128 c2 = _mm_loadu_ps(m.rows[2]);
+  __m128 t = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+
+  __m128 i0 = cross3(c1, c2);
+  __m128 i1 = cross3(c2, c0);
+  __m128 i2 = cross3(c0, c1);
+  __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), horizontalSum(_mm_mul_ps(c0, i0)));
+  i0 = _mm_mul_ps(i0, invDet);
+  i1 = _mm_mul_ps(i1, invDet);
+  i2 = _mm_mul_ps(i2, invDet);
+
+  // Columns of the inverse, then the new translation as a fourth column.
+  __m128 i3 = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+  __m128 sum = _mm_mul_ps(i0, SWIZZLE(t, 0, 0, 0, 0));
+  sum = _mm_add_ps(sum, _mm_mul_ps(i1, SWIZZLE(t, 1, 1, 1, 1)));
+  sum = _mm_add_ps(sum, _mm_mul_ps(i2, SWIZZLE(t, 2, 2, 2, 2)));
+  i3 = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), sum);
+  _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+  Matrix4f result;
+  _mm_storeu_ps(result.rows[0], i0);
+  _mm_storeu_ps(result.rows[1], i1);
+  _mm_storeu_ps(result.rows[2], i2);
+  _mm_storeu_ps(result.rows[3], i3);
+  return result;
+}
+
+#undef SHUFFLE
+#undef SWIZZLE
+
+
+// The array kernels work from the columns of the matrix (the rows of its
+// transpose): the result is x * col0 + y * col1 + z * col2 + w * col3.
+static void transformSSE(const Matrix4f& m, const Vec4f* src, Vec4f* dst, size_t count)
+{
+  Matrix4f t = transpose(m);
+  __m128 c0 = _mm_loadu_ps(t.rows[0]);
+  __m128 c1 = _mm_loadu_ps(t.rows[1]);
+  __m128 c2 = _mm_loadu_ps(t.rows[2]);
+  __m128 c3 = _mm_loadu_ps(t.rows[3]);
+  for (size_t i = 0; i < count; ++i) {
+    __m128 v = _mm_loadu_ps(src[i].data);
+    __m128 sum = _mm_mul_ps(_mm_shuffle_ps(v, v, 0x00), c0);
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0x55), c1));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xAA), c2));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xFF), c3));
+    _mm_storeu_ps(dst[i].data, sum);
+  }
+}
+
+
+// The same, two vectors at a time.
+VGL_TARGET("avx")
+static void transformAVX(const Matrix4f& m, const Vec4f* src, Vec4f* dst, size_t count)
+{
+  Matrix4f t = transpose(m);
+  __m256 c0 = _mm256_broadcast_ps((const __m128*)t.rows[0]);
+  __m256 c1 = _mm256_broadcast_ps((const __m128*)t.rows[1]);
+  __m256 c2 = _mm256_broadcast_ps((const __m128*)t.rows[2]);
+  __m256 c3 = _mm256_broadcast_ps((const __m128*)t.rows[3]);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m256 v = _mm256_loadu_ps(src[i].data);
+    __m256 sum = _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x00), c0);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x55), c1));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xAA), c2));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xFF), c3));
+    _mm256_storeu_ps(dst[i].data, sum);
+  }
+  if (i < count)
+    transformSSE(m, src + i, dst + i, count - i);
+}
+
+
+// Vec3f points are done four at a time. The three vectors holding them,
+//   a = (x0 y0 z0 x1), b = (y1 z1 x2 y2), c = (z2 x3 y3 z3),
+// are shuffled into (x0 x1 x2 x3), (y0 ...), (z0 ...) so that each row of the
+// matrix can be applied to all four at once, then shuffled back again.
+static void transformPointsSSE(const Matrix4f& m, const Vec3f* src, Vec3f* dst, size_t count)
+{
+  __m128 k[12];
+  for (unsigned int row = 0; row < 3; ++row) {
+    for (unsigned int col = 0; col < 4; ++col)
+      k[row * 4 + col] = _mm_set1_ps(m.rows[row][col]);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float* in = src[i].data;
+    __m128 a = _mm_loadu_ps(in);
+    __m128 b = _mm_loadu_ps(in + 4);
+    __m128 c = _mm_loadu_ps(in + 8);
+
+    __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 3, 0)),
+                              _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 0)), _MM_SHUFFLE(3, 1, 1, 0));
+    __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 0, 0, 1)),
+                              _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)),
+                              _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+    __m128 out[3];
+    for (unsigned int row = 0; row < 3; ++row) {
+      __m128 sum = _mm_add_ps(_mm_mul_ps(x, k[row * 4]), _mm_mul_ps(y, k[row * 4 + 1]));
+      out[row] = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(z, k[row * 4 + 2]), k[row * 4 + 3]));
+    }
+    x = out[0];
+    y = out[1];
+    z = out[2];
+
+    __m128 xy = _mm_unpacklo_ps(x, y);
+    a = _mm_shuffle_ps(xy, _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(3, 0, 1, 0));
+    b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                       _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                       _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+
+    float* out3 = dst[i].data;
+    _mm_storeu_ps(out3, a);
+    _mm_storeu_ps(out3 + 4, b);
+    _mm_storeu_ps(out3 + 8, c);
+  }
+  for (; i < count; ++i)
+    dst[i] = transformPoint(m, src[i]);
+}
+
+
+// Eight at a time, with points 0-3 in the low half of each register and 4-7
+// in the high half, so the same in-lane shuffles work.
+VGL_TARGET("avx")
+static void transformPointsAVX(const Matrix4f& m, const Vec3f* src, Vec3f* dst, size_t count)
+{
+  __m256 k[12];
+  for (unsigned int row = 0; row < 3; ++row) {
+    for (unsigned int col = 0; col < 4; ++col)
+      k[row * 4 + col] = _mm256_set1_ps(m.rows[row][col]);
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const float* in = src[i].data;
+    __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in)), _mm_loadu_ps(in + 12), 1);
+    __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 4)), _mm_loadu_ps(in + 16), 1);
+    __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 8)), _mm_loadu_ps(in + 20), 1);
+
+    __m256 x = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 3, 0)),
+                                 _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 0)), _MM_SHUFFLE(3, 1, 1, 0));
+    __m256 y = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 0, 0, 1)),
+                                 _mm256_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 z = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)),
+                                 _mm256_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+    __m256 out[3];
+    for (unsigned int row = 0; row < 3; ++row) {
+      __m256 sum = _mm256_add_ps(_mm256_mul_ps(x, k[row * 4]), _mm256_mul_ps(y, k[row * 4 + 1]));
+      out[row] = _mm256_add_ps(sum, _mm256_add_ps(_mm256_mul_ps(z, k[row * 4 + 2]), k[row * 4 + 3]));
+    }
+    x = out[0];
+    y = out[1];
+    z = out[2];
+
+    __m256 xy = _mm256_unpacklo_ps(x, y);
+    a = _mm256_shuffle_ps(xy, _mm256_shuffle_ps(z, x, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(3, 0, 1, 0));
+    b = _mm256_shuffle_ps(_mm256_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                          _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    c = _mm256_shuffle_ps(_mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                          _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+
+    float* out3 = dst[i].data;
+    _mm_storeu_ps(out3, _mm256_castps256_ps128(a));
+    _mm_storeu_ps(out3 + 4, _mm256_castps256_ps128(b));
+    _mm_storeu_ps(out3 + 8, _mm256_castps256_ps128(c));
+    _mm_storeu_ps(out3 + 12, _mm256_extractf128_ps(a, 1));
+    _mm_storeu_ps(out3 + 16, _mm256_extractf128_ps(b, 1));
+    _mm_storeu_ps(out3 + 20, _mm256_extractf128_ps(c, 1));
+  }
+  if (i < count)
+    transformPointsSSE(m, src + i, dst + i, count - i);
+}
+
+#endif // VGL_SIMD_SSE2
+
+
+//
+// FUNCTIONS
+//
+
+void transform(const Matrix4f& m, const Vec4f* src, Vec4f* dst, size_t count)
+{
+#ifdef VGL_SIMD_SSE2
+  if (cpuHasAVX())
+    transformAVX(m, src, dst, count);
+  else
+    transformSSE(m, src, dst, count);
+#else
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = m * src[i];
+#endif
+}
+
+
+void transformPoints(const Matrix4f& m, const Vec3f* src, Vec3f* dst, size_t count)
+{
+#ifdef VGL_SIMD_SSE2
+  if (cpuHasAVX())
+    transformPointsAVX(m, src, dst, count);
+  else
+    transformPointsSSE(m, src, dst, count);
+#else
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = transformPoint(m, src[i]);
+#endif
+}
+
+
+void rotate(Vec3f* points, size_t count, const Vec3f& axis, float radians)
+{
+  transformPoints(rotationMatrix(axis, radians), points, points, count);
+}
+
+
+float determinant(const Matrix4f& a)
+{
+#ifdef VGL_SIMD_SSE2
+  return determinantSSE(a);
+#else
+  return determinant<float>(a);
+#endif
+}
+
+
+Matrix4f inverse(const Matrix4f& a)
+{
+#ifdef VGL_SIMD_SSE2
+  return inverseSSE(a);
+#else
+  return inverse<float>(a);
+#endif
+}
+
+
+Matrix4f affineInverse(const Matrix4f& a)
+{
+#ifdef VGL_SIMD_SSE2
+  return affineInverseSSE(a);
+#else
+  return affineInverse<float>(a);
+#endif
+}
+
+
+} // namespace vgl
+
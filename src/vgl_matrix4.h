@@ -1,12 +1,25 @@
 #ifndef vgl_matrix4_h
 #define vgl_matrix4_h
 
+#include "vgl_quaternion.h"
+#include "vgl_simd.h"
+#include "vgl_vec3.h"
+#include "vgl_vec4.h"
+
+#include <cmath>
+#include <cstddef>
+
+#ifdef VGL_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace vgl {
 
 //
 // TYPES
 //
 
+// Stored row by row, for transforming column vectors: m[row][col].
 template <typename Num>
 struct Matrix4 {
   union {
@@ -45,14 +58,410 @@ Matrix4<Num> operator * (const Matrix4<Num>& a, const Matrix4<Num>& b)
   for (int row = 0; row < 4; ++row) {
     for (int col = 0; col < 4; ++col) {
       m[row][col] = 0;
-      for (int k = 0; k < 4; ++col)
-        m[row][col] += a[row][k] + b[k][col];
+      for (int k = 0; k < 4; ++k)
+        m[row][col] += a[row][k] * b[k][col];
     }
   }
   return m;
 }
 
 
+template <typename Num>
+Vec4<Num> operator * (const Matrix4<Num>& m, const Vec4<Num>& v)
+{
+  Vec4<Num> result;
+  for (int row = 0; row < 4; ++row)
+    result[row] = m[row][0] * v.x + m[row][1] * v.y + m[row][2] * v.z + m[row][3] * v.w;
+  return result;
+}
+
+
+template <typename Num>
+Matrix4<Num> transpose(const Matrix4<Num>& a)
+{
+  Matrix4<Num> m;
+  for (int row = 0; row < 4; ++row) {
+    for (int col = 0; col < 4; ++col)
+      m[row][col] = a[col][row];
+  }
+  return m;
+}
+
+
+// Transforms p as a point (with w = 1). The bottom row of the matrix is
+// ignored, so there's no divide by w; use the Vec4 form for projections.
+template <typename Num>
+Vec3<Num> transformPoint(const Matrix4<Num>& m, const Vec3<Num>& p)
+{
+  return Vec3<Num>(m.m00 * p.x + m.m01 * p.y + m.m02 * p.z + m.m03,
+                   m.m10 * p.x + m.m11 * p.y + m.m12 * p.z + m.m13,
+                   m.m20 * p.x + m.m21 * p.y + m.m22 * p.z + m.m23);
+}
+
+
+// Transforms v as a direction (with w = 0), so translation doesn't affect it.
+template <typename Num>
+Vec3<Num> transformVector(const Matrix4<Num>& m, const Vec3<Num>& v)
+{
+  return Vec3<Num>(m.m00 * v.x + m.m01 * v.y + m.m02 * v.z,
+                   m.m10 * v.x + m.m11 * v.y + m.m12 * v.z,
+                   m.m20 * v.x + m.m21 * v.y + m.m22 * v.z);
+}
+
+
+template <typename Num>
+Num determinant(const Matrix4<Num>& a)
+{
+  Num s0 = a.m00 * a.m11 - a.m10 * a.m01;
+  Num s1 = a.m00 * a.m12 - a.m10 * a.m02;
+  Num s2 = a.m00 * a.m13 - a.m10 * a.m03;
+  Num s3 = a.m01 * a.m12 - a.m11 * a.m02;
+  Num s4 = a.m01 * a.m13 - a.m11 * a.m03;
+  Num s5 = a.m02 * a.m13 - a.m12 * a.m03;
+  Num c0 = a.m20 * a.m31 - a.m30 * a.m21;
+  Num c1 = a.m20 * a.m32 - a.m30 * a.m22;
+  Num c2 = a.m20 * a.m33 - a.m30 * a.m23;
+  Num c3 = a.m21 * a.m32 - a.m31 * a.m22;
+  Num c4 = a.m21 * a.m33 - a.m31 * a.m23;
+  Num c5 = a.m22 * a.m33 - a.m32 * a.m23;
+  return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+
+// The general inverse, by cofactors built from the 2x2 determinants of the
+// top two and bottom two rows. A singular matrix gives infinities or NaNs;
+// check the determinant first if that's a possibility.
+template <typename Num>
+Matrix4<Num> inverse(const Matrix4<Num>& a)
+{
+  Num s0 = a.m00 * a.m11 - a.m10 * a.m01;
+  Num s1 = a.m00 * a.m12 - a.m10 * a.m02;
+  Num s2 = a.m00 * a.m13 - a.m10 * a.m03;
+  Num s3 = a.m01 * a.m12 - a.m11 * a.m02;
+  Num s4 = a.m01 * a.m13 - a.m11 * a.m03;
+  Num s5 = a.m02 * a.m13 - a.m12 * a.m03;
+  Num c0 = a.m20 * a.m31 - a.m30 * a.m21;
+  Num c1 = a.m20 * a.m32 - a.m30 * a.m22;
+  Num c2 = a.m20 * a.m33 - a.m30 * a.m23;
+  Num c3 = a.m21 * a.m32 - a.m31 * a.m22;
+  Num c4 = a.m21 * a.m33 - a.m31 * a.m23;
+  Num c5 = a.m22 * a.m33 - a.m32 * a.m23;
+  Num invDet = Num(1) / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+  Matrix4<Num> m;
+  m.m00 = ( a.m11 * c5 - a.m12 * c4 + a.m13 * c3) * invDet;
+  m.m01 = (-a.m01 * c5 + a.m02 * c4 - a.m03 * c3) * invDet;
+  m.m02 = ( a.m31 * s5 - a.m32 * s4 + a.m33 * s3) * invDet;
+  m.m03 = (-a.m21 * s5 + a.m22 * s4 - a.m23 * s3) * invDet;
+  m.m10 = (-a.m10 * c5 + a.m12 * c2 - a.m13 * c1) * invDet;
+  m.m11 = ( a.m00 * c5 - a.m02 * c2 + a.m03 * c1) * invDet;
+  m.m12 = (-a.m30 * s5 + a.m32 * s2 - a.m33 * s1) * invDet;
+  m.m13 = ( a.m20 * s5 - a.m22 * s2 + a.m23 * s1) * invDet;
+  m.m20 = ( a.m10 * c4 - a.m11 * c2 + a.m13 * c0) * invDet;
+  m.m21 = (-a.m00 * c4 + a.m01 * c2 - a.m03 * c0) * invDet;
+  m.m22 = ( a.m30 * s4 - a.m31 * s2 + a.m33 * s0) * invDet;
+  m.m23 = (-a.m20 * s4 + a.m21 * s2 - a.m23 * s0) * invDet;
+  m.m30 = (-a.m10 * c3 + a.m11 * c1 - a.m12 * c0) * invDet;
+  m.m31 = ( a.m00 * c3 - a.m01 * c1 + a.m02 * c0) * invDet;
+  m.m32 = (-a.m30 * s3 + a.m31 * s1 - a.m32 * s0) * invDet;
+  m.m33 = ( a.m20 * s3 - a.m21 * s1 + a.m22 * s0) * invDet;
+  return m;
+}
+
+
+// Inverts a matrix whose bottom row is (0, 0, 0, 1), i.e. any combination of
+// rotation, scale, shear and translation: the upper 3x3 is inverted on its
+// own and the translation is the negated original put through that inverse.
+// The bottom row of a isn't looked at.
+template <typename Num>
+Matrix4<Num> affineInverse(const Matrix4<Num>& a)
+{
+  Vec3<Num> c0(a.m00, a.m10, a.m20);
+  Vec3<Num> c1(a.m01, a.m11, a.m21);
+  Vec3<Num> c2(a.m02, a.m12, a.m22);
+  Vec3<Num> t(a.m03, a.m13, a.m23);
+  Vec3<Num> r[3] = { cross(c1, c2), cross(c2, c0), cross(c0, c1) };
+  Num invDet = Num(1) / dot(c0, r[0]);
+
+  Matrix4<Num> m;
+  for (int row = 0; row < 3; ++row) {
+    r[row] *= invDet;
+    m[row][0] = r[row].x;
+    m[row][1] = r[row].y;
+    m[row][2] = r[row].z;
+    m[row][3] = -dot(r[row], t);
+  }
+  return m;
+}
+
+
+// Inverts a rigid transform (rotation and translation only, bottom row
+// (0, 0, 0, 1)): the rotation part is just transposed. Much cheaper than
+// either of the above, but wrong if there's any scale or shear.
+template <typename Num>
+Matrix4<Num> orthonormalInverse(const Matrix4<Num>& a)
+{
+  Matrix4<Num> m;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col)
+      m[row][col] = a[col][row];
+    m[row][3] = -(a.m03 * a[0][row] + a.m13 * a[1][row] + a.m23 * a[2][row]);
+  }
+  return m;
+}
+
+
+//
+// Matrix builders
+//
+// These produce the same matrices as the equivalent GL and GLU calls. Matrix4
+// is stored by rows while GL expects columns, so load the results with
+// glLoadTransposeMatrixf, or transpose them first.
+//
+
+template <typename Num>
+Matrix4<Num> translationMatrix(const Vec3<Num>& t)
+{
+  Matrix4<Num> m;
+  m.m03 = t.x;
+  m.m13 = t.y;
+  m.m23 = t.z;
+  return m;
+}
+
+
+template <typename Num>
+Matrix4<Num> scaleMatrix(const Vec3<Num>& s)
+{
+  Matrix4<Num> m;
+  m.m00 = s.x;
+  m.m11 = s.y;
+  m.m22 = s.z;
+  return m;
+}
+
+
+// The rotation represented by q, which must be a unit quaternion.
+template <typename Num>
+Matrix4<Num> rotationMatrix(const Quaternion<Num>& q)
+{
+  Num x = q.v.x, y = q.v.y, z = q.v.z, w = q.s;
+  Matrix4<Num> m;
+  m.m00 = 1 - 2 * (y * y + z * z);
+  m.m01 = 2 * (x * y - z * w);
+  m.m02 = 2 * (x * z + y * w);
+  m.m10 = 2 * (x * y + z * w);
+  m.m11 = 1 - 2 * (x * x + z * z);
+  m.m12 = 2 * (y * z - x * w);
+  m.m20 = 2 * (x * z - y * w);
+  m.m21 = 2 * (y * z + x * w);
+  m.m22 = 1 - 2 * (x * x + y * y);
+  return m;
+}
+
+
+// A rotation of radians around axis, which needn't be unit length. The same
+// as glRotate, except that glRotate takes degrees.
+template <typename Num>
+Matrix4<Num> rotationMatrix(const Vec3<Num>& axis, Num radians)
+{
+  Num c = std::cos(radians);
+  Num s = std::sin(radians);
+  Vec3<Num> k = norm(axis);
+  Vec3<Num> t = k * (1 - c);
+
+  Matrix4<Num> m;
+  m.m00 = t.x * k.x + c;       m.m01 = t.x * k.y - s * k.z; m.m02 = t.x * k.z + s * k.y;
+  m.m10 = t.y * k.x + s * k.z; m.m11 = t.y * k.y + c;       m.m12 = t.y * k.z - s * k.x;
+  m.m20 = t.z * k.x - s * k.y; m.m21 = t.z * k.y + s * k.x; m.m22 = t.z * k.z + c;
+  return m;
+}
+
+
+// Translation * rotation * scale, built directly rather than by multiplying
+// the three together: scale first, then rotate, then translate.
+template <typename Num>
+Matrix4<Num> trs(const Vec3<Num>& t, const Quaternion<Num>& r, const Vec3<Num>& s)
+{
+  Matrix4<Num> m = rotationMatrix(r);
+  for (int row = 0; row < 3; ++row) {
+    m[row][0] *= s.x;
+    m[row][1] *= s.y;
+    m[row][2] *= s.z;
+  }
+  m.m03 = t.x;
+  m.m13 = t.y;
+  m.m23 = t.z;
+  return m;
+}
+
+
+// Like gluLookAt: the camera sits at eye looking towards target, with up
+// roughly (it needn't be perpendicular to the view direction) upwards.
+template <typename Num>
+Matrix4<Num> lookAt(const Vec3<Num>& eye, const Vec3<Num>& target, const Vec3<Num>& up)
+{
+  Vec3<Num> f = norm(target - eye);
+  Vec3<Num> s = norm(cross(f, up));
+  Vec3<Num> u = cross(s, f);
+
+  Matrix4<Num> m;
+  m.m00 = s.x;  m.m01 = s.y;  m.m02 = s.z;  m.m03 = -dot(s, eye);
+  m.m10 = u.x;  m.m11 = u.y;  m.m12 = u.z;  m.m13 = -dot(u, eye);
+  m.m20 = -f.x; m.m21 = -f.y; m.m22 = -f.z; m.m23 = dot(f, eye);
+  return m;
+}
+
+
+// Like gluPerspective, with the vertical field of view in degrees.
+template <typename Num>
+Matrix4<Num> perspective(Num fovyInDegrees, Num aspect, Num zNear, Num zFar)
+{
+  Num f = Num(1) / std::tan(fovyInDegrees * Num(M_PI / 360.0));
+  Num depth = zNear - zFar;
+
+  Matrix4<Num> m;
+  m.m00 = f / aspect;
+  m.m11 = f;
+  m.m22 = (zFar + zNear) / depth;
+  m.m23 = 2 * zFar * zNear / depth;
+  m.m32 = -1;
+  m.m33 = 0;
+  return m;
+}
+
+
+// Like glOrtho.
+template <typename Num>
+Matrix4<Num> ortho(Num left, Num right, Num bottom, Num top, Num zNear, Num zFar)
+{
+  Matrix4<Num> m;
+  m.m00 = 2 / (right - left);
+  m.m03 = -(right + left) / (right - left);
+  m.m11 = 2 / (top - bottom);
+  m.m13 = -(top + bottom) / (top - bottom);
+  m.m22 = -2 / (zFar - zNear);
+  m.m23 = -(zFar + zNear) / (zFar - zNear);
+  return m;
+}
+
+
+// Transform whole arrays at a time, with SSE or (where the CPU supports it)
+// AVX kernels. src and dst may be the same array, but mustn't otherwise
+// overlap. The Vec3f version treats its inputs as points, like
+// transformPoint.
+void transform(const Matrix4f& m, const Vec4f* src, Vec4f* dst, size_t count);
+void transformPoints(const Matrix4f& m, const Vec3f* src, Vec3f* dst, size_t count);
+
+// Rotates count points in place around axis, building the matrix once and
+// applying it with transformPoints.
+void rotate(Vec3f* points, size_t count, const Vec3f& axis, float radians);
+
+
+// Float versions of the above which use SSE where it's available. They
+// aren't inline because there's a fair bit of code in each.
+float determinant(const Matrix4f& a);
+Matrix4f inverse(const Matrix4f& a);
+Matrix4f affineInverse(const Matrix4f& a);
+
+
+//
+// Matrix4f SIMD OVERLOADS
+//
+
+// As for Vec4f, these take precedence over the templates for floats whenever
+// SSE2 is available. transformPoint and transformVector don't have SIMD
+// versions: for a single Vec3f, packing it into a register and unpacking the
+// result again costs more than the scalar code. Use transformPoints for
+// arrays.
+#ifdef VGL_SIMD_SSE2
+
+// The matrix times (x, y, z, w), as x * col0 + y * col1 + z * col2 + w * col3.
+// Transposing the rows to get the columns only depends on the matrix, so in a
+// loop the compiler can do it once up front.
+inline __m128 mulMatrix4f(const Matrix4f& m, __m128 v)
+{
+  __m128 c0 = _mm_loadu_ps(m.rows[0]);
+  __m128 c1 = _mm_loadu_ps(m.rows[1]);
+  __m128 c2 = _mm_loadu_ps(m.rows[2]);
+  __m128 c3 = _mm_loadu_ps(m.rows[3]);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  __m128 sum = _mm_mul_ps(_mm_shuffle_ps(v, v, 0x00), c0);
+  sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0x55), c1));
+  sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xAA), c2));
+  return _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xFF), c3));
+}
+
+
+inline Matrix4f operator * (const Matrix4f& a, const Matrix4f& b)
+{
+  Matrix4f m;
+  __m128 b0 = _mm_loadu_ps(b.rows[0]);
+  __m128 b1 = _mm_loadu_ps(b.rows[1]);
+  __m128 b2 = _mm_loadu_ps(b.rows[2]);
+  __m128 b3 = _mm_loadu_ps(b.rows[3]);
+  for (int row = 0; row < 4; ++row) {
+    __m128 sum = _mm_mul_ps(_mm_set1_ps(a.rows[row][0]), b0);
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.rows[row][1]), b1));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.rows[row][2]), b2));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.rows[row][3]), b3));
+    _mm_storeu_ps(m.rows[row], sum);
+  }
+  return m;
+}
+
+
+inline Vec4f operator * (const Matrix4f& m, const Vec4f& v)
+{
+  return toVec4f(mulMatrix4f(m, toM128(v)));
+}
+
+
+inline Matrix4f transpose(const Matrix4f& a)
+{
+  __m128 r0 = _mm_loadu_ps(a.rows[0]);
+  __m128 r1 = _mm_loadu_ps(a.rows[1]);
+  __m128 r2 = _mm_loadu_ps(a.rows[2]);
+  __m128 r3 = _mm_loadu_ps(a.rows[3]);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  Matrix4f m;
+  _mm_storeu_ps(m.rows[0], r0);
+  _mm_storeu_ps(m.rows[1], r1);
+  _mm_storeu_ps(m.rows[2], r2);
+  _mm_storeu_ps(m.rows[3], r3);
+  return m;
+}
+
+
+// Builds the columns of the result, which are the rows of the rotation and the
+// new translation, then transposes them.
+inline Matrix4f orthonormalInverse(const Matrix4f& a)
+{
+  const __m128 xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+  __m128 r0 = _mm_loadu_ps(a.rows[0]);
+  __m128 r1 = _mm_loadu_ps(a.rows[1]);
+  __m128 r2 = _mm_loadu_ps(a.rows[2]);
+  __m128 tx = _mm_shuffle_ps(r0, r0, 0xFF);
+  __m128 ty = _mm_shuffle_ps(r1, r1, 0xFF);
+  __m128 tz = _mm_shuffle_ps(r2, r2, 0xFF);
+  r0 = _mm_and_ps(r0, xyz);
+  r1 = _mm_and_ps(r1, xyz);
+  r2 = _mm_and_ps(r2, xyz);
+  __m128 t = _mm_add_ps(_mm_mul_ps(r0, tx), _mm_add_ps(_mm_mul_ps(r1, ty), _mm_mul_ps(r2, tz)));
+  t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, t);
+  Matrix4f m;
+  _mm_storeu_ps(m.rows[0], r0);
+  _mm_storeu_ps(m.rows[1], r1);
+  _mm_storeu_ps(m.rows[2], r2);
+  _mm_storeu_ps(m.rows[3], t);
+  return m;
+}
+
+
+#endif // VGL_SIMD_SSE2
+
+
 } // namespace vgl
 
 #endif // vgl_matrix4_h
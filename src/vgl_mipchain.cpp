@@ -0,0 +1,365 @@
+#include "vgl_mipchain.h"
+
+#include "vgl_convert.h"
+#include "vgl_image.h"
+#include "vgl_pixelpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef linux
+#include <GL/gl.h>
+#else
+#include <OpenGL/gl.h>
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+// Levels are built in square blocks of this many pixels at the base level.
+// Each block is carried all the way down to 1x1 while it's still in cache,
+// before moving on to the next block. Must be a power of two.
+static const unsigned int kBlockLevels = 6;
+static const unsigned int kBlockSize = 1 << kBlockLevels;
+
+static const unsigned int kEncodeBits = 12;
+static const unsigned int kEncodeSize = 1 << kEncodeBits;
+
+
+//
+// HELPER FUNCTIONS
+//
+
+// Lookup tables for converting between sRGB encoded bytes and linear light
+// values. Built on first use.
+struct GammaTables {
+  float decode[256];
+  unsigned char encode[kEncodeSize];
+
+  GammaTables()
+  {
+    for (unsigned int i = 0; i < 256; ++i) {
+      float c = i / 255.0f;
+      decode[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (unsigned int i = 0; i < kEncodeSize; ++i) {
+      float l = i / float(kEncodeSize - 1);
+      float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      encode[i] = (unsigned char)(c * 255.0f + 0.5f);
+    }
+  }
+};
+
+
+static const GammaTables& gammaTables()
+{
+  static GammaTables tables;
+  return tables;
+}
+
+
+// Returns the index of the alpha channel for a pixel format, or -1 if it
+// doesn't have one.
+static int alphaChannel(int type)
+{
+  switch (type) {
+    case GL_RGBA:
+    case GL_BGRA:
+      return 3;
+    case GL_LUMINANCE_ALPHA:
+      return 1;
+    case GL_ALPHA:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+
+// Box filter pixels [x0, x1) of one row of a level from the two rows of the
+// level above it which cover it.
+static void filterRow(const unsigned char* row0, const unsigned char* row1,
+    unsigned int srcWidth, unsigned int bpp, unsigned int x0, unsigned int x1,
+    unsigned char* dst, const GammaTables* gamma, int alpha)
+{
+  for (unsigned int x = x0; x < x1; ++x) {
+    const unsigned char* a = row0 + 2 * x * bpp;
+    const unsigned char* b = (2 * x + 1 < srcWidth) ? a + bpp : a;
+    const unsigned char* c = row1 + 2 * x * bpp;
+    const unsigned char* d = (2 * x + 1 < srcWidth) ? c + bpp : c;
+    unsigned char* out = dst + x * bpp;
+
+    if (gamma == NULL) {
+      for (unsigned int i = 0; i < bpp; ++i)
+        out[i] = (unsigned char)((a[i] + b[i] + c[i] + d[i] + 2) >> 2);
+    } else {
+      for (unsigned int i = 0; i < bpp; ++i) {
+        if ((int)i == alpha) {
+          out[i] = (unsigned char)((a[i] + b[i] + c[i] + d[i] + 2) >> 2);
+        } else {
+          float l = (gamma->decode[a[i]] + gamma->decode[b[i]] +
+                     gamma->decode[c[i]] + gamma->decode[d[i]]) * 0.25f;
+          out[i] = gamma->encode[(unsigned int)(l * (kEncodeSize - 1) + 0.5f)];
+        }
+      }
+    }
+  }
+}
+
+
+inline unsigned short average4(unsigned short a, unsigned short b, unsigned short c, unsigned short d)
+{
+  return (unsigned short)((a + b + c + d + 2u) >> 2);
+}
+
+
+inline float average4(float a, float b, float c, float d)
+{
+  return (a + b + c + d) * 0.25f;
+}
+
+
+// Box filter for 16 bit and floating point channels, which are always treated
+// as linear. Half floats are stored as unsigned shorts, so they get their own
+// flag.
+template <typename T>
+static void filterRowWide(const unsigned char* row0, const unsigned char* row1,
+    unsigned int srcWidth, unsigned int channels, unsigned int x0, unsigned int x1,
+    unsigned char* dst, bool isHalf)
+{
+  const T* r0 = (const T*)row0;
+  const T* r1 = (const T*)row1;
+  T* out = (T*)dst;
+  for (unsigned int x = x0; x < x1; ++x) {
+    unsigned int x2 = (2 * x + 1 < srcWidth) ? 2 * x + 1 : 2 * x;
+    for (unsigned int i = 0; i < channels; ++i) {
+      T a = r0[2 * x * channels + i];
+      T b = r0[x2 * channels + i];
+      T c = r1[2 * x * channels + i];
+      T d = r1[x2 * channels + i];
+      if (isHalf) {
+        float f = average4(halfToFloat(a), halfToFloat(b), halfToFloat(c), halfToFloat(d));
+        out[x * channels + i] = floatToHalf(f);
+      } else {
+        out[x * channels + i] = average4(a, b, c, d);
+      }
+    }
+  }
+}
+
+
+//
+// MipChain METHODS
+//
+
+MipChain::MipChain(RawImage* src, bool linearLight) :
+  _type(src->getType()),
+  _pixelType(src->getPixelType()),
+  _texId(0),
+  _bytesPerPixel(src->getBytesPerPixel()),
+  _numLevels(0),
+  _pixels(NULL)
+{
+  unsigned int w = src->getWidth();
+  unsigned int h = src->getHeight();
+  _offsets[0] = 0;
+  while (_numLevels < kMaxLevels) {
+    _widths[_numLevels] = w;
+    _heights[_numLevels] = h;
+    _offsets[_numLevels + 1] = _offsets[_numLevels] + size_t(w) * h * _bytesPerPixel;
+    ++_numLevels;
+    if (w == 1 && h == 1)
+      break;
+    w = std::max(1u, w / 2);
+    h = std::max(1u, h / 2);
+  }
+
+  _pixels = allocPixels(_offsets[_numLevels]);
+  memcpy(_pixels, src->getPixels(), _offsets[1]);
+
+  for (unsigned int base = 0; base + 1 < _numLevels; base += kBlockLevels)
+    buildLevels(base, std::min(kBlockLevels, _numLevels - 1 - base), linearLight);
+}
+
+
+MipChain::~MipChain()
+{
+  freePixels(_pixels);
+}
+
+
+int MipChain::getType() const
+{
+  return _type;
+}
+
+
+int MipChain::getPixelType() const
+{
+  return _pixelType;
+}
+
+
+unsigned int MipChain::getBytesPerPixel() const
+{
+  return _bytesPerPixel;
+}
+
+
+unsigned int MipChain::getNumLevels() const
+{
+  return _numLevels;
+}
+
+
+unsigned int MipChain::getLevelWidth(unsigned int level) const
+{
+  return _widths[level];
+}
+
+
+unsigned int MipChain::getLevelHeight(unsigned int level) const
+{
+  return _heights[level];
+}
+
+
+size_t MipChain::getLevelOffset(unsigned int level) const
+{
+  return _offsets[level];
+}
+
+
+unsigned char* MipChain::getLevelPixels(unsigned int level)
+{
+  return _pixels + _offsets[level];
+}
+
+
+size_t MipChain::getSize() const
+{
+  return _offsets[_numLevels];
+}
+
+
+unsigned char* MipChain::getPixels()
+{
+  return _pixels;
+}
+
+
+unsigned int MipChain::getTexID() const
+{
+  return _texId;
+}
+
+
+void MipChain::uploadTexture(unsigned int texId)
+{
+  GLenum targetType;
+  switch (_type) {
+    case GL_BGR:
+      targetType = GL_RGB;
+      break;
+    case GL_BGRA:
+      targetType = GL_RGBA;
+      break;
+    default:
+      targetType = _type;
+      break;
+  }
+  uploadTextureAs(targetType, texId);
+}
+
+
+void MipChain::uploadTextureAs(int targetType, unsigned int texId)
+{
+  if (texId == 0)
+    glGenTextures(1, &_texId);
+  else
+    _texId = texId;
+
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, _texId);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _numLevels - 1);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  for (unsigned int level = 0; level < _numLevels; ++level) {
+    glTexImage2D(GL_TEXTURE_2D, level, targetType,
+        _widths[level], _heights[level], 0, _type, _pixelType,
+        _pixels + _offsets[level]);
+  }
+}
+
+
+// Fills in levels base+1 to base+count from level base. The base level is
+// split into blocks of kBlockSize x kBlockSize pixels and each block is
+// filtered down through all count levels before moving on to the next, so the
+// source data for every level is still in cache when it gets read. Blocks
+// don't depend on each other, so they're processed in parallel.
+void MipChain::buildLevels(unsigned int base, unsigned int count, bool linearLight)
+{
+  const GammaTables* gamma = (linearLight && _pixelType == GL_UNSIGNED_BYTE) ? &gammaTables() : NULL;
+  int alpha = alphaChannel(_type);
+  unsigned int channels = _bytesPerPixel / bytesPerChannelForPixelType(_pixelType);
+
+  const unsigned int blockSize = 1u << count;
+  const int blocksX = (_widths[base] + blockSize - 1) / blockSize;
+  const int blocksY = (_heights[base] + blockSize - 1) / blockSize;
+  const int numBlocks = blocksX * blocksY;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int block = 0; block < numBlocks; ++block) {
+    unsigned int bx = block % blocksX;
+    unsigned int by = block / blocksX;
+    for (unsigned int level = base + 1; level <= base + count; ++level) {
+      unsigned int size = blockSize >> (level - base);
+      unsigned int x0 = bx * size;
+      unsigned int y0 = by * size;
+      unsigned int x1 = std::min(x0 + size, _widths[level]);
+      unsigned int y1 = std::min(y0 + size, _heights[level]);
+      if (x0 >= x1 || y0 >= y1)
+        break;
+
+      unsigned int srcWidth = _widths[level - 1];
+      unsigned int srcHeight = _heights[level - 1];
+      size_t srcStride = size_t(srcWidth) * _bytesPerPixel;
+      size_t dstStride = size_t(_widths[level]) * _bytesPerPixel;
+      const unsigned char* src = _pixels + _offsets[level - 1];
+      unsigned char* dst = _pixels + _offsets[level];
+      for (unsigned int y = y0; y < y1; ++y) {
+        const unsigned char* row0 = src + 2 * y * srcStride;
+        const unsigned char* row1 = (2 * y + 1 < srcHeight) ? row0 + srcStride : row0;
+        unsigned char* out = dst + y * dstStride;
+        switch (_pixelType) {
+          case GL_UNSIGNED_SHORT:
+            filterRowWide<unsigned short>(row0, row1, srcWidth, channels, x0, x1, out, false);
+            break;
+          case GL_HALF_FLOAT:
+            filterRowWide<unsigned short>(row0, row1, srcWidth, channels, x0, x1, out, true);
+            break;
+          case GL_FLOAT:
+            filterRowWide<float>(row0, row1, srcWidth, channels, x0, x1, out, false);
+            break;
+          default:
+            filterRow(row0, row1, srcWidth, _bytesPerPixel, x0, x1, out, gamma, alpha);
+            break;
+        }
+      }
+    }
+  }
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,80 @@
+#ifndef vgl_mipchain_h
+#define vgl_mipchain_h
+
+#include <cstddef>
+
+namespace vgl {
+
+//
+// Forward declarations
+//
+
+class RawImage;
+
+
+//
+// Types
+//
+
+// A complete chain of mip levels for an image, from the full size image down
+// to 1x1. All of the levels are stored back to back in a single allocation
+// (level 0 first), so the whole chain can be uploaded or written out as a
+// unit.
+//
+// Each level is made by box filtering the level above it. Where a level has
+// an odd width or height, the last column or row is dropped (i.e. the level
+// sizes are floor(size / 2), the same as OpenGL expects).
+//
+// If linearLight is true, the colour channels of 8 bit images are treated as
+// sRGB encoded and averaged in linear light, via lookup tables. Alpha channels
+// are always averaged as-is. Images with 16 bit or floating point channels
+// are assumed to be linear already.
+class MipChain {
+public:
+  static const unsigned int kMaxLevels = 32;
+
+  MipChain(RawImage* src, bool linearLight = false);
+  ~MipChain();
+
+  int getType() const;
+  int getPixelType() const;
+  unsigned int getBytesPerPixel() const;
+  unsigned int getNumLevels() const;
+  unsigned int getLevelWidth(unsigned int level) const;
+  unsigned int getLevelHeight(unsigned int level) const;
+  size_t getLevelOffset(unsigned int level) const;
+  unsigned char* getLevelPixels(unsigned int level);
+
+  //! The total size, in bytes, of all the levels together.
+  size_t getSize() const;
+  //! The start of the single allocation holding all the levels.
+  unsigned char* getPixels();
+
+  unsigned int getTexID() const;
+  void uploadTexture(unsigned int texID = 0);
+  void uploadTextureAs(int targetType, unsigned int texID = 0);
+
+private:
+  // Not copyable.
+  MipChain(const MipChain& other);
+  MipChain& operator = (const MipChain& other);
+
+  void buildLevels(unsigned int base, unsigned int count, bool linearLight);
+
+private:
+  int _type;
+  int _pixelType;
+  unsigned int _texId;
+  unsigned int _bytesPerPixel;
+  unsigned int _numLevels;
+  unsigned int _widths[kMaxLevels];
+  unsigned int _heights[kMaxLevels];
+  size_t _offsets[kMaxLevels + 1];
+  unsigned char* _pixels;
+};
+
+
+} // namespace vgl
+
+#endif // vgl_mipchain_h
+
@@ -26,5 +26,19 @@ void OrthoCamera::setupModelViewMatrix()
 }
 
 
+// setupProjectionMatrix uses whatever the GL viewport is, which this assumes
+// to be the camera's own size.
+Matrix4f OrthoCamera::getProjectionMatrix() const
+{
+  return ortho(0.0f, float(_pixelWidth), 0.0f, float(_pixelHeight), -0.5f, 0.5f);
+}
+
+
+Matrix4f OrthoCamera::getModelViewMatrix() const
+{
+  return Matrix4f();
+}
+
+
 } // namespace vgl
 
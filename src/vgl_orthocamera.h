@@ -13,6 +13,9 @@ public:
 
   virtual void setupProjectionMatrix();
   virtual void setupModelViewMatrix();
+
+  virtual Matrix4f getProjectionMatrix() const;
+  virtual Matrix4f getModelViewMatrix() const;
 };
 
 
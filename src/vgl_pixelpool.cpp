@@ -0,0 +1,188 @@
+#include "vgl_pixelpool.h"
+
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+static const unsigned int kMinClassBits = 12; // 4 KiB
+static const unsigned int kNumClasses = 2 * (sizeof(size_t) * 8 - kMinClassBits - 1);
+
+
+//
+// TYPES
+//
+
+// Sits in front of every buffer, padded out so the pixels which follow it are
+// still aligned. Freed buffers are chained together through it.
+union BlockHeader {
+  struct {
+    BlockHeader* next;
+    unsigned int sizeClass;
+  } info;
+  unsigned char padding[kPixelAlignment];
+};
+
+
+struct PixelPool {
+  pthread_mutex_t mutex;
+  BlockHeader* freeLists[kNumClasses];
+  size_t cachedBytes;
+  size_t limit;
+
+  PixelPool() : cachedBytes(0), limit(size_t(256) << 20)
+  {
+    pthread_mutex_init(&mutex, NULL);
+    for (unsigned int i = 0; i < kNumClasses; ++i)
+      freeLists[i] = NULL;
+  }
+};
+
+
+// Holds the pool's mutex for the lifetime of a scope. The pool is used from
+// plain threads as well as OpenMP ones, so an omp critical section isn't
+// enough to protect it.
+class PoolLock {
+public:
+  PoolLock(PixelPool& p) : _pool(p) { pthread_mutex_lock(&_pool.mutex); }
+  ~PoolLock() { pthread_mutex_unlock(&_pool.mutex); }
+
+private:
+  PixelPool& _pool;
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static PixelPool& pool()
+{
+  static PixelPool thePool;
+  return thePool;
+}
+
+
+// Even classes are powers of two, odd classes are one and a half times the
+// class below.
+static size_t classSize(unsigned int sizeClass)
+{
+  size_t base = size_t(1) << (kMinClassBits + sizeClass / 2);
+  return (sizeClass & 1) ? base + base / 2 : base;
+}
+
+
+static unsigned int classForSize(size_t bytes)
+{
+  unsigned int sizeClass = 0;
+  while (sizeClass + 1 < kNumClasses && classSize(sizeClass) < bytes)
+    ++sizeClass;
+  return sizeClass;
+}
+
+
+// Releases cached buffers, largest first, until the pool is within the given
+// number of bytes. Must be called with the pool's mutex held.
+static void releaseDownTo(PixelPool& p, size_t bytes)
+{
+  for (int i = kNumClasses - 1; i >= 0 && p.cachedBytes > bytes; --i) {
+    while (p.freeLists[i] != NULL && p.cachedBytes > bytes) {
+      BlockHeader* block = p.freeLists[i];
+      p.freeLists[i] = block->info.next;
+      p.cachedBytes -= classSize(i);
+      free(block);
+    }
+  }
+}
+
+
+//
+// FUNCTIONS
+//
+
+unsigned char* allocPixels(size_t bytes)
+{
+  unsigned int sizeClass = classForSize(bytes);
+  BlockHeader* block = NULL;
+
+  PixelPool& p = pool();
+  {
+    PoolLock lock(p);
+    block = p.freeLists[sizeClass];
+    if (block != NULL) {
+      p.freeLists[sizeClass] = block->info.next;
+      p.cachedBytes -= classSize(sizeClass);
+    }
+  }
+
+  if (block == NULL) {
+    void* mem = NULL;
+    if (posix_memalign(&mem, kPixelAlignment, sizeof(BlockHeader) + classSize(sizeClass)) != 0)
+      throw std::bad_alloc();
+    block = (BlockHeader*)mem;
+    block->info.sizeClass = sizeClass;
+  }
+  block->info.next = NULL;
+  return (unsigned char*)(block + 1);
+}
+
+
+void freePixels(unsigned char* pixels)
+{
+  if (pixels == NULL)
+    return;
+
+  BlockHeader* block = (BlockHeader*)pixels - 1;
+  unsigned int sizeClass = block->info.sizeClass;
+
+  PixelPool& p = pool();
+  PoolLock lock(p);
+  block->info.next = p.freeLists[sizeClass];
+  p.freeLists[sizeClass] = block;
+  p.cachedBytes += classSize(sizeClass);
+  if (p.cachedBytes > p.limit)
+    releaseDownTo(p, p.limit);
+}
+
+
+void setPixelPoolLimit(size_t bytes)
+{
+  PixelPool& p = pool();
+  PoolLock lock(p);
+  p.limit = bytes;
+  releaseDownTo(p, bytes);
+}
+
+
+size_t getPixelPoolLimit()
+{
+  PixelPool& p = pool();
+  PoolLock lock(p);
+  return p.limit;
+}
+
+
+size_t getPixelPoolCachedBytes()
+{
+  PixelPool& p = pool();
+  PoolLock lock(p);
+  return p.cachedBytes;
+}
+
+
+void trimPixelPool()
+{
+  PixelPool& p = pool();
+  PoolLock lock(p);
+  releaseDownTo(p, 0);
+}
+
+
+} // namespace vgl
+
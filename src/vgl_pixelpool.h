@@ -0,0 +1,51 @@
+#ifndef vgl_pixelpool_h
+#define vgl_pixelpool_h
+
+#include <cstddef>
+
+namespace vgl {
+
+//
+// Constants
+//
+
+// Every pixel buffer from allocPixels starts on a boundary of this many bytes,
+// so rows can be loaded with aligned SIMD instructions and don't share cache
+// lines with other allocations.
+static const size_t kPixelAlignment = 64;
+
+
+//
+// Functions
+//
+
+// Pixel buffers are handed out from a pool of size classes (powers of two and
+// the points halfway between them, starting at 4 KiB), so streaming lots of
+// similarly sized images through memory recycles the same few buffers instead
+// of going back to the system allocator every time. Freed buffers are kept
+// until the pool holds more than its limit, after which they're released.
+//
+// These are safe to call from multiple threads.
+
+//! Allocate a buffer of at least the given size. The contents are undefined.
+unsigned char* allocPixels(size_t bytes);
+
+//! Return a buffer from allocPixels to the pool. Does nothing for NULL.
+void freePixels(unsigned char* pixels);
+
+//! The most memory the pool will hold on to in freed buffers. Defaults to
+//! 256 MiB. Lowering it releases any excess straight away.
+void setPixelPoolLimit(size_t bytes);
+size_t getPixelPoolLimit();
+
+//! How much memory is currently sitting in freed buffers.
+size_t getPixelPoolCachedBytes();
+
+//! Release all of the freed buffers back to the system.
+void trimPixelPool();
+
+
+} // namespace vgl
+
+#endif // vgl_pixelpool_h
+
@@ -1,6 +1,7 @@
 #ifndef vgl_plane_h
 #define vgl_plane_h
 
+#include "vgl_ray3.h"
 #include "vgl_vec3.h"
 
 namespace vgl {
@@ -34,6 +35,61 @@ Vec3<Num> planePos(const Plane3<Num>& p, Num u, Num v)
 }
 
 
+// Where a ray crosses the plane. On a hit, t is the distance along the ray
+// and u and v are the plane coordinates of the hit, so that it's at
+// planePos(p, u, v). Rays parallel to the plane miss, as do crossings closer
+// than the same small epsilon as the other ray tests.
+//
+// This is the Moller-Trumbore triangle test with the edges of the triangle
+// replaced by p.u and p.v, leaving out the checks on u and v.
+template <typename Num>
+bool intersectRayPlane(const Ray3<Num>& ray, const Plane3<Num>& p, Num& t, Num& u, Num& v)
+{
+  const Num kMinT = Num(1e-4);
+
+  Vec3<Num> pv = cross(ray.d, p.v);
+  Num det = dot(p.u, pv);
+  if (det == 0)
+    return false;
+
+  Num invDet = 1 / det;
+  Vec3<Num> s = ray.o - p.corner;
+  Vec3<Num> q = cross(s, p.u);
+  t = dot(p.v, q) * invDet;
+  u = dot(s, pv) * invDet;
+  v = dot(ray.d, q) * invDet;
+  return t > kMinT;
+}
+
+
+// The same, but only counting hits on the parallelogram with corners
+// planePos(p, 0, 0) to planePos(p, 1, 1).
+template <typename Num>
+bool intersectRayParallelogram(const Ray3<Num>& ray, const Plane3<Num>& p, Num& t, Num& u, Num& v)
+{
+  const Num kMinT = Num(1e-4);
+
+  Vec3<Num> pv = cross(ray.d, p.v);
+  Num det = dot(p.u, pv);
+  if (det == 0)
+    return false;
+
+  Num invDet = 1 / det;
+  Vec3<Num> s = ray.o - p.corner;
+  u = dot(s, pv) * invDet;
+  if (u < 0 || u > 1)
+    return false;
+
+  Vec3<Num> q = cross(s, p.u);
+  v = dot(ray.d, q) * invDet;
+  if (v < 0 || v > 1)
+    return false;
+
+  t = dot(p.v, q) * invDet;
+  return t > kMinT;
+}
+
+
 } // namespace vgl
 
 #endif // vgl_plane_h
@@ -60,6 +60,20 @@ Quaternion<Num> operator * (const Quaternion<Num>& a, const Quaternion<Num>& b)
 }
 
 
+template <typename Num>
+Quaternion<Num> operator * (const Quaternion<Num>& a, Num k)
+{
+  return Quaternion<Num>(a.v * k, a.s * k);
+}
+
+
+template <typename Num>
+Quaternion<Num> operator * (Num k, const Quaternion<Num>& a)
+{
+  return Quaternion<Num>(a.v * k, a.s * k);
+}
+
+
 template <typename Num>
 Quaternion<Num> operator / (const Quaternion<Num>& a, Num k)
 {
@@ -72,6 +86,7 @@ const Quaternion<Num>& operator += (Quaternion<Num>& a, const Quaternion<Num>& b
 {
   a.v += b.v;
   a.s += b.s;
+  return a;
 }
 
 
@@ -80,6 +95,7 @@ const Quaternion<Num>& operator -= (Quaternion<Num>& a, const Quaternion<Num>& b
 {
   a.v -= b.v;
   a.s -= b.s;
+  return a;
 }
 
 
@@ -87,6 +103,7 @@ template <typename Num>
 const Quaternion<Num>& operator *= (Quaternion<Num>& a, const Quaternion<Num>& b)
 {
   a = a * b;
+  return a;
 }
 
 
@@ -94,6 +111,8 @@ template <typename Num>
 const Quaternion<Num>& operator *= (Quaternion<Num>& a, Num k)
 {
   a.v *= k;
+  a.s *= k;
+  return a;
 }
 
 
@@ -101,6 +120,8 @@ template <typename Num>
 const Quaternion<Num>& operator /= (Quaternion<Num>& a, Num k)
 {
   a.v /= k;
+  a.s /= k;
+  return a;
 }
 
 
@@ -144,8 +165,8 @@ Quaternion<Num> inverse(const Quaternion<Num>& a)
 template <typename Num>
 Quaternion<Num> rotation(const Vec3<Num>& axis, Num angleInRadians)
 {
-  float c = std::cos(angleInRadians / 2);
-  float s = std::sin(angleInRadians / 2);
+  Num c = std::cos(angleInRadians / 2);
+  Num s = std::sin(angleInRadians / 2);
   return Quaternion<Num>(s * norm(axis), c);
 }
 
@@ -166,6 +187,35 @@ Num dot(const Quaternion<Num>& a, const Quaternion<Num>& b)
 }
 
 
+// Normalised linear interpolation between two rotations. Cheaper than slerp
+// but doesn't move at a constant angular speed. Like slerp, it takes the
+// shorter way round, so a and b needn't be in the same hemisphere.
+template <typename Num>
+Quaternion<Num> nlerp(const Quaternion<Num>& a, const Quaternion<Num>& b, Num t)
+{
+  Num tb = (dot(a, b) < 0) ? -t : t;
+  return norm(a * (1 - t) + b * tb);
+}
+
+
+// Spherical linear interpolation between two unit quaternions, for t from 0
+// to 1. Falls back to nlerp when they're so close together that the angle
+// between them can't be worked out accurately.
+template <typename Num>
+Quaternion<Num> slerp(const Quaternion<Num>& a, const Quaternion<Num>& b, Num t)
+{
+  Num d = dot(a, b);
+  Quaternion<Num> c = (d < 0) ? -b : b;
+  d = std::fabs(d);
+  if (d > Num(0.9995))
+    return norm(a * (1 - t) + c * t);
+
+  Num theta = std::acos(d);
+  Num invSin = 1 / std::sin(theta);
+  return a * (std::sin((1 - t) * theta) * invSin) + c * (std::sin(t * theta) * invSin);
+}
+
+
 } // namespace vgl
 
 #endif // vgl_quaternion_h
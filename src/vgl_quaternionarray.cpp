@@ -0,0 +1,605 @@
+#include "vgl_quaternionarray.h"
+
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef VGL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+const size_t QuaternionArray::kAlignment;
+const size_t QuaternionArray::kPadding;
+
+// Arrays are processed in blocks of this many quaternions, one block per
+// OpenMP iteration. It's a multiple of kPadding, so every block but the last
+// is a whole number of vectors.
+static const size_t kBlockSize = 4096;
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static size_t paddedSize(size_t size)
+{
+  return (size + QuaternionArray::kPadding - 1) & ~(QuaternionArray::kPadding - 1);
+}
+
+
+static int numBlocks(size_t size)
+{
+  return int((size + kBlockSize - 1) / kBlockSize);
+}
+
+
+static bool useAVX2()
+{
+#ifdef VGL_SIMD_X86
+  return cpuHasAVX2();
+#else
+  return false;
+#endif
+}
+
+
+static void scalarNorm(const QuaternionArray& a, QuaternionArray& dst, size_t first, size_t last)
+{
+  for (size_t i = first; i < last; ++i) {
+    Quaternionf q = a.get(i);
+    dst.set(i, (dot(q, q) != 0.0f) ? norm(q) : q);
+  }
+}
+
+
+static void scalarNlerp(const QuaternionArray& a, const QuaternionArray& b, float t,
+                        QuaternionArray& dst, size_t first, size_t last)
+{
+  for (size_t i = first; i < last; ++i)
+    dst.set(i, nlerp(a.get(i), b.get(i), t));
+}
+
+
+static void scalarSlerp(const QuaternionArray& a, const QuaternionArray& b, float t,
+                        QuaternionArray& dst, size_t first, size_t last)
+{
+  for (size_t i = first; i < last; ++i)
+    dst.set(i, slerp(a.get(i), b.get(i), t));
+}
+
+
+// v + 2w(u x v) + 2u x (u x v), where u is the vector part of q: the same as
+// q v q* for a unit quaternion, but much less work.
+static void scalarRotate(const QuaternionArray& q, const Vec3Array& src, Vec3Array& dst,
+                         size_t first, size_t last)
+{
+  for (size_t i = first; i < last; ++i) {
+    Quaternionf r = q.get(i);
+    Vec3f v = src.get(i);
+    Vec3f t = cross(r.v, v) * 2.0f;
+    dst.set(i, v + t * r.s + cross(r.v, t));
+  }
+}
+
+
+static void scalarRotationMatrices(const QuaternionArray& q, Matrix4f* dst, size_t first, size_t last)
+{
+  for (size_t i = first; i < last; ++i)
+    dst[i] = rotationMatrix(q.get(i));
+}
+
+
+#ifdef VGL_SIMD_X86
+
+//
+// AVX2 kernels
+//
+// These run from first up to the padded end of the block, 8 at a time.
+//
+
+VGL_TARGET("avx2")
+static inline __m256 avx2Dot(const __m256 a[4], const __m256 b[4])
+{
+  __m256 sum = _mm256_mul_ps(a[0], b[0]);
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(a[1], b[1]));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(a[2], b[2]));
+  return _mm256_add_ps(sum, _mm256_mul_ps(a[3], b[3]));
+}
+
+
+VGL_TARGET("avx2")
+static inline void avx2Load(const QuaternionArray& a, size_t i, __m256 q[4])
+{
+  q[0] = _mm256_load_ps(a.getX() + i);
+  q[1] = _mm256_load_ps(a.getY() + i);
+  q[2] = _mm256_load_ps(a.getZ() + i);
+  q[3] = _mm256_load_ps(a.getW() + i);
+}
+
+
+// Zero length quaternions, which includes the padding, are stored as zero
+// rather than NaN.
+VGL_TARGET("avx2")
+static inline void avx2StoreNormalised(QuaternionArray& dst, size_t i, const __m256 q[4])
+{
+  __m256 lenSqr = avx2Dot(q, q);
+  __m256 inv = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lenSqr)),
+      _mm256_cmp_ps(lenSqr, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+  _mm256_store_ps(dst.getX() + i, _mm256_mul_ps(q[0], inv));
+  _mm256_store_ps(dst.getY() + i, _mm256_mul_ps(q[1], inv));
+  _mm256_store_ps(dst.getZ() + i, _mm256_mul_ps(q[2], inv));
+  _mm256_store_ps(dst.getW() + i, _mm256_mul_ps(q[3], inv));
+}
+
+
+// acos(x) for x in [0, 1], from Abramowitz and Stegun 4.4.46: absolute error
+// is under 2e-8, i.e. below float precision.
+VGL_TARGET("avx2")
+static inline __m256 avx2Acos(__m256 x)
+{
+  __m256 p = _mm256_set1_ps(-0.0012624911f);
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(0.0066700901f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(-0.0170881256f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(0.0308918810f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(-0.0501743046f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(0.0889789874f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(-0.2145988016f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x), _mm256_set1_ps(1.5707963050f));
+  return _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), x)));
+}
+
+
+// sin(x) for x in [0, pi/2], by its Taylor series up to x^11; the first term
+// left out is under 6e-8 over that range.
+VGL_TARGET("avx2")
+static inline __m256 avx2Sin(__m256 x)
+{
+  __m256 x2 = _mm256_mul_ps(x, x);
+  __m256 p = _mm256_set1_ps(-1.0f / 39916800.0f);
+  p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f / 362880.0f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.0f / 5040.0f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f / 120.0f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.0f / 6.0f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f));
+  return _mm256_mul_ps(p, x);
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Norm(const QuaternionArray& a, QuaternionArray& dst, size_t first, size_t last)
+{
+  size_t end = paddedSize(last);
+  for (size_t i = first; i < end; i += 8) {
+    __m256 q[4];
+    avx2Load(a, i, q);
+    avx2StoreNormalised(dst, i, q);
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Nlerp(const QuaternionArray& a, const QuaternionArray& b, float t,
+                      QuaternionArray& dst, size_t first, size_t last)
+{
+  size_t end = paddedSize(last);
+  __m256 ta = _mm256_set1_ps(1.0f - t);
+  __m256 tb = _mm256_set1_ps(t);
+  __m256 negTb = _mm256_set1_ps(-t);
+  for (size_t i = first; i < end; i += 8) {
+    __m256 qa[4], qb[4], q[4];
+    avx2Load(a, i, qa);
+    avx2Load(b, i, qb);
+    // Negative t for b where the dot product is negative (has its sign bit
+    // set), so that it goes the shorter way round.
+    __m256 kb = _mm256_blendv_ps(tb, negTb, avx2Dot(qa, qb));
+    for (unsigned int c = 0; c < 4; ++c)
+      q[c] = _mm256_add_ps(_mm256_mul_ps(qa[c], ta), _mm256_mul_ps(qb[c], kb));
+    avx2StoreNormalised(dst, i, q);
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Slerp(const QuaternionArray& a, const QuaternionArray& b, float t,
+                      QuaternionArray& dst, size_t first, size_t last)
+{
+  size_t end = paddedSize(last);
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  const __m256 threshold = _mm256_set1_ps(0.9995f);
+  const __m256 tv = _mm256_set1_ps(t);
+  const __m256 oneMinusT = _mm256_set1_ps(1.0f - t);
+  for (size_t i = first; i < end; i += 8) {
+    __m256 qa[4], qb[4], q[4];
+    avx2Load(a, i, qa);
+    avx2Load(b, i, qb);
+
+    // Flip b into the same hemisphere as a, as in the scalar slerp.
+    __m256 d = avx2Dot(qa, qb);
+    __m256 sign = _mm256_and_ps(d, signBit);
+    for (unsigned int c = 0; c < 4; ++c)
+      qb[c] = _mm256_xor_ps(qb[c], sign);
+    d = _mm256_andnot_ps(signBit, d);
+
+    // Where the angle is tiny, use the nlerp weights instead; they'd be
+    // divided by (nearly) zero otherwise. That includes any padding lanes.
+    __m256 theta = avx2Acos(_mm256_min_ps(d, _mm256_set1_ps(1.0f)));
+    __m256 invSin = _mm256_div_ps(_mm256_set1_ps(1.0f), avx2Sin(theta));
+    __m256 ka = _mm256_mul_ps(avx2Sin(_mm256_mul_ps(oneMinusT, theta)), invSin);
+    __m256 kb = _mm256_mul_ps(avx2Sin(_mm256_mul_ps(tv, theta)), invSin);
+    __m256 close = _mm256_cmp_ps(d, threshold, _CMP_GT_OQ);
+    ka = _mm256_blendv_ps(ka, oneMinusT, close);
+    kb = _mm256_blendv_ps(kb, tv, close);
+
+    for (unsigned int c = 0; c < 4; ++c)
+      q[c] = _mm256_add_ps(_mm256_mul_ps(qa[c], ka), _mm256_mul_ps(qb[c], kb));
+    avx2StoreNormalised(dst, i, q);
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Rotate(const QuaternionArray& q, const Vec3Array& src, Vec3Array& dst,
+                       size_t first, size_t last)
+{
+  size_t end = paddedSize(last);
+  const float* in[3] = { src.getX(), src.getY(), src.getZ() };
+  float* out[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  const __m256 two = _mm256_set1_ps(2.0f);
+  for (size_t i = first; i < end; i += 8) {
+    __m256 r[4];
+    avx2Load(q, i, r);
+    __m256 vx = _mm256_load_ps(in[0] + i), vy = _mm256_load_ps(in[1] + i), vz = _mm256_load_ps(in[2] + i);
+
+    // t = 2 (u x v)
+    __m256 tx = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(r[1], vz), _mm256_mul_ps(r[2], vy)));
+    __m256 ty = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(r[2], vx), _mm256_mul_ps(r[0], vz)));
+    __m256 tz = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(r[0], vy), _mm256_mul_ps(r[1], vx)));
+
+    // v + w t + u x t
+    vx = _mm256_add_ps(_mm256_add_ps(vx, _mm256_mul_ps(r[3], tx)),
+                       _mm256_sub_ps(_mm256_mul_ps(r[1], tz), _mm256_mul_ps(r[2], ty)));
+    vy = _mm256_add_ps(_mm256_add_ps(vy, _mm256_mul_ps(r[3], ty)),
+                       _mm256_sub_ps(_mm256_mul_ps(r[2], tx), _mm256_mul_ps(r[0], tz)));
+    vz = _mm256_add_ps(_mm256_add_ps(vz, _mm256_mul_ps(r[3], tz)),
+                       _mm256_sub_ps(_mm256_mul_ps(r[0], ty), _mm256_mul_ps(r[1], tx)));
+    _mm256_store_ps(out[0] + i, vx);
+    _mm256_store_ps(out[1] + i, vy);
+    _mm256_store_ps(out[2] + i, vz);
+  }
+}
+
+
+// Stores row k of eight matrices, given its three entries for each of them.
+// A 4x4 transpose within each 128 bit half turns (a, b, c, 0) for quaternions
+// 0-3 and 4-7 into a row apiece.
+VGL_TARGET("avx2")
+static inline void avx2StoreRows(Matrix4f* dst, unsigned int k, __m256 a, __m256 b, __m256 c)
+{
+  __m256 zero = _mm256_setzero_ps();
+  __m256 t0 = _mm256_unpacklo_ps(a, b), t1 = _mm256_unpackhi_ps(a, b);
+  __m256 t2 = _mm256_unpacklo_ps(c, zero), t3 = _mm256_unpackhi_ps(c, zero);
+  __m256 rows[4] = {
+    _mm256_shuffle_ps(t0, t2, 0x44), _mm256_shuffle_ps(t0, t2, 0xEE),
+    _mm256_shuffle_ps(t1, t3, 0x44), _mm256_shuffle_ps(t1, t3, 0xEE)
+  };
+  for (unsigned int j = 0; j < 4; ++j) {
+    _mm_storeu_ps(dst[j].rows[k], _mm256_castps256_ps128(rows[j]));
+    _mm_storeu_ps(dst[j + 4].rows[k], _mm256_extractf128_ps(rows[j], 1));
+  }
+}
+
+
+// Eight at a time, with any leftovers (there's no padding in dst) done by the
+// scalar code.
+VGL_TARGET("avx2")
+static void avx2RotationMatrices(const QuaternionArray& q, Matrix4f* dst, size_t first, size_t last)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m128 bottom = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+  size_t i = first;
+  for (; i + 8 <= last; i += 8) {
+    __m256 r[4];
+    avx2Load(q, i, r);
+    __m256 x2 = _mm256_mul_ps(r[0], two), y2 = _mm256_mul_ps(r[1], two), z2 = _mm256_mul_ps(r[2], two);
+    __m256 xx = _mm256_mul_ps(r[0], x2), yy = _mm256_mul_ps(r[1], y2), zz = _mm256_mul_ps(r[2], z2);
+    __m256 xy = _mm256_mul_ps(r[0], y2), xz = _mm256_mul_ps(r[0], z2), yz = _mm256_mul_ps(r[1], z2);
+    __m256 wx = _mm256_mul_ps(r[3], x2), wy = _mm256_mul_ps(r[3], y2), wz = _mm256_mul_ps(r[3], z2);
+
+    avx2StoreRows(dst + i, 0, _mm256_sub_ps(one, _mm256_add_ps(yy, zz)),
+                  _mm256_sub_ps(xy, wz), _mm256_add_ps(xz, wy));
+    avx2StoreRows(dst + i, 1, _mm256_add_ps(xy, wz),
+                  _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_sub_ps(yz, wx));
+    avx2StoreRows(dst + i, 2, _mm256_sub_ps(xz, wy),
+                  _mm256_add_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)));
+    for (unsigned int j = 0; j < 8; ++j)
+      _mm_storeu_ps(dst[i + j].rows[3], bottom);
+  }
+  scalarRotationMatrices(q, dst, i, last);
+}
+
+#endif // VGL_SIMD_X86
+
+
+//
+// QuaternionArray METHODS
+//
+
+QuaternionArray::QuaternionArray() :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+}
+
+
+QuaternionArray::QuaternionArray(size_t size) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  resize(size);
+}
+
+
+QuaternionArray::QuaternionArray(const std::vector<Quaternionf>& src) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  fromVector(src);
+}
+
+
+QuaternionArray::QuaternionArray(const QuaternionArray& other) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  *this = other;
+}
+
+
+QuaternionArray::~QuaternionArray()
+{
+  free(_data);
+}
+
+
+QuaternionArray& QuaternionArray::operator = (const QuaternionArray& other)
+{
+  if (this != &other) {
+    resize(other._size);
+    for (unsigned int c = 0; c < 4; ++c)
+      memcpy(_data + c * _capacity, other._data + c * other._capacity, _size * sizeof(float));
+  }
+  return *this;
+}
+
+
+size_t QuaternionArray::getSize() const
+{
+  return _size;
+}
+
+
+void QuaternionArray::resize(size_t size)
+{
+  size_t capacity = paddedSize(size);
+  if (capacity > _capacity) {
+    void* mem = NULL;
+    if (posix_memalign(&mem, kAlignment, capacity * 4 * sizeof(float)) != 0)
+      throw std::bad_alloc();
+    float* data = (float*)mem;
+    // Zeroed for the same reason as in Vec3Array.
+    memset(data, 0, capacity * 4 * sizeof(float));
+    for (unsigned int c = 0; c < 4 && _data != NULL; ++c)
+      memcpy(data + c * capacity, _data + c * _capacity, _size * sizeof(float));
+    free(_data);
+    _data = data;
+    _capacity = capacity;
+  }
+  _size = size;
+}
+
+
+float* QuaternionArray::getX()
+{
+  return _data;
+}
+
+
+float* QuaternionArray::getY()
+{
+  return _data + _capacity;
+}
+
+
+float* QuaternionArray::getZ()
+{
+  return _data + _capacity * 2;
+}
+
+
+float* QuaternionArray::getW()
+{
+  return _data + _capacity * 3;
+}
+
+
+const float* QuaternionArray::getX() const
+{
+  return _data;
+}
+
+
+const float* QuaternionArray::getY() const
+{
+  return _data + _capacity;
+}
+
+
+const float* QuaternionArray::getZ() const
+{
+  return _data + _capacity * 2;
+}
+
+
+const float* QuaternionArray::getW() const
+{
+  return _data + _capacity * 3;
+}
+
+
+Quaternionf QuaternionArray::get(size_t i) const
+{
+  return Quaternionf(_data[i], _data[_capacity + i], _data[_capacity * 2 + i], _data[_capacity * 3 + i]);
+}
+
+
+void QuaternionArray::set(size_t i, const Quaternionf& q)
+{
+  _data[i] = q.v.x;
+  _data[_capacity + i] = q.v.y;
+  _data[_capacity * 2 + i] = q.v.z;
+  _data[_capacity * 3 + i] = q.s;
+}
+
+
+void QuaternionArray::fromVector(const std::vector<Quaternionf>& src)
+{
+  resize(src.size());
+  for (size_t i = 0; i < _size; ++i)
+    set(i, src[i]);
+}
+
+
+void QuaternionArray::toVector(std::vector<Quaternionf>& dst) const
+{
+  dst.resize(_size);
+  for (size_t i = 0; i < _size; ++i)
+    dst[i] = get(i);
+}
+
+
+//
+// FUNCTIONS
+//
+
+void norm(const QuaternionArray& a, QuaternionArray& dst)
+{
+  dst.resize(a.getSize());
+  bool simd = useAVX2();
+  int blocks = numBlocks(a.getSize());
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    size_t last = std::min(first + kBlockSize, a.getSize());
+#ifdef VGL_SIMD_X86
+    if (simd) {
+      avx2Norm(a, dst, first, last);
+      continue;
+    }
+#endif
+    scalarNorm(a, dst, first, last);
+  }
+}
+
+
+void nlerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& dst)
+{
+  dst.resize(a.getSize());
+  bool simd = useAVX2();
+  int blocks = numBlocks(a.getSize());
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    size_t last = std::min(first + kBlockSize, a.getSize());
+#ifdef VGL_SIMD_X86
+    if (simd) {
+      avx2Nlerp(a, b, t, dst, first, last);
+      continue;
+    }
+#endif
+    scalarNlerp(a, b, t, dst, first, last);
+  }
+}
+
+
+void slerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& dst)
+{
+  dst.resize(a.getSize());
+  bool simd = useAVX2();
+  int blocks = numBlocks(a.getSize());
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    size_t last = std::min(first + kBlockSize, a.getSize());
+#ifdef VGL_SIMD_X86
+    if (simd) {
+      avx2Slerp(a, b, t, dst, first, last);
+      continue;
+    }
+#endif
+    scalarSlerp(a, b, t, dst, first, last);
+  }
+}
+
+
+void rotate(const QuaternionArray& q, const Vec3Array& src, Vec3Array& dst)
+{
+  dst.resize(q.getSize());
+  bool simd = useAVX2();
+  int blocks = numBlocks(q.getSize());
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    size_t last = std::min(first + kBlockSize, q.getSize());
+#ifdef VGL_SIMD_X86
+    if (simd) {
+      avx2Rotate(q, src, dst, first, last);
+      continue;
+    }
+#endif
+    scalarRotate(q, src, dst, first, last);
+  }
+}
+
+
+void rotate(const Quaternionf& q, const Vec3Array& src, Vec3Array& dst)
+{
+  transformPoints(rotationMatrix(q), src, dst);
+}
+
+
+void rotationMatrices(const QuaternionArray& q, Matrix4f* dst)
+{
+  bool simd = useAVX2();
+  int blocks = numBlocks(q.getSize());
+  #pragma omp parallel for if (blocks > 1)
+  for (int block = 0; block < blocks; ++block) {
+    size_t first = block * kBlockSize;
+    size_t last = std::min(first + kBlockSize, q.getSize());
+#ifdef VGL_SIMD_X86
+    if (simd) {
+      avx2RotationMatrices(q, dst, first, last);
+      continue;
+    }
+#endif
+    scalarRotationMatrices(q, dst, first, last);
+  }
+}
+
+
+} // namespace vgl
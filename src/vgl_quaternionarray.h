@@ -0,0 +1,94 @@
+#ifndef vgl_quaternionarray_h
+#define vgl_quaternionarray_h
+
+#include "vgl_matrix4.h"
+#include "vgl_quaternion.h"
+#include "vgl_vec3array.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace vgl {
+
+//
+// Types
+//
+
+// An array of Quaternionfs stored as structure-of-arrays, laid out the same
+// way as Vec3Array: separate x, y, z and w (the scalar part) arrays, each
+// 64 byte aligned and padded to a multiple of 16 floats.
+class QuaternionArray {
+public:
+  static const size_t kAlignment = 64;
+  static const size_t kPadding = 16;
+
+  QuaternionArray();
+  explicit QuaternionArray(size_t size);
+  explicit QuaternionArray(const std::vector<Quaternionf>& src);
+  QuaternionArray(const QuaternionArray& other);
+  ~QuaternionArray();
+
+  QuaternionArray& operator = (const QuaternionArray& other);
+
+  size_t getSize() const;
+  //! Keeps the existing values up to the new size; new values are undefined.
+  //! Doesn't reallocate unless the array grows past its capacity.
+  void resize(size_t size);
+
+  float* getX();
+  float* getY();
+  float* getZ();
+  float* getW();
+  const float* getX() const;
+  const float* getY() const;
+  const float* getZ() const;
+  const float* getW() const;
+
+  Quaternionf get(size_t i) const;
+  void set(size_t i, const Quaternionf& q);
+
+  void fromVector(const std::vector<Quaternionf>& src);
+  void toVector(std::vector<Quaternionf>& dst) const;
+
+private:
+  size_t _size;
+  size_t _capacity; // Padded length of each component array.
+  float* _data;     // The x array, followed by y, z and then w.
+};
+
+
+//
+// Functions
+//
+
+// Bulk operations on whole arrays. Each has an AVX2 kernel, used when the CPU
+// supports it, and a scalar fallback; big arrays are split into blocks which
+// are processed in parallel with OpenMP.
+//
+// dst is resized to match the first input and may be the same array as
+// either input. Where there are two inputs, b must be at least as long as a.
+// Except for norm, the quaternions are all assumed to be unit length.
+
+//! Quaternions of zero length stay zero.
+void norm(const QuaternionArray& a, QuaternionArray& dst);
+
+//! Blends each pair with the same weight, as the single quaternion versions
+//! do. The SIMD slerp uses polynomial approximations to acos and sin, which
+//! are accurate to within a few float ulps for t between 0 and 1.
+void nlerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& dst);
+void slerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& dst);
+
+//! Rotates each point by the quaternion at the same index.
+void rotate(const QuaternionArray& q, const Vec3Array& src, Vec3Array& dst);
+
+//! Rotates every point by the same quaternion.
+void rotate(const Quaternionf& q, const Vec3Array& src, Vec3Array& dst);
+
+//! The same as calling rotationMatrix on each element. dst must have room for
+//! q.getSize() matrices.
+void rotationMatrices(const QuaternionArray& q, Matrix4f* dst);
+
+
+} // namespace vgl
+
+#endif // vgl_quaternionarray_h
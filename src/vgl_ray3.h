@@ -1,9 +1,11 @@
 #ifndef vgl_ray_h
 #define vgl_ray_h
 
+#include "vgl_simd.h"
 #include "vgl_vec3.h"
 #include "vgl_utils.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace vgl {
@@ -54,32 +56,137 @@ Ray3<Num> refract(const Ray3<Num>& r, const Vec3<Num>& hitpos, const Vec3<Num>&
 }
 
 
+// On a hit, t is the distance along the ray (in multiples of ray.d) to the
+// nearer intersection in front of the origin. Intersections closer than a
+// small epsilon are ignored, so that rays leaving the surface don't hit it
+// again straight away.
 template <typename Num>
-bool intersectRaySphere(const Ray3<Num>& ray, const Vec3<Num>& sphereCenter, Num sphereRadius, Vec3<Num>& hitPoint)
+bool intersectRaySphere(const Ray3<Num>& ray, const Vec3<Num>& sphereCenter, Num sphereRadius, Num& t)
 {
-  const Num kMinT = 1e-4;
-  const Num kMaxT = 1e10;
+  const Num kMinT = Num(1e-4);
+  const Num kMaxT = Num(1e10);
+
+  Vec3<Num> m(ray.o - sphereCenter);
+
+  Num a = dot(ray.d, ray.d);
+  Num b = 2 * dot(ray.d, m);
+  Num c = dot(m, m) - sphereRadius * sphereRadius;
 
-	Vec3<Num> m(ray.o - sphereCenter);
+  Num discriminant = b * b - 4 * a * c;
+  if (discriminant <= 0)
+    return false;
+
+  Num sqrtDiscriminant = std::sqrt(discriminant);
+  t = (-b - sqrtDiscriminant) / (2 * a);
+  if (t < kMinT)
+    t = (-b + sqrtDiscriminant) / (2 * a);
+  return t >= kMinT && t <= kMaxT;
+}
+
+
+template <typename Num>
+bool intersectRaySphere(const Ray3<Num>& ray, const Vec3<Num>& sphereCenter, Num sphereRadius, Vec3<Num>& hitPoint)
+{
+  Num t;
+  if (!intersectRaySphere(ray, sphereCenter, sphereRadius, t))
+    return false;
+  hitPoint = evaluate(ray, t);
+  return true;
+}
 
-	Num a = dot(ray.d, ray.d);
-	Num b = 2 * dot(ray.d, m);
-	Num c = dot(m, m) - sphereRadius * sphereRadius;
 
-	Num discriminant = b * b - 4 * a * c;
-	if (discriminant > 0) {
-		float sqrt_discriminant = std::sqrt(discriminant);
-		float t = (-b - sqrt_discriminant) / (2 * a);
-		if (t < kMinT)
-			t = (-b + sqrt_discriminant) / (2 * a);
-		if (t < kMinT || t > kMaxT)
-			return false;
+// Moller-Trumbore ray/triangle test. Both sides of the triangle count. On a
+// hit, t is the distance along the ray and u and v are the barycentric
+// weights of v1 and v2, so the hit point is (1 - u - v) v0 + u v1 + v v2.
+template <typename Num>
+bool intersectRayTriangle(const Ray3<Num>& ray, const Vec3<Num>& v0, const Vec3<Num>& v1, const Vec3<Num>& v2,
+                          Num& t, Num& u, Num& v)
+{
+  const Num kMinT = Num(1e-4);
+
+  Vec3<Num> e1 = v1 - v0;
+  Vec3<Num> e2 = v2 - v0;
+  Vec3<Num> p = cross(ray.d, e2);
+  Num det = dot(e1, p);
+  if (det == 0)
+    return false;
+
+  Num invDet = 1 / det;
+  Vec3<Num> s = ray.o - v0;
+  u = dot(s, p) * invDet;
+  if (u < 0 || u > 1)
+    return false;
+
+  Vec3<Num> q = cross(s, e1);
+  v = dot(ray.d, q) * invDet;
+  if (v < 0 || u + v > 1)
+    return false;
+
+  t = dot(e2, q) * invDet;
+  return t > kMinT;
+}
 
-    hitPoint = evaluate(ray, t);
-		return true;
-	}
 
-	return false;
+// The watertight ray/triangle test from Woop, Benthin and Wald, "Watertight
+// Ray/Triangle Intersection" (JCGT 2013). The triangle is transformed into a
+// space where the ray runs along +z from the origin, and the 2D edge
+// functions are then evaluated in a way that's consistent for an edge shared
+// by two triangles, so a ray can't slip through the crack between them. It's
+// a bit slower than Moller-Trumbore. Outputs are as for intersectRayTriangle.
+//
+// This leaves out the paper's fallback to double precision for edge functions
+// which come out as exactly zero; edges count as inside, so such rays hit
+// both triangles rather than neither.
+//
+// The guarantee only holds if the products in each edge function are rounded
+// before they're subtracted, so this is never compiled with FMAs, even when
+// the code including it is.
+template <typename Num>
+VGL_NO_FP_CONTRACT
+bool intersectRayTriangleWatertight(const Ray3<Num>& ray, const Vec3<Num>& v0, const Vec3<Num>& v1, const Vec3<Num>& v2,
+                                    Num& t, Num& u, Num& v)
+{
+#ifdef __clang__
+  #pragma STDC FP_CONTRACT OFF
+#endif
+  const Num kMinT = Num(1e-4);
+
+  // The largest component of the direction becomes z. x and y are swapped
+  // when it's negative, to keep the winding the same.
+  unsigned int kz = maxIndex(Vec3<Num>(std::fabs(ray.d.x), std::fabs(ray.d.y), std::fabs(ray.d.z)));
+  unsigned int kx = (kz + 1) % 3;
+  unsigned int ky = (kx + 1) % 3;
+  if (ray.d[kz] < 0)
+    std::swap(kx, ky);
+
+  Num sz = 1 / ray.d[kz];
+  Num sx = ray.d[kx] * sz;
+  Num sy = ray.d[ky] * sz;
+
+  Vec3<Num> a = v0 - ray.o;
+  Vec3<Num> b = v1 - ray.o;
+  Vec3<Num> c = v2 - ray.o;
+  Num ax = a[kx] - sx * a[kz], ay = a[ky] - sy * a[kz];
+  Num bx = b[kx] - sx * b[kz], by = b[ky] - sy * b[kz];
+  Num cx = c[kx] - sx * c[kz], cy = c[ky] - sy * c[kz];
+
+  // The edge functions, which are the unnormalised barycentrics of v0, v1
+  // and v2. The ray misses unless they all have the same sign.
+  Num eu = cx * by - cy * bx;
+  Num ev = ax * cy - ay * cx;
+  Num ew = bx * ay - by * ax;
+  if ((eu < 0 || ev < 0 || ew < 0) && (eu > 0 || ev > 0 || ew > 0))
+    return false;
+
+  Num det = eu + ev + ew;
+  if (det == 0)
+    return false;
+
+  Num invDet = 1 / det;
+  t = (eu * a[kz] + ev * b[kz] + ew * c[kz]) * sz * invDet;
+  u = ev * invDet;
+  v = ew * invDet;
+  return t > kMinT;
 }
 
 
@@ -0,0 +1,947 @@
+#include "vgl_raypacket.h"
+
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef VGL_SIMD_SSE2
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+// The same limits as the single ray tests use.
+static const float kMinT = 1e-4f;
+static const float kMaxSphereT = 1e10f;
+
+
+//
+// TYPES
+//
+
+// A run of lanes from a packet. The kernels work through a packet a register
+// at a time, each getting a Lanes which starts at the first ray it should
+// look at.
+struct Lanes {
+  const float* o[3];
+  const float* d[3];
+  const float* tMax;
+  float* tOut; // Where the new tMax values go; NULL for the box test.
+  float* u;    // Barycentrics, for the triangle tests only.
+  float* v;
+};
+
+
+struct SphereArgs {
+  Vec3f center;
+  float radius;
+};
+
+
+struct TriangleArgs {
+  Vec3f v0, v1, v2;
+};
+
+
+// The kernels for one kind of test, for each register width. Each gets the
+// active mask for its own lanes, starting from bit 0, and returns the hits
+// the same way.
+template <typename Args>
+struct KernelSet {
+  typedef unsigned int (*Kernel)(const Lanes& lanes, unsigned int active, const Args& args);
+  Kernel k1, k4, k8, k16;
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static unsigned int pickWidth()
+{
+#ifdef VGL_SIMD_SSE2
+  if (cpuHasAVX512F())
+    return 16;
+  if (cpuHasAVX())
+    return 8;
+  return 4;
+#else
+  return 1;
+#endif
+}
+
+
+// Called for every packet test, so it's worth not asking the CPU each time.
+static unsigned int widestKernel()
+{
+  static const unsigned int width = pickWidth();
+  return width;
+}
+
+
+template <unsigned int N>
+static Lanes packetLanes(const RayPacket<N>& rays, float* tOut, float* u, float* v)
+{
+  Lanes lanes;
+  lanes.o[0] = rays.ox;
+  lanes.o[1] = rays.oy;
+  lanes.o[2] = rays.oz;
+  lanes.d[0] = rays.dx;
+  lanes.d[1] = rays.dy;
+  lanes.d[2] = rays.dz;
+  lanes.tMax = rays.tMax;
+  lanes.tOut = tOut;
+  lanes.u = u;
+  lanes.v = v;
+  return lanes;
+}
+
+
+static Lanes offsetLanes(const Lanes& lanes, unsigned int first)
+{
+  Lanes result = lanes;
+  for (unsigned int c = 0; c < 3; ++c) {
+    result.o[c] += first;
+    result.d[c] += first;
+  }
+  result.tMax += first;
+  if (result.tOut != NULL)
+    result.tOut += first;
+  if (result.u != NULL) {
+    result.u += first;
+    result.v += first;
+  }
+  return result;
+}
+
+
+// Runs the widest kernel that both the CPU and the packet allow over each
+// group of lanes in turn, skipping groups with nothing active. Usually the
+// whole packet fits in one register, which is worth a shortcut since the
+// tests themselves are only a few dozen instructions.
+template <typename Args>
+static unsigned int runKernels(const KernelSet<Args>& kernels, const Lanes& lanes, unsigned int size,
+                               unsigned int active, const Args& args)
+{
+  unsigned int width = std::min(size, widestKernel());
+  typename KernelSet<Args>::Kernel kernel = kernels.k1;
+  if (width == 16)
+    kernel = kernels.k16;
+  else if (width == 8)
+    kernel = kernels.k8;
+  else if (width == 4)
+    kernel = kernels.k4;
+
+  if (width == size)
+    return (active != 0) ? kernel(lanes, active, args) : 0;
+
+  unsigned int widthMask = (1u << width) - 1;
+  unsigned int hits = 0;
+  for (unsigned int first = 0; first < size; first += width) {
+    unsigned int groupActive = (active >> first) & widthMask;
+    if (groupActive != 0)
+      hits |= kernel(offsetLanes(lanes, first), groupActive, args) << first;
+  }
+  return hits;
+}
+
+
+//
+// Scalar kernels
+//
+// These do a single ray using the code from vgl_ray3.h and vgl_aabb3.h.
+//
+
+static Ray3f laneRay(const Lanes& lanes)
+{
+  return Ray3f(Vec3f(lanes.o[0][0], lanes.o[1][0], lanes.o[2][0]),
+               Vec3f(lanes.d[0][0], lanes.d[1][0], lanes.d[2][0]));
+}
+
+
+static unsigned int scalarSphere(const Lanes& lanes, unsigned int /*active*/, const SphereArgs& args)
+{
+  float t;
+  if (!intersectRaySphere(laneRay(lanes), args.center, args.radius, t) || !(t < lanes.tMax[0]))
+    return 0;
+  lanes.tOut[0] = t;
+  return 1;
+}
+
+
+static unsigned int scalarBox(const Lanes& lanes, unsigned int /*active*/, const AABB3f& box)
+{
+  float tNear, tFar;
+  return (intersectRayBox(laneRay(lanes), box, tNear, tFar) && tNear < lanes.tMax[0]) ? 1 : 0;
+}
+
+
+static unsigned int scalarTriangle(const Lanes& lanes, unsigned int /*active*/, const TriangleArgs& args)
+{
+  float t, u, v;
+  if (!intersectRayTriangle(laneRay(lanes), args.v0, args.v1, args.v2, t, u, v) || !(t < lanes.tMax[0]))
+    return 0;
+  lanes.tOut[0] = t;
+  lanes.u[0] = u;
+  lanes.v[0] = v;
+  return 1;
+}
+
+
+static unsigned int scalarTriangleWatertight(const Lanes& lanes, unsigned int /*active*/, const TriangleArgs& args)
+{
+  float t, u, v;
+  if (!intersectRayTriangleWatertight(laneRay(lanes), args.v0, args.v1, args.v2, t, u, v) || !(t < lanes.tMax[0]))
+    return 0;
+  lanes.tOut[0] = t;
+  lanes.u[0] = u;
+  lanes.v[0] = v;
+  return 1;
+}
+
+
+#ifdef VGL_SIMD_SSE2
+
+//
+// SSE kernels
+//
+
+// a where mask is set, b elsewhere.
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+
+// Expands the low 4 bits of a hit mask into a lane mask.
+static inline __m128 laneMask4(unsigned int bits)
+{
+  const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+  return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(int(bits)), lanes), lanes));
+}
+
+
+static inline void load4(const float* const src[3], __m128 dst[3])
+{
+  for (unsigned int c = 0; c < 3; ++c)
+    dst[c] = _mm_loadu_ps(src[c]);
+}
+
+
+// Stores value into the lanes of dst whose bits are set.
+static inline void store4(float* dst, unsigned int bits, __m128 value)
+{
+  _mm_storeu_ps(dst, select4(laneMask4(bits), value, _mm_loadu_ps(dst)));
+}
+
+
+// Reorders x, y and z per lane for the watertight test, as described there.
+static inline void permute4(const __m128 v[3], __m128 zIsX, __m128 zIsY, __m128 swapXY, __m128 out[3])
+{
+  __m128 x = select4(zIsX, v[1], select4(zIsY, v[2], v[0]));
+  __m128 y = select4(zIsX, v[2], select4(zIsY, v[0], v[1]));
+  out[0] = select4(swapXY, y, x);
+  out[1] = select4(swapXY, x, y);
+  out[2] = select4(zIsX, v[0], select4(zIsY, v[1], v[2]));
+}
+
+
+static unsigned int sseSphere(const Lanes& lanes, unsigned int active, const SphereArgs& args)
+{
+  __m128 o[3], d[3], m[3];
+  load4(lanes.o, o);
+  load4(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c)
+    m[c] = _mm_sub_ps(o[c], _mm_set1_ps(args.center[c]));
+
+  __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+  __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], m[0]), _mm_mul_ps(d[1], m[1])), _mm_mul_ps(d[2], m[2]));
+  __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], m[0]), _mm_mul_ps(m[1], m[1])), _mm_mul_ps(m[2], m[2]));
+  c = _mm_sub_ps(c, _mm_set1_ps(args.radius * args.radius));
+
+  // The half-b form of the quadratic formula.
+  __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+  __m128 hit = _mm_cmpgt_ps(discriminant, _mm_setzero_ps());
+  // Most rays miss most objects, so it's worth stopping here if they all do.
+  if ((_mm_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+  __m128 invA = _mm_div_ps(_mm_set1_ps(1.0f), a);
+  __m128 minusB = _mm_sub_ps(_mm_setzero_ps(), b);
+  __m128 tNear = _mm_mul_ps(_mm_sub_ps(minusB, root), invA);
+  __m128 tFar = _mm_mul_ps(_mm_add_ps(minusB, root), invA);
+  __m128 t = select4(_mm_cmplt_ps(tNear, _mm_set1_ps(kMinT)), tFar, tNear);
+
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(t, _mm_set1_ps(kMinT)));
+  hit = _mm_and_ps(hit, _mm_cmple_ps(t, _mm_set1_ps(kMaxSphereT)));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_loadu_ps(lanes.tMax)));
+
+  unsigned int bits = unsigned(_mm_movemask_ps(hit)) & active;
+  if (bits != 0)
+    store4(lanes.tOut, bits, t);
+  return bits;
+}
+
+
+static unsigned int sseBox(const Lanes& lanes, unsigned int active, const AABB3f& box)
+{
+  __m128 o[3], d[3];
+  load4(lanes.o, o);
+  load4(lanes.d, d);
+
+  __m128 tNear = _mm_set1_ps(-HUGE_VALF);
+  __m128 tFar = _mm_set1_ps(HUGE_VALF);
+  for (unsigned int c = 0; c < 3; ++c) {
+    __m128 invD = _mm_div_ps(_mm_set1_ps(1.0f), d[c]);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.low[c]), o[c]), invD);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.high[c]), o[c]), invD);
+    tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+    tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+  }
+
+  __m128 hit = _mm_cmple_ps(tNear, tFar);
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(tFar, _mm_setzero_ps()));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(tNear, _mm_loadu_ps(lanes.tMax)));
+  return unsigned(_mm_movemask_ps(hit)) & active;
+}
+
+
+static unsigned int sseTriangle(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  Vec3f edge1 = args.v1 - args.v0, edge2 = args.v2 - args.v0;
+  __m128 o[3], d[3], e1[3], e2[3], s[3];
+  load4(lanes.o, o);
+  load4(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c) {
+    e1[c] = _mm_set1_ps(edge1[c]);
+    e2[c] = _mm_set1_ps(edge2[c]);
+    s[c] = _mm_sub_ps(o[c], _mm_set1_ps(args.v0[c]));
+  }
+
+  // p = d x e2.
+  __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1]));
+  __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2]));
+  __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0]));
+  __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], px), _mm_mul_ps(e1[1], py)), _mm_mul_ps(e1[2], pz));
+  __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+  __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s[0], px), _mm_mul_ps(s[1], py)), _mm_mul_ps(s[2], pz));
+  u = _mm_mul_ps(u, invDet);
+
+  // Like the single ray test, give up early if u rules out every ray.
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  __m128 hit = _mm_cmpneq_ps(det, zero);
+  hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+  if ((_mm_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  // q = s x e1.
+  __m128 qx = _mm_sub_ps(_mm_mul_ps(s[1], e1[2]), _mm_mul_ps(s[2], e1[1]));
+  __m128 qy = _mm_sub_ps(_mm_mul_ps(s[2], e1[0]), _mm_mul_ps(s[0], e1[2]));
+  __m128 qz = _mm_sub_ps(_mm_mul_ps(s[0], e1[1]), _mm_mul_ps(s[1], e1[0]));
+  __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz));
+  __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], qx), _mm_mul_ps(e2[1], qy)), _mm_mul_ps(e2[2], qz));
+  v = _mm_mul_ps(v, invDet);
+  t = _mm_mul_ps(t, invDet);
+
+  hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+  hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_set1_ps(kMinT)));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_loadu_ps(lanes.tMax)));
+
+  unsigned int bits = unsigned(_mm_movemask_ps(hit)) & active;
+  if (bits != 0) {
+    store4(lanes.tOut, bits, t);
+    store4(lanes.u, bits, u);
+    store4(lanes.v, bits, v);
+  }
+  return bits;
+}
+
+
+VGL_NO_FP_CONTRACT
+static unsigned int sseTriangleWatertight(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  __m128 o[3], d[3];
+  load4(lanes.o, o);
+  load4(lanes.d, d);
+
+  // Each lane picks its own axes, using the same rules as maxIndex.
+  __m128 ax = _mm_andnot_ps(signBit, d[0]);
+  __m128 ay = _mm_andnot_ps(signBit, d[1]);
+  __m128 az = _mm_andnot_ps(signBit, d[2]);
+  __m128 zIsX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+  __m128 zIsY = _mm_and_ps(_mm_cmplt_ps(ax, ay), _mm_cmpge_ps(ay, az));
+  __m128 swapXY = _mm_cmplt_ps(select4(zIsX, d[0], select4(zIsY, d[1], d[2])), zero);
+
+  __m128 pd[3];
+  permute4(d, zIsX, zIsY, swapXY, pd);
+  __m128 sz = _mm_div_ps(_mm_set1_ps(1.0f), pd[2]);
+  __m128 sx = _mm_mul_ps(pd[0], sz);
+  __m128 sy = _mm_mul_ps(pd[1], sz);
+
+  // The vertices relative to the ray origin, sheared so the ray runs along z.
+  const Vec3f* verts[3] = { &args.v0, &args.v1, &args.v2 };
+  __m128 vx[3], vy[3], vz[3];
+  for (unsigned int i = 0; i < 3; ++i) {
+    __m128 rel[3], p[3];
+    for (unsigned int c = 0; c < 3; ++c)
+      rel[c] = _mm_sub_ps(_mm_set1_ps((*verts[i])[c]), o[c]);
+    permute4(rel, zIsX, zIsY, swapXY, p);
+    vx[i] = _mm_sub_ps(p[0], _mm_mul_ps(sx, p[2]));
+    vy[i] = _mm_sub_ps(p[1], _mm_mul_ps(sy, p[2]));
+    vz[i] = p[2];
+  }
+
+  __m128 eu = _mm_sub_ps(_mm_mul_ps(vx[2], vy[1]), _mm_mul_ps(vy[2], vx[1]));
+  __m128 ev = _mm_sub_ps(_mm_mul_ps(vx[0], vy[2]), _mm_mul_ps(vy[0], vx[2]));
+  __m128 ew = _mm_sub_ps(_mm_mul_ps(vx[1], vy[0]), _mm_mul_ps(vy[1], vx[0]));
+  __m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(eu, zero), _mm_cmplt_ps(ev, zero)), _mm_cmplt_ps(ew, zero));
+  __m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(eu, zero), _mm_cmpgt_ps(ev, zero)), _mm_cmpgt_ps(ew, zero));
+
+  __m128 det = _mm_add_ps(_mm_add_ps(eu, ev), ew);
+  __m128 hit = _mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), _mm_cmpneq_ps(det, zero));
+  if ((_mm_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+  __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(eu, vz[0]), _mm_mul_ps(ev, vz[1])), _mm_mul_ps(ew, vz[2]));
+  t = _mm_mul_ps(_mm_mul_ps(t, sz), invDet);
+  hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_set1_ps(kMinT)));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_loadu_ps(lanes.tMax)));
+
+  unsigned int bits = unsigned(_mm_movemask_ps(hit)) & active;
+  if (bits != 0) {
+    store4(lanes.tOut, bits, t);
+    store4(lanes.u, bits, _mm_mul_ps(ev, invDet));
+    store4(lanes.v, bits, _mm_mul_ps(ew, invDet));
+  }
+  return bits;
+}
+
+
+//
+// AVX kernels
+//
+// The same as the SSE ones, 8 lanes at a time.
+//
+
+// Not blendv, which gcc turns into a sign test that it can't do in 256 bits
+// without AVX2 and so does one lane at a time.
+VGL_TARGET("avx")
+static inline __m256 select8(__m256 mask, __m256 a, __m256 b)
+{
+  return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+}
+
+
+VGL_TARGET("avx")
+static inline __m256 laneMask8(unsigned int bits)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(laneMask4(bits)), laneMask4(bits >> 4), 1);
+}
+
+
+VGL_TARGET("avx")
+static inline void load8(const float* const src[3], __m256 dst[3])
+{
+  for (unsigned int c = 0; c < 3; ++c)
+    dst[c] = _mm256_loadu_ps(src[c]);
+}
+
+
+VGL_TARGET("avx")
+static inline void store8(float* dst, unsigned int bits, __m256 value)
+{
+  _mm256_maskstore_ps(dst, _mm256_castps_si256(laneMask8(bits)), value);
+}
+
+
+VGL_TARGET("avx")
+static inline void permute8(const __m256 v[3], __m256 zIsX, __m256 zIsY, __m256 swapXY, __m256 out[3])
+{
+  __m256 x = select8(zIsX, v[1], select8(zIsY, v[2], v[0]));
+  __m256 y = select8(zIsX, v[2], select8(zIsY, v[0], v[1]));
+  out[0] = select8(swapXY, y, x);
+  out[1] = select8(swapXY, x, y);
+  out[2] = select8(zIsX, v[0], select8(zIsY, v[1], v[2]));
+}
+
+
+VGL_TARGET("avx")
+static unsigned int avxSphere(const Lanes& lanes, unsigned int active, const SphereArgs& args)
+{
+  __m256 o[3], d[3], m[3];
+  load8(lanes.o, o);
+  load8(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c)
+    m[c] = _mm256_sub_ps(o[c], _mm256_set1_ps(args.center[c]));
+
+  __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], d[0]), _mm256_mul_ps(d[1], d[1])), _mm256_mul_ps(d[2], d[2]));
+  __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], m[0]), _mm256_mul_ps(d[1], m[1])), _mm256_mul_ps(d[2], m[2]));
+  __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], m[0]), _mm256_mul_ps(m[1], m[1])), _mm256_mul_ps(m[2], m[2]));
+  c = _mm256_sub_ps(c, _mm256_set1_ps(args.radius * args.radius));
+
+  __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+  __m256 hit = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GT_OQ);
+  if ((_mm256_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  __m256 root = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+  __m256 invA = _mm256_div_ps(_mm256_set1_ps(1.0f), a);
+  __m256 minusB = _mm256_sub_ps(_mm256_setzero_ps(), b);
+  __m256 tNear = _mm256_mul_ps(_mm256_sub_ps(minusB, root), invA);
+  __m256 tFar = _mm256_mul_ps(_mm256_add_ps(minusB, root), invA);
+  __m256 t = select8(_mm256_cmp_ps(tNear, _mm256_set1_ps(kMinT), _CMP_LT_OQ), tFar, tNear);
+
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(kMinT), _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(kMaxSphereT), _CMP_LE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_loadu_ps(lanes.tMax), _CMP_LT_OQ));
+
+  unsigned int bits = unsigned(_mm256_movemask_ps(hit)) & active;
+  if (bits != 0)
+    store8(lanes.tOut, bits, t);
+  return bits;
+}
+
+
+VGL_TARGET("avx")
+static unsigned int avxBox(const Lanes& lanes, unsigned int active, const AABB3f& box)
+{
+  __m256 o[3], d[3];
+  load8(lanes.o, o);
+  load8(lanes.d, d);
+
+  __m256 tNear = _mm256_set1_ps(-HUGE_VALF);
+  __m256 tFar = _mm256_set1_ps(HUGE_VALF);
+  for (unsigned int c = 0; c < 3; ++c) {
+    __m256 invD = _mm256_div_ps(_mm256_set1_ps(1.0f), d[c]);
+    __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.low[c]), o[c]), invD);
+    __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.high[c]), o[c]), invD);
+    tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+    tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+  }
+
+  __m256 hit = _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ);
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(tFar, _mm256_setzero_ps(), _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(tNear, _mm256_loadu_ps(lanes.tMax), _CMP_LT_OQ));
+  return unsigned(_mm256_movemask_ps(hit)) & active;
+}
+
+
+VGL_TARGET("avx")
+static unsigned int avxTriangle(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  Vec3f edge1 = args.v1 - args.v0, edge2 = args.v2 - args.v0;
+  __m256 o[3], d[3], e1[3], e2[3], s[3];
+  load8(lanes.o, o);
+  load8(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c) {
+    e1[c] = _mm256_set1_ps(edge1[c]);
+    e2[c] = _mm256_set1_ps(edge2[c]);
+    s[c] = _mm256_sub_ps(o[c], _mm256_set1_ps(args.v0[c]));
+  }
+
+  __m256 px = _mm256_sub_ps(_mm256_mul_ps(d[1], e2[2]), _mm256_mul_ps(d[2], e2[1]));
+  __m256 py = _mm256_sub_ps(_mm256_mul_ps(d[2], e2[0]), _mm256_mul_ps(d[0], e2[2]));
+  __m256 pz = _mm256_sub_ps(_mm256_mul_ps(d[0], e2[1]), _mm256_mul_ps(d[1], e2[0]));
+  __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1[0], px), _mm256_mul_ps(e1[1], py)), _mm256_mul_ps(e1[2], pz));
+  __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+  __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s[0], px), _mm256_mul_ps(s[1], py)), _mm256_mul_ps(s[2], pz));
+  u = _mm256_mul_ps(u, invDet);
+
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  __m256 hit = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+  hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+  if ((_mm256_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  __m256 qx = _mm256_sub_ps(_mm256_mul_ps(s[1], e1[2]), _mm256_mul_ps(s[2], e1[1]));
+  __m256 qy = _mm256_sub_ps(_mm256_mul_ps(s[2], e1[0]), _mm256_mul_ps(s[0], e1[2]));
+  __m256 qz = _mm256_sub_ps(_mm256_mul_ps(s[0], e1[1]), _mm256_mul_ps(s[1], e1[0]));
+  __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], qx), _mm256_mul_ps(d[1], qy)), _mm256_mul_ps(d[2], qz));
+  __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2[0], qx), _mm256_mul_ps(e2[1], qy)), _mm256_mul_ps(e2[2], qz));
+  v = _mm256_mul_ps(v, invDet);
+  t = _mm256_mul_ps(t, invDet);
+
+  hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                         _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(kMinT), _CMP_GT_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_loadu_ps(lanes.tMax), _CMP_LT_OQ));
+
+  unsigned int bits = unsigned(_mm256_movemask_ps(hit)) & active;
+  if (bits != 0) {
+    store8(lanes.tOut, bits, t);
+    store8(lanes.u, bits, u);
+    store8(lanes.v, bits, v);
+  }
+  return bits;
+}
+
+
+VGL_TARGET("avx") VGL_NO_FP_CONTRACT
+static unsigned int avxTriangleWatertight(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  __m256 o[3], d[3];
+  load8(lanes.o, o);
+  load8(lanes.d, d);
+
+  __m256 ax = _mm256_andnot_ps(signBit, d[0]);
+  __m256 ay = _mm256_andnot_ps(signBit, d[1]);
+  __m256 az = _mm256_andnot_ps(signBit, d[2]);
+  __m256 zIsX = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GE_OQ), _mm256_cmp_ps(ax, az, _CMP_GE_OQ));
+  __m256 zIsY = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_LT_OQ), _mm256_cmp_ps(ay, az, _CMP_GE_OQ));
+  __m256 swapXY = _mm256_cmp_ps(select8(zIsX, d[0], select8(zIsY, d[1], d[2])), zero, _CMP_LT_OQ);
+
+  __m256 pd[3];
+  permute8(d, zIsX, zIsY, swapXY, pd);
+  __m256 sz = _mm256_div_ps(_mm256_set1_ps(1.0f), pd[2]);
+  __m256 sx = _mm256_mul_ps(pd[0], sz);
+  __m256 sy = _mm256_mul_ps(pd[1], sz);
+
+  const Vec3f* verts[3] = { &args.v0, &args.v1, &args.v2 };
+  __m256 vx[3], vy[3], vz[3];
+  for (unsigned int i = 0; i < 3; ++i) {
+    __m256 rel[3], p[3];
+    for (unsigned int c = 0; c < 3; ++c)
+      rel[c] = _mm256_sub_ps(_mm256_set1_ps((*verts[i])[c]), o[c]);
+    permute8(rel, zIsX, zIsY, swapXY, p);
+    vx[i] = _mm256_sub_ps(p[0], _mm256_mul_ps(sx, p[2]));
+    vy[i] = _mm256_sub_ps(p[1], _mm256_mul_ps(sy, p[2]));
+    vz[i] = p[2];
+  }
+
+  __m256 eu = _mm256_sub_ps(_mm256_mul_ps(vx[2], vy[1]), _mm256_mul_ps(vy[2], vx[1]));
+  __m256 ev = _mm256_sub_ps(_mm256_mul_ps(vx[0], vy[2]), _mm256_mul_ps(vy[0], vx[2]));
+  __m256 ew = _mm256_sub_ps(_mm256_mul_ps(vx[1], vy[0]), _mm256_mul_ps(vy[1], vx[0]));
+  __m256 anyNegative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(eu, zero, _CMP_LT_OQ), _mm256_cmp_ps(ev, zero, _CMP_LT_OQ)),
+                                    _mm256_cmp_ps(ew, zero, _CMP_LT_OQ));
+  __m256 anyPositive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(eu, zero, _CMP_GT_OQ), _mm256_cmp_ps(ev, zero, _CMP_GT_OQ)),
+                                    _mm256_cmp_ps(ew, zero, _CMP_GT_OQ));
+
+  __m256 det = _mm256_add_ps(_mm256_add_ps(eu, ev), ew);
+  __m256 hit = _mm256_andnot_ps(_mm256_and_ps(anyNegative, anyPositive), _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ));
+  if ((_mm256_movemask_ps(hit) & active) == 0)
+    return 0;
+
+  __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+  __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(eu, vz[0]), _mm256_mul_ps(ev, vz[1])), _mm256_mul_ps(ew, vz[2]));
+  t = _mm256_mul_ps(_mm256_mul_ps(t, sz), invDet);
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(kMinT), _CMP_GT_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_loadu_ps(lanes.tMax), _CMP_LT_OQ));
+
+  unsigned int bits = unsigned(_mm256_movemask_ps(hit)) & active;
+  if (bits != 0) {
+    store8(lanes.tOut, bits, t);
+    store8(lanes.u, bits, _mm256_mul_ps(ev, invDet));
+    store8(lanes.v, bits, _mm256_mul_ps(ew, invDet));
+  }
+  return bits;
+}
+
+
+//
+// AVX-512 kernels
+//
+// 16 lanes at a time. Comparisons give bit masks directly, so there's no
+// need for movemask or lane masks.
+//
+
+VGL_TARGET("avx512f")
+static inline void load16(const float* const src[3], __m512 dst[3])
+{
+  for (unsigned int c = 0; c < 3; ++c)
+    dst[c] = _mm512_loadu_ps(src[c]);
+}
+
+
+// a where mask is set, b elsewhere.
+VGL_TARGET("avx512f")
+static inline __m512 select16(__mmask16 mask, __m512 a, __m512 b)
+{
+  return _mm512_mask_blend_ps(mask, b, a);
+}
+
+
+VGL_TARGET("avx512f")
+static inline void permute16(const __m512 v[3], __mmask16 zIsX, __mmask16 zIsY, __mmask16 swapXY, __m512 out[3])
+{
+  __m512 x = select16(zIsX, v[1], select16(zIsY, v[2], v[0]));
+  __m512 y = select16(zIsX, v[2], select16(zIsY, v[0], v[1]));
+  out[0] = select16(swapXY, y, x);
+  out[1] = select16(swapXY, x, y);
+  out[2] = select16(zIsX, v[0], select16(zIsY, v[1], v[2]));
+}
+
+
+VGL_TARGET("avx512f")
+static unsigned int avx512Sphere(const Lanes& lanes, unsigned int active, const SphereArgs& args)
+{
+  __m512 o[3], d[3], m[3];
+  load16(lanes.o, o);
+  load16(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c)
+    m[c] = _mm512_sub_ps(o[c], _mm512_set1_ps(args.center[c]));
+
+  __m512 a = _mm512_fmadd_ps(d[2], d[2], _mm512_fmadd_ps(d[1], d[1], _mm512_mul_ps(d[0], d[0])));
+  __m512 b = _mm512_fmadd_ps(d[2], m[2], _mm512_fmadd_ps(d[1], m[1], _mm512_mul_ps(d[0], m[0])));
+  __m512 c = _mm512_fmadd_ps(m[2], m[2], _mm512_fmadd_ps(m[1], m[1], _mm512_mul_ps(m[0], m[0])));
+  c = _mm512_sub_ps(c, _mm512_set1_ps(args.radius * args.radius));
+
+  __m512 discriminant = _mm512_fmsub_ps(b, b, _mm512_mul_ps(a, c));
+  __mmask16 hit = _mm512_mask_cmp_ps_mask(__mmask16(active), discriminant, _mm512_setzero_ps(), _CMP_GT_OQ);
+  if (hit == 0)
+    return 0;
+
+  // Masked so the sqrt only sees positive values (and gcc 12 doesn't warn).
+  __m512 root = _mm512_maskz_sqrt_ps(hit, discriminant);
+  __m512 invA = _mm512_maskz_div_ps(0xFFFF, _mm512_set1_ps(1.0f), a);
+  __m512 minusB = _mm512_sub_ps(_mm512_setzero_ps(), b);
+  __m512 tNear = _mm512_mul_ps(_mm512_sub_ps(minusB, root), invA);
+  __m512 tFar = _mm512_mul_ps(_mm512_add_ps(minusB, root), invA);
+  __m512 t = select16(_mm512_cmp_ps_mask(tNear, _mm512_set1_ps(kMinT), _CMP_LT_OQ), tFar, tNear);
+
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_set1_ps(kMinT), _CMP_GE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_set1_ps(kMaxSphereT), _CMP_LE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_loadu_ps(lanes.tMax), _CMP_LT_OQ);
+  _mm512_mask_storeu_ps(lanes.tOut, hit, t);
+  return hit;
+}
+
+
+VGL_TARGET("avx512f")
+static unsigned int avx512Box(const Lanes& lanes, unsigned int active, const AABB3f& box)
+{
+  __m512 o[3], d[3];
+  load16(lanes.o, o);
+  load16(lanes.d, d);
+
+  __m512 tNear = _mm512_set1_ps(-HUGE_VALF);
+  __m512 tFar = _mm512_set1_ps(HUGE_VALF);
+  for (unsigned int c = 0; c < 3; ++c) {
+    __m512 invD = _mm512_maskz_div_ps(0xFFFF, _mm512_set1_ps(1.0f), d[c]);
+    __m512 t0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.low[c]), o[c]), invD);
+    __m512 t1 = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(box.high[c]), o[c]), invD);
+    tNear = _mm512_maskz_max_ps(0xFFFF, tNear, _mm512_maskz_min_ps(0xFFFF, t0, t1));
+    tFar = _mm512_maskz_min_ps(0xFFFF, tFar, _mm512_maskz_max_ps(0xFFFF, t0, t1));
+  }
+
+  __mmask16 hit = _mm512_mask_cmp_ps_mask(__mmask16(active), tNear, tFar, _CMP_LE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, tFar, _mm512_setzero_ps(), _CMP_GE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, tNear, _mm512_loadu_ps(lanes.tMax), _CMP_LT_OQ);
+  return hit;
+}
+
+
+VGL_TARGET("avx512f")
+static unsigned int avx512Triangle(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  Vec3f edge1 = args.v1 - args.v0, edge2 = args.v2 - args.v0;
+  __m512 o[3], d[3], e1[3], e2[3], s[3];
+  load16(lanes.o, o);
+  load16(lanes.d, d);
+  for (unsigned int c = 0; c < 3; ++c) {
+    e1[c] = _mm512_set1_ps(edge1[c]);
+    e2[c] = _mm512_set1_ps(edge2[c]);
+    s[c] = _mm512_sub_ps(o[c], _mm512_set1_ps(args.v0[c]));
+  }
+
+  __m512 px = _mm512_fmsub_ps(d[1], e2[2], _mm512_mul_ps(d[2], e2[1]));
+  __m512 py = _mm512_fmsub_ps(d[2], e2[0], _mm512_mul_ps(d[0], e2[2]));
+  __m512 pz = _mm512_fmsub_ps(d[0], e2[1], _mm512_mul_ps(d[1], e2[0]));
+  __m512 det = _mm512_fmadd_ps(e1[2], pz, _mm512_fmadd_ps(e1[1], py, _mm512_mul_ps(e1[0], px)));
+  __m512 invDet = _mm512_maskz_div_ps(0xFFFF, _mm512_set1_ps(1.0f), det);
+  __m512 u = _mm512_fmadd_ps(s[2], pz, _mm512_fmadd_ps(s[1], py, _mm512_mul_ps(s[0], px)));
+  u = _mm512_mul_ps(u, invDet);
+
+  const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.0f);
+  __mmask16 hit = _mm512_mask_cmp_ps_mask(__mmask16(active), det, zero, _CMP_NEQ_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, u, zero, _CMP_GE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, u, one, _CMP_LE_OQ);
+  if (hit == 0)
+    return 0;
+
+  __m512 qx = _mm512_fmsub_ps(s[1], e1[2], _mm512_mul_ps(s[2], e1[1]));
+  __m512 qy = _mm512_fmsub_ps(s[2], e1[0], _mm512_mul_ps(s[0], e1[2]));
+  __m512 qz = _mm512_fmsub_ps(s[0], e1[1], _mm512_mul_ps(s[1], e1[0]));
+  __m512 v = _mm512_fmadd_ps(d[2], qz, _mm512_fmadd_ps(d[1], qy, _mm512_mul_ps(d[0], qx)));
+  __m512 t = _mm512_fmadd_ps(e2[2], qz, _mm512_fmadd_ps(e2[1], qy, _mm512_mul_ps(e2[0], qx)));
+  v = _mm512_mul_ps(v, invDet);
+  t = _mm512_mul_ps(t, invDet);
+
+  hit = _mm512_mask_cmp_ps_mask(hit, v, zero, _CMP_GE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, _mm512_add_ps(u, v), one, _CMP_LE_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_set1_ps(kMinT), _CMP_GT_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_loadu_ps(lanes.tMax), _CMP_LT_OQ);
+
+  _mm512_mask_storeu_ps(lanes.tOut, hit, t);
+  _mm512_mask_storeu_ps(lanes.u, hit, u);
+  _mm512_mask_storeu_ps(lanes.v, hit, v);
+  return hit;
+}
+
+
+VGL_TARGET("avx512f") VGL_NO_FP_CONTRACT
+static unsigned int avx512TriangleWatertight(const Lanes& lanes, unsigned int active, const TriangleArgs& args)
+{
+  const __m512 zero = _mm512_setzero_ps();
+  __m512 o[3], d[3];
+  load16(lanes.o, o);
+  load16(lanes.d, d);
+
+  __m512 ax = _mm512_abs_ps(d[0]);
+  __m512 ay = _mm512_abs_ps(d[1]);
+  __m512 az = _mm512_abs_ps(d[2]);
+  __mmask16 zIsX = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(ax, ay, _CMP_GE_OQ), ax, az, _CMP_GE_OQ);
+  __mmask16 zIsY = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(ax, ay, _CMP_LT_OQ), ay, az, _CMP_GE_OQ);
+  __mmask16 swapXY = _mm512_cmp_ps_mask(select16(zIsX, d[0], select16(zIsY, d[1], d[2])), zero, _CMP_LT_OQ);
+
+  __m512 pd[3];
+  permute16(d, zIsX, zIsY, swapXY, pd);
+  __m512 sz = _mm512_maskz_div_ps(0xFFFF, _mm512_set1_ps(1.0f), pd[2]);
+  __m512 sx = _mm512_mul_ps(pd[0], sz);
+  __m512 sy = _mm512_mul_ps(pd[1], sz);
+
+  const Vec3f* verts[3] = { &args.v0, &args.v1, &args.v2 };
+  __m512 vx[3], vy[3], vz[3];
+  for (unsigned int i = 0; i < 3; ++i) {
+    __m512 rel[3], p[3];
+    for (unsigned int c = 0; c < 3; ++c)
+      rel[c] = _mm512_sub_ps(_mm512_set1_ps((*verts[i])[c]), o[c]);
+    permute16(rel, zIsX, zIsY, swapXY, p);
+    vx[i] = _mm512_sub_ps(p[0], _mm512_mul_ps(sx, p[2]));
+    vy[i] = _mm512_sub_ps(p[1], _mm512_mul_ps(sy, p[2]));
+    vz[i] = p[2];
+  }
+
+  // Never fused (the kernel is VGL_NO_FP_CONTRACT), so the edge functions
+  // round the same way as the other kernels and a ray on a shared edge gets
+  // the same answer whichever one is used.
+  __m512 eu = _mm512_sub_ps(_mm512_mul_ps(vx[2], vy[1]), _mm512_mul_ps(vy[2], vx[1]));
+  __m512 ev = _mm512_sub_ps(_mm512_mul_ps(vx[0], vy[2]), _mm512_mul_ps(vy[0], vx[2]));
+  __m512 ew = _mm512_sub_ps(_mm512_mul_ps(vx[1], vy[0]), _mm512_mul_ps(vy[1], vx[0]));
+  __mmask16 anyNegative = _mm512_cmp_ps_mask(eu, zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(ev, zero, _CMP_LT_OQ) |
+                          _mm512_cmp_ps_mask(ew, zero, _CMP_LT_OQ);
+  __mmask16 anyPositive = _mm512_cmp_ps_mask(eu, zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(ev, zero, _CMP_GT_OQ) |
+                          _mm512_cmp_ps_mask(ew, zero, _CMP_GT_OQ);
+
+  __m512 det = _mm512_add_ps(_mm512_add_ps(eu, ev), ew);
+  __mmask16 hit = __mmask16(active) & ~(anyNegative & anyPositive);
+  hit = _mm512_mask_cmp_ps_mask(hit, det, zero, _CMP_NEQ_OQ);
+  if (hit == 0)
+    return 0;
+
+  __m512 invDet = _mm512_maskz_div_ps(0xFFFF, _mm512_set1_ps(1.0f), det);
+  __m512 t = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(eu, vz[0]), _mm512_mul_ps(ev, vz[1])), _mm512_mul_ps(ew, vz[2]));
+  t = _mm512_mul_ps(_mm512_mul_ps(t, sz), invDet);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_set1_ps(kMinT), _CMP_GT_OQ);
+  hit = _mm512_mask_cmp_ps_mask(hit, t, _mm512_loadu_ps(lanes.tMax), _CMP_LT_OQ);
+
+  _mm512_mask_storeu_ps(lanes.tOut, hit, t);
+  _mm512_mask_storeu_ps(lanes.u, hit, _mm512_mul_ps(ev, invDet));
+  _mm512_mask_storeu_ps(lanes.v, hit, _mm512_mul_ps(ew, invDet));
+  return hit;
+}
+
+#endif // VGL_SIMD_SSE2
+
+
+#ifdef VGL_SIMD_SSE2
+static const KernelSet<SphereArgs> kSphereKernels = { scalarSphere, sseSphere, avxSphere, avx512Sphere };
+static const KernelSet<AABB3f> kBoxKernels = { scalarBox, sseBox, avxBox, avx512Box };
+static const KernelSet<TriangleArgs> kTriangleKernels = {
+  scalarTriangle, sseTriangle, avxTriangle, avx512Triangle
+};
+static const KernelSet<TriangleArgs> kTriangleWatertightKernels = {
+  scalarTriangleWatertight, sseTriangleWatertight, avxTriangleWatertight, avx512TriangleWatertight
+};
+#else
+static const KernelSet<SphereArgs> kSphereKernels = { scalarSphere, scalarSphere, scalarSphere, scalarSphere };
+static const KernelSet<AABB3f> kBoxKernels = { scalarBox, scalarBox, scalarBox, scalarBox };
+static const KernelSet<TriangleArgs> kTriangleKernels = {
+  scalarTriangle, scalarTriangle, scalarTriangle, scalarTriangle
+};
+static const KernelSet<TriangleArgs> kTriangleWatertightKernels = {
+  scalarTriangleWatertight, scalarTriangleWatertight, scalarTriangleWatertight, scalarTriangleWatertight
+};
+#endif
+
+
+//
+// FUNCTIONS
+//
+
+template <unsigned int N>
+unsigned int intersectPacketSphere(RayPacket<N>& rays, unsigned int active,
+                                   const Vec3f& center, float radius)
+{
+  SphereArgs args = { center, radius };
+  return runKernels(kSphereKernels, packetLanes(rays, rays.tMax, NULL, NULL), N,
+                    active & RayPacket<N>::kAllActive, args);
+}
+
+
+template <unsigned int N>
+unsigned int intersectPacketBox(const RayPacket<N>& rays, unsigned int active, const AABB3f& box)
+{
+  return runKernels(kBoxKernels, packetLanes(rays, NULL, NULL, NULL), N,
+                    active & RayPacket<N>::kAllActive, box);
+}
+
+
+template <unsigned int N>
+unsigned int intersectPacketTriangle(RayPacket<N>& rays, unsigned int active,
+                                     const Vec3f& v0, const Vec3f& v1, const Vec3f& v2,
+                                     float* u, float* v)
+{
+  TriangleArgs args = { v0, v1, v2 };
+  return runKernels(kTriangleKernels, packetLanes(rays, rays.tMax, u, v), N,
+                    active & RayPacket<N>::kAllActive, args);
+}
+
+
+template <unsigned int N>
+unsigned int intersectPacketTriangleWatertight(RayPacket<N>& rays, unsigned int active,
+                                               const Vec3f& v0, const Vec3f& v1, const Vec3f& v2,
+                                               float* u, float* v)
+{
+  TriangleArgs args = { v0, v1, v2 };
+  return runKernels(kTriangleWatertightKernels, packetLanes(rays, rays.tMax, u, v), N,
+                    active & RayPacket<N>::kAllActive, args);
+}
+
+
+// The packet sizes which are supported.
+template unsigned int intersectPacketSphere<4>(RayPacket<4>&, unsigned int, const Vec3f&, float);
+template unsigned int intersectPacketSphere<8>(RayPacket<8>&, unsigned int, const Vec3f&, float);
+template unsigned int intersectPacketSphere<16>(RayPacket<16>&, unsigned int, const Vec3f&, float);
+
+template unsigned int intersectPacketBox<4>(const RayPacket<4>&, unsigned int, const AABB3f&);
+template unsigned int intersectPacketBox<8>(const RayPacket<8>&, unsigned int, const AABB3f&);
+template unsigned int intersectPacketBox<16>(const RayPacket<16>&, unsigned int, const AABB3f&);
+
+template unsigned int intersectPacketTriangle<4>(RayPacket<4>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+template unsigned int intersectPacketTriangle<8>(RayPacket<8>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+template unsigned int intersectPacketTriangle<16>(RayPacket<16>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+
+template unsigned int intersectPacketTriangleWatertight<4>(RayPacket<4>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+template unsigned int intersectPacketTriangleWatertight<8>(RayPacket<8>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+template unsigned int intersectPacketTriangleWatertight<16>(RayPacket<16>&, unsigned int,
+    const Vec3f&, const Vec3f&, const Vec3f&, float*, float*);
+
+
+} // namespace vgl
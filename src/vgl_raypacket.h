@@ -0,0 +1,103 @@
+#ifndef vgl_raypacket_h
+#define vgl_raypacket_h
+
+#include "vgl_aabb3.h"
+#include "vgl_ray3.h"
+#include "vgl_vec3.h"
+
+#include <cmath>
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// N rays stored as structure-of-arrays, so that a SIMD register can hold the
+// same component of 4, 8 or 16 rays at once. The intersection functions
+// below are only provided for those three sizes.
+//
+// tMax is the furthest each ray can go: hits beyond it are ignored. The
+// sphere and triangle tests shrink it to the distance of each hit they
+// find, so testing a packet against a list of objects leaves tMax holding
+// the nearest hit for each ray.
+template <unsigned int N>
+struct RayPacket {
+  static const unsigned int kSize = N;
+  //! The active mask with every ray switched on.
+  static const unsigned int kAllActive = (1u << N) - 1;
+
+  float ox[N], oy[N], oz[N]; // Origins.
+  float dx[N], dy[N], dz[N]; // Directions.
+  float tMax[N];
+
+  RayPacket()
+  {
+    for (unsigned int i = 0; i < N; ++i) {
+      ox[i] = oy[i] = oz[i] = 0.0f;
+      dx[i] = dy[i] = dz[i] = 0.0f;
+      tMax[i] = HUGE_VALF;
+    }
+  }
+
+  void set(unsigned int i, const Ray3f& ray, float iTMax = HUGE_VALF)
+  {
+    ox[i] = ray.o.x; oy[i] = ray.o.y; oz[i] = ray.o.z;
+    dx[i] = ray.d.x; dy[i] = ray.d.y; dz[i] = ray.d.z;
+    tMax[i] = iTMax;
+  }
+
+  Ray3f get(unsigned int i) const
+  {
+    return Ray3f(Vec3f(ox[i], oy[i], oz[i]), Vec3f(dx[i], dy[i], dz[i]));
+  }
+};
+
+template <unsigned int N> const unsigned int RayPacket<N>::kSize;
+template <unsigned int N> const unsigned int RayPacket<N>::kAllActive;
+
+typedef RayPacket<4> RayPacket4;
+typedef RayPacket<8> RayPacket8;
+typedef RayPacket<16> RayPacket16;
+
+
+//
+// FUNCTIONS
+//
+
+// Packet versions of the single ray tests in vgl_ray3.h and vgl_aabb3.h,
+// with the same rules about what counts as a hit.
+//
+// Each takes an active mask, with bit i set if ray i should be tested; the
+// others are left alone. The result is the mask of active rays which hit.
+// They use SSE, AVX or AVX-512 depending on the packet size and what the CPU
+// supports (a 16 ray packet on a CPU without AVX-512 is done as two halves
+// with AVX, say), falling back to the single ray code.
+
+//! Where a ray hits, tMax is set to the distance to the hit.
+template <unsigned int N>
+unsigned int intersectPacketSphere(RayPacket<N>& rays, unsigned int active,
+                                   const Vec3f& center, float radius);
+
+//! Doesn't change tMax; a ray only hits if it enters the box before tMax.
+template <unsigned int N>
+unsigned int intersectPacketBox(const RayPacket<N>& rays, unsigned int active, const AABB3f& box);
+
+//! Where a ray hits, tMax is set to the distance to the hit and u[i] and v[i]
+//! to the barycentric weights of v1 and v2, as in intersectRayTriangle. u and
+//! v must have room for N floats.
+template <unsigned int N>
+unsigned int intersectPacketTriangle(RayPacket<N>& rays, unsigned int active,
+                                     const Vec3f& v0, const Vec3f& v1, const Vec3f& v2,
+                                     float* u, float* v);
+
+//! The same, using the watertight test (see intersectRayTriangleWatertight).
+template <unsigned int N>
+unsigned int intersectPacketTriangleWatertight(RayPacket<N>& rays, unsigned int active,
+                                               const Vec3f& v0, const Vec3f& v1, const Vec3f& v2,
+                                               float* u, float* v);
+
+
+} // namespace vgl
+
+#endif // vgl_raypacket_h
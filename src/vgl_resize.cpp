@@ -0,0 +1,394 @@
+#include "vgl_resize.h"
+
+#include "vgl_convert.h"
+#include "vgl_pixelpool.h"
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef VGL_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// The weights for resampling along one axis. Destination pixel i reads taps
+// consecutive source pixels, starting from first[i]. Pixels which need fewer
+// taps have their weights padded out with zeros.
+struct FilterTable {
+  unsigned int taps;
+  std::vector<int> first;
+  std::vector<float> weights;       // taps per destination pixel.
+  std::vector<short> fixedWeights;  // The same, scaled by 1 << kFixedBits.
+};
+
+
+//
+// CONSTANTS
+//
+
+static const int kFixedBits = 14;
+
+// The horizontal pass keeps this many fractional bits in signed 16 bit
+// samples. That leaves room for the overshoot of the negative lobes, from
+// about -256 to +511, which the vertical pass needs to see unclamped.
+static const int kMidBits = 6;
+static const int kMidShift = kFixedBits - kMidBits;
+static const int kMidRound = 1 << (kMidShift - 1);
+static const int kOutShift = kFixedBits + kMidBits;
+static const int kOutRound = 1 << (kOutShift - 1);
+static const double kPi = 3.14159265358979323846;
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static double filterSupport(ResizeFilter filter)
+{
+  switch (filter) {
+    case FILTER_BOX:      return 0.5;
+    case FILTER_TRIANGLE: return 1.0;
+    case FILTER_MITCHELL: return 2.0;
+    default:              return 3.0;
+  }
+}
+
+
+static double sinc(double x)
+{
+  if (std::fabs(x) < 1e-8)
+    return 1.0;
+  x *= kPi;
+  return std::sin(x) / x;
+}
+
+
+static double filterWeight(ResizeFilter filter, double x)
+{
+  x = std::fabs(x);
+  switch (filter) {
+    case FILTER_BOX:
+      return (x <= 0.5) ? 1.0 : 0.0;
+    case FILTER_TRIANGLE:
+      return (x < 1.0) ? 1.0 - x : 0.0;
+    case FILTER_MITCHELL: {
+      const double B = 1.0 / 3.0, C = 1.0 / 3.0;
+      if (x < 1.0)
+        return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6.0;
+      if (x < 2.0)
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6.0;
+      return 0.0;
+    }
+    default:
+      return (x < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+  }
+}
+
+
+// Works out the source pixels and weights for every destination pixel along
+// an axis. Source pixel j covers [j, j + 1), so destination pixel i is
+// centred at (i + 0.5) * srcSize / dstSize. Taps which fall off either end
+// are folded onto the edge pixel.
+static void buildFilterTable(ResizeFilter filter, unsigned int srcSize, unsigned int dstSize,
+    FilterTable& table)
+{
+  const double scale = double(srcSize) / dstSize;
+  const double filterScale = std::max(1.0, scale);
+  const double support = filterSupport(filter) * filterScale;
+
+  // Each destination pixel's range of source pixels, clamped to the image.
+  std::vector<int> lo(dstSize), hi(dstSize);
+  table.taps = 1;
+  for (unsigned int i = 0; i < dstSize; ++i) {
+    double center = (i + 0.5) * scale;
+    int a = (int)std::floor(center - support - 0.5);
+    int b = (int)std::ceil(center + support - 0.5);
+    lo[i] = std::max(0, std::min(a, (int)srcSize - 1));
+    hi[i] = std::max(0, std::min(b, (int)srcSize - 1));
+    table.taps = std::max(table.taps, (unsigned int)(hi[i] - lo[i] + 1));
+  }
+
+  const unsigned int taps = table.taps;
+  table.first.resize(dstSize);
+  table.weights.assign(size_t(dstSize) * taps, 0.0f);
+  table.fixedWeights.assign(size_t(dstSize) * taps, 0);
+
+  std::vector<double> w(taps);
+  for (unsigned int i = 0; i < dstSize; ++i) {
+    // Pad the window out to the full number of taps, keeping it inside the
+    // image.
+    int first = std::min(lo[i], (int)srcSize - (int)taps);
+    table.first[i] = first;
+
+    double center = (i + 0.5) * scale;
+    int a = (int)std::floor(center - support - 0.5);
+    int b = (int)std::ceil(center + support - 0.5);
+    std::fill(w.begin(), w.end(), 0.0);
+    double total = 0.0;
+    for (int j = a; j <= b; ++j) {
+      double weight = filterWeight(filter, (j + 0.5 - center) / filterScale);
+      int src = std::max(0, std::min(j, (int)srcSize - 1));
+      w[src - first] += weight;
+      total += weight;
+    }
+    if (total == 0.0) {
+      // Only possible for a box filter exactly between two pixels.
+      w[lo[i] - first] = total = 1.0;
+    }
+
+    float* weights = &table.weights[size_t(i) * taps];
+    short* fixedWeights = &table.fixedWeights[size_t(i) * taps];
+    int fixedTotal = 0;
+    unsigned int largest = 0;
+    for (unsigned int k = 0; k < taps; ++k) {
+      weights[k] = float(w[k] / total);
+      fixedWeights[k] = (short)std::floor(w[k] / total * (1 << kFixedBits) + 0.5);
+      fixedTotal += fixedWeights[k];
+      if (w[k] > w[largest])
+        largest = k;
+    }
+    // Make sure the fixed point weights add up to exactly one, so flat areas
+    // stay flat.
+    fixedWeights[largest] += (short)((1 << kFixedBits) - fixedTotal);
+  }
+}
+
+
+static inline short clampToMid(int sum)
+{
+  sum >>= kMidShift;
+  return (short)(sum < -32768 ? -32768 : (sum > 32767 ? 32767 : sum));
+}
+
+
+static inline unsigned char clampToByte(int sum)
+{
+  sum >>= kOutShift;
+  return (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+}
+
+
+#ifdef VGL_SIMD_X86
+// Two weights packed into each 32 bit lane, for _mm_madd_epi16 against pairs
+// of samples. The weights can be negative, so they are packed as unsigned.
+static inline __m128i weightPair(short a, short b)
+{
+  return _mm_set1_epi32((int)((unsigned int)(unsigned short)a | ((unsigned int)(unsigned short)b << 16)));
+}
+#endif
+
+
+// Horizontal pass over one row of 8 bit pixels, producing samples with
+// kMidBits fractional bits.
+static void resampleRow8(const unsigned char* src, short* dst, unsigned int dstWidth,
+    unsigned int channels, const FilterTable& table)
+{
+  const unsigned int taps = table.taps;
+  unsigned int x = 0;
+
+#ifdef VGL_SIMD_X86
+  // RGBA: two taps per multiply-add, all four channels at once.
+  if (channels == 4) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; x < dstWidth; ++x) {
+      const unsigned char* p = src + table.first[x] * 4;
+      const short* w = &table.fixedWeights[size_t(x) * taps];
+      __m128i sum = _mm_set1_epi32(kMidRound);
+      unsigned int k = 0;
+      for (; k + 1 < taps; k += 2) {
+        __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + k * 4)), zero);
+        px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+        __m128i wk = weightPair(w[k], w[k + 1]);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(px, wk));
+      }
+      if (k < taps) {
+        int last;
+        memcpy(&last, p + k * 4, 4);
+        __m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero), zero);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32((unsigned short)w[k])));
+      }
+      sum = _mm_srai_epi32(sum, kMidShift);
+      _mm_storel_epi64((__m128i*)(dst + x * 4), _mm_packs_epi32(sum, sum));
+    }
+  }
+#endif
+
+  for (; x < dstWidth; ++x) {
+    const unsigned char* p = src + table.first[x] * channels;
+    const short* w = &table.fixedWeights[size_t(x) * taps];
+    for (unsigned int c = 0; c < channels; ++c) {
+      int sum = kMidRound;
+      for (unsigned int k = 0; k < taps; ++k)
+        sum += p[k * channels + c] * w[k];
+      dst[x * channels + c] = clampToMid(sum);
+    }
+  }
+}
+
+
+// Vertical pass for one row of 8 bit pixels: a weighted sum of whole rows
+// from the horizontal pass, so the channel layout doesn't matter.
+static void resampleColumn8(const short* const* rows, const short* w, unsigned int taps,
+    unsigned char* dst, size_t rowBytes)
+{
+  size_t i = 0;
+
+#ifdef VGL_SIMD_X86
+  // Eight samples at a time, interleaving pairs of rows for the multiply-add.
+  for (; i + 8 <= rowBytes; i += 8) {
+    __m128i lo = _mm_set1_epi32(kOutRound);
+    __m128i hi = lo;
+    unsigned int k = 0;
+    for (; k + 1 < taps; k += 2) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(rows[k + 1] + i));
+      __m128i wk = weightPair(w[k], w[k + 1]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wk));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wk));
+    }
+    if (k < taps) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+      __m128i wk = _mm_set1_epi32((unsigned short)w[k]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, _mm_setzero_si128()), wk));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, _mm_setzero_si128()), wk));
+    }
+    __m128i sum = _mm_packs_epi32(_mm_srai_epi32(lo, kOutShift), _mm_srai_epi32(hi, kOutShift));
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(sum, sum));
+  }
+#endif
+
+  for (; i < rowBytes; ++i) {
+    int sum = kOutRound;
+    for (unsigned int k = 0; k < taps; ++k)
+      sum += rows[k][i] * w[k];
+    dst[i] = clampToByte(sum);
+  }
+}
+
+
+static void resample8(const unsigned char* src, unsigned int srcWidth, unsigned int srcHeight,
+    unsigned char* dst, unsigned int dstWidth, unsigned int dstHeight, unsigned int channels,
+    const FilterTable& xTable, const FilterTable& yTable)
+{
+  const size_t srcRowBytes = size_t(srcWidth) * channels;
+  const size_t dstRowBytes = size_t(dstWidth) * channels;
+  short* tmp = (short*)allocPixels(dstRowBytes * srcHeight * sizeof(short));
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)srcHeight; ++y)
+    resampleRow8(src + y * srcRowBytes, tmp + y * dstRowBytes, dstWidth, channels, xTable);
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)dstHeight; ++y) {
+    std::vector<const short*> rows(yTable.taps);
+    for (unsigned int k = 0; k < yTable.taps; ++k)
+      rows[k] = tmp + (yTable.first[y] + k) * dstRowBytes;
+    resampleColumn8(&rows[0], &yTable.fixedWeights[size_t(y) * yTable.taps], yTable.taps,
+        dst + y * dstRowBytes, dstRowBytes);
+  }
+
+  freePixels((unsigned char*)tmp);
+}
+
+
+static void resampleFloat(const float* src, unsigned int srcWidth, unsigned int srcHeight,
+    float* dst, unsigned int dstWidth, unsigned int dstHeight, unsigned int channels,
+    const FilterTable& xTable, const FilterTable& yTable)
+{
+  const size_t srcRowSize = size_t(srcWidth) * channels;
+  const size_t dstRowSize = size_t(dstWidth) * channels;
+  float* tmp = (float*)allocPixels(dstRowSize * srcHeight * sizeof(float));
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)srcHeight; ++y) {
+    const float* in = src + y * srcRowSize;
+    float* out = tmp + y * dstRowSize;
+    for (unsigned int x = 0; x < dstWidth; ++x) {
+      const float* p = in + xTable.first[x] * channels;
+      const float* w = &xTable.weights[size_t(x) * xTable.taps];
+      for (unsigned int c = 0; c < channels; ++c) {
+        float sum = 0.0f;
+        for (unsigned int k = 0; k < xTable.taps; ++k)
+          sum += p[k * channels + c] * w[k];
+        out[x * channels + c] = sum;
+      }
+    }
+  }
+
+  #pragma omp parallel for
+  for (int y = 0; y < (int)dstHeight; ++y) {
+    float* out = dst + y * dstRowSize;
+    const float* w = &yTable.weights[size_t(y) * yTable.taps];
+    std::fill(out, out + dstRowSize, 0.0f);
+    for (unsigned int k = 0; k < yTable.taps; ++k) {
+      const float* in = tmp + (yTable.first[y] + k) * dstRowSize;
+      for (size_t i = 0; i < dstRowSize; ++i)
+        out[i] += in[i] * w[k];
+    }
+  }
+
+  freePixels((unsigned char*)tmp);
+}
+
+
+//
+// FUNCTIONS
+//
+
+RawImage* resize(RawImage* src, unsigned int width, unsigned int height, ResizeFilter filter)
+{
+  const int type = src->getType();
+  const int pixelType = src->getPixelType();
+  const unsigned int channels = channelsForType(type);
+  const unsigned int srcWidth = src->getWidth();
+  const unsigned int srcHeight = src->getHeight();
+
+  RawImage* result = new RawImage(type, src->getBytesPerPixel(), width, height,
+      pixelType, src->getOrigin());
+  if (width == 0 || height == 0)
+    return result;
+  if (srcWidth == 0 || srcHeight == 0) {
+    memset(result->getPixels(), 0, size_t(result->getBytesPerPixel()) * width * height);
+    return result;
+  }
+
+  FilterTable xTable, yTable;
+  buildFilterTable(filter, srcWidth, width, xTable);
+  buildFilterTable(filter, srcHeight, height, yTable);
+
+  if (pixelType == GL_UNSIGNED_BYTE) {
+    resample8(src->getPixels(), srcWidth, srcHeight, result->getPixels(), width, height,
+        channels, xTable, yTable);
+    return result;
+  }
+
+  // Everything else goes through floats.
+  unsigned char* srcFloats = src->getPixels();
+  unsigned char* dstFloats = result->getPixels();
+  if (pixelType != GL_FLOAT) {
+    srcFloats = allocPixels(size_t(srcWidth) * srcHeight * channels * sizeof(float));
+    dstFloats = allocPixels(size_t(width) * height * channels * sizeof(float));
+    convertPixels(src->getPixels(), type, srcFloats, type, srcWidth, srcHeight, pixelType, GL_FLOAT);
+  }
+  resampleFloat((const float*)srcFloats, srcWidth, srcHeight, (float*)dstFloats, width, height,
+      channels, xTable, yTable);
+  if (pixelType != GL_FLOAT) {
+    convertPixels(dstFloats, type, result->getPixels(), type, width, height, GL_FLOAT, pixelType);
+    freePixels(srcFloats);
+    freePixels(dstFloats);
+  }
+  return result;
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,48 @@
+#ifndef vgl_resize_h
+#define vgl_resize_h
+
+#include "vgl_image.h"
+
+namespace vgl {
+
+//
+// Types
+//
+
+enum ResizeFilter {
+  FILTER_BOX,       //!< Nearest neighbour when enlarging, averaging when shrinking.
+  FILTER_TRIANGLE,  //!< Bilinear.
+  FILTER_MITCHELL,  //!< Mitchell-Netravali cubic with B = C = 1/3.
+  FILTER_LANCZOS3   //!< Windowed sinc with three lobes; the sharpest.
+};
+
+
+//
+// Functions
+//
+
+// Resample an image to any size, filtering horizontally and then vertically.
+// When shrinking, the filter is widened to cover every source pixel that
+// falls under each destination pixel, so there's no aliasing; pixels past the
+// edges of the image repeat the edge pixels.
+//
+// The weights for each destination column and row are worked out once up
+// front. 8 bit images are filtered in 14 bit fixed point, using SSE2 for the
+// vertical pass and for the horizontal pass over RGBA rows. The result of the
+// first pass is kept unclamped and with some fractional bits, so 8 bit results
+// come out within a level of filtering as floats.
+// Everything else is filtered as floats and converted back to its original
+// pixel type. Rows are shared out between threads in both passes.
+//
+// Lanczos and Mitchell have negative lobes, so 8 and 16 bit results are
+// clamped, but float results can overshoot a little around sharp edges.
+// Colours bleed out of transparent pixels unless the image is premultiplied
+// first (see RawImage::convertInPlace).
+RawImage* resize(RawImage* src, unsigned int width, unsigned int height,
+    ResizeFilter filter = FILTER_LANCZOS3);
+
+
+} // namespace vgl
+
+#endif // vgl_resize_h
+
@@ -0,0 +1,64 @@
+#include "vgl_simd.h"
+
+namespace vgl {
+
+//
+// FUNCTIONS
+//
+
+#ifdef VGL_SIMD_X86
+
+bool cpuHasSSSE3()
+{
+  static const bool result = __builtin_cpu_supports("ssse3");
+  return result;
+}
+
+
+bool cpuHasSSE41()
+{
+  static const bool result = __builtin_cpu_supports("sse4.1");
+  return result;
+}
+
+
+bool cpuHasAVX()
+{
+  static const bool result = __builtin_cpu_supports("avx");
+  return result;
+}
+
+
+bool cpuHasF16C()
+{
+  static const bool result = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return result;
+}
+
+
+bool cpuHasAVX2()
+{
+  static const bool result = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return result;
+}
+
+
+bool cpuHasAVX512F()
+{
+  static const bool result = __builtin_cpu_supports("avx512f");
+  return result;
+}
+
+#else
+
+bool cpuHasSSSE3()   { return false; }
+bool cpuHasSSE41()   { return false; }
+bool cpuHasAVX()     { return false; }
+bool cpuHasF16C()    { return false; }
+bool cpuHasAVX2()    { return false; }
+bool cpuHasAVX512F() { return false; }
+
+#endif // VGL_SIMD_X86
+
+
+} // namespace vgl
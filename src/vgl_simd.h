@@ -0,0 +1,54 @@
+#ifndef vgl_simd_h
+#define vgl_simd_h
+
+// Helpers for writing SIMD code paths. Kernels are compiled for a specific
+// instruction set with VGL_TARGET and then picked at runtime using the
+// cpuHas*() functions below, so the library itself can still be built for
+// the baseline architecture. On compilers or CPUs where none of this is
+// available, VGL_SIMD_X86 is left undefined and callers should use their
+// scalar fallback.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define VGL_SIMD_X86 1
+  #define VGL_TARGET(isa) __attribute__((target(isa)))
+#else
+  #define VGL_TARGET(isa)
+#endif
+
+// Inline code in headers can't be given a target, so it's only vectorised
+// when the compiler is already allowed to use SSE2 everywhere (always the
+// case for x86-64).
+#if defined(VGL_SIMD_X86) && defined(__SSE2__)
+  #define VGL_SIMD_SSE2 1
+#endif
+
+// Stops gcc fusing multiplies and adds into FMAs anywhere in a function,
+// whatever -ffp-contract and -m flags it's built with, for code which has to
+// round the same way on every path. Clang only fuses within a single
+// expression unless told otherwise, so it uses #pragma STDC FP_CONTRACT OFF
+// for those instead.
+#if defined(__GNUC__) && !defined(__clang__)
+  #define VGL_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+  #define VGL_NO_FP_CONTRACT
+#endif
+
+namespace vgl {
+
+//
+// FUNCTIONS
+//
+
+// Runtime checks for instruction set support. These always return false if
+// VGL_SIMD_X86 isn't defined.
+bool cpuHasSSSE3();
+bool cpuHasSSE41();
+bool cpuHasAVX();
+bool cpuHasF16C();
+bool cpuHasAVX2();
+bool cpuHasAVX512F();
+
+
+} // namespace vgl
+
+#endif // vgl_simd_h
@@ -0,0 +1,560 @@
+#include "vgl_tiledimage.h"
+
+#include "vgl_convert.h"
+#include "vgl_pixelpool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <sys/types.h>
+#include <tiffio.h>
+
+
+namespace vgl {
+
+//
+// HELPER FUNCTIONS
+//
+
+// Exceptions can't be allowed to escape from a parallel loop, so the tiled
+// kernels catch them per tile and rethrow the first one afterwards.
+struct KernelError {
+  bool failed;
+  std::string message;
+
+  KernelError() : failed(false), message() {}
+
+  void record(const ImageException& ex)
+  {
+    #pragma omp critical (vgl_tilekernel)
+    if (!failed) {
+      failed = true;
+      message = ex.what();
+    }
+  }
+
+  void rethrow() const throw(ImageException)
+  {
+    if (failed)
+      throw ImageException("%s", message.c_str());
+  }
+};
+
+
+// Holds a mutex for the lifetime of a scope.
+class MutexLock {
+public:
+  MutexLock(pthread_mutex_t* mutex) : _mutex(mutex) { pthread_mutex_lock(_mutex); }
+  ~MutexLock() { pthread_mutex_unlock(_mutex); }
+
+private:
+  pthread_mutex_t* _mutex;
+};
+
+
+//
+// TiledImage METHODS
+//
+
+TiledImage::TiledImage(int type, int bytesPerPixel, unsigned int width, unsigned int height,
+    int pixelType, ImageOrigin origin, unsigned int tileWidth, unsigned int tileHeight,
+    size_t cacheBytes) :
+  _type(type),
+  _pixelType(pixelType),
+  _bytesPerPixel(bytesPerPixel),
+  _width(width),
+  _height(height),
+  _origin(origin),
+  _tileWidth(tileWidth),
+  _tileHeight(tileHeight),
+  _tilesX(0),
+  _tilesY(0),
+  _tileBytes(0),
+  _cacheBytes(cacheBytes),
+  _residentBytes(0),
+  _tiles(),
+  _lru(),
+  _tiff(NULL),
+  _spill(NULL)
+{
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_ioDone, NULL);
+  pthread_mutex_init(&_ioMutex, NULL);
+  initTiles();
+}
+
+
+TiledImage::TiledImage(const char* path, size_t cacheBytes) throw(ImageException) :
+  _type(GL_RGB),
+  _pixelType(GL_UNSIGNED_BYTE),
+  _bytesPerPixel(0),
+  _width(0),
+  _height(0),
+  _origin(ORIGIN_TOP_LEFT),
+  _tileWidth(0),
+  _tileHeight(0),
+  _tilesX(0),
+  _tilesY(0),
+  _tileBytes(0),
+  _cacheBytes(cacheBytes),
+  _residentBytes(0),
+  _tiles(),
+  _lru(),
+  _tiff(NULL),
+  _spill(NULL)
+{
+  _tiff = TIFFOpen(path, "r");
+  if (_tiff == NULL)
+    throw ImageException("Unable to open TIFF file: %s.", path);
+
+  uint16 bitsPerSample = 8, samplesPerPixel = 1, sampleFormat = SAMPLEFORMAT_UINT;
+  uint16 planarConfig = PLANARCONFIG_CONTIG, photometric = PHOTOMETRIC_RGB;
+  uint32 tileWidth = 0, tileHeight = 0;
+  TIFFGetField(_tiff, TIFFTAG_IMAGEWIDTH, &_width);
+  TIFFGetField(_tiff, TIFFTAG_IMAGELENGTH, &_height);
+  TIFFGetField(_tiff, TIFFTAG_TILEWIDTH, &tileWidth);
+  TIFFGetField(_tiff, TIFFTAG_TILELENGTH, &tileHeight);
+  TIFFGetField(_tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+  TIFFGetFieldDefaulted(_tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+  TIFFGetFieldDefaulted(_tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+  TIFFGetFieldDefaulted(_tiff, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+  TIFFGetFieldDefaulted(_tiff, TIFFTAG_PLANARCONFIG, &planarConfig);
+
+  bool supported = TIFFIsTiled(_tiff) && tileWidth > 0 && tileHeight > 0 &&
+      ((bitsPerSample == 8 && sampleFormat == SAMPLEFORMAT_UINT) ||
+       (bitsPerSample == 16 && sampleFormat == SAMPLEFORMAT_UINT) ||
+       (bitsPerSample == 16 && sampleFormat == SAMPLEFORMAT_IEEEFP) ||
+       (bitsPerSample == 32 && sampleFormat == SAMPLEFORMAT_IEEEFP)) &&
+      samplesPerPixel >= 1 && samplesPerPixel <= 4 &&
+      planarConfig == PLANARCONFIG_CONTIG &&
+      (photometric == PHOTOMETRIC_MINISBLACK || photometric == PHOTOMETRIC_RGB);
+  if (!supported) {
+    TIFFClose(_tiff);
+    throw ImageException("Unsupported TIFF for tiled access: %s. It must be tiled, "
+        "contiguous, greyscale or RGB, with 8 or 16 bit integer or 16 or 32 bit float samples.", path);
+  }
+
+  static const int kTypes[] = { 0, GL_ALPHA, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+  _type = kTypes[samplesPerPixel];
+  if (sampleFormat == SAMPLEFORMAT_UINT)
+    _pixelType = (bitsPerSample == 8) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+  else
+    _pixelType = (bitsPerSample == 16) ? GL_HALF_FLOAT : GL_FLOAT;
+  _bytesPerPixel = samplesPerPixel * bitsPerSample / 8;
+  _tileWidth = tileWidth;
+  _tileHeight = tileHeight;
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_ioDone, NULL);
+  pthread_mutex_init(&_ioMutex, NULL);
+  initTiles();
+}
+
+
+TiledImage::~TiledImage()
+{
+  for (size_t i = 0; i < _tiles.size(); ++i)
+    freePixels(_tiles[i].data);
+  if (_tiff != NULL)
+    TIFFClose(_tiff);
+  if (_spill != NULL)
+    fclose(_spill);
+  pthread_mutex_destroy(&_ioMutex);
+  pthread_cond_destroy(&_ioDone);
+  pthread_mutex_destroy(&_mutex);
+}
+
+
+int TiledImage::getType() const
+{
+  return _type;
+}
+
+
+int TiledImage::getPixelType() const
+{
+  return _pixelType;
+}
+
+
+unsigned int TiledImage::getBytesPerPixel() const
+{
+  return _bytesPerPixel;
+}
+
+
+unsigned int TiledImage::getWidth() const
+{
+  return _width;
+}
+
+
+unsigned int TiledImage::getHeight() const
+{
+  return _height;
+}
+
+
+ImageOrigin TiledImage::getOrigin() const
+{
+  return _origin;
+}
+
+
+unsigned int TiledImage::getTileWidth() const
+{
+  return _tileWidth;
+}
+
+
+unsigned int TiledImage::getTileHeight() const
+{
+  return _tileHeight;
+}
+
+
+unsigned int TiledImage::getTilesX() const
+{
+  return _tilesX;
+}
+
+
+unsigned int TiledImage::getTilesY() const
+{
+  return _tilesY;
+}
+
+
+size_t TiledImage::getTileBytes() const
+{
+  return _tileBytes;
+}
+
+
+size_t TiledImage::getCacheBytes() const
+{
+  return _cacheBytes;
+}
+
+
+void TiledImage::setCacheBytes(size_t cacheBytes) throw(ImageException)
+{
+  bool ok;
+  {
+    MutexLock lock(&_mutex);
+    _cacheBytes = cacheBytes;
+    ok = evictDownTo(_cacheBytes);
+  }
+  if (!ok)
+    throw ImageException("Unable to write to the tile spill file.");
+}
+
+
+size_t TiledImage::getResidentBytes() const
+{
+  MutexLock lock(&_mutex);
+  return _residentBytes;
+}
+
+
+const unsigned char* TiledImage::lockTile(unsigned int tx, unsigned int ty) throw(ImageException)
+{
+  return acquireTile(tx, ty, false);
+}
+
+
+unsigned char* TiledImage::lockTileForWriting(unsigned int tx, unsigned int ty) throw(ImageException)
+{
+  return acquireTile(tx, ty, true);
+}
+
+
+void TiledImage::unlockTile(unsigned int tx, unsigned int ty)
+{
+  unsigned int index = ty * _tilesX + tx;
+  MutexLock lock(&_mutex);
+  Tile& tile = _tiles[index];
+  if (tile.locks > 0 && --tile.locks == 0) {
+    tile.lruPos = _lru.insert(_lru.end(), index);
+    tile.cached = true;
+    // Tiles locked while the cache was full can leave it over budget.
+    evictDownTo(_cacheBytes);
+  }
+}
+
+
+void TiledImage::readTile(unsigned int tx, unsigned int ty, void* dst) throw(ImageException)
+{
+  memcpy(dst, lockTile(tx, ty), _tileBytes);
+  unlockTile(tx, ty);
+}
+
+
+void TiledImage::writeTile(unsigned int tx, unsigned int ty, const void* src) throw(ImageException)
+{
+  memcpy(lockTileForWriting(tx, ty), src, _tileBytes);
+  unlockTile(tx, ty);
+}
+
+
+void TiledImage::initTiles()
+{
+  _tilesX = (_width + _tileWidth - 1) / _tileWidth;
+  _tilesY = (_height + _tileHeight - 1) / _tileHeight;
+  _tileBytes = size_t(_tileWidth) * _tileHeight * _bytesPerPixel;
+
+  Tile blank;
+  blank.data = NULL;
+  blank.dirty = false;
+  blank.spilled = false;
+  blank.locks = 0;
+  blank.cached = false;
+  blank.busy = false;
+  _tiles.assign(size_t(_tilesX) * _tilesY, blank);
+}
+
+
+unsigned char* TiledImage::acquireTile(unsigned int tx, unsigned int ty, bool forWriting)
+  throw(ImageException)
+{
+  if (tx >= _tilesX || ty >= _tilesY)
+    throw ImageException("Tile (%u, %u) is outside the image.", tx, ty);
+
+  unsigned int index = ty * _tilesX + tx;
+  unsigned char* data = NULL;
+  bool ok = true;
+  {
+    MutexLock lock(&_mutex);
+    Tile& tile = _tiles[index];
+    while (true) {
+      while (tile.busy)
+        pthread_cond_wait(&_ioDone, &_mutex);
+      if (tile.data != NULL)
+        break;
+
+      // Making room can drop the lock, so another thread may have started
+      // reading the tile in by the time it's done.
+      ok = evictDownTo(_cacheBytes > _tileBytes ? _cacheBytes - _tileBytes : 0);
+      if (!ok)
+        break;
+      if (tile.busy || tile.data != NULL)
+        continue;
+
+      tile.data = allocPixels(_tileBytes);
+      _residentBytes += _tileBytes;
+      tile.busy = true;
+      pthread_mutex_unlock(&_mutex);
+      ok = loadTile(index);
+      pthread_mutex_lock(&_mutex);
+      tile.busy = false;
+      pthread_cond_broadcast(&_ioDone);
+      if (!ok) {
+        freePixels(tile.data);
+        tile.data = NULL;
+        _residentBytes -= _tileBytes;
+      }
+      break;
+    }
+
+    if (ok) {
+      if (tile.cached) {
+        _lru.erase(tile.lruPos);
+        tile.cached = false;
+      }
+      ++tile.locks;
+      if (forWriting)
+        tile.dirty = true;
+      data = tile.data;
+    }
+  }
+  if (!ok)
+    throw ImageException("Unable to page in tile (%u, %u).", tx, ty);
+  return data;
+}
+
+
+// Drops unlocked tiles, least recently used first, until the cache is using no
+// more than the given number of bytes or there's nothing left to drop. Must be
+// called with the cache lock held, which is released while modified tiles are
+// written to the spill file.
+bool TiledImage::evictDownTo(size_t bytes)
+{
+  while (_residentBytes > bytes && !_lru.empty()) {
+    unsigned int index = _lru.front();
+    Tile& tile = _tiles[index];
+    _lru.pop_front();
+    tile.cached = false;
+
+    if (tile.dirty) {
+      // Nothing can lock the tile while it's busy, so its pixels can't
+      // change until it's gone.
+      tile.busy = true;
+      pthread_mutex_unlock(&_mutex);
+      bool ok = spillTile(index);
+      pthread_mutex_lock(&_mutex);
+      tile.busy = false;
+      pthread_cond_broadcast(&_ioDone);
+      if (!ok) {
+        tile.lruPos = _lru.insert(_lru.begin(), index);
+        tile.cached = true;
+        return false;
+      }
+      tile.dirty = false;
+      tile.spilled = true;
+    }
+
+    freePixels(tile.data);
+    tile.data = NULL;
+    _residentBytes -= _tileBytes;
+  }
+  return true;
+}
+
+
+// Fills in a tile's pixels from wherever they live. Called without the cache
+// lock held, while the tile is marked as busy.
+bool TiledImage::loadTile(unsigned int index)
+{
+  Tile& tile = _tiles[index];
+  if (tile.spilled) {
+    MutexLock io(&_ioMutex);
+    return fseeko(_spill, off_t(index) * off_t(_tileBytes), SEEK_SET) == 0 &&
+           fread(tile.data, 1, _tileBytes, _spill) == _tileBytes;
+  } else if (_tiff != NULL) {
+    uint32 x = (index % _tilesX) * _tileWidth;
+    uint32 y = (index / _tilesX) * _tileHeight;
+    MutexLock io(&_ioMutex);
+    return TIFFReadEncodedTile(_tiff, TIFFComputeTile(_tiff, x, y, 0, 0), tile.data, _tileBytes) >= 0;
+  } else {
+    memset(tile.data, 0, _tileBytes);
+    return true;
+  }
+}
+
+
+// Writes a tile's pixels to the spill file. Called without the cache lock
+// held, while the tile is marked as busy.
+bool TiledImage::spillTile(unsigned int index)
+{
+  MutexLock io(&_ioMutex);
+  if (_spill == NULL)
+    _spill = tmpfile();
+  if (_spill == NULL)
+    return false;
+
+  const Tile& tile = _tiles[index];
+  return fseeko(_spill, off_t(index) * off_t(_tileBytes), SEEK_SET) == 0 &&
+         fwrite(tile.data, 1, _tileBytes, _spill) == _tileBytes;
+}
+
+
+//
+// FUNCTIONS
+//
+
+TiledImage* downsample(TiledImage* src, unsigned int downsampleX, unsigned int downsampleY)
+  throw(ImageException)
+{
+  TiledImage* dst = new TiledImage(src->getType(), src->getBytesPerPixel(),
+      src->getWidth() / downsampleX, src->getHeight() / downsampleY,
+      src->getPixelType(), src->getOrigin(),
+      src->getTileWidth(), src->getTileHeight(), src->getCacheBytes());
+
+  const unsigned int tw = dst->getTileWidth();
+  const unsigned int th = dst->getTileHeight();
+  const unsigned int bpp = dst->getBytesPerPixel();
+  const int numTiles = dst->getTilesX() * dst->getTilesY();
+  KernelError error;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < numTiles; ++t) {
+    unsigned int tx = t % dst->getTilesX();
+    unsigned int ty = t / dst->getTilesX();
+    unsigned int x0 = tx * tw, x1 = std::min(x0 + tw, dst->getWidth());
+    unsigned int y0 = ty * th, y1 = std::min(y0 + th, dst->getHeight());
+    try {
+      unsigned char* out = dst->lockTileForWriting(tx, ty);
+
+      // Work through the source tiles this one samples from, so each is only
+      // locked once.
+      unsigned int stx0 = x0 * downsampleX / tw, stx1 = (x1 - 1) * downsampleX / tw;
+      unsigned int sty0 = y0 * downsampleY / th, sty1 = (y1 - 1) * downsampleY / th;
+      for (unsigned int sty = sty0; sty <= sty1; ++sty) {
+        for (unsigned int stx = stx0; stx <= stx1; ++stx) {
+          const unsigned char* in = src->lockTile(stx, sty);
+          for (unsigned int y = y0; y < y1; ++y) {
+            unsigned int sy = y * downsampleY;
+            if (sy / th != sty)
+              continue;
+            const unsigned char* inRow = in + size_t(sy % th) * tw * bpp;
+            unsigned char* outRow = out + size_t(y - y0) * tw * bpp;
+            for (unsigned int x = x0; x < x1; ++x) {
+              unsigned int sx = x * downsampleX;
+              if (sx / tw == stx)
+                memcpy(outRow + size_t(x - x0) * bpp, inRow + size_t(sx % tw) * bpp, bpp);
+            }
+          }
+          src->unlockTile(stx, sty);
+        }
+      }
+
+      dst->unlockTile(tx, ty);
+    } catch (ImageException& ex) {
+      error.record(ex);
+    }
+  }
+
+  if (error.failed) {
+    delete dst;
+    error.rethrow();
+  }
+  return dst;
+}
+
+
+TiledImage* convertTiled(TiledImage* src, int targetType, int targetPixelType)
+  throw(ImageException)
+{
+  unsigned int dstBytesPerPixel = channelsForType(targetType) * bytesPerChannelForPixelType(targetPixelType);
+  if (channelsForType(src->getType()) == 0 || bytesPerChannelForPixelType(src->getPixelType()) == 0 ||
+      dstBytesPerPixel == 0)
+    throw ImageException("Unsupported pixel format conversion.");
+
+  TiledImage* dst = new TiledImage(targetType, dstBytesPerPixel,
+      src->getWidth(), src->getHeight(), targetPixelType, src->getOrigin(),
+      src->getTileWidth(), src->getTileHeight(), src->getCacheBytes());
+
+  const int numTiles = dst->getTilesX() * dst->getTilesY();
+  KernelError error;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < numTiles; ++t) {
+    unsigned int tx = t % dst->getTilesX();
+    unsigned int ty = t / dst->getTilesX();
+    try {
+      const unsigned char* in = src->lockTile(tx, ty);
+      unsigned char* out;
+      try {
+        out = dst->lockTileForWriting(tx, ty);
+      } catch (ImageException&) {
+        src->unlockTile(tx, ty);
+        throw;
+      }
+      convertPixels(in, src->getType(), out, targetType,
+          src->getTileWidth(), src->getTileHeight(), src->getPixelType(), targetPixelType);
+      dst->unlockTile(tx, ty);
+      src->unlockTile(tx, ty);
+    } catch (ImageException& ex) {
+      error.record(ex);
+    }
+  }
+
+  if (error.failed) {
+    delete dst;
+    error.rethrow();
+  }
+  return dst;
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,140 @@
+#ifndef vgl_tiledimage_h
+#define vgl_tiledimage_h
+
+#include "vgl_image.h"
+
+#include <cstdio>
+#include <list>
+#include <pthread.h>
+#include <vector>
+
+struct tiff;
+
+namespace vgl {
+
+//
+// Types
+//
+
+// An image which is too big to hold in memory all at once. The pixels are
+// split into fixed size tiles and only the most recently used tiles are kept
+// in memory, up to a budget of cacheBytes. Tiles which get pushed out of the
+// cache after being modified are written to a temporary spill file and read
+// back from there when they're next needed.
+//
+// An image can either start out blank (all zeros) or be backed by a tiled
+// TIFF file, in which case tiles are read from the file on demand and the
+// tile size is whatever the file uses. The TIFF is never written to: changes
+// go to the spill file like they do for a blank image.
+//
+// Every tile is a full tileWidth x tileHeight block of pixels, stored row by
+// row, even where it hangs off the edge of the image. Tiles are
+// accessed by locking them, which keeps them in memory until they're unlocked
+// again. Locking and unlocking are thread safe. Tiles are read and spilled
+// without holding the cache lock, so threads only wait for IO on the tile
+// they want; reads and writes of the TIFF and spill files are serialised.
+class TiledImage {
+public:
+  static const unsigned int kDefaultTileSize = 256;
+  static const size_t kDefaultCacheBytes = size_t(256) << 20;
+
+  TiledImage(int type, int bytesPerPixel, unsigned int width, unsigned int height,
+      int pixelType = GL_UNSIGNED_BYTE, ImageOrigin origin = ORIGIN_BOTTOM_LEFT,
+      unsigned int tileWidth = kDefaultTileSize, unsigned int tileHeight = kDefaultTileSize,
+      size_t cacheBytes = kDefaultCacheBytes);
+  //! Open a tiled TIFF. The image has ORIGIN_TOP_LEFT, like the file.
+  TiledImage(const char* path, size_t cacheBytes = kDefaultCacheBytes) throw(ImageException);
+  ~TiledImage();
+
+  int getType() const;
+  int getPixelType() const;
+  unsigned int getBytesPerPixel() const;
+  unsigned int getWidth() const;
+  unsigned int getHeight() const;
+  ImageOrigin getOrigin() const;
+
+  unsigned int getTileWidth() const;
+  unsigned int getTileHeight() const;
+  unsigned int getTilesX() const;
+  unsigned int getTilesY() const;
+  size_t getTileBytes() const;
+
+  size_t getCacheBytes() const;
+  void setCacheBytes(size_t cacheBytes) throw(ImageException);
+  //! How much memory the tiles currently in the cache are using.
+  size_t getResidentBytes() const;
+
+  //! Lock a tile in memory and return its pixels. Every lock must be matched
+  //! by a call to unlockTile. Locking for writing marks the tile as modified.
+  const unsigned char* lockTile(unsigned int tx, unsigned int ty) throw(ImageException);
+  unsigned char* lockTileForWriting(unsigned int tx, unsigned int ty) throw(ImageException);
+  void unlockTile(unsigned int tx, unsigned int ty);
+
+  //! Copy a whole tile out of or into the image, getTileBytes() at a time.
+  void readTile(unsigned int tx, unsigned int ty, void* dst) throw(ImageException);
+  void writeTile(unsigned int tx, unsigned int ty, const void* src) throw(ImageException);
+
+private:
+  struct Tile {
+    unsigned char* data;
+    bool dirty;
+    bool spilled;
+    unsigned int locks;
+    bool cached;
+    bool busy; // Being read in or spilled, without the cache lock held.
+    std::list<unsigned int>::iterator lruPos;
+  };
+
+  // Not copyable.
+  TiledImage(const TiledImage& other);
+  TiledImage& operator = (const TiledImage& other);
+
+  void initTiles();
+  unsigned char* acquireTile(unsigned int tx, unsigned int ty, bool forWriting) throw(ImageException);
+  bool evictDownTo(size_t bytes);
+  bool loadTile(unsigned int index);
+  bool spillTile(unsigned int index);
+
+private:
+  int _type;
+  int _pixelType;
+  unsigned int _bytesPerPixel;
+  unsigned int _width, _height;
+  ImageOrigin _origin;
+  unsigned int _tileWidth, _tileHeight;
+  unsigned int _tilesX, _tilesY;
+  size_t _tileBytes;
+
+  size_t _cacheBytes;
+  size_t _residentBytes;
+  std::vector<Tile> _tiles;
+  std::list<unsigned int> _lru; // Unlocked tiles in memory, least recently used first.
+
+  struct tiff* _tiff;
+  FILE* _spill;
+  mutable pthread_mutex_t _mutex;
+  pthread_cond_t _ioDone;
+  pthread_mutex_t _ioMutex; // Guards _tiff and _spill.
+};
+
+
+//
+// Functions
+//
+
+// These work through the destination image a tile at a time, in parallel.
+// The result has the same tile size and cache budget as the source.
+
+//! Point sampled downsampling, like downsample() for a RawImage.
+TiledImage* downsample(TiledImage* src, unsigned int downsampleX, unsigned int downsampleY)
+  throw(ImageException);
+
+//! Convert to a different layout and/or pixel type, as per convertPixels().
+TiledImage* convertTiled(TiledImage* src, int targetType, int targetPixelType)
+  throw(ImageException);
+
+
+} // namespace vgl
+
+#endif // vgl_tiledimage_h
+
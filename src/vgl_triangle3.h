@@ -0,0 +1,141 @@
+#ifndef vgl_triangle3_h
+#define vgl_triangle3_h
+
+#include "vgl_ray3.h"
+#include "vgl_vec3.h"
+
+namespace vgl {
+
+//
+// TYPES
+//
+
+// Triangles stored in forms which make the ray test cheaper, for when a
+// triangle is going to be tested against lots of rays. Both give the same
+// results as intersectRayTriangle, apart from rounding: t is the distance
+// along the ray and u and v are the barycentric weights of v1 and v2. Both
+// sides of the triangle count.
+//
+// Building either costs about as much as a few ray tests, so they're only
+// worth it if they can be built once and kept, e.g. alongside a mesh.
+
+
+// Woop's unit triangle transform ("Real-time ray tracing of dynamic scenes on
+// an FPGA chip", 2004): an affine transform which takes the triangle to the
+// one with corners (0,0,0), (1,0,0) and (0,1,0). A ray transformed the same
+// way hits the z = 0 plane at the barycentrics of the hit, so the test is
+// just three dot products per ray component. Degenerate triangles give
+// infinities or NaNs here, which no ray hits.
+template <typename Num>
+struct TriangleWoop {
+  Vec3<Num> row[3]; // The transform, as rows plus a translation.
+  Num offset[3];
+
+  TriangleWoop() {}
+  TriangleWoop(const Vec3<Num>& v0, const Vec3<Num>& v1, const Vec3<Num>& v2)
+  {
+    // The inverse of the matrix with columns e1, e2 and n. With n at right
+    // angles to both edges, the last row comes out as n / |n|^2.
+    Vec3<Num> e1 = v1 - v0, e2 = v2 - v0;
+    Vec3<Num> n = cross(e1, e2);
+    Num invDet = 1 / dot(n, n);
+    row[0] = cross(e2, n) * invDet;
+    row[1] = cross(n, e1) * invDet;
+    row[2] = n * invDet;
+    for (unsigned int i = 0; i < 3; ++i)
+      offset[i] = -dot(row[i], v0);
+  }
+};
+
+
+// The edges of the triangle as Plucker coordinates, plus its plane. Which
+// side of an edge a ray passes is a single permuted inner product between
+// the two lines, and the three results are the barycentrics of the hit,
+// scaled. The edges come out the same for a triangle sharing them, so like
+// intersectRayTriangleWatertight, rays can't slip between two triangles.
+// The moments grow with distance from the origin though, so precision drops
+// for triangles a long way from it.
+template <typename Num>
+struct TrianglePlucker {
+  // Edge i is the one opposite vertex i: direction and moment.
+  Vec3<Num> edge[3], moment[3];
+  Vec3<Num> normal; // Not normalised.
+  Num planeDist;    // dot(normal, v0).
+
+  TrianglePlucker() {}
+  TrianglePlucker(const Vec3<Num>& v0, const Vec3<Num>& v1, const Vec3<Num>& v2)
+  {
+    edge[0] = v2 - v1;
+    edge[1] = v0 - v2;
+    edge[2] = v1 - v0;
+    moment[0] = cross(v1, v2);
+    moment[1] = cross(v2, v0);
+    moment[2] = cross(v0, v1);
+    normal = cross(v1 - v0, v2 - v0);
+    planeDist = dot(normal, v0);
+  }
+};
+
+
+typedef TriangleWoop<float> TriangleWoopf;
+typedef TriangleWoop<double> TriangleWoopd;
+
+typedef TrianglePlucker<float> TrianglePluckerf;
+typedef TrianglePlucker<double> TrianglePluckerd;
+
+
+//
+// FUNCTIONS
+//
+
+template <typename Num>
+bool intersectRayTriangle(const Ray3<Num>& ray, const TriangleWoop<Num>& tri, Num& t, Num& u, Num& v)
+{
+  const Num kMinT = Num(1e-4);
+
+  // Where the transformed ray crosses z = 0.
+  Num dz = dot(tri.row[2], ray.d);
+  if (dz == 0)
+    return false;
+  t = -(dot(tri.row[2], ray.o) + tri.offset[2]) / dz;
+  if (!(t > kMinT))
+    return false;
+
+  u = dot(tri.row[0], ray.o) + tri.offset[0] + t * dot(tri.row[0], ray.d);
+  if (!(u >= 0 && u <= 1))
+    return false;
+
+  v = dot(tri.row[1], ray.o) + tri.offset[1] + t * dot(tri.row[1], ray.d);
+  return v >= 0 && u + v <= 1;
+}
+
+
+template <typename Num>
+bool intersectRayTriangle(const Ray3<Num>& ray, const TrianglePlucker<Num>& tri, Num& t, Num& u, Num& v)
+{
+  const Num kMinT = Num(1e-4);
+
+  // The ray's own moment, for the inner products with the edges.
+  Vec3<Num> m = cross(ray.o, ray.d);
+  Num w0 = dot(ray.d, tri.moment[0]) + dot(tri.edge[0], m);
+  Num w1 = dot(ray.d, tri.moment[1]) + dot(tri.edge[1], m);
+  Num w2 = dot(ray.d, tri.moment[2]) + dot(tri.edge[2], m);
+  if ((w0 < 0 || w1 < 0 || w2 < 0) && (w0 > 0 || w1 > 0 || w2 > 0))
+    return false;
+
+  Num sum = w0 + w1 + w2;
+  Num dn = dot(tri.normal, ray.d);
+  if (sum == 0 || dn == 0)
+    return false;
+
+  t = (tri.planeDist - dot(tri.normal, ray.o)) / dn;
+  Num invSum = 1 / sum;
+  u = w1 * invSum;
+  v = w2 * invSum;
+  return t > kMinT;
+}
+
+
+} // namespace vgl
+
+#endif // vgl_triangle3_h
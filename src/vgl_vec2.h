@@ -1,6 +1,7 @@
 #ifndef vgl_vec2_h
 #define vgl_vec2_h
 
+#include "vgl_fastmath.h"
 #include "vgl_utils.h"
 
 #include <algorithm>
@@ -235,6 +236,30 @@ Vec2<Num> rotate(const Vec2<Num>& a, Num radians)
 }
 
 
+//
+// Vec2 FUNCTIONS WITH A MATH POLICY
+//
+
+// These do the same as the functions above, using the math policy given as
+// the first template parameter (ExactMath or FastMath, from vgl_fastmath.h):
+// e.g. norm<FastMath>(v).
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec2<Num> >::Type norm(const Vec2<Num>& a)
+{
+  return a * Math::rsqrt(lengthSqr(a));
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec2<Num> >::Type rotate(const Vec2<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec2<Num>(c * a.x - s * a.y, s * a.x + c * a.y);
+}
+
+
 } // namespace vgl
 
 #endif // vgl_vec2_h
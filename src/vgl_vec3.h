@@ -1,6 +1,7 @@
 #ifndef vgl_vec3_h
 #define vgl_vec3_h
 
+#include "vgl_fastmath.h"
 #include "vgl_utils.h"
 
 #include <algorithm>
@@ -277,31 +278,68 @@ Vec3<Num> rotateZ(const Vec3<Num>& a, Num radians)
 }
 
 
+// Rotates a around axis, which needn't be unit length, using Rodrigues'
+// formula. To rotate many points by the same amount, build a matrix with
+// rotationMatrix(axis, radians) from vgl_matrix4.h instead.
 template <typename Num>
 Vec3<Num> rotate(const Vec3<Num>& a, const Vec3<Num>& axis, Num radians)
 {
   Num c = std::cos(radians);
-  Num s = std::cos(radians);
-
-  Vec3<Num> n = norm(axis);
-  Num x = n.x;
-  Num y = n.y;
-  Num z = n.z;
-
-  Vec3<Num> out(
-    ( (sqr(x) * (1 - c) + c) * a.x +
-      (x * y * (1 - c) - z * s) * a.y + 
-      (x * z * (1 - c) + y * s) * a.z ),
-
-    ( (y * x * (1 - c) + z * s) * a.x +
-      (sqr(y) * (1 - c) + c) * a.y +
-      (y * z * (1 - c) - x * s) * a.z ),
-
-    ( (x * z * (1 - c) - y * s) * a.x +
-      (y * z * (1 - c) + x * s) * a.y +
-      (sqr(z) * (1 - c) + c) * a.z )
-  );
-  return out;
+  Num s = std::sin(radians);
+  Vec3<Num> k = norm(axis);
+  return a * c + cross(k, a) * s + k * (dot(k, a) * (1 - c));
+}
+
+
+//
+// Vec3 FUNCTIONS WITH A MATH POLICY
+//
+
+// These do the same as the functions above, using the math policy given as
+// the first template parameter (ExactMath or FastMath, from vgl_fastmath.h):
+// e.g. norm<FastMath>(v).
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec3<Num> >::Type norm(const Vec3<Num>& a)
+{
+  return a * Math::rsqrt(lengthSqr(a));
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec3<Num> >::Type rotateX(const Vec3<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec3<Num>(a.x, c * a.y - s * a.z, s * a.y + c * a.z);
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec3<Num> >::Type rotateY(const Vec3<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec3<Num>(c * a.x + s * a.z, a.y, -s * a.x + c * a.z);
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec3<Num> >::Type rotateZ(const Vec3<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec3<Num>(c * a.x - s * a.y, s * a.x + c * a.y, a.z);
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec3<Num> >::Type rotate(const Vec3<Num>& a, const Vec3<Num>& axis, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  Vec3<Num> k = norm<Math>(axis);
+  return a * c + cross(k, a) * s + k * (dot(k, a) * (1 - c));
 }
 
 
@@ -0,0 +1,658 @@
+#include "vgl_vec3array.h"
+
+#include "vgl_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef VGL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+namespace vgl {
+
+//
+// CONSTANTS
+//
+
+const size_t Vec3Array::kAlignment;
+const size_t Vec3Array::kPadding;
+
+
+//
+// TYPES
+//
+
+// Which set of kernels to use.
+enum Vec3Kernels {
+  KERNELS_SCALAR,
+  KERNELS_AVX2,
+  KERNELS_AVX512
+};
+
+
+//
+// HELPER FUNCTIONS
+//
+
+static Vec3Kernels pickKernels()
+{
+  if (cpuHasAVX512F())
+    return KERNELS_AVX512;
+  if (cpuHasAVX2())
+    return KERNELS_AVX2;
+  return KERNELS_SCALAR;
+}
+
+
+// The number of floats the vector loops cover: the whole padded length.
+static size_t paddedSize(size_t size)
+{
+  return (size + Vec3Array::kPadding - 1) & ~(Vec3Array::kPadding - 1);
+}
+
+
+static void scalarAdd(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  for (size_t i = 0; i < a.getSize(); ++i) {
+    dst.getX()[i] = a.getX()[i] + b.getX()[i];
+    dst.getY()[i] = a.getY()[i] + b.getY()[i];
+    dst.getZ()[i] = a.getZ()[i] + b.getZ()[i];
+  }
+}
+
+
+static void scalarScale(const Vec3Array& a, float k, Vec3Array& dst)
+{
+  for (size_t i = 0; i < a.getSize(); ++i) {
+    dst.getX()[i] = a.getX()[i] * k;
+    dst.getY()[i] = a.getY()[i] * k;
+    dst.getZ()[i] = a.getZ()[i] * k;
+  }
+}
+
+
+static void scalarCross(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  for (size_t i = 0; i < a.getSize(); ++i) {
+    Vec3f v = cross(a.get(i), b.get(i));
+    dst.set(i, v);
+  }
+}
+
+
+static void scalarNorm(const Vec3Array& a, Vec3Array& dst)
+{
+  for (size_t i = 0; i < a.getSize(); ++i) {
+    Vec3f v = a.get(i);
+    float lenSqr = dot(v, v);
+    dst.set(i, v * ((lenSqr != 0.0f) ? 1.0f / std::sqrt(lenSqr) : 0.0f));
+  }
+}
+
+
+static void scalarDot(const Vec3Array& a, const Vec3Array& b, float* dst)
+{
+  for (size_t i = 0; i < a.getSize(); ++i)
+    dst[i] = a.getX()[i] * b.getX()[i] + a.getY()[i] * b.getY()[i] + a.getZ()[i] * b.getZ()[i];
+}
+
+
+// Reduces elements [first, size) into low and high.
+static void scalarMinMax(const Vec3Array& a, size_t first, Vec3f& low, Vec3f& high)
+{
+  for (size_t i = first; i < a.getSize(); ++i) {
+    low = pairwiseMin(low, a.get(i));
+    high = pairwiseMax(high, a.get(i));
+  }
+}
+
+
+static void scalarTransform(const Matrix4f& m, const Vec3Array& src, Vec3Array& dst)
+{
+  for (size_t i = 0; i < src.getSize(); ++i)
+    dst.set(i, transformPoint(m, src.get(i)));
+}
+
+
+#ifdef VGL_SIMD_X86
+
+//
+// AVX2 kernels
+//
+
+VGL_TARGET("avx2")
+static void avx2Add(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  size_t n = paddedSize(a.getSize());
+  const float* in[3][2] = {
+    { a.getX(), b.getX() }, { a.getY(), b.getY() }, { a.getZ(), b.getZ() }
+  };
+  float* out[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  for (unsigned int c = 0; c < 3; ++c) {
+    for (size_t i = 0; i < n; i += 8)
+      _mm256_store_ps(out[c] + i, _mm256_add_ps(_mm256_load_ps(in[c][0] + i), _mm256_load_ps(in[c][1] + i)));
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Scale(const Vec3Array& a, float k, Vec3Array& dst)
+{
+  size_t n = paddedSize(a.getSize());
+  const float* in[3] = { a.getX(), a.getY(), a.getZ() };
+  float* out[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  __m256 kv = _mm256_set1_ps(k);
+  for (unsigned int c = 0; c < 3; ++c) {
+    for (size_t i = 0; i < n; i += 8)
+      _mm256_store_ps(out[c] + i, _mm256_mul_ps(_mm256_load_ps(in[c] + i), kv));
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Cross(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  const float* pb[3] = { b.getX(), b.getY(), b.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(a.getSize());
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 ax = _mm256_load_ps(pa[0] + i), ay = _mm256_load_ps(pa[1] + i), az = _mm256_load_ps(pa[2] + i);
+    __m256 bx = _mm256_load_ps(pb[0] + i), by = _mm256_load_ps(pb[1] + i), bz = _mm256_load_ps(pb[2] + i);
+    _mm256_store_ps(pd[0] + i, _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by)));
+    _mm256_store_ps(pd[1] + i, _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz)));
+    _mm256_store_ps(pd[2] + i, _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx)));
+  }
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Norm(const Vec3Array& a, Vec3Array& dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(a.getSize());
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 x = _mm256_load_ps(pa[0] + i), y = _mm256_load_ps(pa[1] + i), z = _mm256_load_ps(pa[2] + i);
+    __m256 lenSqr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+    // Zero length vectors, including the padding, come out as zero, not NaN.
+    __m256 inv = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(lenSqr)),
+        _mm256_cmp_ps(lenSqr, zero, _CMP_NEQ_OQ));
+    _mm256_store_ps(pd[0] + i, _mm256_mul_ps(x, inv));
+    _mm256_store_ps(pd[1] + i, _mm256_mul_ps(y, inv));
+    _mm256_store_ps(pd[2] + i, _mm256_mul_ps(z, inv));
+  }
+}
+
+
+// dst isn't padded, so this one stops at the last whole vector.
+VGL_TARGET("avx2")
+static void avx2Dot(const Vec3Array& a, const Vec3Array& b, float* dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  const float* pb[3] = { b.getX(), b.getY(), b.getZ() };
+  size_t size = a.getSize();
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 sum = _mm256_mul_ps(_mm256_load_ps(pa[0] + i), _mm256_load_ps(pb[0] + i));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_load_ps(pa[1] + i), _mm256_load_ps(pb[1] + i)));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_load_ps(pa[2] + i), _mm256_load_ps(pb[2] + i)));
+    _mm256_storeu_ps(dst + i, sum);
+  }
+  for (; i < size; ++i)
+    dst[i] = pa[0][i] * pb[0][i] + pa[1][i] * pb[1][i] + pa[2][i] * pb[2][i];
+}
+
+
+VGL_TARGET("avx2")
+static void avx2MinMax(const Vec3Array& a, Vec3f& low, Vec3f& high)
+{
+  size_t whole = a.getSize() & ~size_t(7);
+  const float* in[3] = { a.getX(), a.getY(), a.getZ() };
+  for (unsigned int c = 0; c < 3; ++c) {
+    __m256 lo = _mm256_set1_ps(HUGE_VALF), hi = _mm256_set1_ps(-HUGE_VALF);
+    for (size_t i = 0; i < whole; i += 8) {
+      __m256 v = _mm256_load_ps(in[c] + i);
+      lo = _mm256_min_ps(lo, v);
+      hi = _mm256_max_ps(hi, v);
+    }
+    float los[8], his[8];
+    _mm256_storeu_ps(los, lo);
+    _mm256_storeu_ps(his, hi);
+    low[c] = *std::min_element(los, los + 8);
+    high[c] = *std::max_element(his, his + 8);
+  }
+  scalarMinMax(a, whole, low, high);
+}
+
+
+VGL_TARGET("avx2")
+static void avx2Transform(const Matrix4f& m, const Vec3Array& src, Vec3Array& dst)
+{
+  const float* ps[3] = { src.getX(), src.getY(), src.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(src.getSize());
+  __m256 k[12];
+  for (unsigned int i = 0; i < 12; ++i)
+    k[i] = _mm256_set1_ps(m.data[i]);
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 x = _mm256_load_ps(ps[0] + i), y = _mm256_load_ps(ps[1] + i), z = _mm256_load_ps(ps[2] + i);
+    float* out[3] = { pd[0] + i, pd[1] + i, pd[2] + i };
+    for (unsigned int row = 0; row < 3; ++row) {
+      __m256 sum = _mm256_add_ps(_mm256_mul_ps(x, k[row * 4]), _mm256_mul_ps(y, k[row * 4 + 1]));
+      sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_mul_ps(z, k[row * 4 + 2]), k[row * 4 + 3]));
+      _mm256_store_ps(out[row], sum);
+    }
+  }
+}
+
+
+//
+// AVX-512 kernels
+//
+
+VGL_TARGET("avx512f")
+static void avx512Add(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  size_t n = paddedSize(a.getSize());
+  const float* in[3][2] = {
+    { a.getX(), b.getX() }, { a.getY(), b.getY() }, { a.getZ(), b.getZ() }
+  };
+  float* out[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  for (unsigned int c = 0; c < 3; ++c) {
+    for (size_t i = 0; i < n; i += 16)
+      _mm512_store_ps(out[c] + i, _mm512_add_ps(_mm512_load_ps(in[c][0] + i), _mm512_load_ps(in[c][1] + i)));
+  }
+}
+
+
+VGL_TARGET("avx512f")
+static void avx512Scale(const Vec3Array& a, float k, Vec3Array& dst)
+{
+  size_t n = paddedSize(a.getSize());
+  const float* in[3] = { a.getX(), a.getY(), a.getZ() };
+  float* out[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  __m512 kv = _mm512_set1_ps(k);
+  for (unsigned int c = 0; c < 3; ++c) {
+    for (size_t i = 0; i < n; i += 16)
+      _mm512_store_ps(out[c] + i, _mm512_mul_ps(_mm512_load_ps(in[c] + i), kv));
+  }
+}
+
+
+VGL_TARGET("avx512f")
+static void avx512Cross(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  const float* pb[3] = { b.getX(), b.getY(), b.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(a.getSize());
+  for (size_t i = 0; i < n; i += 16) {
+    __m512 ax = _mm512_load_ps(pa[0] + i), ay = _mm512_load_ps(pa[1] + i), az = _mm512_load_ps(pa[2] + i);
+    __m512 bx = _mm512_load_ps(pb[0] + i), by = _mm512_load_ps(pb[1] + i), bz = _mm512_load_ps(pb[2] + i);
+    _mm512_store_ps(pd[0] + i, _mm512_fmsub_ps(ay, bz, _mm512_mul_ps(az, by)));
+    _mm512_store_ps(pd[1] + i, _mm512_fmsub_ps(az, bx, _mm512_mul_ps(ax, bz)));
+    _mm512_store_ps(pd[2] + i, _mm512_fmsub_ps(ax, by, _mm512_mul_ps(ay, bx)));
+  }
+}
+
+
+VGL_TARGET("avx512f")
+static void avx512Norm(const Vec3Array& a, Vec3Array& dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(a.getSize());
+  const __m512 one = _mm512_set1_ps(1.0f);
+  for (size_t i = 0; i < n; i += 16) {
+    __m512 x = _mm512_load_ps(pa[0] + i), y = _mm512_load_ps(pa[1] + i), z = _mm512_load_ps(pa[2] + i);
+    __m512 lenSqr = _mm512_fmadd_ps(z, z, _mm512_fmadd_ps(y, y, _mm512_mul_ps(x, x)));
+    // Zero length vectors, including the padding, come out as zero, not NaN.
+    __mmask16 nonZero = _mm512_cmp_ps_mask(lenSqr, _mm512_setzero_ps(), _CMP_NEQ_OQ);
+    __m512 inv = _mm512_maskz_div_ps(nonZero, one, _mm512_maskz_sqrt_ps(nonZero, lenSqr));
+    _mm512_store_ps(pd[0] + i, _mm512_mul_ps(x, inv));
+    _mm512_store_ps(pd[1] + i, _mm512_mul_ps(y, inv));
+    _mm512_store_ps(pd[2] + i, _mm512_mul_ps(z, inv));
+  }
+}
+
+
+// The last partial vector is written with a mask, since dst isn't padded.
+VGL_TARGET("avx512f")
+static void avx512Dot(const Vec3Array& a, const Vec3Array& b, float* dst)
+{
+  const float* pa[3] = { a.getX(), a.getY(), a.getZ() };
+  const float* pb[3] = { b.getX(), b.getY(), b.getZ() };
+  size_t size = a.getSize();
+  for (size_t i = 0; i < size; i += 16) {
+    __m512 sum = _mm512_mul_ps(_mm512_load_ps(pa[0] + i), _mm512_load_ps(pb[0] + i));
+    sum = _mm512_fmadd_ps(_mm512_load_ps(pa[1] + i), _mm512_load_ps(pb[1] + i), sum);
+    sum = _mm512_fmadd_ps(_mm512_load_ps(pa[2] + i), _mm512_load_ps(pb[2] + i), sum);
+    size_t left = size - i;
+    __mmask16 mask = (left >= 16) ? __mmask16(0xFFFF) : __mmask16((1u << left) - 1);
+    _mm512_mask_storeu_ps(dst + i, mask, sum);
+  }
+}
+
+
+// Padding lanes in the last vector are masked out of the comparisons.
+VGL_TARGET("avx512f")
+static void avx512MinMax(const Vec3Array& a, Vec3f& low, Vec3f& high)
+{
+  size_t size = a.getSize();
+  const float* in[3] = { a.getX(), a.getY(), a.getZ() };
+  for (unsigned int c = 0; c < 3; ++c) {
+    __m512 lo = _mm512_set1_ps(HUGE_VALF), hi = _mm512_set1_ps(-HUGE_VALF);
+    for (size_t i = 0; i < size; i += 16) {
+      size_t left = size - i;
+      __mmask16 mask = (left >= 16) ? __mmask16(0xFFFF) : __mmask16((1u << left) - 1);
+      __m512 v = _mm512_load_ps(in[c] + i);
+      lo = _mm512_mask_min_ps(lo, mask, lo, v);
+      hi = _mm512_mask_max_ps(hi, mask, hi, v);
+    }
+    float los[16], his[16];
+    _mm512_storeu_ps(los, lo);
+    _mm512_storeu_ps(his, hi);
+    low[c] = *std::min_element(los, los + 16);
+    high[c] = *std::max_element(his, his + 16);
+  }
+}
+
+
+VGL_TARGET("avx512f")
+static void avx512Transform(const Matrix4f& m, const Vec3Array& src, Vec3Array& dst)
+{
+  const float* ps[3] = { src.getX(), src.getY(), src.getZ() };
+  float* pd[3] = { dst.getX(), dst.getY(), dst.getZ() };
+  size_t n = paddedSize(src.getSize());
+  __m512 k[12];
+  for (unsigned int i = 0; i < 12; ++i)
+    k[i] = _mm512_set1_ps(m.data[i]);
+  for (size_t i = 0; i < n; i += 16) {
+    __m512 x = _mm512_load_ps(ps[0] + i), y = _mm512_load_ps(ps[1] + i), z = _mm512_load_ps(ps[2] + i);
+    float* out[3] = { pd[0] + i, pd[1] + i, pd[2] + i };
+    for (unsigned int row = 0; row < 3; ++row) {
+      __m512 sum = _mm512_fmadd_ps(x, k[row * 4], k[row * 4 + 3]);
+      sum = _mm512_fmadd_ps(y, k[row * 4 + 1], sum);
+      sum = _mm512_fmadd_ps(z, k[row * 4 + 2], sum);
+      _mm512_store_ps(out[row], sum);
+    }
+  }
+}
+
+#endif // VGL_SIMD_X86
+
+
+//
+// Vec3Array METHODS
+//
+
+Vec3Array::Vec3Array() :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+}
+
+
+Vec3Array::Vec3Array(size_t size) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  resize(size);
+}
+
+
+Vec3Array::Vec3Array(const std::vector<Vec3f>& src) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  fromVector(src);
+}
+
+
+Vec3Array::Vec3Array(const Vec3Array& other) :
+  _size(0),
+  _capacity(0),
+  _data(NULL)
+{
+  *this = other;
+}
+
+
+Vec3Array::~Vec3Array()
+{
+  free(_data);
+}
+
+
+Vec3Array& Vec3Array::operator = (const Vec3Array& other)
+{
+  if (this != &other) {
+    resize(other._size);
+    memcpy(getX(), other.getX(), _size * sizeof(float));
+    memcpy(getY(), other.getY(), _size * sizeof(float));
+    memcpy(getZ(), other.getZ(), _size * sizeof(float));
+  }
+  return *this;
+}
+
+
+size_t Vec3Array::getSize() const
+{
+  return _size;
+}
+
+
+void Vec3Array::resize(size_t size)
+{
+  size_t capacity = paddedSize(size);
+  if (capacity > _capacity) {
+    void* mem = NULL;
+    if (posix_memalign(&mem, kAlignment, capacity * 3 * sizeof(float)) != 0)
+      throw std::bad_alloc();
+    float* data = (float*)mem;
+    // Zero everything, so the padding doesn't hold NaNs or denormals which
+    // could slow the kernels down.
+    memset(data, 0, capacity * 3 * sizeof(float));
+    for (unsigned int c = 0; c < 3 && _data != NULL; ++c)
+      memcpy(data + c * capacity, _data + c * _capacity, _size * sizeof(float));
+    free(_data);
+    _data = data;
+    _capacity = capacity;
+  }
+  _size = size;
+}
+
+
+float* Vec3Array::getX()
+{
+  return _data;
+}
+
+
+float* Vec3Array::getY()
+{
+  return _data + _capacity;
+}
+
+
+float* Vec3Array::getZ()
+{
+  return _data + _capacity * 2;
+}
+
+
+const float* Vec3Array::getX() const
+{
+  return _data;
+}
+
+
+const float* Vec3Array::getY() const
+{
+  return _data + _capacity;
+}
+
+
+const float* Vec3Array::getZ() const
+{
+  return _data + _capacity * 2;
+}
+
+
+Vec3f Vec3Array::get(size_t i) const
+{
+  return Vec3f(_data[i], _data[_capacity + i], _data[_capacity * 2 + i]);
+}
+
+
+void Vec3Array::set(size_t i, const Vec3f& v)
+{
+  _data[i] = v.x;
+  _data[_capacity + i] = v.y;
+  _data[_capacity * 2 + i] = v.z;
+}
+
+
+void Vec3Array::fromVector(const std::vector<Vec3f>& src)
+{
+  resize(src.size());
+  float* x = getX();
+  float* y = getY();
+  float* z = getZ();
+  for (size_t i = 0; i < _size; ++i) {
+    x[i] = src[i].x;
+    y[i] = src[i].y;
+    z[i] = src[i].z;
+  }
+}
+
+
+void Vec3Array::toVector(std::vector<Vec3f>& dst) const
+{
+  dst.resize(_size);
+  const float* x = getX();
+  const float* y = getY();
+  const float* z = getZ();
+  for (size_t i = 0; i < _size; ++i) {
+    dst[i].x = x[i];
+    dst[i].y = y[i];
+    dst[i].z = z[i];
+  }
+}
+
+
+//
+// FUNCTIONS
+//
+
+void add(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  dst.resize(a.getSize());
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Add(a, b, dst); return;
+    case KERNELS_AVX2:   avx2Add(a, b, dst); return;
+    default: break;
+  }
+#endif
+  scalarAdd(a, b, dst);
+}
+
+
+void scale(const Vec3Array& a, float k, Vec3Array& dst)
+{
+  dst.resize(a.getSize());
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Scale(a, k, dst); return;
+    case KERNELS_AVX2:   avx2Scale(a, k, dst); return;
+    default: break;
+  }
+#endif
+  scalarScale(a, k, dst);
+}
+
+
+void cross(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst)
+{
+  dst.resize(a.getSize());
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Cross(a, b, dst); return;
+    case KERNELS_AVX2:   avx2Cross(a, b, dst); return;
+    default: break;
+  }
+#endif
+  scalarCross(a, b, dst);
+}
+
+
+void norm(const Vec3Array& a, Vec3Array& dst)
+{
+  dst.resize(a.getSize());
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Norm(a, dst); return;
+    case KERNELS_AVX2:   avx2Norm(a, dst); return;
+    default: break;
+  }
+#endif
+  scalarNorm(a, dst);
+}
+
+
+void dot(const Vec3Array& a, const Vec3Array& b, float* dst)
+{
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Dot(a, b, dst); return;
+    case KERNELS_AVX2:   avx2Dot(a, b, dst); return;
+    default: break;
+  }
+#endif
+  scalarDot(a, b, dst);
+}
+
+
+void reduceMinMax(const Vec3Array& a, Vec3f& low, Vec3f& high)
+{
+  low = Vec3f(HUGE_VALF);
+  high = Vec3f(-HUGE_VALF);
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512MinMax(a, low, high); return;
+    case KERNELS_AVX2:   avx2MinMax(a, low, high); return;
+    default: break;
+  }
+#endif
+  scalarMinMax(a, 0, low, high);
+}
+
+
+void transformPoints(const Matrix4f& m, const Vec3Array& src, Vec3Array& dst)
+{
+  dst.resize(src.getSize());
+#ifdef VGL_SIMD_X86
+  switch (pickKernels()) {
+    case KERNELS_AVX512: avx512Transform(m, src, dst); return;
+    case KERNELS_AVX2:   avx2Transform(m, src, dst); return;
+    default: break;
+  }
+#endif
+  scalarTransform(m, src, dst);
+}
+
+
+} // namespace vgl
+
@@ -0,0 +1,92 @@
+#ifndef vgl_vec3array_h
+#define vgl_vec3array_h
+
+#include "vgl_matrix4.h"
+#include "vgl_vec3.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace vgl {
+
+//
+// Types
+//
+
+// An array of Vec3fs stored as structure-of-arrays: all the x values, then all
+// the y values, then all the z values, so a SIMD register can hold the same
+// component of 8 or 16 vectors at once.
+//
+// Each component array starts on a 64 byte boundary and is padded out to a
+// multiple of 16 floats. The bulk functions below rely on that to run their
+// vector loops past the end instead of having scalar leftovers; what ends up
+// in the padding is undefined.
+class Vec3Array {
+public:
+  static const size_t kAlignment = 64;
+  static const size_t kPadding = 16;
+
+  Vec3Array();
+  explicit Vec3Array(size_t size);
+  explicit Vec3Array(const std::vector<Vec3f>& src);
+  Vec3Array(const Vec3Array& other);
+  ~Vec3Array();
+
+  Vec3Array& operator = (const Vec3Array& other);
+
+  size_t getSize() const;
+  //! Keeps the existing values up to the new size; new values are undefined.
+  //! Doesn't reallocate unless the array grows past its capacity.
+  void resize(size_t size);
+
+  float* getX();
+  float* getY();
+  float* getZ();
+  const float* getX() const;
+  const float* getY() const;
+  const float* getZ() const;
+
+  Vec3f get(size_t i) const;
+  void set(size_t i, const Vec3f& v);
+
+  void fromVector(const std::vector<Vec3f>& src);
+  void toVector(std::vector<Vec3f>& dst) const;
+
+private:
+  size_t _size;
+  size_t _capacity; // Padded length of each component array.
+  float* _data;     // The x array, followed by y and then z.
+};
+
+
+//
+// Functions
+//
+
+// Bulk operations on whole arrays. Each has AVX2 and AVX-512 kernels, picked
+// at runtime according to what the CPU supports, and a scalar fallback.
+//
+// dst is resized to match the first input and may be the same array as
+// either input. Where there are two inputs, b must be at least as long as a.
+
+void add(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst);
+void scale(const Vec3Array& a, float k, Vec3Array& dst);
+void cross(const Vec3Array& a, const Vec3Array& b, Vec3Array& dst);
+//! Vectors of zero length stay zero.
+void norm(const Vec3Array& a, Vec3Array& dst);
+
+//! dst must have room for a.getSize() floats.
+void dot(const Vec3Array& a, const Vec3Array& b, float* dst);
+
+//! The smallest and largest of each component, found in a single pass. The
+//! empty array gives +inf and -inf respectively.
+void reduceMinMax(const Vec3Array& a, Vec3f& low, Vec3f& high);
+
+//! Transforms every element as a point, like transformPoint.
+void transformPoints(const Matrix4f& m, const Vec3Array& src, Vec3Array& dst);
+
+
+} // namespace vgl
+
+#endif // vgl_vec3array_h
+
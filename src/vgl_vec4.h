@@ -1,11 +1,17 @@
 #ifndef vgl_vec4_h
 #define vgl_vec4_h
 
+#include "vgl_fastmath.h"
+#include "vgl_simd.h"
 #include "vgl_utils.h"
 
 #include <algorithm>
 #include <cmath>
 
+#ifdef VGL_SIMD_SSE2
+#include <xmmintrin.h>
+#endif
+
 namespace vgl {
 
 //
@@ -292,6 +298,175 @@ Vec4<Num> rotateZ(const Vec4<Num>& a, Num radians)
 }
 
 
+//
+// Vec4 FUNCTIONS WITH A MATH POLICY
+//
+
+// These do the same as the functions above, using the math policy given as
+// the first template parameter (ExactMath or FastMath, from vgl_fastmath.h):
+// e.g. norm<FastMath>(v).
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec4<Num> >::Type norm(const Vec4<Num>& a)
+{
+  return a * Math::rsqrt(lengthSqr(a));
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec4<Num> >::Type rotateX(const Vec4<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec4<Num>(a.x, c * a.y - s * a.z, s * a.y + c * a.z, a.w);
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec4<Num> >::Type rotateY(const Vec4<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec4<Num>(c * a.x + s * a.z, a.y, -s * a.x + c * a.z, a.w);
+}
+
+
+template <typename Math, typename Num>
+typename MathPolicy<Math, Vec4<Num> >::Type rotateZ(const Vec4<Num>& a, Num radians)
+{
+  Num s, c;
+  Math::sincos(radians, s, c);
+  return Vec4<Num>(c * a.x - s * a.y, s * a.x + c * a.y, a.z, a.w);
+}
+
+
+//
+// Vec4f SIMD OVERLOADS
+//
+
+// These do all four components of a Vec4f at once with SSE. Being ordinary
+// functions, overload resolution picks them over the templates above; without
+// SSE2 the templates are used instead.
+#ifdef VGL_SIMD_SSE2
+
+inline __m128 toM128(const Vec4f& a)
+{
+  return _mm_loadu_ps(a.data);
+}
+
+
+inline Vec4f toVec4f(__m128 v)
+{
+  Vec4f result;
+  _mm_storeu_ps(result.data, v);
+  return result;
+}
+
+
+inline Vec4f operator - (const Vec4f& a)
+{
+  return toVec4f(_mm_sub_ps(_mm_setzero_ps(), toM128(a)));
+}
+
+
+inline Vec4f operator + (const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_add_ps(toM128(a), toM128(b)));
+}
+
+
+inline Vec4f operator - (const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_sub_ps(toM128(a), toM128(b)));
+}
+
+
+inline Vec4f operator * (const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_mul_ps(toM128(a), toM128(b)));
+}
+
+
+inline Vec4f operator * (const Vec4f& a, float k)
+{
+  return toVec4f(_mm_mul_ps(toM128(a), _mm_set1_ps(k)));
+}
+
+
+inline Vec4f operator * (float k, const Vec4f& a)
+{
+  return toVec4f(_mm_mul_ps(toM128(a), _mm_set1_ps(k)));
+}
+
+
+inline Vec4f operator / (const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_div_ps(toM128(a), toM128(b)));
+}
+
+
+inline Vec4f operator / (const Vec4f& a, float k)
+{
+  return toVec4f(_mm_div_ps(toM128(a), _mm_set1_ps(k)));
+}
+
+
+inline const Vec4f& operator += (Vec4f& a, const Vec4f& b)
+{
+  _mm_storeu_ps(a.data, _mm_add_ps(toM128(a), toM128(b)));
+  return a;
+}
+
+
+inline const Vec4f& operator -= (Vec4f& a, const Vec4f& b)
+{
+  _mm_storeu_ps(a.data, _mm_sub_ps(toM128(a), toM128(b)));
+  return a;
+}
+
+
+inline const Vec4f& operator *= (Vec4f& a, const Vec4f& b)
+{
+  _mm_storeu_ps(a.data, _mm_mul_ps(toM128(a), toM128(b)));
+  return a;
+}
+
+
+inline const Vec4f& operator *= (Vec4f& a, float k)
+{
+  _mm_storeu_ps(a.data, _mm_mul_ps(toM128(a), _mm_set1_ps(k)));
+  return a;
+}
+
+
+inline const Vec4f& operator /= (Vec4f& a, const Vec4f& b)
+{
+  _mm_storeu_ps(a.data, _mm_div_ps(toM128(a), toM128(b)));
+  return a;
+}
+
+
+inline const Vec4f& operator /= (Vec4f& a, float k)
+{
+  _mm_storeu_ps(a.data, _mm_div_ps(toM128(a), _mm_set1_ps(k)));
+  return a;
+}
+
+
+inline Vec4f pairwiseMin(const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_min_ps(toM128(a), toM128(b)));
+}
+
+
+inline Vec4f pairwiseMax(const Vec4f& a, const Vec4f& b)
+{
+  return toVec4f(_mm_max_ps(toM128(a), toM128(b)));
+}
+
+#endif // VGL_SIMD_SSE2
+
+
 } // namespace vgl
 
 #endif // vgl_vec4_h
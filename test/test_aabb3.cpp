@@ -0,0 +1,217 @@
+#include "vgl_aabb3.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(b));
+}
+
+
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b)
+{
+  return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z);
+}
+
+
+static bool equal(const vgl::AABB3f& a, const vgl::AABB3f& b)
+{
+  return a.low.x == b.low.x && a.low.y == b.low.y && a.low.z == b.low.z &&
+         a.high.x == b.high.x && a.high.y == b.high.y && a.high.z == b.high.z;
+}
+
+
+static std::vector<vgl::Vec3f> makePoints(size_t count)
+{
+  std::vector<vgl::Vec3f> points(count);
+  for (size_t i = 0; i < count; ++i)
+    points[i] = vgl::Vec3f(std::sin(i * 1.3f) * i, std::cos(i * 0.7f) * 2.0f, i * 0.25f - 3.0f);
+  return points;
+}
+
+
+//
+// TESTS
+//
+
+class TestAABB3 : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestAABB3);
+  CPPUNIT_TEST(testEmpty);
+  CPPUNIT_TEST(testMerge);
+  CPPUNIT_TEST(testIntersection);
+  CPPUNIT_TEST(testSurfaceArea);
+  CPPUNIT_TEST(testTransform);
+  CPPUNIT_TEST(testRay);
+  CPPUNIT_TEST(testSlabRay);
+  CPPUNIT_TEST(testComputeBounds);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testEmpty() {
+    vgl::AABB3f box;
+    CPPUNIT_ASSERT( vgl::isEmpty(box) );
+    CPPUNIT_ASSERT( !vgl::contains(box, vgl::Vec3f(0, 0, 0)) );
+    CPPUNIT_ASSERT( vgl::surfaceArea(box) == 0.0f );
+
+    // A single point is a box with no size, but it's not empty.
+    box = vgl::merge(box, vgl::Vec3f(1, 2, 3));
+    CPPUNIT_ASSERT( !vgl::isEmpty(box) );
+    CPPUNIT_ASSERT( vgl::contains(box, vgl::Vec3f(1, 2, 3)) );
+    CPPUNIT_ASSERT( vgl::surfaceArea(box) == 0.0f );
+  }
+
+  void testMerge() {
+    vgl::AABB3f a(vgl::Vec3f(0, 0, 0), vgl::Vec3f(1, 1, 1));
+    vgl::AABB3f b(vgl::Vec3f(-1, 0.5f, 2), vgl::Vec3f(0.5f, 3, 4));
+    vgl::AABB3f c = vgl::merge(a, b);
+    CPPUNIT_ASSERT( equal(c, vgl::AABB3f(vgl::Vec3f(-1, 0, 0), vgl::Vec3f(1, 3, 4))) );
+    CPPUNIT_ASSERT( equal(vgl::merge(a, vgl::AABB3f()), a) );
+    CPPUNIT_ASSERT( equal(vgl::merge(vgl::AABB3f(), a), a) );
+    CPPUNIT_ASSERT( close(vgl::center(c), vgl::Vec3f(0, 1.5f, 2)) );
+    CPPUNIT_ASSERT( close(vgl::extent(c), vgl::Vec3f(2, 3, 4)) );
+  }
+
+  void testIntersection() {
+    vgl::AABB3f a(vgl::Vec3f(0, 0, 0), vgl::Vec3f(2, 2, 2));
+    vgl::AABB3f b(vgl::Vec3f(1, -1, 1), vgl::Vec3f(3, 1, 1.5f));
+    CPPUNIT_ASSERT( vgl::overlaps(a, b) );
+    CPPUNIT_ASSERT( equal(vgl::intersection(a, b), vgl::AABB3f(vgl::Vec3f(1, 0, 1), vgl::Vec3f(2, 1, 1.5f))) );
+
+    vgl::AABB3f c(vgl::Vec3f(2.5f, 0, 0), vgl::Vec3f(3, 1, 1));
+    CPPUNIT_ASSERT( !vgl::overlaps(a, c) );
+    CPPUNIT_ASSERT( vgl::isEmpty(vgl::intersection(a, c)) );
+    CPPUNIT_ASSERT( !vgl::overlaps(a, vgl::AABB3f()) );
+  }
+
+  void testSurfaceArea() {
+    vgl::AABB3f box(vgl::Vec3f(-1, 0, 2), vgl::Vec3f(1, 3, 6));
+    CPPUNIT_ASSERT( close(vgl::surfaceArea(box), 2.0f * (2 * 3 + 3 * 4 + 4 * 2)) );
+  }
+
+  void testTransform() {
+    // Should match the bounds of the eight transformed corners.
+    vgl::AABB3f box(vgl::Vec3f(-1, 0.5f, 2), vgl::Vec3f(3, 1, 4));
+    vgl::Matrix4f m = vgl::trs(vgl::Vec3f(5, -2, 1),
+                               vgl::rotation(vgl::Vec3f(0.3f, 1.0f, -0.5f), 0.9f),
+                               vgl::Vec3f(2, 0.5f, -1));
+    vgl::AABB3f expected;
+    for (unsigned int corner = 0; corner < 8; ++corner) {
+      vgl::Vec3f p((corner & 1) ? box.high.x : box.low.x,
+                   (corner & 2) ? box.high.y : box.low.y,
+                   (corner & 4) ? box.high.z : box.low.z);
+      expected = vgl::merge(expected, vgl::transformPoint(m, p));
+    }
+    vgl::AABB3f result = vgl::transformBox(m, box);
+    CPPUNIT_ASSERT( close(result.low, expected.low) && close(result.high, expected.high) );
+
+    CPPUNIT_ASSERT( vgl::isEmpty(vgl::transformBox(m, vgl::AABB3f())) );
+  }
+
+  void testRay() {
+    vgl::AABB3f box(vgl::Vec3f(-1, -1, -1), vgl::Vec3f(1, 2, 3));
+    float tNear, tFar;
+
+    // Straight through along x.
+    vgl::Ray3f ray(vgl::Vec3f(-5, 0, 0), vgl::Vec3f(1, 0, 0));
+    CPPUNIT_ASSERT( vgl::intersectRayBox(ray, box, tNear, tFar) );
+    CPPUNIT_ASSERT( close(tNear, 4.0f) && close(tFar, 6.0f) );
+
+    // Starting inside.
+    ray = vgl::Ray3f(vgl::Vec3f(0, 0, 0), vgl::Vec3f(0, 0, 2));
+    CPPUNIT_ASSERT( vgl::intersectRayBox(ray, box, tNear, tFar) );
+    CPPUNIT_ASSERT( close(tNear, -0.5f) && close(tFar, 1.5f) );
+
+    // Pointing away, and passing to one side.
+    ray = vgl::Ray3f(vgl::Vec3f(-5, 0, 0), vgl::Vec3f(-1, 0, 0));
+    CPPUNIT_ASSERT( !vgl::intersectRayBox(ray, box, tNear, tFar) );
+    ray = vgl::Ray3f(vgl::Vec3f(-5, 2.5f, 0), vgl::Vec3f(1, 0, 0));
+    CPPUNIT_ASSERT( !vgl::intersectRayBox(ray, box, tNear, tFar) );
+
+    // Diagonal, hitting the corner region.
+    ray = vgl::Ray3f(vgl::Vec3f(-3, -3, -3), vgl::Vec3f(1, 1, 1));
+    CPPUNIT_ASSERT( vgl::intersectRayBox(ray, box, tNear, tFar) );
+    CPPUNIT_ASSERT( close(tNear, 2.0f) && close(tFar, 4.0f) );
+  }
+
+  void testSlabRay() {
+    // Should agree with the plain slab test, including for directions with
+    // zero or negative components.
+    vgl::AABB3f box(vgl::Vec3f(-1, -1, -1), vgl::Vec3f(1, 2, 3));
+    size_t hits = 0;
+    for (unsigned int i = 0; i < 200; ++i) {
+      vgl::Vec3f o(std::sin(i * 1.3f) * 4.0f, std::cos(i * 0.7f) * 4.0f, std::sin(i * 0.4f) * 4.0f);
+      // Mostly towards points in or near the box.
+      vgl::Vec3f target(std::sin(i * 2.1f) * 1.5f, std::cos(i * 1.7f) * 2.0f + 0.5f, std::sin(i * 0.9f) * 2.5f + 1.0f);
+      vgl::Vec3f d = target - o;
+      if (i % 5 == 0)
+        d[i % 3] = 0.0f;
+      vgl::Ray3f ray(o + vgl::Vec3f(0.01f, 0.02f, 0.03f), d);
+
+      float tNear, tFar, tNear2, tFar2;
+      bool expected = vgl::intersectRayBox(ray, box, tNear, tFar);
+      CPPUNIT_ASSERT( vgl::intersectRayBox(vgl::SlabRay3f(ray), box, tNear2, tFar2) == expected );
+      if (expected) {
+        CPPUNIT_ASSERT( close(tNear2, tNear) && close(tFar2, tFar) );
+        ++hits;
+      }
+    }
+    CPPUNIT_ASSERT( hits > 20 );
+  }
+
+  void testComputeBounds() {
+    // Sizes either side of each kernel width and of the OpenMP block size.
+    const size_t kSizes[] = { 0, 1, 3, 4, 5, 8, 15, 16, 17, 47, 48, 49, 100, 65536, 65537, 200001 };
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+      std::vector<vgl::Vec3f> points = makePoints(kSizes[s] + 1);
+      // The extra point is out past everything else, so reading it would show.
+      points[kSizes[s]] = vgl::Vec3f(1e9f, -1e9f, 1e9f);
+
+      vgl::AABB3f expected;
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected = vgl::merge(expected, points[i]);
+      CPPUNIT_ASSERT( equal(vgl::computeBounds(&points[0], kSizes[s]), expected) );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestAABB3);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+#include "vgl_atlas.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Every image gets its own pattern, so any mixup shows.
+static unsigned char pattern(unsigned int image, unsigned int x, unsigned int y, unsigned int channel)
+{
+  return (unsigned char)(image * 37 + x * 5 + y * 11 + channel * 64);
+}
+
+
+// An RGB image filled with its pattern, with y counting rows from the start
+// of the pixel data.
+static vgl::RawImage* makeImage(unsigned int image, unsigned int width, unsigned int height,
+    vgl::ImageOrigin origin = vgl::ORIGIN_BOTTOM_LEFT)
+{
+  vgl::RawImage* img = new vgl::RawImage(GL_RGB, 3, width, height, GL_UNSIGNED_BYTE, origin);
+  unsigned char* p = img->getPixels();
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      for (unsigned int c = 0; c < 3; ++c)
+        *p++ = pattern(image, x, y, c);
+    }
+  }
+  return img;
+}
+
+
+static std::vector<vgl::RawImage*> makeRandomImages(unsigned int count, unsigned int maxSize)
+{
+  srand(count);
+  std::vector<vgl::RawImage*> images;
+  for (unsigned int i = 0; i < count; ++i)
+    images.push_back(makeImage(i, 1 + rand() % maxSize, 1 + rand() % maxSize));
+  return images;
+}
+
+
+static void deleteImages(std::vector<vgl::RawImage*>& images)
+{
+  for (size_t i = 0; i < images.size(); ++i)
+    delete images[i];
+  images.clear();
+}
+
+
+static bool overlaps(const vgl::AtlasRect& a, const vgl::AtlasRect& b, unsigned int padding)
+{
+  return a.page == b.page &&
+         a.x < b.x + b.width + 2 * padding && b.x < a.x + a.width + 2 * padding &&
+         a.y < b.y + b.height + 2 * padding && b.y < a.y + a.height + 2 * padding;
+}
+
+
+// The RGBA pixel at x, y on an atlas page.
+static const unsigned char* pagePixel(vgl::TextureAtlas& atlas, unsigned int page, unsigned int x, unsigned int y)
+{
+  vgl::RawImage* img = atlas.getPage(page);
+  return img->getPixels() + (size_t(y) * img->getWidth() + x) * 4;
+}
+
+
+// Checks that the image was copied into its rectangle, with the padding
+// around it filled from the nearest edge pixel. flipped says whether the image
+// had the other origin to the page.
+static bool copiedCorrectly(vgl::TextureAtlas& atlas, unsigned int image, unsigned int padding, bool flipped)
+{
+  const vgl::AtlasRect& r = atlas.getRect(image);
+  for (int y = -(int)padding; y < (int)(r.height + padding); ++y) {
+    for (int x = -(int)padding; x < (int)(r.width + padding); ++x) {
+      unsigned int sx = (unsigned int)std::max(0, std::min(x, (int)r.width - 1));
+      unsigned int sy = (unsigned int)std::max(0, std::min(y, (int)r.height - 1));
+      if (flipped)
+        sy = r.height - 1 - sy;
+      const unsigned char* p = pagePixel(atlas, r.page, r.x + x, r.y + y);
+      for (unsigned int c = 0; c < 3; ++c) {
+        if (p[c] != pattern(image, sx, sy, c))
+          return false;
+      }
+      if (p[3] != 255)
+        return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestAtlas : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestAtlas);
+  CPPUNIT_TEST(testPacking);
+  CPPUNIT_TEST(testPixels);
+  CPPUNIT_TEST(testOrigin);
+  CPPUNIT_TEST(testRemapUV);
+  CPPUNIT_TEST(testPages);
+  CPPUNIT_TEST(testTooBig);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testPacking() {
+    const unsigned int kPadding = 2;
+    std::vector<vgl::RawImage*> images = makeRandomImages(300, 40);
+    vgl::TextureAtlas atlas(256, 256, kPadding);
+    atlas.build(&images[0], images.size());
+
+    // Every image is placed, on a page, with its padding on the page too, and
+    // nothing overlaps.
+    unsigned long area = 0;
+    for (unsigned int i = 0; i < images.size(); ++i) {
+      const vgl::AtlasRect& r = atlas.getRect(i);
+      CPPUNIT_ASSERT( r.page < atlas.getNumPages() );
+      CPPUNIT_ASSERT( r.width == images[i]->getWidth() && r.height == images[i]->getHeight() );
+      CPPUNIT_ASSERT( r.x >= kPadding && r.x + r.width + kPadding <= 256 );
+      CPPUNIT_ASSERT( r.y >= kPadding && r.y + r.height + kPadding <= 256 );
+      for (unsigned int j = 0; j < i; ++j)
+        CPPUNIT_ASSERT( !overlaps(r, atlas.getRect(j), kPadding) );
+      area += (r.width + 2 * kPadding) * (r.height + 2 * kPadding);
+    }
+
+    // The packing should be reasonably tight.
+    CPPUNIT_ASSERT( atlas.getNumPages() <= area / (256 * 256) + 2 );
+    for (unsigned int page = 0; page < atlas.getNumPages(); ++page) {
+      CPPUNIT_ASSERT( atlas.getPage(page)->getWidth() == 256 );
+      CPPUNIT_ASSERT( atlas.getPage(page)->getType() == GL_RGBA );
+    }
+    deleteImages(images);
+  }
+
+  void testPixels() {
+    std::vector<vgl::RawImage*> images = makeRandomImages(50, 30);
+    vgl::TextureAtlas atlas(128, 128, 3);
+    atlas.build(&images[0], images.size());
+    for (unsigned int i = 0; i < images.size(); ++i)
+      CPPUNIT_ASSERT( copiedCorrectly(atlas, i, 3, false) );
+
+    // Building again replaces everything.
+    deleteImages(images);
+    images = makeRandomImages(20, 60);
+    atlas.build(&images[0], images.size());
+    for (unsigned int i = 0; i < images.size(); ++i)
+      CPPUNIT_ASSERT( copiedCorrectly(atlas, i, 3, false) );
+    deleteImages(images);
+  }
+
+  void testOrigin() {
+    // Images with a top left origin get flipped to match the pages.
+    std::vector<vgl::RawImage*> images;
+    images.push_back(makeImage(0, 7, 5, vgl::ORIGIN_TOP_LEFT));
+    images.push_back(makeImage(1, 9, 4));
+    vgl::TextureAtlas atlas(32, 32, 1);
+    atlas.build(&images[0], images.size());
+    CPPUNIT_ASSERT( copiedCorrectly(atlas, 0, 1, true) );
+    CPPUNIT_ASSERT( copiedCorrectly(atlas, 1, 1, false) );
+    deleteImages(images);
+  }
+
+  void testRemapUV() {
+    std::vector<vgl::RawImage*> images = makeRandomImages(10, 20);
+    vgl::TextureAtlas atlas(64, 128);
+    atlas.build(&images[0], images.size());
+    for (unsigned int i = 0; i < images.size(); ++i) {
+      const vgl::AtlasRect& r = atlas.getRect(i);
+      float u = 0.0f, v = 0.0f;
+      atlas.remapUV(i, u, v);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL( u, r.x / 64.0, 1e-6 );
+      CPPUNIT_ASSERT_DOUBLES_EQUAL( v, r.y / 128.0, 1e-6 );
+      u = 1.0f;
+      v = 0.5f;
+      atlas.remapUV(i, u, v);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL( u, (r.x + r.width) / 64.0, 1e-6 );
+      CPPUNIT_ASSERT_DOUBLES_EQUAL( v, (r.y + r.height * 0.5) / 128.0, 1e-6 );
+    }
+    deleteImages(images);
+  }
+
+  void testPages() {
+    // Images which only fit one to a page, with a page size that isn't a
+    // power of two.
+    std::vector<vgl::RawImage*> images;
+    for (unsigned int i = 0; i < 4; ++i)
+      images.push_back(makeImage(i, 30, 17));
+    vgl::TextureAtlas atlas(50, 21, 2);
+    atlas.build(&images[0], images.size());
+    CPPUNIT_ASSERT( atlas.getNumPages() == 4 );
+    for (unsigned int i = 0; i < 4; ++i) {
+      CPPUNIT_ASSERT( atlas.getRect(i).page == i );
+      CPPUNIT_ASSERT( copiedCorrectly(atlas, i, 2, false) );
+    }
+    deleteImages(images);
+  }
+
+  void testTooBig() {
+    // The image fits the page, but not with its padding.
+    vgl::RawImage* img = makeImage(0, 32, 8);
+    vgl::TextureAtlas atlas(32, 32, 1);
+    CPPUNIT_ASSERT_THROW( atlas.build(&img, 1), vgl::ImageException );
+    delete img;
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestAtlas);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
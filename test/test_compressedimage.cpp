@@ -0,0 +1,410 @@
+#include "vgl_compressedimage.h"
+#include "vgl_mipchain.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Smooth gradients in every channel, with a size that isn't a multiple of the
+// block size.
+static vgl::RawImage* makeTestImage()
+{
+  const unsigned int width = 61, height = 46;
+  vgl::RawImage* img = new vgl::RawImage(GL_RGBA, 4, width, height);
+  unsigned char* pixels = img->getPixels();
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      unsigned char* p = pixels + (y * width + x) * 4;
+      float fx = x / float(width), fy = y / float(height);
+      p[0] = (unsigned char)(255 * fx);
+      p[1] = (unsigned char)(255 * fy);
+      p[2] = (unsigned char)(127.5f + 127.5f * std::sin(fx * 20.0f) * std::cos(fy * 13.0f));
+      p[3] = (unsigned char)(255 * (1.0f - fx * fy));
+    }
+  }
+  return img;
+}
+
+
+static double roundTripPSNR(vgl::BlockFormat format, unsigned int numChannels)
+{
+  vgl::RawImage* img = makeTestImage();
+  vgl::CompressedImage compressed(img, format);
+  vgl::RawImage* decompressed = compressed.decompress();
+  double psnr = vgl::computePSNR(img, decompressed, numChannels);
+  delete decompressed;
+  delete img;
+  return psnr;
+}
+
+
+static void putLE32(FILE* file, unsigned int value)
+{
+  for (unsigned int i = 0; i < 4; ++i)
+    fputc((value >> (i * 8)) & 0xFF, file);
+}
+
+
+// Writes a minimal DXT5 DDS file holding every level of img.
+static void writeDDS(const char* path, const vgl::CompressedImage& img)
+{
+  FILE* file = fopen(path, "wb");
+  fwrite("DDS ", 1, 4, file);
+  putLE32(file, 124);
+  putLE32(file, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // caps, height, width, format, mip count
+  putLE32(file, img.getHeight());
+  putLE32(file, img.getWidth());
+  putLE32(file, 0);
+  putLE32(file, 0);
+  putLE32(file, img.getNumLevels());
+  for (unsigned int i = 0; i < 11; ++i)
+    putLE32(file, 0);
+  putLE32(file, 32);
+  putLE32(file, 0x4); // fourCC
+  fwrite("DXT5", 1, 4, file);
+  for (unsigned int i = 0; i < 5; ++i)
+    putLE32(file, 0);
+  putLE32(file, 0x1000);
+  for (unsigned int i = 0; i < 4; ++i)
+    putLE32(file, 0);
+  for (unsigned int level = 0; level < img.getNumLevels(); ++level)
+    fwrite(img.getLevelData(level), 1, img.getLevelSize(level), file);
+  fclose(file);
+}
+
+
+static void putBE32(FILE* file, unsigned int value)
+{
+  for (unsigned int i = 0; i < 4; ++i)
+    fputc((value >> ((3 - i) * 8)) & 0xFF, file);
+}
+
+
+static void putLE64(FILE* file, unsigned long long value)
+{
+  putLE32(file, (unsigned int)(value & 0xFFFFFFFF));
+  putLE32(file, (unsigned int)(value >> 32));
+}
+
+
+// Writes a KTX file holding every level of img, in either byte order, with a
+// KTXorientation key if orientation isn't NULL.
+static void writeKTX(const char* path, const vgl::CompressedImage& img, unsigned int glInternalFormat,
+    bool bigEndian, const char* orientation)
+{
+  void (*put32)(FILE*, unsigned int) = bigEndian ? putBE32 : putLE32;
+  const char* kKey = "KTXorientation";
+  size_t pairBytes = orientation ? strlen(kKey) + 1 + strlen(orientation) + 1 : 0;
+  size_t paddedPairBytes = (pairBytes + 3) & ~size_t(3);
+
+  FILE* file = fopen(path, "wb");
+  const unsigned char kIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+  fwrite(kIdentifier, 1, 12, file);
+  put32(file, 0x04030201);
+  put32(file, 0);      // glType
+  put32(file, 1);      // glTypeSize
+  put32(file, 0);      // glFormat
+  put32(file, glInternalFormat);
+  put32(file, 0x1908); // glBaseInternalFormat, GL_RGBA
+  put32(file, img.getWidth());
+  put32(file, img.getHeight());
+  put32(file, 0);      // pixelDepth
+  put32(file, 0);      // numberOfArrayElements
+  put32(file, 1);      // numberOfFaces
+  put32(file, img.getNumLevels());
+  put32(file, orientation ? unsigned(4 + paddedPairBytes) : 0);
+  if (orientation) {
+    put32(file, (unsigned int)pairBytes);
+    fwrite(kKey, 1, strlen(kKey) + 1, file);
+    fwrite(orientation, 1, strlen(orientation) + 1, file);
+    for (size_t i = pairBytes; i < paddedPairBytes; ++i)
+      fputc(0, file);
+  }
+  for (unsigned int level = 0; level < img.getNumLevels(); ++level) {
+    put32(file, (unsigned int)img.getLevelSize(level));
+    fwrite(img.getLevelData(level), 1, img.getLevelSize(level), file);
+  }
+  fclose(file);
+}
+
+
+// Writes a KTX2 file holding every level of img. The levels are stored
+// smallest first, as the spec recommends, so the level index has to be used
+// to find them.
+static void writeKTX2(const char* path, const vgl::CompressedImage& img, unsigned int vkFormat,
+    const char* orientation)
+{
+  const char* kKey = "KTXorientation";
+  const size_t kHeaderSize = 80;
+  const unsigned int numLevels = img.getNumLevels();
+  size_t kvdOffset = kHeaderSize + numLevels * 24;
+  size_t pairBytes = strlen(kKey) + 1 + strlen(orientation) + 1;
+  size_t kvdSize = 4 + ((pairBytes + 3) & ~size_t(3));
+  size_t dataOffset = (kvdOffset + kvdSize + 15) & ~size_t(15);
+
+  FILE* file = fopen(path, "wb");
+  const unsigned char kIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+  fwrite(kIdentifier, 1, 12, file);
+  putLE32(file, vkFormat);
+  putLE32(file, 1);   // typeSize
+  putLE32(file, img.getWidth());
+  putLE32(file, img.getHeight());
+  putLE32(file, 0);   // pixelDepth
+  putLE32(file, 0);   // layerCount
+  putLE32(file, 1);   // faceCount
+  putLE32(file, numLevels);
+  putLE32(file, 0);   // supercompressionScheme
+  putLE32(file, 0);   // dfdByteOffset
+  putLE32(file, 0);   // dfdByteLength
+  putLE32(file, (unsigned int)kvdOffset);
+  putLE32(file, (unsigned int)kvdSize);
+  putLE64(file, 0);   // sgdByteOffset
+  putLE64(file, 0);   // sgdByteLength
+
+  std::vector<size_t> offsets(numLevels);
+  size_t offset = dataOffset;
+  for (int level = numLevels - 1; level >= 0; --level) {
+    offsets[level] = offset;
+    offset += img.getLevelSize(level);
+  }
+  for (unsigned int level = 0; level < numLevels; ++level) {
+    putLE64(file, offsets[level]);
+    putLE64(file, img.getLevelSize(level));
+    putLE64(file, 0); // uncompressedByteLength
+  }
+
+  putLE32(file, (unsigned int)pairBytes);
+  fwrite(kKey, 1, strlen(kKey) + 1, file);
+  fwrite(orientation, 1, strlen(orientation) + 1, file);
+  while ((size_t)ftell(file) < dataOffset)
+    fputc(0, file);
+  for (int level = numLevels - 1; level >= 0; --level)
+    fwrite(img.getLevelData(level), 1, img.getLevelSize(level), file);
+  fclose(file);
+}
+
+
+// Checks that a loaded file has the same levels as the image it was written
+// from.
+static bool sameLevels(const vgl::CompressedImage& loaded, const vgl::CompressedImage& expected)
+{
+  if (loaded.getFormat() != expected.getFormat() || loaded.getNumLevels() != expected.getNumLevels() ||
+      loaded.getWidth() != expected.getWidth() || loaded.getHeight() != expected.getHeight())
+    return false;
+  for (unsigned int level = 0; level < expected.getNumLevels(); ++level) {
+    if (loaded.getLevelWidth(level) != expected.getLevelWidth(level) ||
+        loaded.getLevelHeight(level) != expected.getLevelHeight(level) ||
+        loaded.getLevelSize(level) != expected.getLevelSize(level) ||
+        memcmp(loaded.getLevelData(level), expected.getLevelData(level), expected.getLevelSize(level)) != 0)
+      return false;
+  }
+  return true;
+}
+
+
+// Chops bytes off the end of a file.
+static void truncateFile(const char* path, size_t bytes)
+{
+  FILE* file = fopen(path, "rb");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  CPPUNIT_ASSERT( truncate(path, size - bytes) == 0 );
+}
+
+
+//
+// TESTS
+//
+
+class TestCompressedImage : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestCompressedImage);
+  CPPUNIT_TEST(testSizes);
+  CPPUNIT_TEST(testBC1);
+  CPPUNIT_TEST(testBC3);
+  CPPUNIT_TEST(testBC4);
+  CPPUNIT_TEST(testBC5);
+  CPPUNIT_TEST(testBC7);
+  CPPUNIT_TEST(testLoadDDS);
+  CPPUNIT_TEST(testLoadKTX);
+  CPPUNIT_TEST(testLoadKTX2);
+  CPPUNIT_TEST(testFormatValues);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testSizes() {
+    vgl::CompressedImage bc1(vgl::BLOCK_BC1, 61, 46, 3);
+    CPPUNIT_ASSERT( bc1.getLevelSize(0) == 16 * 12 * 8 );
+    CPPUNIT_ASSERT( bc1.getLevelWidth(1) == 30 && bc1.getLevelHeight(1) == 23 );
+    CPPUNIT_ASSERT( bc1.getLevelSize(1) == 8 * 6 * 8 );
+    CPPUNIT_ASSERT( bc1.getSize() == bc1.getLevelSize(0) + bc1.getLevelSize(1) + bc1.getLevelSize(2) );
+
+    vgl::CompressedImage bc7(vgl::BLOCK_BC7, 1, 1);
+    CPPUNIT_ASSERT( bc7.getSize() == 16 );
+  }
+
+  void testBC1() {
+    CPPUNIT_ASSERT( roundTripPSNR(vgl::BLOCK_BC1, 3) > 32.0 );
+  }
+
+  void testBC3() {
+    CPPUNIT_ASSERT( roundTripPSNR(vgl::BLOCK_BC3, 4) > 33.0 );
+  }
+
+  void testBC4() {
+    CPPUNIT_ASSERT( roundTripPSNR(vgl::BLOCK_BC4, 1) > 48.0 );
+  }
+
+  void testBC5() {
+    CPPUNIT_ASSERT( roundTripPSNR(vgl::BLOCK_BC5, 2) > 48.0 );
+  }
+
+  void testBC7() {
+    CPPUNIT_ASSERT( roundTripPSNR(vgl::BLOCK_BC7, 4) > 36.0 );
+  }
+
+  void testLoadDDS() {
+    vgl::RawImage* img = makeTestImage();
+    vgl::CompressedImage compressed(img, vgl::BLOCK_BC3);
+    delete img;
+
+    const char* path = "test_compressedimage.dds";
+    writeDDS(path, compressed);
+    {
+      vgl::CompressedImage loaded(path);
+      CPPUNIT_ASSERT( loaded.getFormat() == vgl::BLOCK_BC3 );
+      CPPUNIT_ASSERT( loaded.getWidth() == compressed.getWidth() );
+      CPPUNIT_ASSERT( loaded.getHeight() == compressed.getHeight() );
+      CPPUNIT_ASSERT( loaded.getNumLevels() == 1 );
+      CPPUNIT_ASSERT( loaded.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+      CPPUNIT_ASSERT( loaded.getSize() == compressed.getSize() );
+      CPPUNIT_ASSERT( memcmp(loaded.getLevelData(0), compressed.getLevelData(0), compressed.getSize()) == 0 );
+    }
+    remove(path);
+  }
+
+  void testLoadKTX() {
+    vgl::RawImage* img = makeTestImage();
+    vgl::MipChain chain(img);
+    vgl::CompressedImage compressed(&chain, vgl::BLOCK_BC1);
+    delete img;
+    CPPUNIT_ASSERT( compressed.getNumLevels() == 6 );
+
+    // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, which has to come through as is.
+    const unsigned int kGLFormat = 0x8C4D;
+    const char* path = "test_compressedimage.ktx";
+    writeKTX(path, compressed, kGLFormat, false, NULL);
+    {
+      vgl::CompressedImage loaded(path);
+      CPPUNIT_ASSERT( sameLevels(loaded, compressed) );
+      CPPUNIT_ASSERT( loaded.getGLFormat() == (int)kGLFormat );
+      CPPUNIT_ASSERT( loaded.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    }
+
+    // Written big endian, and flipped.
+    writeKTX(path, compressed, kGLFormat, true, "S=r,T=u");
+    {
+      vgl::CompressedImage loaded(path);
+      CPPUNIT_ASSERT( sameLevels(loaded, compressed) );
+      CPPUNIT_ASSERT( loaded.getOrigin() == vgl::ORIGIN_BOTTOM_LEFT );
+    }
+
+    // Losing even the last byte of the smallest level is an error.
+    truncateFile(path, 1);
+    CPPUNIT_ASSERT_THROW( vgl::CompressedImage loaded(path), vgl::ImageException );
+    truncateFile(path, compressed.getSize());
+    CPPUNIT_ASSERT_THROW( vgl::CompressedImage loaded(path), vgl::ImageException );
+
+    // Not a block compressed format.
+    writeKTX(path, compressed, 0x8058, false, NULL);
+    CPPUNIT_ASSERT_THROW( vgl::CompressedImage loaded(path), vgl::ImageException );
+    remove(path);
+  }
+
+  void testLoadKTX2() {
+    vgl::RawImage* img = makeTestImage();
+    vgl::MipChain chain(img);
+    vgl::CompressedImage compressed(&chain, vgl::BLOCK_BC7);
+    delete img;
+
+    // VK_FORMAT_BC7_SRGB_BLOCK.
+    const char* path = "test_compressedimage.ktx2";
+    writeKTX2(path, compressed, 146, "ru");
+    {
+      vgl::CompressedImage loaded(path);
+      CPPUNIT_ASSERT( sameLevels(loaded, compressed) );
+      CPPUNIT_ASSERT( loaded.getGLFormat() == 0x8E8D ); // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+      CPPUNIT_ASSERT( loaded.getOrigin() == vgl::ORIGIN_BOTTOM_LEFT );
+    }
+
+    writeKTX2(path, compressed, 146, "rd");
+    {
+      vgl::CompressedImage loaded(path);
+      CPPUNIT_ASSERT( sameLevels(loaded, compressed) );
+      CPPUNIT_ASSERT( loaded.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    }
+
+    // The largest level is stored last, so any truncation cuts into it.
+    truncateFile(path, 1);
+    CPPUNIT_ASSERT_THROW( vgl::CompressedImage loaded(path), vgl::ImageException );
+
+    // VK_FORMAT_R8G8B8A8_UNORM isn't block compressed.
+    writeKTX2(path, compressed, 37, "rd");
+    CPPUNIT_ASSERT_THROW( vgl::CompressedImage loaded(path), vgl::ImageException );
+    remove(path);
+  }
+
+  void testFormatValues() {
+    // The formats which could be encoded from the start keep their values,
+    // so code which stored them still works.
+    CPPUNIT_ASSERT( vgl::BLOCK_BC1 == 0 && vgl::BLOCK_BC3 == 1 && vgl::BLOCK_BC4 == 2 );
+    CPPUNIT_ASSERT( vgl::BLOCK_BC5 == 3 && vgl::BLOCK_BC7 == 4 );
+    CPPUNIT_ASSERT( vgl::bytesPerBlock(vgl::BLOCK_BC2) == 16 && vgl::bytesPerBlock(vgl::BLOCK_BC6H) == 16 );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestCompressedImage);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );        
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );      
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+#include "vgl_convert.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+//
+// CONSTANTS
+//
+
+static const int kTypes[] = {
+  GL_RGB, GL_BGR, GL_RGBA, GL_BGRA, GL_ALPHA, GL_LUMINANCE, GL_LUMINANCE_ALPHA
+};
+static const unsigned int kNumTypes = sizeof(kTypes) / sizeof(kTypes[0]);
+
+// Odd sizes, so the SIMD kernels all have a scalar tail to finish off.
+static const unsigned int kWidth = 37;
+static const unsigned int kHeight = 5;
+
+
+//
+// HELPER METHODS
+//
+
+static std::vector<unsigned char> randomBytes(size_t count)
+{
+  std::vector<unsigned char> bytes(count);
+  for (size_t i = 0; i < count; ++i)
+    bytes[i] = (unsigned char)(rand() & 0xFF);
+  return bytes;
+}
+
+
+// Reads the red, green, blue and alpha of an 8 bit pixel.
+static void readPixel(const unsigned char* p, int type, unsigned int rgba[4])
+{
+  switch (type) {
+    case GL_RGB:  rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = 255; break;
+    case GL_BGR:  rgba[0] = p[2]; rgba[1] = p[1]; rgba[2] = p[0]; rgba[3] = 255; break;
+    case GL_RGBA: rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = p[3]; break;
+    case GL_BGRA: rgba[0] = p[2]; rgba[1] = p[1]; rgba[2] = p[0]; rgba[3] = p[3]; break;
+    case GL_LUMINANCE_ALPHA: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = p[1]; break;
+    default: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = 255; break;
+  }
+}
+
+
+// The 8 bit conversion done one pixel at a time, the slow and obvious way.
+static bool matchesReference(const unsigned char* src, int srcType, const unsigned char* dst, int dstType,
+    size_t numPixels)
+{
+  unsigned int srcChannels = vgl::channelsForType(srcType);
+  unsigned int dstChannels = vgl::channelsForType(dstType);
+  for (size_t i = 0; i < numPixels; ++i) {
+    unsigned int rgba[4];
+    readPixel(src + i * srcChannels, srcType, rgba);
+    if (srcChannels > 2 && dstChannels <= 2)
+      rgba[0] = (rgba[0] * 77 + rgba[1] * 150 + rgba[2] * 29 + 128) >> 8;
+
+    // Grey pixels read back with the same value in all three colours.
+    unsigned int got[4];
+    readPixel(dst + i * dstChannels, dstType, got);
+    if (got[0] != rgba[0] || (dstChannels > 2 && (got[1] != rgba[1] || got[2] != rgba[2])))
+      return false;
+    if ((dstChannels == 2 || dstChannels == 4) && got[3] != rgba[3])
+      return false;
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestConvert : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestConvert);
+  CPPUNIT_TEST(testSizes);
+  CPPUNIT_TEST(testAllLayouts);
+  CPPUNIT_TEST(testInPlace);
+  CPPUNIT_TEST(test8And16Bit);
+  CPPUNIT_TEST(testFloatTo8Bit);
+  CPPUNIT_TEST(testHalf);
+  CPPUNIT_TEST(testHalfRows);
+  CPPUNIT_TEST(testPremultiply);
+  CPPUNIT_TEST(testFlipRows);
+  CPPUNIT_TEST(testUnknownFormats);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testSizes() {
+    CPPUNIT_ASSERT( vgl::channelsForType(GL_BGRA) == 4 );
+    CPPUNIT_ASSERT( vgl::channelsForType(GL_LUMINANCE_ALPHA) == 2 );
+    CPPUNIT_ASSERT( vgl::channelsForType(GL_ALPHA) == 1 );
+    CPPUNIT_ASSERT( vgl::bytesPerChannelForPixelType(GL_HALF_FLOAT) == 2 );
+    CPPUNIT_ASSERT( vgl::bytesPerChannelForPixelType(GL_FLOAT) == 4 );
+  }
+
+  void testAllLayouts() {
+    // Every pair of layouts, which covers all of the SIMD kernels as well as
+    // the generic code.
+    srand(1);
+    for (unsigned int i = 0; i < kNumTypes; ++i) {
+      std::vector<unsigned char> src = randomBytes(kWidth * kHeight * vgl::channelsForType(kTypes[i]));
+      for (unsigned int j = 0; j < kNumTypes; ++j) {
+        std::vector<unsigned char> dst(kWidth * kHeight * vgl::channelsForType(kTypes[j]));
+        vgl::convertPixels(&src[0], kTypes[i], &dst[0], kTypes[j], kWidth, kHeight);
+        CPPUNIT_ASSERT( matchesReference(&src[0], kTypes[i], &dst[0], kTypes[j], kWidth * kHeight) );
+      }
+    }
+  }
+
+  void testInPlace() {
+    // Growing and shrinking the pixels in place should give the same as
+    // converting into a separate buffer.
+    srand(2);
+    for (unsigned int i = 0; i < kNumTypes; ++i) {
+      for (unsigned int j = 0; j < kNumTypes; ++j) {
+        size_t srcSize = kWidth * kHeight * vgl::channelsForType(kTypes[i]);
+        size_t dstSize = kWidth * kHeight * vgl::channelsForType(kTypes[j]);
+        std::vector<unsigned char> src = randomBytes(srcSize);
+        std::vector<unsigned char> expected(dstSize);
+        vgl::convertPixels(&src[0], kTypes[i], &expected[0], kTypes[j], kWidth, kHeight);
+
+        std::vector<unsigned char> buffer(src);
+        buffer.resize(std::max(srcSize, dstSize));
+        vgl::convertPixels(&buffer[0], kTypes[i], &buffer[0], kTypes[j], kWidth, kHeight);
+        CPPUNIT_ASSERT( memcmp(&buffer[0], &expected[0], dstSize) == 0 );
+      }
+    }
+  }
+
+  void test8And16Bit() {
+    // Every 16 bit value, narrowed by the SIMD kernel and the generic code
+    // (via a layout change).
+    std::vector<unsigned short> wide(65536);
+    for (unsigned int i = 0; i < 65536; ++i)
+      wide[i] = (unsigned short)i;
+    std::vector<unsigned char> narrow(65536), narrowGrey(65536);
+    vgl::convertPixels(&wide[0], GL_ALPHA, &narrow[0], GL_ALPHA, 65536, 1, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE);
+    vgl::convertPixels(&wide[0], GL_ALPHA, &narrowGrey[0], GL_LUMINANCE, 65536, 1, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE);
+    for (unsigned int i = 0; i < 65536; ++i) {
+      CPPUNIT_ASSERT( narrow[i] == (unsigned char)std::floor(i / 257.0 + 0.5) );
+      CPPUNIT_ASSERT( narrowGrey[i] == narrow[i] );
+    }
+
+    // Widening is exact, and narrowing it again gets back to where we were.
+    std::vector<unsigned char> bytes(256);
+    for (unsigned int i = 0; i < 256; ++i)
+      bytes[i] = (unsigned char)i;
+    vgl::convertPixels(&bytes[0], GL_ALPHA, &wide[0], GL_ALPHA, 256, 1, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT);
+    vgl::convertPixels(&wide[0], GL_ALPHA, &narrow[0], GL_ALPHA, 256, 1, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE);
+    for (unsigned int i = 0; i < 256; ++i) {
+      CPPUNIT_ASSERT( wide[i] == i * 257 );
+      CPPUNIT_ASSERT( narrow[i] == i );
+    }
+  }
+
+  void testFloatTo8Bit() {
+    // Out of range values clamp, and the SIMD and generic code round the same.
+    const unsigned int kCount = 1000;
+    std::vector<float> floats(kCount);
+    for (unsigned int i = 0; i < kCount; ++i)
+      floats[i] = i / float(kCount - 1) * 1.4f - 0.2f;
+    std::vector<unsigned char> simd(kCount), generic(kCount);
+    vgl::convertPixels(&floats[0], GL_ALPHA, &simd[0], GL_ALPHA, kCount, 1, GL_FLOAT, GL_UNSIGNED_BYTE);
+    vgl::convertPixels(&floats[0], GL_ALPHA, &generic[0], GL_LUMINANCE, kCount, 1, GL_FLOAT, GL_UNSIGNED_BYTE);
+    for (unsigned int i = 0; i < kCount; ++i) {
+      float clamped = std::max(0.0f, std::min(1.0f, floats[i]));
+      CPPUNIT_ASSERT( simd[i] == (unsigned char)(clamped * 255.0f + 0.5f) );
+      CPPUNIT_ASSERT( generic[i] == simd[i] );
+    }
+  }
+
+  void testHalf() {
+    CPPUNIT_ASSERT( vgl::floatToHalf(1.0f) == 0x3C00 );
+    CPPUNIT_ASSERT( vgl::floatToHalf(-2.0f) == 0xC000 );
+    CPPUNIT_ASSERT( vgl::floatToHalf(65504.0f) == 0x7BFF );
+    CPPUNIT_ASSERT( vgl::floatToHalf(65520.0f) == 0x7C00 ); // Rounds up to infinity.
+    CPPUNIT_ASSERT( vgl::floatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00 ); // Halfway, rounds to even.
+    CPPUNIT_ASSERT( vgl::floatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02 );
+    CPPUNIT_ASSERT( vgl::floatToHalf(5.9604644775390625e-8f) == 0x0001 ); // Smallest denormal.
+    CPPUNIT_ASSERT( vgl::halfToFloat(0x3555) == 0.333251953125f );
+
+    // Every half other than the NaNs survives a round trip through float.
+    for (unsigned int h = 0; h < 65536; ++h) {
+      if ((h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0)
+        CPPUNIT_ASSERT( vgl::halfToFloat((unsigned short)h) != vgl::halfToFloat((unsigned short)h) );
+      else
+        CPPUNIT_ASSERT( vgl::floatToHalf(vgl::halfToFloat((unsigned short)h)) == h );
+    }
+  }
+
+  void testHalfRows() {
+    // The F16C kernels should match the scalar conversions, denormals and
+    // all.
+    const unsigned int kCount = 1027;
+    std::vector<float> floats(kCount), back(kCount);
+    for (unsigned int i = 0; i < kCount; ++i)
+      floats[i] = std::ldexp(float(i % 97) - 48.5f, int(i % 41) - 30);
+    std::vector<unsigned short> halves(kCount);
+    vgl::convertPixels(&floats[0], GL_ALPHA, &halves[0], GL_ALPHA, kCount, 1, GL_FLOAT, GL_HALF_FLOAT);
+    vgl::convertPixels(&halves[0], GL_ALPHA, &back[0], GL_ALPHA, kCount, 1, GL_HALF_FLOAT, GL_FLOAT);
+    for (unsigned int i = 0; i < kCount; ++i) {
+      CPPUNIT_ASSERT( halves[i] == vgl::floatToHalf(floats[i]) );
+      CPPUNIT_ASSERT( back[i] == vgl::halfToFloat(halves[i]) );
+    }
+  }
+
+  void testPremultiply() {
+    // Every colour against every alpha.
+    std::vector<unsigned char> rgba(256 * 256 * 4), la(256 * 256 * 2);
+    for (unsigned int a = 0; a < 256; ++a) {
+      for (unsigned int c = 0; c < 256; ++c) {
+        unsigned char* p = &rgba[(a * 256 + c) * 4];
+        p[0] = p[1] = p[2] = (unsigned char)c;
+        p[3] = (unsigned char)a;
+        la[(a * 256 + c) * 2] = (unsigned char)c;
+        la[(a * 256 + c) * 2 + 1] = (unsigned char)a;
+      }
+    }
+    vgl::premultiplyAlpha(&rgba[0], GL_BGRA, 256, 256);
+    vgl::premultiplyAlpha(&la[0], GL_LUMINANCE_ALPHA, 256, 256);
+    for (unsigned int a = 0; a < 256; ++a) {
+      for (unsigned int c = 0; c < 256; ++c) {
+        unsigned int expected = (c * a + 127) / 255;
+        const unsigned char* p = &rgba[(a * 256 + c) * 4];
+        CPPUNIT_ASSERT( p[0] == expected && p[1] == expected && p[2] == expected && p[3] == a );
+        CPPUNIT_ASSERT( la[(a * 256 + c) * 2] == expected );
+      }
+    }
+
+    // Float alpha scales the colour as it is.
+    float pixel[4] = { 0.5f, 2.0f, -1.0f, 0.25f };
+    vgl::premultiplyAlpha(pixel, GL_RGBA, 1, 1, GL_FLOAT);
+    CPPUNIT_ASSERT( pixel[0] == 0.125f && pixel[1] == 0.5f && pixel[2] == -0.25f && pixel[3] == 0.25f );
+  }
+
+  void testFlipRows() {
+    const unsigned int kRows = 7;
+    std::vector<unsigned char> rows(kRows * 3);
+    for (unsigned int i = 0; i < rows.size(); ++i)
+      rows[i] = (unsigned char)i;
+    vgl::flipRowsInPlace(&rows[0], 3, kRows);
+    for (unsigned int y = 0; y < kRows; ++y) {
+      for (unsigned int x = 0; x < 3; ++x)
+        CPPUNIT_ASSERT( rows[y * 3 + x] == (kRows - 1 - y) * 3 + x );
+    }
+  }
+
+  void testUnknownFormats() {
+    // Nothing gets written for formats convertPixels doesn't know.
+    unsigned char src[4] = { 1, 2, 3, 4 };
+    unsigned char dst[4] = { 9, 9, 9, 9 };
+    vgl::convertPixels(src, GL_RGBA, dst, GL_DEPTH_COMPONENT, 1, 1);
+    vgl::convertPixels(src, GL_RGBA, dst, GL_BGRA, 1, 1, GL_UNSIGNED_BYTE, GL_INT);
+    CPPUNIT_ASSERT( dst[0] == 9 && dst[1] == 9 && dst[2] == 9 && dst[3] == 9 );
+    CPPUNIT_ASSERT( vgl::channelsForType(GL_DEPTH_COMPONENT) == 0 );
+    CPPUNIT_ASSERT( vgl::bytesPerChannelForPixelType(GL_INT) == 0 );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestConvert);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+#include "vgl_fastmath.h"
+#include "vgl_vec2.h"
+#include "vgl_vec3.h"
+#include "vgl_vec4.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//
+// HELPER METHODS
+//
+
+// The error bounds documented in vgl_fastmath.h.
+#ifdef VGL_SIMD_SSE2
+static const double kRsqrtError = 5e-7;
+#else
+static const double kRsqrtError = 5e-6;
+#endif
+static const double kFloatSinCosError = 2e-7;
+static const double kDoubleSinCosError = 5e-8;
+static const double kMaxAngle = 8192.0;
+
+
+static double relativeError(double value, double expected)
+{
+  return std::fabs(value - expected) / std::fabs(expected);
+}
+
+
+// Equal, or both NaN.
+template <typename Num>
+static bool sameValue(Num a, Num b)
+{
+  return a == b || (a != a && b != b);
+}
+
+
+// For the vector functions: each component must be within the error bound,
+// relative to the length of the vector.
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b, float error)
+{
+  float tolerance = error * std::max(1.0f, vgl::length(b));
+  return std::fabs(a.x - b.x) <= tolerance &&
+         std::fabs(a.y - b.y) <= tolerance &&
+         std::fabs(a.z - b.z) <= tolerance;
+}
+
+
+static bool close(const vgl::Vec3d& a, const vgl::Vec3d& b, double error)
+{
+  double tolerance = error * std::max(1.0, vgl::length(b));
+  return std::fabs(a.x - b.x) <= tolerance &&
+         std::fabs(a.y - b.y) <= tolerance &&
+         std::fabs(a.z - b.z) <= tolerance;
+}
+
+
+//
+// TESTS
+//
+
+class TestFastMath : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestFastMath);
+  CPPUNIT_TEST(testExact);
+  CPPUNIT_TEST(testRsqrt);
+  CPPUNIT_TEST(testSinCosFloat);
+  CPPUNIT_TEST(testSinCosDouble);
+  CPPUNIT_TEST(testSinCosRange);
+  CPPUNIT_TEST(testNorm);
+  CPPUNIT_TEST(testRotate);
+  CPPUNIT_TEST(testExplicitNum);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testExact() {
+    for (float x = -10.0f; x < 10.0f; x += 0.37f) {
+      float s, c;
+      vgl::ExactMath::sincos(x, s, c);
+      CPPUNIT_ASSERT( s == std::sin(x) && c == std::cos(x) );
+      CPPUNIT_ASSERT( vgl::ExactMath::sin(x) == std::sin(x) );
+      CPPUNIT_ASSERT( vgl::ExactMath::cos(x) == std::cos(x) );
+      if (x > 0.0f)
+        CPPUNIT_ASSERT( vgl::ExactMath::rsqrt(x) == 1.0f / std::sqrt(x) );
+    }
+  }
+
+  void testRsqrt() {
+    // Every binade from the smallest normal float up, at several points each.
+    double worst = 0.0, worstDouble = 0.0;
+    for (float x = FLT_MIN; x < FLT_MAX / 2.0f; x *= 1.37f) {
+      double expected = 1.0 / std::sqrt(double(x));
+      worst = std::max(worst, relativeError(vgl::FastMath::rsqrt(x), expected));
+      worstDouble = std::max(worstDouble, relativeError(vgl::FastMath::rsqrt(double(x)), expected));
+    }
+    CPPUNIT_ASSERT( worst < kRsqrtError );
+    CPPUNIT_ASSERT( worstDouble < kRsqrtError );
+  }
+
+  void testSinCosFloat() {
+    double worstSin = 0.0, worstCos = 0.0;
+    for (double d = -kMaxAngle; d <= kMaxAngle; d += 0.0137) {
+      float x = float(d);
+      float s, c;
+      vgl::FastMath::sincos(x, s, c);
+      worstSin = std::max(worstSin, std::fabs(s - std::sin(double(x))));
+      worstCos = std::max(worstCos, std::fabs(c - std::cos(double(x))));
+      CPPUNIT_ASSERT( vgl::FastMath::sin(x) == s && vgl::FastMath::cos(x) == c );
+    }
+    CPPUNIT_ASSERT( worstSin < kFloatSinCosError );
+    CPPUNIT_ASSERT( worstCos < kFloatSinCosError );
+
+    // Exact at the quadrant boundaries, near enough.
+    const float kHalfPi = 1.5707963f;
+    for (int k = -8; k <= 8; ++k) {
+      float x = k * kHalfPi, s, c;
+      vgl::FastMath::sincos(x, s, c);
+      CPPUNIT_ASSERT( std::fabs(s - std::sin(double(x))) < kFloatSinCosError );
+      CPPUNIT_ASSERT( std::fabs(c - std::cos(double(x))) < kFloatSinCosError );
+    }
+  }
+
+  void testSinCosDouble() {
+    double worst = 0.0;
+    for (double x = -kMaxAngle; x <= kMaxAngle; x += 0.0137) {
+      double s, c;
+      vgl::FastMath::sincos(x, s, c);
+      worst = std::max(worst, std::fabs(s - std::sin(x)));
+      worst = std::max(worst, std::fabs(c - std::cos(x)));
+    }
+    CPPUNIT_ASSERT( worst < kDoubleSinCosError );
+  }
+
+  void testSinCosRange() {
+    // Outside the range of the fast reduction, the results are the standard
+    // library's.
+    const double kAngles[] = { kMaxAngle * 1.5, -1e5, 3.5e9, -1e20, HUGE_VAL, -HUGE_VAL, std::sqrt(-1.0) };
+    for (unsigned int i = 0; i < sizeof(kAngles) / sizeof(kAngles[0]); ++i) {
+      float xf = float(kAngles[i]), sf, cf;
+      vgl::FastMath::sincos(xf, sf, cf);
+      CPPUNIT_ASSERT( sameValue(sf, std::sin(xf)) && sameValue(cf, std::cos(xf)) );
+      double xd = kAngles[i], sd, cd;
+      vgl::FastMath::sincos(xd, sd, cd);
+      CPPUNIT_ASSERT( sameValue(sd, std::sin(xd)) && sameValue(cd, std::cos(xd)) );
+    }
+  }
+
+  void testNorm() {
+    for (int i = 1; i < 200; ++i) {
+      vgl::Vec3f v(std::sin(i * 1.3f) * i, std::cos(i * 0.7f), i * 0.25f - 3.0f);
+      CPPUNIT_ASSERT( close(vgl::norm<vgl::FastMath>(v), vgl::norm(v), 2 * kRsqrtError) );
+      CPPUNIT_ASSERT( close(vgl::norm<vgl::ExactMath>(v), vgl::norm(v), 1e-6f) );
+
+      vgl::Vec3d vd(v.x, v.y, v.z);
+      CPPUNIT_ASSERT( close(vgl::norm<vgl::FastMath>(vd), vgl::norm(vd), 2 * kRsqrtError) );
+
+      vgl::Vec2f v2(v.x, v.y);
+      vgl::Vec2f n2 = vgl::norm<vgl::FastMath>(v2), e2 = vgl::norm(v2);
+      CPPUNIT_ASSERT( std::fabs(n2.x - e2.x) < 2 * kRsqrtError && std::fabs(n2.y - e2.y) < 2 * kRsqrtError );
+
+      vgl::Vec4f v4(v.x, v.y, v.z, 2.0f);
+      CPPUNIT_ASSERT( std::fabs(vgl::length(vgl::norm<vgl::FastMath>(v4)) - 1.0f) < 2 * kRsqrtError );
+    }
+  }
+
+  void testRotate() {
+    vgl::Vec3f v(1.5f, -2.0f, 0.75f);
+    vgl::Vec3d vd(1.5, -2.0, 0.75);
+    for (float a = -100.0f; a < 100.0f; a += 0.53f) {
+      // Both the angle and the rotation are rounded, so allow a bit extra.
+      const float kError = 2 * kFloatSinCosError + 1e-6f;
+      CPPUNIT_ASSERT( close(vgl::rotateX<vgl::FastMath>(v, a), vgl::rotateX(v, a), kError) );
+      CPPUNIT_ASSERT( close(vgl::rotateY<vgl::FastMath>(v, a), vgl::rotateY(v, a), kError) );
+      CPPUNIT_ASSERT( close(vgl::rotateZ<vgl::FastMath>(v, a), vgl::rotateZ(v, a), kError) );
+      CPPUNIT_ASSERT( close(vgl::rotateY<vgl::ExactMath>(v, a), vgl::rotateY(v, a), 1e-6f) );
+
+      double ad = a;
+      CPPUNIT_ASSERT( close(vgl::rotateZ<vgl::FastMath>(vd, ad), vgl::rotateZ(vd, ad), 2 * kDoubleSinCosError) );
+
+      vgl::Vec2f r2 = vgl::rotate<vgl::FastMath>(vgl::Vec2f(v.x, v.y), a);
+      vgl::Vec3f r3 = vgl::rotateZ(v, a);
+      CPPUNIT_ASSERT( std::fabs(r2.x - r3.x) < kError * 3 && std::fabs(r2.y - r3.y) < kError * 3 );
+
+      vgl::Vec4f r4 = vgl::rotateX<vgl::FastMath>(vgl::Vec4f(v.x, v.y, v.z, 1.0f), a);
+      CPPUNIT_ASSERT( close(vgl::Vec3f(r4.x, r4.y, r4.z), vgl::rotateX(v, a), kError) && r4.w == 1.0f );
+    }
+  }
+
+  void testExplicitNum() {
+    // Naming the number type instead of a policy picks the plain versions,
+    // rather than being ambiguous with the policy ones.
+    vgl::Vec3f v(3.0f, 0.0f, 4.0f);
+    CPPUNIT_ASSERT( close(vgl::norm<float>(v), vgl::Vec3f(0.6f, 0.0f, 0.8f), 1e-7f) );
+    CPPUNIT_ASSERT( close(vgl::rotateX<float>(v, 0.5f), vgl::rotateX(v, 0.5f), 0.0f) );
+    CPPUNIT_ASSERT( close(vgl::rotateY<float>(v, 0.5f), vgl::rotateY(v, 0.5f), 0.0f) );
+    CPPUNIT_ASSERT( close(vgl::rotateZ<float>(v, 0.5f), vgl::rotateZ(v, 0.5f), 0.0f) );
+    CPPUNIT_ASSERT( close(vgl::rotate<float>(v, vgl::Vec3f(0.0f, 2.0f, 0.0f), 0.5f),
+                          vgl::rotateY(v, 0.5f), 1e-6f) );
+
+    vgl::Vec2d n2 = vgl::norm<double>(vgl::Vec2d(0.0, -2.0));
+    CPPUNIT_ASSERT( n2.x == 0.0 && n2.y == -1.0 );
+    vgl::Vec2d r2 = vgl::rotate<double>(vgl::Vec2d(1.0, 0.0), 0.25);
+    CPPUNIT_ASSERT( r2.x == std::cos(0.25) && r2.y == std::sin(0.25) );
+    vgl::Vec4f v4(1.0f, 2.0f, 3.0f, 4.0f);
+    vgl::Vec4f n4 = vgl::norm<float>(v4), e4 = vgl::norm(v4);
+    CPPUNIT_ASSERT( n4.x == e4.x && n4.y == e4.y && n4.z == e4.z && n4.w == e4.w );
+    vgl::Vec4f r4 = vgl::rotateZ<float>(vgl::Vec4f(v.x, v.y, v.z, 1.0f), 0.5f);
+    CPPUNIT_ASSERT( close(vgl::Vec3f(r4.x, r4.y, r4.z), vgl::rotateZ(v, 0.5f), 0.0f) );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestFastMath);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,981 @@
+#include "vgl_image.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef VGL_USE_OPENEXR
+#include <ImfRgbaFile.h>
+#endif
+
+
+//
+// TYPES
+//
+
+typedef std::vector<unsigned char> Bytes;
+
+
+//
+// HELPER METHODS
+//
+
+static void writeFile(const char* path, const Bytes& bytes)
+{
+  FILE* file = fopen(path, "wb");
+  fwrite(&bytes[0], 1, bytes.size(), file);
+  fclose(file);
+}
+
+
+static void putLE16(Bytes& bytes, unsigned int value)
+{
+  bytes.push_back((unsigned char)(value & 0xFF));
+  bytes.push_back((unsigned char)((value >> 8) & 0xFF));
+}
+
+
+static void putLE32(Bytes& bytes, unsigned int value)
+{
+  putLE16(bytes, value & 0xFFFF);
+  putLE16(bytes, value >> 16);
+}
+
+
+// The test pattern: a different value for every channel of every pixel, with
+// y counting rows from the top of the image.
+static unsigned char pattern(unsigned int x, unsigned int y, unsigned int channel)
+{
+  return (unsigned char)(channel * 80 + y * 13 + x);
+}
+
+
+// The pattern as rows, top row first.
+static Bytes patternRows(unsigned int width, unsigned int height, unsigned int channels)
+{
+  Bytes rows;
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      for (unsigned int c = 0; c < channels; ++c)
+        rows.push_back(pattern(x, y, c));
+    }
+  }
+  return rows;
+}
+
+
+// A 24 bit BMP holding the pattern, with its rows stored bottom-up (the
+// usual way) or top-down (a negative height).
+static Bytes makeBMP(unsigned int width, unsigned int height, bool topDown)
+{
+  unsigned int rowBytes = (width * 3 + 3) & ~3u;
+  Bytes bmp;
+  bmp.push_back('B');
+  bmp.push_back('M');
+  putLE32(bmp, 54 + rowBytes * height);
+  putLE32(bmp, 0);
+  putLE32(bmp, 54);
+  putLE32(bmp, 40);
+  putLE32(bmp, width);
+  putLE32(bmp, topDown ? (unsigned int)-(int)height : height);
+  putLE16(bmp, 1);
+  putLE16(bmp, 24);
+  for (unsigned int i = 0; i < 6; ++i)
+    putLE32(bmp, 0);
+
+  Bytes rows = patternRows(width, height, 3);
+  for (unsigned int i = 0; i < height; ++i) {
+    unsigned int y = topDown ? i : height - 1 - i;
+    bmp.insert(bmp.end(), rows.begin() + y * width * 3, rows.begin() + (y + 1) * width * 3);
+    bmp.resize(bmp.size() + rowBytes - width * 3, 0);
+  }
+  return bmp;
+}
+
+
+static Bytes makeTGAHeader(unsigned int imageType, unsigned int width, unsigned int height,
+    unsigned int channels, bool topDown)
+{
+  Bytes tga(18, 0);
+  tga[0] = 3; // Image ID length.
+  tga[2] = (unsigned char)imageType;
+  tga[0xC] = (unsigned char)(width & 0xFF);
+  tga[0xD] = (unsigned char)(width >> 8);
+  tga[0xE] = (unsigned char)(height & 0xFF);
+  tga[0xF] = (unsigned char)(height >> 8);
+  tga[0x10] = (unsigned char)(channels * 8);
+  tga[0x11] = topDown ? 0x20 : 0;
+  tga.push_back('I');
+  tga.push_back('D');
+  tga.push_back('!');
+  return tga;
+}
+
+
+// An uncompressed TGA holding the pattern.
+static Bytes makeTGA(unsigned int width, unsigned int height, unsigned int channels, bool topDown)
+{
+  Bytes tga = makeTGAHeader(channels == 1 ? 3 : 2, width, height, channels, topDown);
+  Bytes rows = patternRows(width, height, channels);
+  for (unsigned int i = 0; i < height; ++i) {
+    unsigned int y = topDown ? i : height - 1 - i;
+    tga.insert(tga.end(), rows.begin() + y * width * channels, rows.begin() + (y + 1) * width * channels);
+  }
+  return tga;
+}
+
+
+// A binary (P6) or ASCII (P3) PPM holding the pattern.
+static Bytes makePPM(unsigned int width, unsigned int height, bool binary)
+{
+  char header[64];
+  sprintf(header, "P%d\n# A comment\n%u %u\n255\n", binary ? 6 : 3, width, height);
+  Bytes ppm(header, header + strlen(header));
+  Bytes rows = patternRows(width, height, 3);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (binary) {
+      ppm.push_back(rows[i]);
+    } else {
+      char value[8];
+      sprintf(value, "%d ", rows[i]);
+      ppm.insert(ppm.end(), value, value + strlen(value));
+    }
+  }
+  return ppm;
+}
+
+
+// A one row, 16 bit PPM holding the given samples, three to a pixel.
+static Bytes makePPM16(const unsigned int* samples, unsigned int count, unsigned int maxValue, bool binary)
+{
+  char header[64];
+  sprintf(header, "P%d %u 1 %u\n", binary ? 6 : 3, count / 3, maxValue);
+  Bytes ppm(header, header + strlen(header));
+  for (unsigned int i = 0; i < count; ++i) {
+    if (binary) {
+      ppm.push_back((unsigned char)(samples[i] >> 8));
+      ppm.push_back((unsigned char)(samples[i] & 0xFF));
+    } else {
+      char value[16];
+      sprintf(value, "%u\n", samples[i]);
+      ppm.insert(ppm.end(), value, value + strlen(value));
+    }
+  }
+  return ppm;
+}
+
+
+// Checks that the pixels hold the pattern, the right way up for the image's
+// origin.
+static bool hasPattern(const vgl::RawImage& img, unsigned int channels)
+{
+  for (unsigned int row = 0; row < img.getHeight(); ++row) {
+    unsigned int y = (img.getOrigin() == vgl::ORIGIN_TOP_LEFT) ? row : img.getHeight() - 1 - row;
+    const unsigned char* p = img.getPixels() + row * img.getWidth() * channels;
+    for (unsigned int x = 0; x < img.getWidth(); ++x) {
+      for (unsigned int c = 0; c < channels; ++c) {
+        if (p[x * channels + c] != pattern(x, y, c))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// Writes the file, then loads it with both origins and checks both.
+static bool loadsPattern(const char* path, const Bytes& bytes, unsigned int width, unsigned int height,
+    unsigned int channels)
+{
+  writeFile(path, bytes);
+  bool ok = true;
+  for (int i = 0; i < 2; ++i) {
+    vgl::ImageOrigin origin = (i == 0) ? vgl::ORIGIN_BOTTOM_LEFT : vgl::ORIGIN_TOP_LEFT;
+    vgl::RawImage img(path, origin);
+    ok = ok && img.getOrigin() == origin && img.getWidth() == width && img.getHeight() == height &&
+         img.getBytesPerPixel() == channels && hasPattern(img, channels);
+  }
+  remove(path);
+  return ok;
+}
+
+
+// Pixels for the RLE tests, top row first: blocks of seven identical pixels,
+// every third block noise instead, and the third row all one colour. Blocks
+// don't line up with rows, so runs and raw packets cross from one row to the
+// next, and a wide enough row needs several packets for its run.
+static Bytes runPixels(unsigned int width, unsigned int height, unsigned int channels)
+{
+  Bytes pixels;
+  for (size_t i = 0; i < size_t(width) * height; ++i) {
+    size_t block = i / 7;
+    for (unsigned int c = 0; c < channels; ++c) {
+      if (i / width == 2)
+        pixels.push_back((unsigned char)(200 + c));
+      else if (block % 3 == 2)
+        pixels.push_back((unsigned char)((i * 29 + c * 71) % 251));
+      else
+        pixels.push_back((unsigned char)(block * 53 + c * 97));
+    }
+  }
+  return pixels;
+}
+
+
+static bool samePixel(const Bytes& pixels, size_t a, size_t b, unsigned int bpp)
+{
+  return memcmp(&pixels[a * bpp], &pixels[b * bpp], bpp) == 0;
+}
+
+
+// Run length encodes pixels the way a TGA writer would, ignoring rows: runs
+// of two or more identical pixels, and raw packets for everything between.
+static Bytes encodeRLE(const Bytes& pixels, unsigned int bpp)
+{
+  Bytes out;
+  const size_t count = pixels.size() / bpp;
+  size_t i = 0;
+  while (i < count) {
+    size_t n = 1;
+    while (i + n < count && n < 128 && samePixel(pixels, i, i + n, bpp))
+      ++n;
+    if (n > 1) {
+      out.push_back((unsigned char)(0x80 | (n - 1)));
+      out.insert(out.end(), pixels.begin() + i * bpp, pixels.begin() + (i + 1) * bpp);
+    } else {
+      while (i + n < count && n < 128 && !(i + n + 1 < count && samePixel(pixels, i + n, i + n + 1, bpp)))
+        ++n;
+      out.push_back((unsigned char)(n - 1));
+      out.insert(out.end(), pixels.begin() + i * bpp, pixels.begin() + (i + n) * bpp);
+    }
+    i += n;
+  }
+  return out;
+}
+
+
+// A run length encoded TGA holding runPixels.
+static Bytes makeRLETGA(unsigned int width, unsigned int height, unsigned int channels, bool topDown)
+{
+  Bytes pixels = runPixels(width, height, channels);
+  Bytes fileOrder;
+  for (unsigned int i = 0; i < height; ++i) {
+    unsigned int y = topDown ? i : height - 1 - i;
+    size_t rowBytes = size_t(width) * channels;
+    fileOrder.insert(fileOrder.end(), pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes);
+  }
+  Bytes tga = makeTGAHeader(channels == 1 ? 11 : 10, width, height, channels, topDown);
+  Bytes rle = encodeRLE(fileOrder, channels);
+  tga.insert(tga.end(), rle.begin(), rle.end());
+  return tga;
+}
+
+
+// Writes the RLE TGA, then loads it with both origins and checks both.
+static bool loadsRLE(const char* path, unsigned int width, unsigned int height, unsigned int channels,
+    bool topDown)
+{
+  writeFile(path, makeRLETGA(width, height, channels, topDown));
+  Bytes pixels = runPixels(width, height, channels);
+  const size_t rowBytes = size_t(width) * channels;
+  bool ok = true;
+  for (int i = 0; i < 2 && ok; ++i) {
+    vgl::ImageOrigin origin = (i == 0) ? vgl::ORIGIN_BOTTOM_LEFT : vgl::ORIGIN_TOP_LEFT;
+    vgl::RawImage img(path, origin);
+    ok = img.getOrigin() == origin && img.getWidth() == width && img.getHeight() == height &&
+         img.getBytesPerPixel() == channels;
+    for (unsigned int row = 0; row < height && ok; ++row) {
+      unsigned int y = (origin == vgl::ORIGIN_TOP_LEFT) ? row : height - 1 - row;
+      ok = memcmp(img.getPixels() + row * rowBytes, &pixels[y * rowBytes], rowBytes) == 0;
+    }
+  }
+  remove(path);
+  return ok;
+}
+
+
+// Noise in every channel, with every third pixel repeating the one before it.
+// That makes TGA's run length encoding alternate between single raw pixels and
+// runs of two, which is its worst case for size.
+static vgl::RawImage makeNoise(int type, unsigned int channels, unsigned int width, unsigned int height,
+    int pixelType, vgl::ImageOrigin origin)
+{
+  unsigned int channelBytes = (pixelType == GL_UNSIGNED_SHORT) ? 2 : 1;
+  unsigned int bpp = channels * channelBytes;
+  vgl::RawImage img(type, bpp, width, height, pixelType, origin);
+  unsigned char* p = img.getPixels();
+  srand(width * 7 + height * channels);
+  for (size_t i = 0; i < size_t(width) * height; ++i, p += bpp) {
+    if (i % 3 == 2) {
+      memcpy(p, p - bpp, bpp);
+    } else {
+      for (unsigned int j = 0; j < bpp; ++j)
+        p[j] = (unsigned char)(rand() >> 4);
+    }
+  }
+  return img;
+}
+
+
+// Compares two images as RGBA pixels of the given type, allowing for them
+// having different origins and layouts.
+static bool samePixels(const vgl::RawImage& a, const vgl::RawImage& b, int pixelType,
+    unsigned int tolerance = 0)
+{
+  if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+    return false;
+  vgl::RawImage x(a), y(b);
+  x.convertInPlace(GL_RGBA, pixelType);
+  y.convertInPlace(GL_RGBA, pixelType);
+  if (x.getOrigin() != y.getOrigin())
+    y.flipVerticalInPlace();
+
+  size_t count = size_t(a.getWidth()) * a.getHeight() * 4;
+  for (size_t i = 0; i < count; ++i) {
+    int diff = (pixelType == GL_UNSIGNED_SHORT) ?
+        int(((const unsigned short*)x.getPixels())[i]) - int(((const unsigned short*)y.getPixels())[i]) :
+        int(x.getPixels()[i]) - int(y.getPixels()[i]);
+    if ((unsigned int)abs(diff) > tolerance)
+      return false;
+  }
+  return true;
+}
+
+
+// Saves the image, loads it back with the same origin, and compares the two.
+static bool savesAndLoads(const vgl::RawImage& img, const char* path,
+    const vgl::SaveOptions& options, int pixelType = GL_UNSIGNED_BYTE, unsigned int tolerance = 0)
+{
+  img.save(path, options);
+  vgl::RawImage loaded(path, img.getOrigin());
+  remove(path);
+  return loaded.getOrigin() == img.getOrigin() && loaded.getPixelType() == pixelType &&
+         samePixels(img, loaded, pixelType, tolerance);
+}
+
+
+// Writes a 16 or 32 bit value into a header in either byte order.
+static void setU16(Bytes& bytes, size_t pos, unsigned int value, bool bigEndian)
+{
+  bytes[pos + (bigEndian ? 0 : 1)] = (unsigned char)(value >> 8);
+  bytes[pos + (bigEndian ? 1 : 0)] = (unsigned char)(value & 0xFF);
+}
+
+
+static void setU32(Bytes& bytes, size_t pos, unsigned int value, bool bigEndian)
+{
+  setU16(bytes, pos + (bigEndian ? 0 : 2), value >> 16, bigEndian);
+  setU16(bytes, pos + (bigEndian ? 2 : 0), value & 0xFFFF, bigEndian);
+}
+
+
+// The film test pattern: a 10 bit value for every sample, with y counting
+// rows from the top of the image.
+static unsigned int filmSample(unsigned int x, unsigned int y, unsigned int channel)
+{
+  return (x * 37 + y * 101 + channel * 311) % 1024;
+}
+
+
+// The pattern's value as a DPX or Cineon file of the given bit depth stores it.
+static unsigned int filmStored(unsigned int value, unsigned int bitSize)
+{
+  switch (bitSize) {
+    case 8:  return value >> 2;
+    case 12: return (value << 2) | (value >> 8);
+    case 16: return (value << 6) | (value >> 4);
+    default: return value;
+  }
+}
+
+
+// The stored value as it should load: 8 bit samples as they are, everything
+// else widened to 16 bits.
+static unsigned int filmLoaded(unsigned int value, unsigned int bitSize)
+{
+  unsigned int v = filmStored(value, bitSize);
+  switch (bitSize) {
+    case 10: return (v << 6) | (v >> 4);
+    case 12: return (v << 4) | (v >> 8);
+    default: return v;
+  }
+}
+
+
+// Appends the pattern's rows in file order. 10 bit samples are packed three
+// to a 32 bit word and 12 bit samples one to 16 bits, using method A (unused
+// bits at the bottom) or method B (unused bits at the top).
+static void appendFilmRows(Bytes& out, unsigned int width, unsigned int height, unsigned int channels,
+    unsigned int bitSize, bool methodB, bool padRows, bool bigEndian, bool topDown, unsigned int eolPadding)
+{
+  for (unsigned int i = 0; i < height; ++i) {
+    unsigned int y = topDown ? i : height - 1 - i;
+    std::vector<unsigned int> samples;
+    for (unsigned int x = 0; x < width; ++x) {
+      for (unsigned int c = 0; c < channels; ++c)
+        samples.push_back(filmStored(filmSample(x, y, c), bitSize));
+    }
+
+    size_t start = out.size();
+    if (bitSize == 10) {
+      for (size_t j = 0; j < samples.size(); j += 3) {
+        unsigned int word = 0;
+        for (size_t k = 0; k < 3; ++k)
+          word |= ((j + k < samples.size()) ? samples[j + k] : 0) << (10 * (2 - k));
+        out.resize(out.size() + 4);
+        setU32(out, out.size() - 4, methodB ? word : word << 2, bigEndian);
+      }
+    } else if (bitSize == 8) {
+      out.insert(out.end(), samples.begin(), samples.end());
+    } else {
+      for (size_t j = 0; j < samples.size(); ++j) {
+        out.resize(out.size() + 2);
+        setU16(out, out.size() - 2, (bitSize == 12 && !methodB) ? samples[j] << 4 : samples[j], bigEndian);
+      }
+    }
+    if (padRows)
+      out.resize(start + ((out.size() - start + 3) & ~size_t(3)), 0);
+    out.resize(out.size() + eolPadding, 0);
+  }
+}
+
+
+// A DPX file holding the film pattern in a single image element.
+static Bytes makeDPX(unsigned int width, unsigned int height, unsigned int channels, unsigned int bitSize,
+    unsigned int packing, bool bigEndian, bool topDown, unsigned int eolPadding = 0)
+{
+  Bytes dpx(832, 0);
+  memcpy(&dpx[0], bigEndian ? "SDPX" : "XPDS", 4);
+  setU32(dpx, 4, 832, bigEndian);
+  setU16(dpx, 768, topDown ? 0 : 2, bigEndian);
+  setU32(dpx, 772, width, bigEndian);
+  setU32(dpx, 776, height, bigEndian);
+  dpx[800] = (channels == 1) ? 6 : (channels == 3) ? 50 : 51;
+  dpx[803] = (unsigned char)bitSize;
+  setU16(dpx, 804, packing, bigEndian);
+  setU32(dpx, 808, 0xFFFFFFFF, bigEndian);
+  setU32(dpx, 812, eolPadding, bigEndian);
+  appendFilmRows(dpx, width, height, channels, bitSize, packing == 2, packing != 0 || bitSize == 12,
+      bigEndian, topDown, eolPadding);
+  return dpx;
+}
+
+
+// A Cineon file holding the film pattern, 10 bit or 8 bit.
+static Bytes makeCIN(unsigned int width, unsigned int height, unsigned int channels, unsigned int bitSize,
+    bool bigEndian, bool topDown)
+{
+  Bytes cin(692, 0);
+  setU32(cin, 0, 0x802A5FD7, bigEndian);
+  setU32(cin, 4, 692, bigEndian);
+  cin[192] = topDown ? 0 : 1;
+  cin[193] = (unsigned char)channels;
+  for (unsigned int c = 0; c < channels; ++c)
+    cin[198 + c * 28] = (unsigned char)bitSize;
+  setU32(cin, 200, width, bigEndian);
+  setU32(cin, 204, height, bigEndian);
+  cin[681] = (bitSize == 10) ? 5 : 0;
+  appendFilmRows(cin, width, height, channels, bitSize, false, false, bigEndian, topDown, 0);
+  return cin;
+}
+
+
+// Writes the film file, then loads it with both origins and checks the
+// samples in both.
+static bool loadsFilm(const char* path, const Bytes& bytes, unsigned int width, unsigned int height,
+    unsigned int channels, unsigned int bitSize)
+{
+  writeFile(path, bytes);
+  bool ok = true;
+  for (int i = 0; i < 2 && ok; ++i) {
+    vgl::ImageOrigin origin = (i == 0) ? vgl::ORIGIN_BOTTOM_LEFT : vgl::ORIGIN_TOP_LEFT;
+    vgl::RawImage img(path, origin);
+    int pixelType = (bitSize == 8) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+    ok = img.getOrigin() == origin && img.getWidth() == width && img.getHeight() == height &&
+         img.getPixelType() == pixelType && img.getBytesPerPixel() == channels * ((bitSize == 8) ? 1 : 2);
+    for (unsigned int row = 0; row < height && ok; ++row) {
+      unsigned int y = (origin == vgl::ORIGIN_TOP_LEFT) ? row : height - 1 - row;
+      for (unsigned int x = 0; x < width; ++x) {
+        for (unsigned int c = 0; c < channels; ++c) {
+          size_t index = (size_t(row) * width + x) * channels + c;
+          unsigned int actual = (bitSize == 8) ? img.getPixels()[index] :
+              ((const unsigned short*)img.getPixels())[index];
+          ok = ok && actual == filmLoaded(filmSample(x, y, c), bitSize);
+        }
+      }
+    }
+  }
+  remove(path);
+  return ok;
+}
+
+
+// Checks that loading the file throws an ImageException (rather than
+// anything else, like std::bad_alloc).
+static bool failsToLoad(const char* path, const Bytes& bytes)
+{
+  writeFile(path, bytes);
+  bool threw = false;
+  try {
+    vgl::RawImage img(path);
+  } catch (vgl::ImageException&) {
+    threw = true;
+  }
+  remove(path);
+  return threw;
+}
+
+
+//
+// TESTS
+//
+
+class TestImage : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestImage);
+  CPPUNIT_TEST(testOriginBMP);
+  CPPUNIT_TEST(testOriginTGA);
+  CPPUNIT_TEST(testRLETGA);
+  CPPUNIT_TEST(testRLETGAParallel);
+  CPPUNIT_TEST(testOriginPPM);
+  CPPUNIT_TEST(testFlipVertical);
+  CPPUNIT_TEST(testPPM16Bit);
+  CPPUNIT_TEST(testPixelTypes);
+  CPPUNIT_TEST(testLoadErrors);
+  CPPUNIT_TEST(testSaveTGA);
+  CPPUNIT_TEST(testSavePNG);
+  CPPUNIT_TEST(testSavePPM);
+  CPPUNIT_TEST(testSaveJPG);
+  CPPUNIT_TEST(testSaveErrors);
+  CPPUNIT_TEST(testLoadDPX);
+  CPPUNIT_TEST(testLoadCIN);
+  CPPUNIT_TEST(testFilmErrors);
+  CPPUNIT_TEST(testLoadEXR);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testOriginBMP() {
+    // 5 pixels of 3 bytes needs a byte of padding on each row.
+    CPPUNIT_ASSERT( loadsPattern("test_image.bmp", makeBMP(5, 3, false), 5, 3, 3) );
+    CPPUNIT_ASSERT( loadsPattern("test_image.bmp", makeBMP(5, 3, true), 5, 3, 3) );
+  }
+
+  void testOriginTGA() {
+    for (unsigned int channels = 1; channels <= 4; channels += (channels == 1) ? 2 : 1) {
+      CPPUNIT_ASSERT( loadsPattern("test_image.tga", makeTGA(7, 4, channels, false), 7, 4, channels) );
+      CPPUNIT_ASSERT( loadsPattern("test_image.tga", makeTGA(7, 4, channels, true), 7, 4, channels) );
+    }
+  }
+
+  void testRLETGA() {
+    for (unsigned int channels = 1; channels <= 4; channels += (channels == 1) ? 2 : 1) {
+      CPPUNIT_ASSERT( loadsRLE("test_image.tga", 150, 6, channels, false) );
+      CPPUNIT_ASSERT( loadsRLE("test_image.tga", 150, 6, channels, true) );
+      CPPUNIT_ASSERT( loadsRLE("test_image.tga", 3, 11, channels, false) );
+    }
+
+    // Truncated part way through a packet, and with a whole packet missing.
+    Bytes tga = makeRLETGA(150, 6, 3, false);
+    tga.resize(tga.size() - 1);
+    writeFile("test_image.tga", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.tga"), vgl::ImageException );
+    tga.resize(tga.size() - 3);
+    writeFile("test_image.tga", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.tga"), vgl::ImageException );
+    tga.resize(21);
+    writeFile("test_image.tga", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.tga"), vgl::ImageException );
+    remove("test_image.tga");
+  }
+
+  void testRLETGAParallel() {
+    // Big enough to be decoded a row per thread, so every row has to start at
+    // the right place in whatever packet crosses into it.
+    CPPUNIT_ASSERT( loadsRLE("test_image.tga", 600, 500, 3, false) );
+    CPPUNIT_ASSERT( loadsRLE("test_image.tga", 512, 512, 4, true) );
+    CPPUNIT_ASSERT( loadsRLE("test_image.tga", 1000, 300, 1, false) );
+
+    Bytes tga = makeRLETGA(512, 512, 3, true);
+    tga.resize(tga.size() - 2);
+    writeFile("test_image.tga", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.tga"), vgl::ImageException );
+    remove("test_image.tga");
+  }
+
+  void testOriginPPM() {
+    CPPUNIT_ASSERT( loadsPattern("test_image.ppm", makePPM(6, 5, true), 6, 5, 3) );
+    CPPUNIT_ASSERT( loadsPattern("test_image.ppm", makePPM(6, 5, false), 6, 5, 3) );
+  }
+
+  void testFlipVertical() {
+    const char* path = "test_image.tga";
+    writeFile(path, makeTGA(9, 5, 4, false));
+    vgl::RawImage img(path, vgl::ORIGIN_TOP_LEFT);
+    remove(path);
+
+    img.flipVerticalInPlace();
+    CPPUNIT_ASSERT( img.getOrigin() == vgl::ORIGIN_BOTTOM_LEFT );
+    CPPUNIT_ASSERT( hasPattern(img, 4) );
+    img.flipVerticalInPlace();
+    CPPUNIT_ASSERT( img.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    CPPUNIT_ASSERT( hasPattern(img, 4) );
+  }
+
+  void testPPM16Bit() {
+    // Samples get rescaled to the full 16 bit range, including ones big
+    // enough to overflow an int along the way. Anything over the maximum
+    // value is clamped to it.
+    const unsigned int kSamples[] = { 0, 1, 32768, 32769, 40000, 65534, 65535, 0, 0 };
+    const char* path = "test_image.ppm";
+    for (int binary = 0; binary < 2; ++binary) {
+      writeFile(path, makePPM16(kSamples, 9, 65535, binary != 0));
+      vgl::RawImage full(path, vgl::ORIGIN_TOP_LEFT);
+      CPPUNIT_ASSERT( full.getPixelType() == GL_UNSIGNED_SHORT && full.getBytesPerPixel() == 6 );
+      const unsigned short* pixels = (const unsigned short*)full.getPixels();
+      for (unsigned int i = 0; i < 9; ++i)
+        CPPUNIT_ASSERT( pixels[i] == kSamples[i] );
+
+      const unsigned int kTenBit[] = { 0, 1, 511, 1023, 1023, 2000 };
+      writeFile(path, makePPM16(kTenBit, 6, 1023, binary != 0));
+      vgl::RawImage tenBit(path, vgl::ORIGIN_TOP_LEFT);
+      pixels = (const unsigned short*)tenBit.getPixels();
+      CPPUNIT_ASSERT( pixels[0] == 0 && pixels[1] == 64 && pixels[2] == 32735 );
+      CPPUNIT_ASSERT( pixels[3] == 65535 && pixels[4] == 65535 && pixels[5] == 65535 );
+    }
+    remove(path);
+  }
+
+  void testPixelTypes() {
+    // New images start out white (or opaque), whatever the pixel type.
+    vgl::RawImage bytes(GL_RGBA, 4, 3, 2);
+    vgl::RawImage shorts(GL_RGBA, 8, 3, 2, GL_UNSIGNED_SHORT);
+    vgl::RawImage halves(GL_RGBA, 8, 3, 2, GL_HALF_FLOAT);
+    vgl::RawImage floats(GL_RGBA, 16, 3, 2, GL_FLOAT, vgl::ORIGIN_TOP_LEFT);
+    for (unsigned int i = 0; i < 3 * 2 * 4; ++i) {
+      CPPUNIT_ASSERT( bytes.getPixels()[i] == 255 );
+      CPPUNIT_ASSERT( ((unsigned short*)shorts.getPixels())[i] == 65535 );
+      CPPUNIT_ASSERT( ((unsigned short*)halves.getPixels())[i] == 0x3C00 );
+      CPPUNIT_ASSERT( ((float*)floats.getPixels())[i] == 1.0f );
+    }
+    CPPUNIT_ASSERT( floats.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+
+    // Copies keep the pixel type.
+    vgl::RawImage copy(halves);
+    CPPUNIT_ASSERT( copy.getPixelType() == GL_HALF_FLOAT && copy.getBytesPerPixel() == 8 );
+    copy = floats;
+    CPPUNIT_ASSERT( copy.getPixelType() == GL_FLOAT && copy.getBytesPerPixel() == 16 );
+    CPPUNIT_ASSERT( copy.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    CPPUNIT_ASSERT( memcmp(copy.getPixels(), floats.getPixels(), 3 * 2 * 16) == 0 );
+
+    // Converting 8 bit pixels through every wider type and back again
+    // doesn't lose anything.
+    const char* path = "test_image.tga";
+    writeFile(path, makeTGA(9, 5, 4, true));
+    vgl::RawImage img(path);
+    remove(path);
+    vgl::RawImage original(img);
+    const int kPixelTypes[] = { GL_UNSIGNED_SHORT, GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_BYTE };
+    const unsigned int kBytes[] = { 8, 16, 8, 4 };
+    for (unsigned int i = 0; i < 4; ++i) {
+      img.convertInPlace(GL_BGRA, kPixelTypes[i]);
+      CPPUNIT_ASSERT( img.getPixelType() == kPixelTypes[i] );
+      CPPUNIT_ASSERT( img.getBytesPerPixel() == kBytes[i] );
+    }
+    CPPUNIT_ASSERT( memcmp(img.getPixels(), original.getPixels(), 9 * 5 * 4) == 0 );
+
+    // Changing the layout and type at the same time.
+    img.convertInPlace(GL_RGB, GL_FLOAT);
+    CPPUNIT_ASSERT( img.getType() == GL_RGB && img.getBytesPerPixel() == 12 );
+    const float* rgb = (const float*)img.getPixels();
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( rgb[0], original.getPixels()[2] / 255.0, 1e-6 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( rgb[2], original.getPixels()[0] / 255.0, 1e-6 );
+
+    // Unknown pixel types are rejected.
+    CPPUNIT_ASSERT_THROW( img.convertInPlace(GL_RGB, GL_INT), vgl::ImageException );
+  }
+
+  void testLoadErrors() {
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image_missing.png"), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image"), vgl::ImageException );
+
+    // Truncated pixel data.
+    Bytes tga = makeTGA(7, 4, 3, false);
+    tga.resize(tga.size() - 10);
+    writeFile("test_image.tga", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.tga"), vgl::ImageException );
+    remove("test_image.tga");
+
+    writeFile("test_image.xyz", tga);
+    CPPUNIT_ASSERT_THROW( vgl::RawImage("test_image.xyz"), vgl::ImageException );
+    remove("test_image.xyz");
+  }
+
+  void testSaveTGA() {
+    // 8, 16, 24 and 32 bit sources, with odd widths and enough rows for the
+    // run length encoder to be split across threads. The 16 bit one (grey
+    // and alpha) gets saved as 32 bit BGRA.
+    const int kTypes[] = { GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+    vgl::SaveOptions options;
+    for (unsigned int channels = 1; channels <= 4; ++channels) {
+      for (int origin = 0; origin < 2; ++origin) {
+        vgl::RawImage img = makeNoise(kTypes[channels - 1], channels, 301, 97, GL_UNSIGNED_BYTE,
+            origin ? vgl::ORIGIN_TOP_LEFT : vgl::ORIGIN_BOTTOM_LEFT);
+        options.tgaRLE = true;
+        CPPUNIT_ASSERT( savesAndLoads(img, "test_image.tga", options) );
+        options.tgaRLE = false;
+        CPPUNIT_ASSERT( savesAndLoads(img, "test_image.tga", options) );
+      }
+    }
+
+    // A single pixel, and a single row of one long run.
+    options.tgaRLE = true;
+    CPPUNIT_ASSERT( savesAndLoads(makeNoise(GL_RGB, 3, 1, 1, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT),
+        "test_image.tga", options) );
+    vgl::RawImage flat(GL_RGBA, 4, 1000, 1);
+    CPPUNIT_ASSERT( savesAndLoads(flat, "test_image.tga", options) );
+  }
+
+  void testSavePNG() {
+    // 8 and 16 bit, through both libpng and the parallel strip writer.
+    const int kTypes[] = { GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+    const int kPixelTypes[] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT };
+    vgl::SaveOptions options;
+    for (unsigned int channels = 1; channels <= 4; ++channels) {
+      for (unsigned int i = 0; i < 2; ++i) {
+        vgl::RawImage img = makeNoise(kTypes[channels - 1], channels, 67, 45, kPixelTypes[i],
+            (channels % 2) ? vgl::ORIGIN_TOP_LEFT : vgl::ORIGIN_BOTTOM_LEFT);
+        options.pngParallel = false;
+        CPPUNIT_ASSERT( savesAndLoads(img, "test_image.png", options, kPixelTypes[i]) );
+        options.pngParallel = true;
+        options.pngStripRows = 0;
+        CPPUNIT_ASSERT( savesAndLoads(img, "test_image.png", options, kPixelTypes[i]) );
+        // Strips which don't divide the height evenly.
+        options.pngStripRows = 7;
+        CPPUNIT_ASSERT( savesAndLoads(img, "test_image.png", options, kPixelTypes[i]) );
+      }
+    }
+
+    // Float pixels are saved as 8 bit.
+    vgl::RawImage floats(GL_RGB, 12, 5, 3, GL_FLOAT);
+    floats.save("test_image.png");
+    vgl::RawImage loaded("test_image.png");
+    remove("test_image.png");
+    CPPUNIT_ASSERT( loaded.getPixelType() == GL_UNSIGNED_BYTE && loaded.getPixels()[0] == 255 );
+  }
+
+  void testSavePPM() {
+    vgl::SaveOptions options;
+    vgl::RawImage rgb = makeNoise(GL_RGB, 3, 33, 21, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT);
+    CPPUNIT_ASSERT( savesAndLoads(rgb, "test_image.ppm", options) );
+    vgl::RawImage deep = makeNoise(GL_RGB, 3, 33, 21, GL_UNSIGNED_SHORT, vgl::ORIGIN_TOP_LEFT);
+    CPPUNIT_ASSERT( savesAndLoads(deep, "test_image.ppm", options, GL_UNSIGNED_SHORT) );
+
+    // PPM has no alpha, so it's dropped.
+    vgl::RawImage rgba = makeNoise(GL_RGBA, 4, 8, 3, GL_UNSIGNED_BYTE, vgl::ORIGIN_TOP_LEFT);
+    rgba.save("test_image.ppm");
+    vgl::RawImage loaded("test_image.ppm", vgl::ORIGIN_TOP_LEFT);
+    remove("test_image.ppm");
+    CPPUNIT_ASSERT( loaded.getType() == GL_RGB );
+    CPPUNIT_ASSERT( memcmp(loaded.getPixels(), rgba.getPixels(), 3) == 0 );
+  }
+
+  void testSaveJPG() {
+    // JPEG is lossy, so use a smooth image and allow a little error.
+    vgl::RawImage img(GL_RGB, 3, 35, 19);
+    unsigned char* p = img.getPixels();
+    for (unsigned int y = 0; y < 19; ++y) {
+      for (unsigned int x = 0; x < 35; ++x, p += 3) {
+        p[0] = (unsigned char)(x * 7);
+        p[1] = (unsigned char)(y * 13);
+        p[2] = 128;
+      }
+    }
+    vgl::SaveOptions options;
+    options.jpegQuality = 100;
+    CPPUNIT_ASSERT( savesAndLoads(img, "test_image.jpg", options, GL_UNSIGNED_BYTE, 8) );
+
+    vgl::RawImage grey(img);
+    grey.convertInPlace(GL_LUMINANCE);
+    grey.save("test_image.jpeg", options);
+    vgl::RawImage loaded("test_image.jpeg");
+    remove("test_image.jpeg");
+    CPPUNIT_ASSERT( loaded.getBytesPerPixel() == 1 );
+    CPPUNIT_ASSERT( samePixels(grey, loaded, GL_UNSIGNED_BYTE, 8) );
+  }
+
+  void testSaveErrors() {
+    vgl::RawImage img(GL_RGB, 3, 4, 4);
+    CPPUNIT_ASSERT_THROW( img.save("test_image"), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( img.save("test_image.xyz"), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( img.save("test_image_missing_dir/test_image.png"), vgl::ImageException );
+
+    vgl::RawImage wide(GL_LUMINANCE, 1, 70000, 1);
+    CPPUNIT_ASSERT_THROW( wide.save("test_image.tga"), vgl::ImageException );
+    remove("test_image.tga");
+    // Too wide for libjpeg, whose error has to come back as an exception.
+    CPPUNIT_ASSERT_THROW( wide.save("test_image.jpg"), vgl::ImageException );
+    CPPUNIT_ASSERT( fopen("test_image.jpg", "rb") == NULL );
+
+    img.deletePixels();
+    CPPUNIT_ASSERT_THROW( img.save("test_image.png"), vgl::ImageException );
+  }
+
+  void testLoadDPX() {
+    const char* path = "test_image.dpx";
+    for (int bigEndian = 0; bigEndian < 2; ++bigEndian) {
+      for (int topDown = 0; topDown < 2; ++topDown) {
+        // 13 RGB pixels make 39 samples a row: three lots of 12 for the SSSE3
+        // unpacking, and a partly filled word left over.
+        for (unsigned int packing = 1; packing <= 2; ++packing) {
+          CPPUNIT_ASSERT( loadsFilm(path, makeDPX(13, 5, 3, 10, packing, bigEndian, topDown), 13, 5, 3, 10) );
+          CPPUNIT_ASSERT( loadsFilm(path, makeDPX(7, 3, 4, 12, packing, bigEndian, topDown), 7, 3, 4, 12) );
+        }
+        CPPUNIT_ASSERT( loadsFilm(path, makeDPX(200, 3, 3, 10, 1, bigEndian, topDown), 200, 3, 3, 10) );
+        CPPUNIT_ASSERT( loadsFilm(path, makeDPX(5, 4, 3, 16, 0, bigEndian, topDown), 5, 4, 3, 16) );
+      }
+    }
+
+    // 8 and 16 bit rows are only padded to 32 bits when the data is packed.
+    CPPUNIT_ASSERT( loadsFilm(path, makeDPX(5, 4, 1, 8, 0, true, true), 5, 4, 1, 8) );
+    CPPUNIT_ASSERT( loadsFilm(path, makeDPX(5, 4, 1, 8, 1, true, true), 5, 4, 1, 8) );
+    CPPUNIT_ASSERT( loadsFilm(path, makeDPX(3, 2, 1, 16, 1, false, false), 3, 2, 1, 16) );
+
+    // Padding at the end of each row, and data which doesn't follow the
+    // header straight away.
+    CPPUNIT_ASSERT( loadsFilm(path, makeDPX(4, 3, 3, 10, 1, true, true, 12), 4, 3, 3, 10) );
+    Bytes dpx = makeDPX(6, 2, 3, 10, 2, false, true);
+    dpx.insert(dpx.begin() + 832, 100, 0);
+    setU32(dpx, 808, 932, false);
+    CPPUNIT_ASSERT( loadsFilm(path, dpx, 6, 2, 3, 10) );
+  }
+
+  void testLoadCIN() {
+    const char* path = "test_image.cin";
+    for (int bigEndian = 0; bigEndian < 2; ++bigEndian) {
+      for (int topDown = 0; topDown < 2; ++topDown) {
+        CPPUNIT_ASSERT( loadsFilm(path, makeCIN(11, 4, 3, 10, bigEndian, topDown), 11, 4, 3, 10) );
+        CPPUNIT_ASSERT( loadsFilm(path, makeCIN(6, 3, 1, 8, bigEndian, topDown), 6, 3, 1, 8) );
+      }
+    }
+    CPPUNIT_ASSERT( loadsFilm(path, makeCIN(64, 2, 1, 10, true, true), 64, 2, 1, 10) );
+  }
+
+  void testFilmErrors() {
+    Bytes dpx = makeDPX(13, 5, 3, 10, 1, true, true);
+    dpx.resize(dpx.size() - 4);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", Bytes(dpx.begin(), dpx.begin() + 500)) );
+
+    // Sizes in the header far bigger than the file are caught before anything
+    // gets allocated for them.
+    dpx = makeDPX(13, 5, 3, 10, 1, true, true);
+    setU32(dpx, 772, 0x7FFFFFFF, true);
+    setU32(dpx, 776, 0x7FFFFFFF, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    setU32(dpx, 772, 13, true);
+    setU32(dpx, 776, 0x40000000, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    setU32(dpx, 776, 5, true);
+    setU32(dpx, 812, 0x7FFFFFF0, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    setU32(dpx, 812, 0, true);
+    setU32(dpx, 4, 0x7FFFFFF0, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    setU32(dpx, 4, 832, true);
+    setU32(dpx, 772, 0, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    setU32(dpx, 772, 13, true);
+    dpx[800] = 100;
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+    dpx[800] = 50;
+    dpx[803] = 10;
+    setU16(dpx, 804, 0, true);
+    CPPUNIT_ASSERT( failsToLoad("test_image.dpx", dpx) );
+
+    Bytes cin = makeCIN(11, 4, 3, 10, false, true);
+    cin.resize(cin.size() - 1);
+    CPPUNIT_ASSERT( failsToLoad("test_image.cin", cin) );
+    cin = makeCIN(11, 4, 3, 10, false, true);
+    setU32(cin, 200, 0xFFFFFFFF, false);
+    setU32(cin, 204, 0xFFFFFFFF, false);
+    CPPUNIT_ASSERT( failsToLoad("test_image.cin", cin) );
+    cin = makeCIN(11, 4, 3, 10, false, true);
+    cin[198 + 28] = 8;
+    CPPUNIT_ASSERT( failsToLoad("test_image.cin", cin) );
+  }
+
+  void testLoadEXR() {
+    const char* path = "test_image.exr";
+#ifdef VGL_USE_OPENEXR
+    // Half float RGBA, with y counting rows from the top as EXR stores them.
+    const unsigned int kWidth = 5, kHeight = 3;
+    std::vector<Imf::Rgba> pixels(kWidth * kHeight);
+    for (unsigned int y = 0; y < kHeight; ++y) {
+      for (unsigned int x = 0; x < kWidth; ++x)
+        pixels[y * kWidth + x] = Imf::Rgba(x * 0.25f, y * 0.5f, -1.0f, 1.0f + x + y);
+    }
+    {
+      Imf::RgbaOutputFile out(path, kWidth, kHeight, Imf::WRITE_RGBA);
+      out.setFrameBuffer(&pixels[0], 1, kWidth);
+      out.writePixels(kHeight);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+      vgl::ImageOrigin origin = (i == 0) ? vgl::ORIGIN_BOTTOM_LEFT : vgl::ORIGIN_TOP_LEFT;
+      vgl::RawImage img(path, origin);
+      CPPUNIT_ASSERT( img.getOrigin() == origin && img.getType() == GL_RGBA );
+      CPPUNIT_ASSERT( img.getPixelType() == GL_HALF_FLOAT && img.getBytesPerPixel() == 8 );
+      CPPUNIT_ASSERT( img.getWidth() == kWidth && img.getHeight() == kHeight );
+      const unsigned short* p = (const unsigned short*)img.getPixels();
+      for (unsigned int row = 0; row < kHeight; ++row) {
+        unsigned int y = (origin == vgl::ORIGIN_TOP_LEFT) ? row : kHeight - 1 - row;
+        for (unsigned int x = 0; x < kWidth; ++x, p += 4) {
+          const Imf::Rgba& expected = pixels[y * kWidth + x];
+          CPPUNIT_ASSERT( p[0] == expected.r.bits() && p[1] == expected.g.bits() );
+          CPPUNIT_ASSERT( p[2] == expected.b.bits() && p[3] == expected.a.bits() );
+        }
+      }
+    }
+    remove(path);
+
+    CPPUNIT_ASSERT( failsToLoad(path, Bytes(100, 0x55)) );
+#else
+    // Without OpenEXR, even a valid file can't be loaded.
+    CPPUNIT_ASSERT( failsToLoad(path, Bytes(100, 0x55)) );
+#endif
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestImage);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
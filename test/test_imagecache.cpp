@@ -0,0 +1,263 @@
+#include "vgl_imagecache.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <utime.h>
+
+
+//
+// HELPER METHODS
+//
+
+// Saves an RGB image where every byte is the given value.
+static void writeImage(const char* path, unsigned int width, unsigned int height, unsigned char value)
+{
+  vgl::RawImage img(GL_RGB, 3, width, height);
+  memset(img.getPixels(), value, size_t(width) * height * 3);
+  img.save(path);
+}
+
+
+// Moves the file's modification time, as if it had been edited.
+static void touch(const char* path, time_t mtime)
+{
+  struct utimbuf times;
+  times.actime = mtime;
+  times.modtime = mtime;
+  utime(path, &times);
+}
+
+
+struct Getter {
+  vgl::ImageCache* cache;
+  const vgl::RawImage* image;
+};
+
+
+static void* getImage(void* arg)
+{
+  Getter* g = (Getter*)arg;
+  vgl::ImageHandle handle = g->cache->get("test_imagecache_a.tga");
+  g->image = handle.get();
+  return NULL;
+}
+
+
+//
+// TESTS
+//
+
+class TestImageCache : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestImageCache);
+  CPPUNIT_TEST(testHits);
+  CPPUNIT_TEST(testOptions);
+  CPPUNIT_TEST(testModified);
+  CPPUNIT_TEST(testEviction);
+  CPPUNIT_TEST(testHandles);
+  CPPUNIT_TEST(testErrors);
+  CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {
+    writeImage("test_imagecache_a.tga", 10, 10, 10);
+    writeImage("test_imagecache_b.tga", 20, 5, 20);
+    writeImage("test_imagecache_c.tga", 7, 3, 30);
+  }
+
+  void tearDown() {
+    remove("test_imagecache_a.tga");
+    remove("test_imagecache_b.tga");
+    remove("test_imagecache_c.tga");
+  }
+
+protected:
+  void testHits() {
+    vgl::ImageCache cache;
+    CPPUNIT_ASSERT( cache.getMaxBytes() == vgl::ImageCache::kDefaultMaxBytes );
+    vgl::ImageHandle a = cache.get("test_imagecache_a.tga");
+    vgl::ImageHandle b = cache.get("test_imagecache_a.tga");
+    CPPUNIT_ASSERT( a.get() != NULL && a.get() == b.get() );
+    CPPUNIT_ASSERT( a->getWidth() == 10 && (*a).getPixels()[0] == 10 );
+
+    vgl::ImageCacheStats stats = cache.getStats();
+    CPPUNIT_ASSERT( stats.hits == 1 && stats.misses == 1 && stats.coalesced == 0 );
+    CPPUNIT_ASSERT( stats.entries == 1 && stats.bytes == 300 );
+
+    // Resetting the stats keeps track of the memory still in use.
+    cache.resetStats();
+    stats = cache.getStats();
+    CPPUNIT_ASSERT( stats.hits == 0 && stats.misses == 0 );
+    CPPUNIT_ASSERT( stats.entries == 1 && stats.bytes == 300 );
+  }
+
+  void testOptions() {
+    vgl::ImageCache cache;
+    vgl::ImageLoadOptions options;
+    vgl::ImageHandle plain = cache.get("test_imagecache_b.tga", options);
+    options.downsampleX = 2;
+    options.downsampleY = 5;
+    options.targetType = GL_RGBA;
+    options.targetPixelType = GL_UNSIGNED_SHORT;
+    vgl::ImageHandle small = cache.get("test_imagecache_b.tga", options);
+    options.origin = vgl::ORIGIN_TOP_LEFT;
+    vgl::ImageHandle flipped = cache.get("test_imagecache_b.tga", options);
+
+    CPPUNIT_ASSERT( plain.get() != small.get() && small.get() != flipped.get() );
+    CPPUNIT_ASSERT( plain->getWidth() == 20 && plain->getBytesPerPixel() == 3 );
+    CPPUNIT_ASSERT( small->getWidth() == 10 && small->getHeight() == 1 );
+    CPPUNIT_ASSERT( small->getType() == GL_RGBA && small->getPixelType() == GL_UNSIGNED_SHORT );
+    CPPUNIT_ASSERT( ((const unsigned short*)small->getPixels())[0] == 20 * 257 );
+    CPPUNIT_ASSERT( flipped->getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    CPPUNIT_ASSERT( cache.getStats().misses == 3 && cache.getStats().entries == 3 );
+    CPPUNIT_ASSERT( cache.getStats().bytes == 300 + 80 + 80 );
+
+    CPPUNIT_ASSERT( cache.get("test_imagecache_b.tga", options).get() == flipped.get() );
+  }
+
+  void testModified() {
+    vgl::ImageCache cache;
+    touch("test_imagecache_a.tga", 1000000);
+    vgl::ImageHandle before = cache.get("test_imagecache_a.tga");
+
+    writeImage("test_imagecache_a.tga", 4, 4, 99);
+    touch("test_imagecache_a.tga", 2000000);
+    vgl::ImageHandle after = cache.get("test_imagecache_a.tga");
+    CPPUNIT_ASSERT( after.get() != before.get() );
+    CPPUNIT_ASSERT( after->getWidth() == 4 && after->getPixels()[0] == 99 );
+    CPPUNIT_ASSERT( before->getWidth() == 10 && before->getPixels()[0] == 10 );
+    CPPUNIT_ASSERT( cache.getStats().misses == 2 );
+  }
+
+  void testEviction() {
+    // Room for a and b (300 + 300 bytes) but not c as well.
+    vgl::ImageCache cache(650);
+    const vgl::RawImage* a = cache.get("test_imagecache_a.tga").get();
+    cache.get("test_imagecache_b.tga");
+    CPPUNIT_ASSERT( cache.getStats().entries == 2 && cache.getStats().evictions == 0 );
+
+    // Using a again makes b the least recently used.
+    CPPUNIT_ASSERT( cache.get("test_imagecache_a.tga").get() == a );
+    cache.get("test_imagecache_c.tga");
+    vgl::ImageCacheStats stats = cache.getStats();
+    CPPUNIT_ASSERT( stats.evictions == 1 && stats.entries == 2 && stats.bytes == 300 + 63 );
+    CPPUNIT_ASSERT( cache.get("test_imagecache_a.tga").get() == a );
+    CPPUNIT_ASSERT( cache.getStats().hits == 2 );
+
+    // Shrinking the cache evicts straight away, least recently used first.
+    cache.setMaxBytes(350);
+    CPPUNIT_ASSERT( cache.getMaxBytes() == 350 );
+    CPPUNIT_ASSERT( cache.getStats().entries == 1 && cache.getStats().bytes == 300 );
+    CPPUNIT_ASSERT( cache.get("test_imagecache_a.tga").get() == a );
+
+    // An image bigger than the whole cache is returned but not kept.
+    cache.setMaxBytes(100);
+    CPPUNIT_ASSERT( cache.getStats().entries == 0 );
+    vgl::ImageHandle big = cache.get("test_imagecache_b.tga");
+    CPPUNIT_ASSERT( big->getWidth() == 20 );
+    CPPUNIT_ASSERT( cache.getStats().entries == 0 && cache.getStats().bytes == 0 );
+
+    cache.clear();
+    CPPUNIT_ASSERT( cache.getStats().entries == 0 && cache.getStats().bytes == 0 );
+    CPPUNIT_ASSERT( big->getPixels()[0] == 20 );
+  }
+
+  void testHandles() {
+    vgl::ImageHandle empty;
+    CPPUNIT_ASSERT( empty.get() == NULL );
+
+    vgl::ImageHandle kept;
+    {
+      vgl::ImageCache cache;
+      vgl::ImageHandle handle = cache.get("test_imagecache_c.tga");
+      kept = handle;
+      kept = kept;
+      vgl::ImageHandle copy(kept);
+      CPPUNIT_ASSERT( copy.get() == handle.get() );
+      copy = empty;
+      CPPUNIT_ASSERT( copy.get() == NULL );
+    }
+
+    // The image outlives the cache.
+    CPPUNIT_ASSERT( kept->getWidth() == 7 && kept->getPixels()[0] == 30 );
+  }
+
+  void testErrors() {
+    vgl::ImageCache cache;
+    CPPUNIT_ASSERT_THROW( cache.get("test_imagecache_missing.tga"), vgl::ImageException );
+
+    FILE* file = fopen("test_imagecache_a.tga", "wb");
+    fputs("not a TGA", file);
+    fclose(file);
+    touch("test_imagecache_a.tga", 1000000);
+    CPPUNIT_ASSERT_THROW( cache.get("test_imagecache_a.tga"), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( cache.get("test_imagecache_a.tga"), vgl::ImageException );
+    vgl::ImageCacheStats stats = cache.getStats();
+    CPPUNIT_ASSERT( stats.failures == 2 && stats.misses == 2 && stats.entries == 0 );
+
+    // Failures aren't cached, so fixing the file works even if its time
+    // doesn't change.
+    writeImage("test_imagecache_a.tga", 10, 10, 10);
+    touch("test_imagecache_a.tga", 1000000);
+    CPPUNIT_ASSERT( cache.get("test_imagecache_a.tga")->getWidth() == 10 );
+
+    // Errors converting after the load are reported too.
+    vgl::ImageLoadOptions options;
+    options.targetPixelType = GL_INT;
+    CPPUNIT_ASSERT_THROW( cache.get("test_imagecache_b.tga", options), vgl::ImageException );
+    CPPUNIT_ASSERT( cache.getStats().entries == 1 );
+  }
+
+  void testThreads() {
+    // Lots of threads asking for the same image at once decode it once
+    // between them.
+    const unsigned int kThreads = 16;
+    vgl::ImageCache cache;
+    pthread_t threads[kThreads];
+    Getter getters[kThreads];
+    for (unsigned int i = 0; i < kThreads; ++i) {
+      getters[i].cache = &cache;
+      getters[i].image = NULL;
+      CPPUNIT_ASSERT( pthread_create(&threads[i], NULL, getImage, &getters[i]) == 0 );
+    }
+    for (unsigned int i = 0; i < kThreads; ++i)
+      pthread_join(threads[i], NULL);
+
+    vgl::ImageCacheStats stats = cache.getStats();
+    CPPUNIT_ASSERT( stats.misses == 1 && stats.hits + stats.coalesced == kThreads - 1 );
+    for (unsigned int i = 1; i < kThreads; ++i)
+      CPPUNIT_ASSERT( getters[i].image == getters[0].image );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestImageCache);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include "vgl_imagestats.h"
+#include "vgl_convert.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Big enough to be split into several blocks, with a size that leaves some
+// samples over at the end for the scalar code.
+static const unsigned int kWidth = 517;
+static const unsigned int kHeight = 301;
+
+
+// Random values, except that one pixel holds the extremes of each channel.
+static vgl::RawImage* makeTestImage(int type, unsigned int channels, int pixelType)
+{
+  unsigned int bytesPerChannel = vgl::bytesPerChannelForPixelType(pixelType);
+  vgl::RawImage* img = new vgl::RawImage(type, channels * bytesPerChannel, kWidth, kHeight, pixelType);
+  size_t numSamples = size_t(kWidth) * kHeight * channels;
+  srand(42);
+  for (size_t i = 0; i < numSamples; ++i) {
+    float value = (i < channels) ? 0.0f : (i < 2 * channels) ? 1.0f : rand() / float(RAND_MAX);
+    switch (pixelType) {
+      case GL_UNSIGNED_BYTE:
+        img->getPixels()[i] = (unsigned char)(value * 255.0f + 0.5f);
+        break;
+      case GL_UNSIGNED_SHORT:
+        ((unsigned short*)img->getPixels())[i] = (unsigned short)(value * 65535.0f + 0.5f);
+        break;
+      case GL_HALF_FLOAT:
+        ((unsigned short*)img->getPixels())[i] = vgl::floatToHalf(value);
+        break;
+      default:
+        ((float*)img->getPixels())[i] = value * 4.0f - 2.0f;
+        break;
+    }
+  }
+  return img;
+}
+
+
+static double sampleAt(const vgl::RawImage* img, size_t i)
+{
+  switch (img->getPixelType()) {
+    case GL_UNSIGNED_BYTE:  return img->getPixels()[i] / 255.0;
+    case GL_UNSIGNED_SHORT: return ((const unsigned short*)img->getPixels())[i] / 65535.0;
+    case GL_HALF_FLOAT:     return vgl::halfToFloat(((const unsigned short*)img->getPixels())[i]);
+    default:                return ((const float*)img->getPixels())[i];
+  }
+}
+
+
+static bool close(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-9 + 1e-9 * std::fabs(b);
+}
+
+
+// Compares imageStats and histogram against straightforward loops.
+static bool matchesReference(int type, unsigned int channels, int pixelType)
+{
+  vgl::RawImage* img = makeTestImage(type, channels, pixelType);
+  vgl::ImageStats stats = vgl::imageStats(*img);
+  vgl::Histogram hist = vgl::histogram(*img, 100, -0.5, 1.5);
+
+  bool ok = stats.numChannels == channels && hist.numChannels == channels;
+  size_t numPixels = size_t(kWidth) * kHeight;
+  for (unsigned int c = 0; ok && c < channels; ++c) {
+    double lo = HUGE_VAL, hi = -HUGE_VAL, sum = 0.0, sumSq = 0.0;
+    std::vector<size_t> counts(100, 0);
+    for (size_t p = 0; p < numPixels; ++p) {
+      double v = sampleAt(img, p * channels + c);
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      sum += v;
+      sumSq += v * v;
+      int bin = int(std::floor(float((float(v) + 0.5f) * 50.0f)));
+      ++counts[std::max(0, std::min(bin, 99))];
+    }
+    double mean = sum / numPixels;
+    double stdDev = std::sqrt(sumSq / numPixels - mean * mean);
+    ok = close(stats.min[c], lo) && close(stats.max[c], hi) &&
+         close(stats.mean[c], mean) && std::fabs(stats.stdDev[c] - stdDev) < 1e-7;
+    for (unsigned int bin = 0; ok && bin < 100; ++bin)
+      ok = hist.count(c, bin) == counts[bin];
+  }
+  delete img;
+  return ok;
+}
+
+
+//
+// TESTS
+//
+
+class TestImageStats : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestImageStats);
+  CPPUNIT_TEST(testUnsignedByte);
+  CPPUNIT_TEST(testUnsignedShort);
+  CPPUNIT_TEST(testHalfFloat);
+  CPPUNIT_TEST(testFloat);
+  CPPUNIT_TEST(testHistogramBins);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testUnsignedByte() {
+    CPPUNIT_ASSERT( matchesReference(GL_ALPHA, 1, GL_UNSIGNED_BYTE) );
+    CPPUNIT_ASSERT( matchesReference(GL_LUMINANCE_ALPHA, 2, GL_UNSIGNED_BYTE) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGB, 3, GL_UNSIGNED_BYTE) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGBA, 4, GL_UNSIGNED_BYTE) );
+  }
+
+  void testUnsignedShort() {
+    CPPUNIT_ASSERT( matchesReference(GL_ALPHA, 1, GL_UNSIGNED_SHORT) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGB, 3, GL_UNSIGNED_SHORT) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGBA, 4, GL_UNSIGNED_SHORT) );
+  }
+
+  void testHalfFloat() {
+    CPPUNIT_ASSERT( matchesReference(GL_RGB, 3, GL_HALF_FLOAT) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGBA, 4, GL_HALF_FLOAT) );
+  }
+
+  void testFloat() {
+    CPPUNIT_ASSERT( matchesReference(GL_ALPHA, 1, GL_FLOAT) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGB, 3, GL_FLOAT) );
+    CPPUNIT_ASSERT( matchesReference(GL_RGBA, 4, GL_FLOAT) );
+  }
+
+  void testHistogramBins() {
+    // With 256 bins over [0, 1], each 8 bit value gets a bin to itself.
+    vgl::RawImage img(GL_ALPHA, 1, 256, 3);
+    for (unsigned int i = 0; i < 256 * 3; ++i)
+      img.getPixels()[i] = (unsigned char)(i % 256);
+    vgl::Histogram hist = vgl::histogram(img);
+    bool ok = true;
+    for (unsigned int bin = 0; bin < 256; ++bin)
+      ok = ok && hist.count(0, bin) == 3;
+    CPPUNIT_ASSERT( ok );
+
+    CPPUNIT_ASSERT_THROW( vgl::histogram(img, 0), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( vgl::histogram(img, 16, 1.0, 1.0), vgl::ImageException );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestImageStats);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "vgl_matrix3.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cmath>
+
+
+//
+// HELPER METHODS
+//
+
+static vgl::Matrix3d makeMatrix(double offset)
+{
+  vgl::Matrix3d m;
+  for (unsigned int i = 0; i < 9; ++i)
+    m.data[i] = std::sin(i * 1.7 + offset) * 3.0;
+  return m;
+}
+
+
+static bool isIdentity(const vgl::Matrix3d& a)
+{
+  for (unsigned int row = 0; row < 3; ++row) {
+    for (unsigned int col = 0; col < 3; ++col) {
+      if (std::fabs(a[row][col] - (row == col ? 1.0 : 0.0)) > 1e-9)
+        return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestMatrix3 : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestMatrix3);
+  CPPUNIT_TEST(testMultiply);
+  CPPUNIT_TEST(testTranspose);
+  CPPUNIT_TEST(testDeterminant);
+  CPPUNIT_TEST(testInverse);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testMultiply() {
+    vgl::Matrix3d a, b;
+    for (unsigned int i = 0; i < 9; ++i) {
+      a.data[i] = i + 1;
+      b.data[i] = 9 - i;
+    }
+    vgl::Matrix3d m = a * b;
+    CPPUNIT_ASSERT( m.m00 == 30 && m.m01 == 24 && m.m02 == 18 );
+    CPPUNIT_ASSERT( m.m10 == 84 && m.m11 == 69 && m.m12 == 54 );
+    CPPUNIT_ASSERT( m.m20 == 138 && m.m21 == 114 && m.m22 == 90 );
+
+    vgl::Vec3d v = a * vgl::Vec3d(1, 0, -1);
+    CPPUNIT_ASSERT( v.x == -2 && v.y == -2 && v.z == -2 );
+  }
+
+  void testTranspose() {
+    vgl::Matrix3d a = makeMatrix(0.0);
+    vgl::Matrix3d t = vgl::transpose(a);
+    CPPUNIT_ASSERT( t.m01 == a.m10 && t.m12 == a.m21 && t.m20 == a.m02 && t.m11 == a.m11 );
+  }
+
+  void testDeterminant() {
+    vgl::Matrix3d a;
+    a.m00 = 2;
+    a.m11 = 3;
+    a.m22 = 4;
+    a.m01 = 5; // Upper triangular, so still just the diagonal.
+    CPPUNIT_ASSERT( vgl::determinant(a) == 24 );
+
+    vgl::Matrix3d b = makeMatrix(1.0);
+    CPPUNIT_ASSERT( std::fabs(vgl::determinant(a * b) - vgl::determinant(a) * vgl::determinant(b)) < 1e-9 );
+    CPPUNIT_ASSERT( std::fabs(vgl::determinant(vgl::transpose(b)) - vgl::determinant(b)) < 1e-12 );
+  }
+
+  void testInverse() {
+    for (unsigned int i = 0; i < 8; ++i) {
+      // makeMatrix on its own is singular.
+      vgl::Matrix3d a = makeMatrix(i * 0.9);
+      for (unsigned int j = 0; j < 3; ++j)
+        a[j][j] += 4.0;
+      vgl::Matrix3d inv = vgl::inverse(a);
+      CPPUNIT_ASSERT( isIdentity(a * inv) );
+      CPPUNIT_ASSERT( isIdentity(inv * a) );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestMatrix3);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
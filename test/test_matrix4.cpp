@@ -0,0 +1,401 @@
+#include "vgl_matrix4.h"
+
+#include "vgl_utils.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(b));
+}
+
+
+template <typename Num>
+bool operator == (const vgl::Matrix4<Num>& a, const vgl::Matrix4<Num>& b)
+{
+  for (unsigned int i = 0; i < 16; ++i) {
+    if (!close(a.data[i], b.data[i]))
+      return false;
+  }
+  return true;
+}
+
+
+template <typename Num>
+bool operator == (const vgl::Vec4<Num>& a, const vgl::Vec4<Num>& b)
+{
+  return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z) && close(a.w, b.w);
+}
+
+
+template <typename Num>
+bool operator == (const vgl::Vec3<Num>& a, const vgl::Vec3<Num>& b)
+{
+  return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z);
+}
+
+
+// Compares a float result against a double precision one, relative to the
+// largest entry since inverses can have a wide range of magnitudes.
+static bool closeToDouble(const vgl::Matrix4f& a, const vgl::Matrix4d& b)
+{
+  double scale = 1.0;
+  for (unsigned int i = 0; i < 16; ++i)
+    scale = std::max(scale, std::fabs(b.data[i]));
+  for (unsigned int i = 0; i < 16; ++i) {
+    if (std::fabs(a.data[i] - b.data[i]) > 1e-4 * scale)
+      return false;
+  }
+  return true;
+}
+
+
+static vgl::Matrix4d toDouble(const vgl::Matrix4f& a)
+{
+  vgl::Matrix4d m;
+  for (unsigned int i = 0; i < 16; ++i)
+    m.data[i] = a.data[i];
+  return m;
+}
+
+
+static bool isIdentity(const vgl::Matrix4d& a)
+{
+  for (unsigned int row = 0; row < 4; ++row) {
+    for (unsigned int col = 0; col < 4; ++col) {
+      if (std::fabs(a[row][col] - (row == col ? 1.0 : 0.0)) > 1e-9)
+        return false;
+    }
+  }
+  return true;
+}
+
+
+// Every entry different, so a mixed up row or column shows.
+static vgl::Matrix4f makeMatrix(float offset)
+{
+  vgl::Matrix4f m;
+  for (unsigned int i = 0; i < 16; ++i)
+    m.data[i] = std::sin(i * 1.7f + offset) * 3.0f;
+  return m;
+}
+
+
+// makeMatrix's rows are linearly dependent, so weight the diagonal to get
+// something well away from singular.
+static vgl::Matrix4f makeInvertible(float offset)
+{
+  vgl::Matrix4f m = makeMatrix(offset);
+  for (unsigned int i = 0; i < 4; ++i)
+    m[i][i] += 5.0f;
+  return m;
+}
+
+
+//
+// TESTS
+//
+
+class TestMatrix4 : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestMatrix4);
+  CPPUNIT_TEST(testMultiply);
+  CPPUNIT_TEST(testMultiplyIdentity);
+  CPPUNIT_TEST(testTranspose);
+  CPPUNIT_TEST(testTransformVec4);
+  CPPUNIT_TEST(testTransformPoint);
+  CPPUNIT_TEST(testTransformVector);
+  CPPUNIT_TEST(testTransformArrays);
+  CPPUNIT_TEST(testDeterminant);
+  CPPUNIT_TEST(testInverse);
+  CPPUNIT_TEST(testAffineInverse);
+  CPPUNIT_TEST(testOrthonormalInverse);
+  CPPUNIT_TEST(testTRS);
+  CPPUNIT_TEST(testAxisAngleRotation);
+  CPPUNIT_TEST(testBatchRotate);
+  CPPUNIT_TEST(testLookAt);
+  CPPUNIT_TEST(testPerspective);
+  CPPUNIT_TEST(testOrtho);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testMultiply() {
+    vgl::Matrix4d a, b;
+    for (unsigned int i = 0; i < 16; ++i) {
+      a.data[i] = i + 1;
+      b.data[i] = 16 - i;
+    }
+    vgl::Matrix4d m = a * b;
+    CPPUNIT_ASSERT( m.m00 == 80 && m.m01 == 70 && m.m02 == 60 && m.m03 == 50 );
+    CPPUNIT_ASSERT( m.m10 == 240 && m.m11 == 214 && m.m12 == 188 && m.m13 == 162 );
+    CPPUNIT_ASSERT( m.m30 == 560 && m.m33 == 386 );
+
+    // The float version against the template.
+    vgl::Matrix4f fa = makeMatrix(0.0f), fb = makeMatrix(1.0f);
+    CPPUNIT_ASSERT( fa * fb == vgl::operator *<float>(fa, fb) );
+  }
+
+  void testMultiplyIdentity() {
+    vgl::Matrix4f a = makeMatrix(0.5f);
+    vgl::Matrix4f identity;
+    CPPUNIT_ASSERT( a * identity == a );
+    CPPUNIT_ASSERT( identity * a == a );
+  }
+
+  void testTranspose() {
+    vgl::Matrix4f a = makeMatrix(2.0f);
+    vgl::Matrix4f t = vgl::transpose(a);
+    CPPUNIT_ASSERT( t.m01 == a.m10 && t.m23 == a.m32 && t.m30 == a.m03 );
+    CPPUNIT_ASSERT( t == vgl::transpose<float>(a) );
+    CPPUNIT_ASSERT( vgl::transpose(t) == a );
+  }
+
+  void testTransformVec4() {
+    vgl::Matrix4f m = makeMatrix(3.0f);
+    vgl::Vec4f v(1.5f, -2.0f, 0.25f, 1.0f);
+    vgl::Vec4f expected(m.m00 * 1.5f - m.m01 * 2.0f + m.m02 * 0.25f + m.m03,
+                        m.m10 * 1.5f - m.m11 * 2.0f + m.m12 * 0.25f + m.m13,
+                        m.m20 * 1.5f - m.m21 * 2.0f + m.m22 * 0.25f + m.m23,
+                        m.m30 * 1.5f - m.m31 * 2.0f + m.m32 * 0.25f + m.m33);
+    CPPUNIT_ASSERT( m * v == expected );
+    CPPUNIT_ASSERT( vgl::operator *<float>(m, v) == expected );
+  }
+
+  void testTransformPoint() {
+    vgl::Matrix4f m;
+    m.m03 = 10.0f;
+    m.m13 = 20.0f;
+    m.m23 = 30.0f;
+    m.m00 = 2.0f;
+    CPPUNIT_ASSERT( vgl::transformPoint(m, vgl::Vec3f(1, 2, 3)) == vgl::Vec3f(12, 22, 33) );
+
+    vgl::Matrix4f a = makeMatrix(4.0f);
+    vgl::Vec3f p(0.5f, 7.0f, -3.0f);
+    CPPUNIT_ASSERT( vgl::transformPoint(a, p) == vgl::transformPoint<float>(a, p) );
+  }
+
+  void testTransformVector() {
+    vgl::Matrix4f m;
+    m.m03 = 10.0f;
+    CPPUNIT_ASSERT( vgl::transformVector(m, vgl::Vec3f(1, 2, 3)) == vgl::Vec3f(1, 2, 3) );
+
+    vgl::Matrix4f a = makeMatrix(5.0f);
+    vgl::Vec3f v(0.5f, 7.0f, -3.0f);
+    CPPUNIT_ASSERT( vgl::transformVector(a, v) == vgl::transformVector<float>(a, v) );
+  }
+
+  void testTransformArrays() {
+    // Every count up to a few times the widest kernel, to cover the leftovers.
+    vgl::Matrix4f m = makeMatrix(6.0f);
+    bool ok = true;
+    for (size_t count = 0; count < 21; ++count) {
+      std::vector<vgl::Vec4f> v4(count + 1), out4(count + 1);
+      std::vector<vgl::Vec3f> v3(count + 1), out3(count + 1);
+      for (size_t i = 0; i < count; ++i) {
+        v4[i] = vgl::Vec4f(i * 0.5f, 1.0f - i, i * i * 0.1f, (i % 2) ? 1.0f : 0.0f);
+        v3[i] = vgl::Vec3f(i * 0.5f, 1.0f - i, i * i * 0.1f);
+      }
+      vgl::transform(m, &v4[0], &out4[0], count);
+      vgl::transformPoints(m, &v3[0], &out3[0], count);
+      for (size_t i = 0; i < count; ++i) {
+        ok = ok && out4[i] == vgl::operator *<float>(m, v4[i]);
+        ok = ok && out3[i] == vgl::transformPoint<float>(m, v3[i]);
+      }
+
+      // In place.
+      vgl::transformPoints(m, &v3[0], &v3[0], count);
+      for (size_t i = 0; i < count; ++i)
+        ok = ok && v3[i] == out3[i];
+    }
+    CPPUNIT_ASSERT( ok );
+  }
+
+  void testDeterminant() {
+    vgl::Matrix4d a;
+    a.m00 = 2;
+    a.m11 = 3;
+    a.m22 = 4;
+    a.m03 = 7; // Translation doesn't change it.
+    CPPUNIT_ASSERT( vgl::determinant(a) == 24 );
+
+    // Swapping two rows flips the sign.
+    std::swap(a.rows[0][0], a.rows[1][0]);
+    std::swap(a.rows[0][1], a.rows[1][1]);
+    std::swap(a.rows[0][3], a.rows[1][3]);
+    CPPUNIT_ASSERT( vgl::determinant(a) == -24 );
+
+    for (unsigned int i = 0; i < 8; ++i) {
+      vgl::Matrix4f m = makeInvertible(i * 0.9f);
+      double expected = vgl::determinant(toDouble(m));
+      CPPUNIT_ASSERT( std::fabs(vgl::determinant(m) - expected) <= 1e-4 * std::max(1.0, std::fabs(expected)) );
+      CPPUNIT_ASSERT( std::fabs(vgl::determinant<float>(m) - expected) <= 1e-4 * std::max(1.0, std::fabs(expected)) );
+    }
+  }
+
+  void testInverse() {
+    for (unsigned int i = 0; i < 8; ++i) {
+      vgl::Matrix4f m = makeInvertible(i * 0.9f);
+      vgl::Matrix4d md = toDouble(m);
+      vgl::Matrix4d expected = vgl::inverse(md);
+      CPPUNIT_ASSERT( isIdentity(md * expected) );
+      CPPUNIT_ASSERT( isIdentity(expected * md) );
+      CPPUNIT_ASSERT( closeToDouble(vgl::inverse(m), expected) );
+      CPPUNIT_ASSERT( closeToDouble(vgl::inverse<float>(m), expected) );
+    }
+
+    // A projection matrix, which the affine versions can't handle.
+    vgl::Matrix4f p = vgl::perspective(60.0f, 1.5f, 0.1f, 100.0f);
+    CPPUNIT_ASSERT( closeToDouble(vgl::inverse(p), vgl::inverse(toDouble(p))) );
+  }
+
+  void testAffineInverse() {
+    vgl::Matrix4f identity;
+    for (unsigned int i = 0; i < 8; ++i) {
+      vgl::Matrix4f m = makeInvertible(i * 1.3f);
+      m.m30 = m.m31 = m.m32 = 0.0f;
+      m.m33 = 1.0f;
+      vgl::Matrix4d expected = vgl::inverse(toDouble(m));
+      CPPUNIT_ASSERT( closeToDouble(vgl::affineInverse(m), expected) );
+      CPPUNIT_ASSERT( closeToDouble(vgl::affineInverse<float>(m), expected) );
+      CPPUNIT_ASSERT( isIdentity(toDouble(m) * vgl::affineInverse(toDouble(m))) );
+    }
+  }
+
+  void testOrthonormalInverse() {
+    for (unsigned int i = 0; i < 8; ++i) {
+      vgl::Quaternionf r = vgl::rotation(vgl::Vec3f(1.0f, i * 0.5f, -2.0f), i * 0.8f);
+      vgl::Matrix4f m = vgl::trs(vgl::Vec3f(i * 1.5f, -3.0f, 0.25f), r, vgl::Vec3f(1.0f));
+      vgl::Matrix4d expected = vgl::inverse(toDouble(m));
+      CPPUNIT_ASSERT( closeToDouble(vgl::orthonormalInverse(m), expected) );
+      CPPUNIT_ASSERT( closeToDouble(vgl::orthonormalInverse<float>(m), expected) );
+      CPPUNIT_ASSERT( closeToDouble(vgl::affineInverse(m), expected) );
+    }
+  }
+
+  void testTRS() {
+    vgl::Vec3f t(1.0f, -2.0f, 3.0f);
+    vgl::Vec3f s(2.0f, 0.5f, 1.5f);
+    vgl::Quaternionf r = vgl::rotation(vgl::Vec3f(0.3f, 1.0f, -0.2f), 0.7f);
+    vgl::Matrix4f m = vgl::trs(t, r, s);
+    vgl::Matrix4f composed = vgl::translationMatrix(t) * vgl::rotationMatrix(r) * vgl::scaleMatrix(s);
+    CPPUNIT_ASSERT( m == composed );
+
+    vgl::Vec3f p(0.5f, 4.0f, -1.0f);
+    CPPUNIT_ASSERT( vgl::transformPoint(m, p) == vgl::rotate(r, p * s) + t );
+  }
+
+  void testAxisAngleRotation() {
+    // The matrix, the single point rotate and the quaternion should all agree,
+    // whether or not the axis is unit length.
+    vgl::Vec3f p(0.5f, 4.0f, -1.0f);
+    for (unsigned int i = 0; i < 16; ++i) {
+      vgl::Vec3f axis(std::sin(i * 0.9f), 1.0f - i * 0.3f, i * 0.2f + 0.1f);
+      float angle = i * 0.45f - 3.0f;
+      vgl::Quaternionf q = vgl::rotation(axis, angle);
+      vgl::Matrix4f m = vgl::rotationMatrix(axis, angle);
+      CPPUNIT_ASSERT( m == vgl::rotationMatrix(q) );
+      CPPUNIT_ASSERT( vgl::transformPoint(m, p) == vgl::rotate(q, p) );
+      CPPUNIT_ASSERT( vgl::rotate(p, axis, angle) == vgl::rotate(q, p) );
+      CPPUNIT_ASSERT( vgl::rotate<vgl::FastMath>(p, axis, angle) == vgl::rotate(q, p) );
+    }
+
+    // A quarter turn around z takes x to y.
+    CPPUNIT_ASSERT( vgl::rotate(vgl::Vec3f(1, 0, 0), vgl::Vec3f(0, 0, 2), float(M_PI / 2)) == vgl::Vec3f(0, 1, 0) );
+  }
+
+  void testBatchRotate() {
+    vgl::Vec3f axis(0.3f, -1.0f, 0.6f);
+    float angle = 2.2f;
+    vgl::Quaternionf q = vgl::rotation(axis, angle);
+    bool ok = true;
+    for (size_t count = 0; count < 21; ++count) {
+      std::vector<vgl::Vec3f> points(count + 1);
+      for (size_t i = 0; i <= count; ++i)
+        points[i] = vgl::Vec3f(i * 0.5f, 1.0f - i, i * i * 0.1f);
+      vgl::rotate(&points[0], count, axis, angle);
+      for (size_t i = 0; i < count; ++i)
+        ok = ok && points[i] == vgl::rotate(q, vgl::Vec3f(i * 0.5f, 1.0f - i, i * i * 0.1f));
+      // The one past the end is left alone.
+      ok = ok && points[count].x == count * 0.5f;
+    }
+    CPPUNIT_ASSERT( ok );
+  }
+
+  void testLookAt() {
+    // From +z looking at the origin is the identity, apart from translation.
+    vgl::Matrix4f m = vgl::lookAt(vgl::Vec3f(0, 0, 5), vgl::Vec3f(0, 0, 0), vgl::Vec3f(0, 1, 0));
+    vgl::Matrix4f expected = vgl::translationMatrix(vgl::Vec3f(0, 0, -5));
+    CPPUNIT_ASSERT( m == expected );
+
+    // The eye ends up at the origin and the target straight ahead on -z, with
+    // up still up (it doesn't have to be perpendicular to start with).
+    vgl::Vec3f eye(3.0f, 4.0f, -2.0f), target(-1.0f, 0.5f, 6.0f);
+    m = vgl::lookAt(eye, target, vgl::Vec3f(0.2f, 1.0f, 0.0f));
+    CPPUNIT_ASSERT( vgl::length(vgl::transformPoint(m, eye)) < 1e-5f );
+    CPPUNIT_ASSERT( vgl::transformPoint(m, target) == vgl::Vec3f(0, 0, -vgl::length(target - eye)) );
+    CPPUNIT_ASSERT( vgl::transformVector(m, vgl::Vec3f(0.2f, 1.0f, 0.0f)).x < 1e-6f );
+    CPPUNIT_ASSERT( vgl::transformVector(m, vgl::Vec3f(0.2f, 1.0f, 0.0f)).y > 0.0f );
+    CPPUNIT_ASSERT( closeToDouble(vgl::orthonormalInverse(m), vgl::inverse(toDouble(m))) );
+  }
+
+  void testPerspective() {
+    vgl::Matrix4f m = vgl::perspective(90.0f, 2.0f, 1.0f, 10.0f);
+    // The near and far planes go to -1 and +1 after the divide by w.
+    vgl::Vec4f nearPoint = m * vgl::Vec4f(0, 0, -1, 1);
+    vgl::Vec4f farPoint = m * vgl::Vec4f(0, 0, -10, 1);
+    CPPUNIT_ASSERT( close(nearPoint.z / nearPoint.w, -1.0f) );
+    CPPUNIT_ASSERT( close(farPoint.z / farPoint.w, 1.0f) );
+    // A 90 degree field of view puts the top edge at 45 degrees, and the
+    // right edge is twice as far out.
+    vgl::Vec4f corner = m * vgl::Vec4f(4, 2, -2, 1);
+    CPPUNIT_ASSERT( close(corner.x / corner.w, 1.0f) && close(corner.y / corner.w, 1.0f) );
+  }
+
+  void testOrtho() {
+    vgl::Matrix4f m = vgl::ortho(-2.0f, 6.0f, 1.0f, 3.0f, 0.5f, 10.5f);
+    CPPUNIT_ASSERT( vgl::transformPoint(m, vgl::Vec3f(-2.0f, 1.0f, -0.5f)) == vgl::Vec3f(-1, -1, -1) );
+    CPPUNIT_ASSERT( vgl::transformPoint(m, vgl::Vec3f(6.0f, 3.0f, -10.5f)) == vgl::Vec3f(1, 1, 1) );
+    CPPUNIT_ASSERT( vgl::transformPoint(m, vgl::Vec3f(2.0f, 2.0f, -5.5f)) == vgl::Vec3f(0, 0, 0) );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestMatrix4);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+#include "vgl_mipchain.h"
+#include "vgl_image.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Noise in every channel, so that any mixup between pixels shows.
+template <typename T>
+static vgl::RawImage* makeNoiseImage(int type, unsigned int channels, unsigned int width,
+    unsigned int height, int pixelType, T maxValue)
+{
+  vgl::RawImage* img = new vgl::RawImage(type, channels * sizeof(T), width, height, pixelType);
+  T* pixels = (T*)img->getPixels();
+  srand(width * 31 + height);
+  for (size_t i = 0; i < size_t(width) * height * channels; ++i)
+    pixels[i] = T(rand() % 1000 / 999.0 * maxValue);
+  return img;
+}
+
+
+template <typename T>
+static T referenceAverage(T a, T b, T c, T d)
+{
+  return T((a + b + c + d + 2u) >> 2);
+}
+
+
+template <>
+float referenceAverage(float a, float b, float c, float d)
+{
+  return (a + b + c + d) * 0.25f;
+}
+
+
+// Checks each level against a straightforward box filter of the level above
+// it, done one pixel at a time.
+template <typename T>
+static bool matchesReference(vgl::MipChain& chain, unsigned int channels)
+{
+  for (unsigned int level = 1; level < chain.getNumLevels(); ++level) {
+    unsigned int srcWidth = chain.getLevelWidth(level - 1);
+    unsigned int srcHeight = chain.getLevelHeight(level - 1);
+    const T* src = (const T*)chain.getLevelPixels(level - 1);
+    const T* dst = (const T*)chain.getLevelPixels(level);
+    for (unsigned int y = 0; y < chain.getLevelHeight(level); ++y) {
+      unsigned int y0 = 2 * y, y1 = std::min(2 * y + 1, srcHeight - 1);
+      for (unsigned int x = 0; x < chain.getLevelWidth(level); ++x) {
+        unsigned int x0 = 2 * x, x1 = std::min(2 * x + 1, srcWidth - 1);
+        for (unsigned int i = 0; i < channels; ++i) {
+          T expected = referenceAverage(src[(y0 * srcWidth + x0) * channels + i],
+                                        src[(y0 * srcWidth + x1) * channels + i],
+                                        src[(y1 * srcWidth + x0) * channels + i],
+                                        src[(y1 * srcWidth + x1) * channels + i]);
+          if (dst[(y * chain.getLevelWidth(level) + x) * channels + i] != expected)
+            return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestMipChain : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestMipChain);
+  CPPUNIT_TEST(testLevelSizes);
+  CPPUNIT_TEST(testSinglePixel);
+  CPPUNIT_TEST(testUnsignedByte);
+  CPPUNIT_TEST(testUnsignedShort);
+  CPPUNIT_TEST(testFloat);
+  CPPUNIT_TEST(testLinearLight);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testLevelSizes() {
+    vgl::RawImage img(GL_RGBA, 4, 61, 46);
+    vgl::MipChain chain(&img);
+    const unsigned int kWidths[] = { 61, 30, 15, 7, 3, 1 };
+    const unsigned int kHeights[] = { 46, 23, 11, 5, 2, 1 };
+    CPPUNIT_ASSERT( chain.getNumLevels() == 6 );
+    size_t offset = 0;
+    for (unsigned int level = 0; level < 6; ++level) {
+      CPPUNIT_ASSERT( chain.getLevelWidth(level) == kWidths[level] );
+      CPPUNIT_ASSERT( chain.getLevelHeight(level) == kHeights[level] );
+      CPPUNIT_ASSERT( chain.getLevelOffset(level) == offset );
+      offset += kWidths[level] * kHeights[level] * 4;
+    }
+    CPPUNIT_ASSERT( chain.getSize() == offset );
+
+    // Long and thin: the short side stays at 1.
+    vgl::RawImage thin(GL_ALPHA, 1, 1, 37);
+    vgl::MipChain thinChain(&thin);
+    CPPUNIT_ASSERT( thinChain.getNumLevels() == 6 );
+    CPPUNIT_ASSERT( thinChain.getLevelWidth(5) == 1 && thinChain.getLevelHeight(5) == 1 );
+    CPPUNIT_ASSERT( thinChain.getLevelHeight(1) == 18 );
+  }
+
+  void testSinglePixel() {
+    vgl::RawImage img(GL_RGB, 3, 1, 1);
+    img.getPixels()[1] = 42;
+    vgl::MipChain chain(&img);
+    CPPUNIT_ASSERT( chain.getNumLevels() == 1 );
+    CPPUNIT_ASSERT( chain.getSize() == 3 );
+    CPPUNIT_ASSERT( chain.getLevelPixels(0)[1] == 42 );
+  }
+
+  void testUnsignedByte() {
+    // Big enough for more than one block and more than one pass of levels,
+    // with odd sizes along the way.
+    vgl::RawImage* img = makeNoiseImage<unsigned char>(GL_RGB, 3, 301, 203, GL_UNSIGNED_BYTE, 255);
+    vgl::MipChain chain(img);
+    CPPUNIT_ASSERT( chain.getNumLevels() == 9 );
+    CPPUNIT_ASSERT( memcmp(chain.getLevelPixels(0), img->getPixels(), 301 * 203 * 3) == 0 );
+    CPPUNIT_ASSERT( matchesReference<unsigned char>(chain, 3) );
+    delete img;
+  }
+
+  void testUnsignedShort() {
+    vgl::RawImage* img = makeNoiseImage<unsigned short>(GL_RGBA, 4, 130, 67, GL_UNSIGNED_SHORT, 65535);
+    vgl::MipChain chain(img);
+    CPPUNIT_ASSERT( chain.getPixelType() == GL_UNSIGNED_SHORT );
+    CPPUNIT_ASSERT( chain.getBytesPerPixel() == 8 );
+    CPPUNIT_ASSERT( matchesReference<unsigned short>(chain, 4) );
+    delete img;
+  }
+
+  void testFloat() {
+    vgl::RawImage* img = makeNoiseImage<float>(GL_LUMINANCE_ALPHA, 2, 97, 150, GL_FLOAT, 4.0f);
+    vgl::MipChain chain(img);
+    CPPUNIT_ASSERT( matchesReference<float>(chain, 2) );
+    delete img;
+  }
+
+  void testLinearLight() {
+    // A black and white checkerboard averages to 50% grey in linear light,
+    // which is 188 in sRGB, rather than 128. Alpha is averaged as it is.
+    vgl::RawImage img(GL_RGBA, 4, 16, 16);
+    unsigned char* pixels = img.getPixels();
+    for (unsigned int i = 0; i < 16 * 16; ++i) {
+      unsigned char c = ((i % 16 + i / 16) % 2 == 0) ? 255 : 0;
+      pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4 + 3] = c;
+    }
+
+    vgl::MipChain plain(&img, false);
+    vgl::MipChain linear(&img, true);
+    for (unsigned int level = 1; level < linear.getNumLevels(); ++level) {
+      const unsigned char* p = plain.getLevelPixels(level);
+      const unsigned char* l = linear.getLevelPixels(level);
+      CPPUNIT_ASSERT( p[0] == 128 && p[3] == 128 );
+      CPPUNIT_ASSERT( l[0] >= 187 && l[0] <= 188 && l[1] == l[0] && l[2] == l[0] );
+      CPPUNIT_ASSERT( l[3] == 128 );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestMipChain);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
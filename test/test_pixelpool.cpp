@@ -0,0 +1,179 @@
+#include "vgl_pixelpool.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cstring>
+#include <pthread.h>
+#include <stdint.h>
+
+
+//
+// HELPER METHODS
+//
+
+static bool isAligned(const unsigned char* p)
+{
+  return ((uintptr_t)p % vgl::kPixelAlignment) == 0;
+}
+
+
+// Allocates, fills and frees buffers of varying sizes over and over, checking
+// that nothing else wrote to a buffer while this thread owned it.
+static void* churn(void* arg)
+{
+  size_t id = (size_t)arg;
+  bool* ok = new bool(true);
+  unsigned char* held[8] = { NULL };
+  for (unsigned int i = 0; i < 4000; ++i) {
+    unsigned int slot = (i * 7 + id) % 8;
+    size_t bytes = 100 + ((i * 2654435761u + id) % 20000);
+    unsigned char* p = vgl::allocPixels(bytes);
+    if (!isAligned(p))
+      *ok = false;
+    memset(p, int(id), bytes);
+
+    if (held[slot] != NULL) {
+      for (size_t j = 0; j < 100; ++j) {
+        if (held[slot][j] != (unsigned char)id)
+          *ok = false;
+      }
+      vgl::freePixels(held[slot]);
+    }
+    held[slot] = p;
+  }
+  for (unsigned int slot = 0; slot < 8; ++slot)
+    vgl::freePixels(held[slot]);
+  return ok;
+}
+
+
+//
+// TESTS
+//
+
+class TestPixelPool : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestPixelPool);
+  CPPUNIT_TEST(testAlignment);
+  CPPUNIT_TEST(testReuse);
+  CPPUNIT_TEST(testLimit);
+  CPPUNIT_TEST(testTrim);
+  CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() { vgl::trimPixelPool(); }
+  void tearDown() { vgl::setPixelPoolLimit(size_t(256) << 20); }
+
+protected:
+  void testAlignment() {
+    const size_t kSizes[] = { 0, 1, 63, 4095, 4096, 4097, 6145, 1000000 };
+    unsigned char* p[8];
+    for (unsigned int i = 0; i < 8; ++i) {
+      p[i] = vgl::allocPixels(kSizes[i]);
+      CPPUNIT_ASSERT( p[i] != NULL && isAligned(p[i]) );
+      memset(p[i], 0xAB, kSizes[i]);
+    }
+    for (unsigned int i = 0; i < 8; ++i)
+      vgl::freePixels(p[i]);
+    vgl::freePixels(NULL);
+  }
+
+  void testReuse() {
+    // 5000 and 6000 bytes both round up to the 6 KiB class, 7000 doesn't.
+    unsigned char* a = vgl::allocPixels(5000);
+    vgl::freePixels(a);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 6144 );
+    unsigned char* b = vgl::allocPixels(6000);
+    CPPUNIT_ASSERT( b == a );
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 0 );
+    vgl::freePixels(b);
+
+    unsigned char* c = vgl::allocPixels(7000);
+    CPPUNIT_ASSERT( c != a );
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 6144 );
+    vgl::freePixels(c);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 6144 + 8192 );
+  }
+
+  void testLimit() {
+    vgl::setPixelPoolLimit(24000);
+    CPPUNIT_ASSERT( vgl::getPixelPoolLimit() == 24000 );
+
+    // Freeing past the limit releases the largest buffers first.
+    unsigned char* small = vgl::allocPixels(4096);
+    unsigned char* big = vgl::allocPixels(16384);
+    unsigned char* bigger = vgl::allocPixels(24576);
+    vgl::freePixels(small);
+    vgl::freePixels(big);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 4096 + 16384 );
+    vgl::freePixels(bigger);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 4096 + 16384 );
+
+    // Lowering the limit releases the excess straight away.
+    vgl::setPixelPoolLimit(5000);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 4096 );
+    vgl::setPixelPoolLimit(0);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 0 );
+
+    // With no limit, nothing is kept.
+    vgl::freePixels(vgl::allocPixels(100));
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 0 );
+  }
+
+  void testTrim() {
+    unsigned char* a = vgl::allocPixels(100000);
+    unsigned char* b = vgl::allocPixels(10);
+    vgl::freePixels(a);
+    vgl::freePixels(b);
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 131072 + 4096 );
+    vgl::trimPixelPool();
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() == 0 );
+  }
+
+  void testThreads() {
+    // Plain threads rather than OpenMP ones, which is what the pool's lock
+    // has to cope with.
+    const unsigned int kThreads = 8;
+    vgl::setPixelPoolLimit(100000);
+    pthread_t threads[kThreads];
+    for (size_t i = 0; i < kThreads; ++i)
+      CPPUNIT_ASSERT( pthread_create(&threads[i], NULL, churn, (void*)(i + 1)) == 0 );
+    for (unsigned int i = 0; i < kThreads; ++i) {
+      void* result = NULL;
+      pthread_join(threads[i], &result);
+      bool* ok = (bool*)result;
+      CPPUNIT_ASSERT( *ok );
+      delete ok;
+    }
+    CPPUNIT_ASSERT( vgl::getPixelPoolCachedBytes() <= 100000 );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPixelPool);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "vgl_plane3.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+}
+
+
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b)
+{
+  return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z);
+}
+
+
+//
+// TESTS
+//
+
+class TestPlane3 : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestPlane3);
+  CPPUNIT_TEST(testPlane);
+  CPPUNIT_TEST(testParallelogram);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testPlane() {
+    vgl::Plane3f p(vgl::Vec3f(1, -1, 2), vgl::Vec3f(2, 0.5f, 0), vgl::Vec3f(-0.3f, 1, 0.4f));
+    float t, u, v;
+
+    // The hit point should agree with planePos, wherever on the plane it is.
+    for (unsigned int i = 0; i < 50; ++i) {
+      vgl::Ray3f ray(vgl::Vec3f(std::sin(i * 1.3f), std::cos(i * 0.7f), -3.0f),
+                     vgl::Vec3f(std::sin(i * 2.1f) * 0.5f, std::cos(i * 1.7f) * 0.5f, 1.0f));
+      CPPUNIT_ASSERT( vgl::intersectRayPlane(ray, p, t, u, v) );
+      CPPUNIT_ASSERT( close(vgl::evaluate(ray, t), vgl::planePos(p, u, v)) );
+    }
+
+    // Parallel, and pointing away.
+    vgl::Ray3f parallel(vgl::Vec3f(0, 0, 0), p.u);
+    CPPUNIT_ASSERT( !vgl::intersectRayPlane(parallel, p, t, u, v) );
+    vgl::Ray3f away(vgl::Vec3f(0, 0, -3), vgl::Vec3f(0, 0, -1));
+    CPPUNIT_ASSERT( !vgl::intersectRayPlane(away, p, t, u, v) );
+  }
+
+  void testParallelogram() {
+    vgl::Plane3f p(vgl::Vec3f(0, 0, 5), vgl::Vec3f(2, 0, 0), vgl::Vec3f(1, 1, 0));
+    float t, u, v;
+
+    // Through the middle, with a direction that isn't unit length.
+    vgl::Ray3f ray(vgl::Vec3f(1.5f, 0.5f, 1), vgl::Vec3f(0, 0, 2));
+    CPPUNIT_ASSERT( vgl::intersectRayParallelogram(ray, p, t, u, v) );
+    CPPUNIT_ASSERT( close(t, 2.0f) && close(u, 0.5f) && close(v, 0.5f) );
+
+    // Near the far corner, which would be outside a triangle with the same
+    // edges.
+    ray = vgl::Ray3f(vgl::Vec3f(2.9f, 0.95f, 1), vgl::Vec3f(0, 0, 1));
+    CPPUNIT_ASSERT( vgl::intersectRayParallelogram(ray, p, t, u, v) );
+    CPPUNIT_ASSERT( u + v > 1.0f );
+
+    // Off each side.
+    const float kMisses[][2] = { { -0.2f, 0.5f }, { 1.2f, 0.5f }, { 0.5f, -0.2f }, { 0.5f, 1.2f } };
+    for (unsigned int i = 0; i < 4; ++i) {
+      vgl::Vec3f target = vgl::planePos(p, kMisses[i][0], kMisses[i][1]);
+      ray = vgl::Ray3f(target - vgl::Vec3f(0, 0, 4), vgl::Vec3f(0, 0, 1));
+      CPPUNIT_ASSERT( !vgl::intersectRayParallelogram(ray, p, t, u, v) );
+      CPPUNIT_ASSERT( vgl::intersectRayPlane(ray, p, t, u, v) );
+      CPPUNIT_ASSERT( close(u, kMisses[i][0]) && close(v, kMisses[i][1]) );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPlane3);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
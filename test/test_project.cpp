@@ -0,0 +1,195 @@
+#include "vgl_basecamera.h"
+#include "vgl_funcs.h"
+#include "vgl_matrix4.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef linux
+#include <GL/glu.h>
+#else
+#include <OpenGL/glu.h>
+#endif
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(const vgl::Vec3f& a, const vgl::Vec3d& b, double tolerance)
+{
+  return std::fabs(a.x - b.x) <= tolerance && std::fabs(a.y - b.y) <= tolerance &&
+         std::fabs(a.z - b.z) <= tolerance;
+}
+
+
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b, float tolerance)
+{
+  return close(a, vgl::Vec3d(b.x, b.y, b.z), tolerance);
+}
+
+
+// GLU wants column-major doubles.
+static void toGL(const vgl::Matrix4f& m, double out[16])
+{
+  for (unsigned int row = 0; row < 4; ++row) {
+    for (unsigned int col = 0; col < 4; ++col)
+      out[col * 4 + row] = m[row][col];
+  }
+}
+
+
+static vgl::Vec3d gluReferenceProject(const vgl::Vec3f& p, const vgl::Matrix4f& modelView,
+    const vgl::Matrix4f& projection, const vgl::Vec4i& viewport)
+{
+  double mv[16], proj[16];
+  toGL(modelView, mv);
+  toGL(projection, proj);
+  vgl::Vec3d win;
+  gluProject(p.x, p.y, p.z, mv, proj, viewport.data, &win.x, &win.y, &win.z);
+  return win;
+}
+
+
+static vgl::Vec3d gluReferenceUnproject(const vgl::Vec3f& win, const vgl::Matrix4f& modelView,
+    const vgl::Matrix4f& projection, const vgl::Vec4i& viewport)
+{
+  double mv[16], proj[16];
+  toGL(modelView, mv);
+  toGL(projection, proj);
+  vgl::Vec3d p;
+  gluUnProject(win.x, win.y, win.z, mv, proj, viewport.data, &p.x, &p.y, &p.z);
+  return p;
+}
+
+
+//
+// TESTS
+//
+
+class TestProject : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestProject);
+  CPPUNIT_TEST(testOrtho);
+  CPPUNIT_TEST(testAgainstGLU);
+  CPPUNIT_TEST(testRoundTrip);
+  CPPUNIT_TEST(testArrays);
+  CPPUNIT_TEST(testCamera);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {
+    _modelView = vgl::lookAt(vgl::Vec3f(3, 2, 8), vgl::Vec3f(0, 0.5f, 0), vgl::Vec3f(0, 1, 0));
+    _projection = vgl::perspective(40.0f, 1.5f, 0.5f, 50.0f);
+    _viewport = vgl::Vec4i(16, 8, 640, 480);
+  }
+
+  void tearDown() {}
+
+protected:
+  void testOrtho() {
+    vgl::Matrix4f identity;
+    vgl::Matrix4f projection = vgl::ortho(0.0f, 100.0f, 0.0f, 50.0f, -1.0f, 1.0f);
+    vgl::Vec4i viewport(10, 20, 200, 100);
+    vgl::Vec3f win = vgl::project(vgl::Vec3f(25, 10, 0), identity, projection, viewport);
+    CPPUNIT_ASSERT( close(win, vgl::Vec3f(60, 40, 0.5f), 1e-4f) );
+    vgl::Vec3f p = vgl::unproject(vgl::Vec3f(210, 120, 0), identity, projection, viewport);
+    CPPUNIT_ASSERT( close(p, vgl::Vec3f(100, 50, 1), 1e-4f) );
+  }
+
+  void testAgainstGLU() {
+    for (int i = 0; i < 20; ++i) {
+      vgl::Vec3f p(std::sin(i * 0.7f) * 3.0f, std::cos(i * 1.1f) * 2.0f, i * 0.2f - 2.0f);
+      vgl::Vec3d expected = gluReferenceProject(p, _modelView, _projection, _viewport);
+      CPPUNIT_ASSERT( close(vgl::project(p, _modelView, _projection, _viewport), expected, 1e-2) );
+
+      vgl::Vec3f win(20 + i * 31, 10 + i * 23, 0.05f * i);
+      expected = gluReferenceUnproject(win, _modelView, _projection, _viewport);
+      CPPUNIT_ASSERT( close(vgl::unproject(win, _modelView, _projection, _viewport), expected, 1e-3) );
+    }
+  }
+
+  void testRoundTrip() {
+    for (int i = 0; i < 20; ++i) {
+      vgl::Vec3f p(std::sin(i * 0.3f) * 4.0f, std::cos(i * 0.9f), i * 0.3f - 3.0f);
+      vgl::Vec3f win = vgl::project(p, _modelView, _projection, _viewport);
+      CPPUNIT_ASSERT( close(vgl::unproject(win, _modelView, _projection, _viewport), p, 1e-3f) );
+    }
+  }
+
+  void testArrays() {
+    const size_t kCount = 37;
+    std::vector<vgl::Vec3f> src(kCount), win(kCount), back(kCount);
+    for (size_t i = 0; i < kCount; ++i)
+      src[i] = vgl::Vec3f(i * 0.1f - 2.0f, std::sin(i * 0.5f), -std::cos(i * 0.2f));
+
+    vgl::project(_modelView, _projection, _viewport, &src[0], &win[0], kCount);
+    vgl::unproject(_modelView, _projection, _viewport, &win[0], &back[0], kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+      CPPUNIT_ASSERT( close(win[i], vgl::project(src[i], _modelView, _projection, _viewport), 1e-6f) );
+      CPPUNIT_ASSERT( close(back[i], vgl::unproject(win[i], _modelView, _projection, _viewport), 1e-6f) );
+    }
+
+    // In place.
+    vgl::project(_modelView, _projection, _viewport, &src[0], &src[0], kCount);
+    for (size_t i = 0; i < kCount; ++i)
+      CPPUNIT_ASSERT( close(src[i], win[i], 0.0f) );
+  }
+
+  void testCamera() {
+    vgl::Vec3f pos(1, 2, 10), target(1, 0, 0), up(0, 1, 0);
+    vgl::BaseCamera camera(pos, target, up, -1, 1, -1, 1, 30, 800, 600);
+    vgl::Matrix4f modelView = camera.getModelViewMatrix();
+    vgl::Matrix4f projection = camera.getProjectionMatrix();
+    vgl::Vec4i viewport = camera.getViewport();
+    CPPUNIT_ASSERT( viewport.x == 0 && viewport.y == 0 && viewport.z == 800 && viewport.w == 600 );
+
+    // The target is in the middle of the screen.
+    vgl::Vec3f win = vgl::project(target, modelView, projection, viewport);
+    CPPUNIT_ASSERT( std::fabs(win.x - 400) < 1e-3f && std::fabs(win.y - 300) < 1e-3f );
+
+    // And everything under the middle pixel is on the line from the camera
+    // through the target.
+    vgl::Vec3f dir = vgl::norm(target - pos);
+    for (int i = 1; i < 10; ++i) {
+      vgl::Vec3f p = vgl::unproject(vgl::Vec3f(400, 300, i * 0.1f), modelView, projection, viewport);
+      vgl::Vec3f offset = p - pos;
+      CPPUNIT_ASSERT( vgl::length(offset - dir * vgl::dot(offset, dir)) < 1e-3f );
+    }
+  }
+
+private:
+  vgl::Matrix4f _modelView, _projection;
+  vgl::Vec4i _viewport;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestProject);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -44,6 +44,9 @@ class TestQuaternion : public CPPUNIT_NS::TestCase
   CPPUNIT_TEST(testConjugate);
   CPPUNIT_TEST(testInverse);
   CPPUNIT_TEST(testRotate);
+  CPPUNIT_TEST(testCompoundOperators);
+  CPPUNIT_TEST(testNlerp);
+  CPPUNIT_TEST(testSlerp);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -149,6 +152,53 @@ protected:
     CPPUNIT_ASSERT( rotate(xAxis, zPoint) == -yPoint );
     CPPUNIT_ASSERT( rotate(yAxis, zPoint) == xPoint );
   }
+
+
+  void testCompoundOperators() {
+    vgl::Quaternionf a(1, 2, 3, 4);
+    vgl::Quaternionf b(5, 6, 7, 8);
+
+    vgl::Quaternionf r = a;
+    CPPUNIT_ASSERT( (r += b) == a + b );
+    CPPUNIT_ASSERT( r == a + b );
+    r = a;
+    CPPUNIT_ASSERT( (r -= b) == a - b );
+    r = a;
+    CPPUNIT_ASSERT( (r *= b) == a * b );
+    r = a;
+    CPPUNIT_ASSERT( (r *= 2.0f) == vgl::Quaternionf(2, 4, 6, 8) );
+    CPPUNIT_ASSERT( (r /= 2.0f) == a );
+  }
+
+
+  void testNlerp() {
+    vgl::Quaternionf a = vgl::rotation(vgl::Vec3f(0, 1, 0), 0.2f);
+    vgl::Quaternionf b = vgl::rotation(vgl::Vec3f(1, 1, 0), 1.4f);
+
+    CPPUNIT_ASSERT( nlerp(a, b, 0.0f) == a );
+    CPPUNIT_ASSERT( nlerp(a, b, 1.0f) == b );
+    CPPUNIT_ASSERT( vgl::equal(length(nlerp(a, b, 0.3f)), 1.0f) );
+    // -b is the same rotation as b, so it should make no difference.
+    CPPUNIT_ASSERT( nlerp(a, -b, 0.3f) == nlerp(a, b, 0.3f) );
+  }
+
+
+  void testSlerp() {
+    vgl::Vec3f axis(0, 0, 1);
+    vgl::Quaternionf a = vgl::rotation(axis, 0.2f);
+    vgl::Quaternionf b = vgl::rotation(axis, 1.0f);
+
+    // Constant angular speed, so it's the same as interpolating the angle.
+    for (int i = 0; i <= 10; ++i) {
+      float t = i / 10.0f;
+      CPPUNIT_ASSERT( slerp(a, b, t) == vgl::rotation(axis, 0.2f + 0.8f * t) );
+    }
+    CPPUNIT_ASSERT( slerp(a, -b, 0.3f) == slerp(a, b, 0.3f) );
+
+    // Nearly identical rotations take the nlerp path.
+    vgl::Quaternionf c = vgl::rotation(axis, 0.2001f);
+    CPPUNIT_ASSERT( slerp(a, c, 0.5f) == vgl::rotation(axis, 0.20005f) );
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestQuaternion);
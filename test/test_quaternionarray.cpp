@@ -0,0 +1,241 @@
+#include "vgl_quaternionarray.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Sizes either side of the vector width, plus one that spans several of the
+// blocks which get handed out to threads.
+static const size_t kSizes[] = { 0, 1, 7, 8, 9, 17, 100, 10000 };
+static const size_t kNumSizes = sizeof(kSizes) / sizeof(kSizes[0]);
+
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 2e-5f * std::max(1.0f, std::fabs(b));
+}
+
+
+static bool close(const vgl::Quaternionf& a, const vgl::Quaternionf& b)
+{
+  return close(a.v.x, b.v.x) && close(a.v.y, b.v.y) && close(a.v.z, b.v.z) && close(a.s, b.s);
+}
+
+
+// Relative to the length of the whole vector, since a rotated point can end
+// up with one tiny component.
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b)
+{
+  return vgl::length(a - b) <= 2e-5f * std::max(1.0f, vgl::length(b));
+}
+
+
+static bool matches(const vgl::QuaternionArray& a, const std::vector<vgl::Quaternionf>& expected)
+{
+  if (a.getSize() != expected.size())
+    return false;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (!close(a.get(i), expected[i]))
+      return false;
+  }
+  return true;
+}
+
+
+// Unit quaternions for a spread of axes and angles, with both signs of dot
+// product between the two sets, and some pairs that are nearly the same.
+static std::vector<vgl::Quaternionf> makeRotations(size_t size, float offset)
+{
+  std::vector<vgl::Quaternionf> q(size);
+  for (size_t i = 0; i < size; ++i) {
+    vgl::Vec3f axis(std::sin(i * 0.37f), std::cos(i * 0.91f), 0.5f);
+    float angle = (i % 5 == 0) ? 1.0f : std::sin(i * 1.3f) * 3.0f + offset;
+    q[i] = vgl::rotation(axis, angle);
+  }
+  return q;
+}
+
+
+//
+// TESTS
+//
+
+class TestQuaternionArray : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestQuaternionArray);
+  CPPUNIT_TEST(testConvert);
+  CPPUNIT_TEST(testNorm);
+  CPPUNIT_TEST(testNlerp);
+  CPPUNIT_TEST(testSlerp);
+  CPPUNIT_TEST(testRotate);
+  CPPUNIT_TEST(testRotationMatrices);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testConvert() {
+    std::vector<vgl::Quaternionf> src = makeRotations(19, 0.0f);
+    vgl::QuaternionArray a(src);
+    CPPUNIT_ASSERT( a.getSize() == 19 );
+    CPPUNIT_ASSERT( a.getW()[4] == src[4].s && a.getX()[4] == src[4].v.x );
+    CPPUNIT_ASSERT( size_t(a.getW()) % vgl::QuaternionArray::kAlignment == 0 );
+
+    std::vector<vgl::Quaternionf> back;
+    a.toVector(back);
+    CPPUNIT_ASSERT( back.size() == 19 && back[18].s == src[18].s && back[18].v.z == src[18].v.z );
+
+    vgl::QuaternionArray copy(a);
+    a.resize(100);
+    CPPUNIT_ASSERT( matches(copy, src) );
+    a.resize(19);
+    CPPUNIT_ASSERT( matches(a, src) );
+  }
+
+  void testNorm() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Quaternionf> src(kSizes[s]), expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i) {
+        src[i] = vgl::Quaternionf(i * 0.5f + 1.0f, -2.0f, std::sin(i * 0.1f), 3.0f);
+        expected[i] = vgl::norm(src[i]);
+      }
+      vgl::QuaternionArray a(src), dst;
+      vgl::norm(a, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+
+    // Zero quaternions stay zero, and so does the padding after the last one,
+    // rather than filling up with NaNs.
+    std::vector<vgl::Quaternionf> src = makeRotations(21, 0.0f);
+    src[3] = src[20] = vgl::Quaternionf(0.0f, 0.0f, 0.0f, 0.0f);
+    vgl::QuaternionArray a(src), dst;
+    vgl::norm(a, dst);
+    CPPUNIT_ASSERT( close(dst.get(3), src[3]) && close(dst.get(20), src[20]) );
+    CPPUNIT_ASSERT( close(dst.get(4), src[4]) );
+    for (size_t i = 21; i < 32; ++i) {
+      CPPUNIT_ASSERT( dst.getX()[i] == 0.0f && dst.getY()[i] == 0.0f );
+      CPPUNIT_ASSERT( dst.getZ()[i] == 0.0f && dst.getW()[i] == 0.0f );
+    }
+
+    // The same goes for the padding nlerp and slerp leave behind.
+    vgl::nlerp(a, a, 0.5f, dst);
+    for (size_t i = 21; i < 32; ++i)
+      CPPUNIT_ASSERT( dst.getX()[i] == 0.0f && dst.getW()[i] == 0.0f );
+    vgl::slerp(a, a, 0.5f, dst);
+    for (size_t i = 21; i < 32; ++i)
+      CPPUNIT_ASSERT( dst.getX()[i] == 0.0f && dst.getW()[i] == 0.0f );
+  }
+
+  void testNlerp() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Quaternionf> qa = makeRotations(kSizes[s], 0.0f), qb = makeRotations(kSizes[s], 2.0f);
+      std::vector<vgl::Quaternionf> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = vgl::nlerp(qa[i], qb[i], 0.3f);
+      vgl::QuaternionArray a(qa), b(qb), dst;
+      vgl::nlerp(a, b, 0.3f, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+  }
+
+  void testSlerp() {
+    const float kWeights[] = { 0.0f, 0.1f, 0.5f, 0.77f, 1.0f };
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Quaternionf> qa = makeRotations(kSizes[s], 0.0f), qb = makeRotations(kSizes[s], 2.0f);
+      vgl::QuaternionArray a(qa), b(qb), dst;
+      for (unsigned int w = 0; w < 5; ++w) {
+        std::vector<vgl::Quaternionf> expected(kSizes[s]);
+        for (size_t i = 0; i < kSizes[s]; ++i)
+          expected[i] = vgl::slerp(qa[i], qb[i], kWeights[w]);
+        vgl::slerp(a, b, kWeights[w], dst);
+        CPPUNIT_ASSERT( matches(dst, expected) );
+      }
+    }
+
+    // In place.
+    std::vector<vgl::Quaternionf> qa = makeRotations(33, 0.0f), qb = makeRotations(33, 1.0f);
+    vgl::QuaternionArray a(qa), b(qb);
+    vgl::slerp(a, b, 0.25f, a);
+    for (size_t i = 0; i < 33; ++i)
+      CPPUNIT_ASSERT( close(a.get(i), vgl::slerp(qa[i], qb[i], 0.25f)) );
+  }
+
+  void testRotate() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Quaternionf> q = makeRotations(kSizes[s], 1.0f);
+      std::vector<vgl::Vec3f> v(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        v[i] = vgl::Vec3f(i * 0.01f, 1.0f - i * 0.02f, std::cos(i * 0.3f));
+      vgl::QuaternionArray qa(q);
+      vgl::Vec3Array src(v), dst;
+
+      vgl::rotate(qa, src, dst);
+      bool ok = dst.getSize() == kSizes[s];
+      for (size_t i = 0; ok && i < kSizes[s]; ++i)
+        ok = close(dst.get(i), vgl::rotate(q[i], v[i]));
+      CPPUNIT_ASSERT( ok );
+
+      vgl::Quaternionf single = vgl::rotation(vgl::Vec3f(1, 2, 3), 0.6f);
+      vgl::rotate(single, src, dst);
+      for (size_t i = 0; ok && i < kSizes[s]; ++i)
+        ok = close(dst.get(i), vgl::rotate(single, v[i]));
+      CPPUNIT_ASSERT( ok );
+    }
+  }
+
+  void testRotationMatrices() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Quaternionf> q = makeRotations(kSizes[s], 0.5f);
+      vgl::QuaternionArray qa(q);
+      // One extra, to check nothing gets written past the end.
+      std::vector<vgl::Matrix4f> dst(kSizes[s] + 1);
+      dst[kSizes[s]].m00 = 42.0f;
+      vgl::rotationMatrices(qa, &dst[0]);
+      bool ok = true;
+      for (size_t i = 0; i < kSizes[s]; ++i) {
+        vgl::Matrix4f expected = vgl::rotationMatrix(q[i]);
+        for (unsigned int j = 0; j < 16; ++j)
+          ok = ok && close(dst[i].data[j], expected.data[j]);
+      }
+      CPPUNIT_ASSERT( ok );
+      CPPUNIT_ASSERT( dst[kSizes[s]].m00 == 42.0f );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestQuaternionArray);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+#include "vgl_raypacket.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+}
+
+
+// Rays from around z = -5 towards points scattered around the origin, so
+// that roughly half of them hit the objects used below. Some go backwards.
+static std::vector<vgl::Ray3f> makeRays(size_t count)
+{
+  std::vector<vgl::Ray3f> rays(count);
+  for (size_t i = 0; i < count; ++i) {
+    vgl::Vec3f o(std::sin(i * 1.3f) * 2.0f, std::cos(i * 0.7f) * 2.0f, -5.0f + std::sin(i * 0.3f));
+    vgl::Vec3f target(std::sin(i * 2.1f) * 1.5f, std::cos(i * 1.7f) * 1.5f, std::sin(i * 0.9f));
+    vgl::Vec3f d = target - o;
+    if (i % 7 == 3)
+      d = -d;
+    rays[i] = vgl::Ray3f(o, d);
+  }
+  return rays;
+}
+
+
+// Every other ray, plus the last, with some whole groups left out.
+static unsigned int makeActive(unsigned int n, unsigned int seed)
+{
+  unsigned int active = 0x5A5Au ^ (seed * 0x9E37u);
+  active |= 1u << (n - 1);
+  return active & ((1u << n) - 1);
+}
+
+
+template <unsigned int N>
+static vgl::RayPacket<N> makePacket(const std::vector<vgl::Ray3f>& rays, size_t first)
+{
+  vgl::RayPacket<N> packet;
+  for (unsigned int i = 0; i < N; ++i)
+    packet.set(i, rays[first + i], (i % 5 == 1) ? 6.0f : HUGE_VALF);
+  return packet;
+}
+
+
+template <unsigned int N>
+static bool checkSphere(const std::vector<vgl::Ray3f>& rays, const vgl::Vec3f& center, float radius)
+{
+  for (size_t first = 0; first + N <= rays.size(); first += N) {
+    vgl::RayPacket<N> packet = makePacket<N>(rays, first);
+    vgl::RayPacket<N> before = packet;
+    unsigned int active = makeActive(N, unsigned(first));
+    unsigned int hits = vgl::intersectPacketSphere(packet, active, center, radius);
+
+    for (unsigned int i = 0; i < N; ++i) {
+      float t;
+      bool expected = (active & (1u << i)) &&
+                      vgl::intersectRaySphere(rays[first + i], center, radius, t) && t < before.tMax[i];
+      if (expected != bool(hits & (1u << i)))
+        return false;
+      if (expected ? !close(packet.tMax[i], t) : packet.tMax[i] != before.tMax[i])
+        return false;
+    }
+  }
+  return true;
+}
+
+
+template <unsigned int N>
+static bool checkBox(const std::vector<vgl::Ray3f>& rays, const vgl::AABB3f& box)
+{
+  for (size_t first = 0; first + N <= rays.size(); first += N) {
+    vgl::RayPacket<N> packet = makePacket<N>(rays, first);
+    unsigned int active = makeActive(N, unsigned(first));
+    unsigned int hits = vgl::intersectPacketBox(packet, active, box);
+
+    for (unsigned int i = 0; i < N; ++i) {
+      float tNear, tFar;
+      bool expected = (active & (1u << i)) &&
+                      vgl::intersectRayBox(rays[first + i], box, tNear, tFar) && tNear < packet.tMax[i];
+      if (expected != bool(hits & (1u << i)))
+        return false;
+    }
+  }
+  return true;
+}
+
+
+template <unsigned int N>
+static bool checkTriangle(const std::vector<vgl::Ray3f>& rays, bool watertight,
+                          const vgl::Vec3f& v0, const vgl::Vec3f& v1, const vgl::Vec3f& v2)
+{
+  for (size_t first = 0; first + N <= rays.size(); first += N) {
+    vgl::RayPacket<N> packet = makePacket<N>(rays, first);
+    vgl::RayPacket<N> before = packet;
+    unsigned int active = makeActive(N, unsigned(first));
+    float u[N], v[N];
+    unsigned int hits = watertight ? vgl::intersectPacketTriangleWatertight(packet, active, v0, v1, v2, u, v)
+                                   : vgl::intersectPacketTriangle(packet, active, v0, v1, v2, u, v);
+
+    for (unsigned int i = 0; i < N; ++i) {
+      float t, eu, ev;
+      bool hit = watertight ? vgl::intersectRayTriangleWatertight(rays[first + i], v0, v1, v2, t, eu, ev)
+                            : vgl::intersectRayTriangle(rays[first + i], v0, v1, v2, t, eu, ev);
+      bool expected = (active & (1u << i)) && hit && t < before.tMax[i];
+      if (expected != bool(hits & (1u << i)))
+        return false;
+      if (!expected && packet.tMax[i] != before.tMax[i])
+        return false;
+      if (expected && !(close(packet.tMax[i], t) && close(u[i], eu) && close(v[i], ev)))
+        return false;
+    }
+  }
+  return true;
+}
+
+
+// A random float in [lo, hi).
+static float randomFloat(float lo, float hi)
+{
+  return lo + (hi - lo) * float(rand() / (RAND_MAX + 1.0));
+}
+
+
+static vgl::Vec3f randomPoint(float size)
+{
+  return vgl::Vec3f(randomFloat(-size, size), randomFloat(-size, size), randomFloat(-size, size));
+}
+
+
+// Random pairs of triangles (a, b, c) and (b, a, d) sharing the edge ab, each
+// with a packet of rays aimed at random points along the edge. Every ray has
+// to hit one triangle or the other, unless the pair folds over itself as seen
+// from its origin, and the kernel has to agree with the scalar test about
+// which.
+template <unsigned int N>
+static bool checkSharedEdges(unsigned int pairs)
+{
+  srand(N);
+  for (unsigned int p = 0; p < pairs; ++p) {
+    vgl::Vec3f a = randomPoint(1.0f), b = randomPoint(1.0f), c = randomPoint(1.0f);
+    vgl::Vec3f d = a + b - c + randomPoint(0.3f);
+    vgl::RayPacket<N> packet;
+    for (unsigned int i = 0; i < N; ++i) {
+      vgl::Vec3f o(randomFloat(-3.0f, 3.0f), randomFloat(-3.0f, 3.0f), randomFloat(-6.0f, -4.0f));
+      packet.set(i, vgl::Ray3f(o, a + (b - a) * randomFloat(0.0f, 1.0f) - o));
+    }
+
+    vgl::RayPacket<N> first = packet, second = packet;
+    float u[N], v[N];
+    unsigned int hits1 = vgl::intersectPacketTriangleWatertight(first, packet.kAllActive, a, b, c, u, v);
+    unsigned int hits2 = vgl::intersectPacketTriangleWatertight(second, packet.kAllActive, b, a, d, u, v);
+    for (unsigned int i = 0; i < N; ++i) {
+      vgl::Ray3f ray = packet.get(i);
+      float t, eu, ev;
+      bool hit1 = vgl::intersectRayTriangleWatertight(ray, a, b, c, t, eu, ev);
+      bool hit2 = vgl::intersectRayTriangleWatertight(ray, b, a, d, t, eu, ev);
+      if (hit1 != bool(hits1 & (1u << i)) || hit2 != bool(hits2 & (1u << i)))
+        return false;
+
+      vgl::Vec3f n = vgl::cross(a - ray.o, b - ray.o);
+      bool folded = (vgl::dot(n, c - ray.o) > 0.0f) == (vgl::dot(n, d - ray.o) > 0.0f);
+      if (!folded && !hit1 && !hit2)
+        return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestRayPacket : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestRayPacket);
+  CPPUNIT_TEST(testSetGet);
+  CPPUNIT_TEST(testSphere);
+  CPPUNIT_TEST(testBox);
+  CPPUNIT_TEST(testTriangle);
+  CPPUNIT_TEST(testTriangleWatertight);
+  CPPUNIT_TEST(testNearestHit);
+  CPPUNIT_TEST(testWatertightFan);
+  CPPUNIT_TEST(testWatertightSharedEdges);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testSetGet() {
+    vgl::RayPacket8 packet;
+    CPPUNIT_ASSERT( packet.tMax[7] == HUGE_VALF );
+    packet.set(5, vgl::Ray3f(vgl::Vec3f(1, 2, 3), vgl::Vec3f(4, 5, 6)), 7.0f);
+    vgl::Ray3f ray = packet.get(5);
+    CPPUNIT_ASSERT( ray.o.x == 1 && ray.o.y == 2 && ray.o.z == 3 );
+    CPPUNIT_ASSERT( ray.d.x == 4 && ray.d.y == 5 && ray.d.z == 6 );
+    CPPUNIT_ASSERT( packet.tMax[5] == 7.0f );
+    CPPUNIT_ASSERT( vgl::RayPacket16::kAllActive == 0xFFFFu );
+  }
+
+  void testSphere() {
+    std::vector<vgl::Ray3f> rays = makeRays(480);
+    vgl::Vec3f center(0.2f, -0.1f, 0.3f);
+    CPPUNIT_ASSERT( checkSphere<4>(rays, center, 1.2f) );
+    CPPUNIT_ASSERT( checkSphere<8>(rays, center, 1.2f) );
+    CPPUNIT_ASSERT( checkSphere<16>(rays, center, 1.2f) );
+
+    // Rays starting inside hit the far side.
+    vgl::RayPacket4 packet;
+    packet.set(0, vgl::Ray3f(vgl::Vec3f(0, 0, 0), vgl::Vec3f(0, 0, 1)));
+    CPPUNIT_ASSERT( vgl::intersectPacketSphere(packet, 1, vgl::Vec3f(0, 0, 0), 2.0f) == 1u );
+    CPPUNIT_ASSERT( close(packet.tMax[0], 2.0f) );
+  }
+
+  void testBox() {
+    std::vector<vgl::Ray3f> rays = makeRays(480);
+    vgl::AABB3f box(vgl::Vec3f(-1, -0.5f, -0.8f), vgl::Vec3f(0.7f, 1.1f, 0.9f));
+    CPPUNIT_ASSERT( checkBox<4>(rays, box) );
+    CPPUNIT_ASSERT( checkBox<8>(rays, box) );
+    CPPUNIT_ASSERT( checkBox<16>(rays, box) );
+  }
+
+  void testTriangle() {
+    std::vector<vgl::Ray3f> rays = makeRays(480);
+    vgl::Vec3f v0(-1.5f, -1, 0.2f), v1(1.2f, -0.8f, -0.3f), v2(0.1f, 1.4f, 0.5f);
+    CPPUNIT_ASSERT( checkTriangle<4>(rays, false, v0, v1, v2) );
+    CPPUNIT_ASSERT( checkTriangle<8>(rays, false, v0, v1, v2) );
+    CPPUNIT_ASSERT( checkTriangle<16>(rays, false, v0, v1, v2) );
+    // The other way round, which is the back face for most of the rays.
+    CPPUNIT_ASSERT( checkTriangle<8>(rays, false, v0, v2, v1) );
+  }
+
+  void testTriangleWatertight() {
+    std::vector<vgl::Ray3f> rays = makeRays(480);
+    vgl::Vec3f v0(-1.5f, -1, 0.2f), v1(1.2f, -0.8f, -0.3f), v2(0.1f, 1.4f, 0.5f);
+    CPPUNIT_ASSERT( checkTriangle<4>(rays, true, v0, v1, v2) );
+    CPPUNIT_ASSERT( checkTriangle<8>(rays, true, v0, v1, v2) );
+    CPPUNIT_ASSERT( checkTriangle<16>(rays, true, v0, v1, v2) );
+    CPPUNIT_ASSERT( checkTriangle<8>(rays, true, v0, v2, v1) );
+
+    // Directions along each axis, both ways, to cover every choice of z.
+    for (unsigned int axis = 0; axis < 6; ++axis) {
+      vgl::Vec3f d(0, 0, 0);
+      d[axis % 3] = (axis < 3) ? 1.0f : -1.0f;
+      vgl::Vec3f e(0.1f, 0.2f, 0.3f);
+      e[axis % 3] = 0.0f;
+      vgl::Vec3f a = e - d * 0.5f + vgl::Vec3f(0.4f, 0.4f, 0.4f);
+      vgl::Vec3f b = a, c = a;
+      b[(axis + 1) % 3] -= 1.0f;
+      c[(axis + 2) % 3] -= 1.0f;
+      vgl::RayPacket4 packet;
+      packet.set(0, vgl::Ray3f(e - d * 3.0f, d));
+      float u[4], v[4];
+      CPPUNIT_ASSERT( vgl::intersectPacketTriangleWatertight(packet, 1, a, b, c, u, v) == 1u );
+      CPPUNIT_ASSERT( close(packet.tMax[0], 2.5f + 0.4f * d[axis % 3]) );
+    }
+  }
+
+  void testNearestHit() {
+    // Three parallel squares, tested out of order; each ray should end up
+    // with the distance to the nearest.
+    vgl::RayPacket16 packet;
+    for (unsigned int i = 0; i < 16; ++i)
+      packet.set(i, vgl::Ray3f(vgl::Vec3f(i * 0.1f - 0.75f, 0.2f, -10.0f), vgl::Vec3f(0, 0, 1)));
+    const float kDepths[] = { 3.0f, -1.0f, 1.0f };
+    float u[16], v[16];
+    for (unsigned int k = 0; k < 3; ++k) {
+      vgl::Vec3f a(-1, -1, kDepths[k]), b(1, -1, kDepths[k]), c(1, 1, kDepths[k]), d(-1, 1, kDepths[k]);
+      vgl::intersectPacketTriangle(packet, packet.kAllActive, a, b, c, u, v);
+      vgl::intersectPacketTriangle(packet, packet.kAllActive, a, c, d, u, v);
+    }
+    for (unsigned int i = 0; i < 16; ++i)
+      CPPUNIT_ASSERT( close(packet.tMax[i], 9.0f) );
+  }
+
+  void testWatertightFan() {
+    // A fan of triangles around a center point, with rays aimed exactly at
+    // the center and along the shared edges. Every ray should hit at least
+    // one of the triangles.
+    const unsigned int kTriangles = 7;
+    vgl::Vec3f center(0.13f, -0.07f, 0.31f);
+    std::vector<vgl::Vec3f> rim(kTriangles);
+    for (unsigned int k = 0; k < kTriangles; ++k) {
+      float angle = k * 2.0f * float(M_PI) / kTriangles + 0.1f;
+      rim[k] = vgl::Vec3f(std::cos(angle) * 1.7f, std::sin(angle) * 1.3f, 0.31f + 0.2f * std::sin(angle * 3.0f));
+    }
+
+    vgl::RayPacket16 packet;
+    for (unsigned int i = 0; i < 16; ++i) {
+      vgl::Vec3f o(std::sin(i * 1.9f) * 3.0f, std::cos(i * 1.1f) * 3.0f, -4.0f - i * 0.1f);
+      // Points along the edges from the center out to the rim.
+      float s = (i % 4) * 0.23f;
+      vgl::Vec3f target = center + (rim[i % kTriangles] - center) * s;
+      packet.set(i, vgl::Ray3f(o, target - o));
+    }
+
+    unsigned int hits = 0;
+    float u[16], v[16];
+    for (unsigned int k = 0; k < kTriangles; ++k)
+      hits |= vgl::intersectPacketTriangleWatertight(packet, packet.kAllActive, center, rim[k],
+                                                     rim[(k + 1) % kTriangles], u, v);
+    CPPUNIT_ASSERT( hits == packet.kAllActive );
+  }
+
+  void testWatertightSharedEdges() {
+    CPPUNIT_ASSERT( checkSharedEdges<4>(500) );
+    CPPUNIT_ASSERT( checkSharedEdges<8>(500) );
+    CPPUNIT_ASSERT( checkSharedEdges<16>(500) );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestRayPacket);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
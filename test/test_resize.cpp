@@ -0,0 +1,251 @@
+#include "vgl_resize.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+//
+// CONSTANTS
+//
+
+static const vgl::ResizeFilter kFilters[] = {
+  vgl::FILTER_BOX, vgl::FILTER_TRIANGLE, vgl::FILTER_MITCHELL, vgl::FILTER_LANCZOS3
+};
+static const int kTypes[] = { GL_LUMINANCE, GL_RGB, GL_RGBA };
+
+
+//
+// HELPER METHODS
+//
+
+static unsigned int channelsFor(int type)
+{
+  return (type == GL_LUMINANCE) ? 1 : (type == GL_RGB) ? 3 : 4;
+}
+
+
+// An 8 bit image of random values, which is as hard as it gets for the
+// filters with negative lobes.
+static vgl::RawImage* makeNoise(int type, unsigned int width, unsigned int height)
+{
+  unsigned int channels = channelsFor(type);
+  vgl::RawImage* img = new vgl::RawImage(type, channels, width, height);
+  srand(width * 31 + height * channels);
+  for (size_t i = 0; i < size_t(width) * height * channels; ++i)
+    img->getPixels()[i] = (unsigned char)(rand() >> 4);
+  return img;
+}
+
+
+// An 8 bit image of gentle gradients, different in each channel.
+static vgl::RawImage* makeSmooth(int type, unsigned int width, unsigned int height)
+{
+  unsigned int channels = channelsFor(type);
+  vgl::RawImage* img = new vgl::RawImage(type, channels, width, height);
+  unsigned char* p = img->getPixels();
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      for (unsigned int c = 0; c < channels; ++c)
+        *p++ = (unsigned char)(127.5 + 127.5 * std::sin(x * 0.11 + y * 0.07 * (c + 1) + c));
+    }
+  }
+  return img;
+}
+
+
+// Resizes a copy of the image as floats and converts the result back, for
+// comparing with the 8 bit path.
+static vgl::RawImage* resizeAsFloat(const vgl::RawImage& img, unsigned int width, unsigned int height,
+    vgl::ResizeFilter filter)
+{
+  vgl::RawImage floats(img);
+  floats.convertInPlace(img.getType(), GL_FLOAT);
+  vgl::RawImage* result = vgl::resize(&floats, width, height, filter);
+  result->convertInPlace(img.getType(), img.getPixelType());
+  return result;
+}
+
+
+// The largest difference between any two samples of two 8 bit images, or -1
+// if they don't match in size and layout.
+static int maxDifference(const vgl::RawImage& a, const vgl::RawImage& b)
+{
+  if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() ||
+      a.getBytesPerPixel() != b.getBytesPerPixel() || a.getPixelType() != b.getPixelType())
+    return -1;
+  int largest = 0;
+  for (size_t i = 0; i < size_t(a.getWidth()) * a.getHeight() * a.getBytesPerPixel(); ++i)
+    largest = std::max(largest, abs(int(a.getPixels()[i]) - int(b.getPixels()[i])));
+  return largest;
+}
+
+
+// Checks that the 8 bit and float paths agree to within one level, enlarging
+// and shrinking.
+static bool matchesFloat(const vgl::RawImage& img, vgl::ResizeFilter filter)
+{
+  const unsigned int kSizes[][2] = { { 37, 23 }, { 80, 50 }, { 13, 9 }, { 50, 7 }, { 1, 1 } };
+  for (unsigned int i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    vgl::RawImage* fixed = vgl::resize(const_cast<vgl::RawImage*>(&img), kSizes[i][0], kSizes[i][1], filter);
+    vgl::RawImage* floats = resizeAsFloat(img, kSizes[i][0], kSizes[i][1], filter);
+    int diff = maxDifference(*fixed, *floats);
+    delete fixed;
+    delete floats;
+    if (diff < 0 || diff > 1)
+      return false;
+  }
+  return true;
+}
+
+
+//
+// TESTS
+//
+
+class TestResize : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestResize);
+  CPPUNIT_TEST(testSmooth);
+  CPPUNIT_TEST(testNoise);
+  CPPUNIT_TEST(testSameSize);
+  CPPUNIT_TEST(testFlat);
+  CPPUNIT_TEST(testBox);
+  CPPUNIT_TEST(testSixteenBit);
+  CPPUNIT_TEST(testEmpty);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testSmooth() {
+    for (unsigned int t = 0; t < 3; ++t) {
+      vgl::RawImage* img = makeSmooth(kTypes[t], 37, 23);
+      for (unsigned int f = 0; f < 4; ++f)
+        CPPUNIT_ASSERT( matchesFloat(*img, kFilters[f]) );
+      delete img;
+    }
+  }
+
+  void testNoise() {
+    // Noise overshoots well past 0 and 255 between the two passes, which the
+    // 8 bit path has to keep hold of to agree with the float path.
+    for (unsigned int t = 0; t < 3; ++t) {
+      vgl::RawImage* img = makeNoise(kTypes[t], 37, 23);
+      for (unsigned int f = 0; f < 4; ++f)
+        CPPUNIT_ASSERT( matchesFloat(*img, kFilters[f]) );
+      delete img;
+    }
+  }
+
+  void testSameSize() {
+    // Filters which are zero at every other whole pixel leave the image alone.
+    vgl::RawImage* img = makeNoise(GL_RGBA, 29, 17);
+    for (unsigned int f = 0; f < 4; ++f) {
+      if (kFilters[f] == vgl::FILTER_MITCHELL)
+        continue;
+      vgl::RawImage* same = vgl::resize(img, 29, 17, kFilters[f]);
+      CPPUNIT_ASSERT( maxDifference(*img, *same) == 0 );
+      delete same;
+    }
+    delete img;
+  }
+
+  void testFlat() {
+    for (unsigned int t = 0; t < 3; ++t) {
+      unsigned int channels = channelsFor(kTypes[t]);
+      vgl::RawImage img(kTypes[t], channels, 19, 11, GL_UNSIGNED_BYTE, vgl::ORIGIN_TOP_LEFT);
+      memset(img.getPixels(), 200, size_t(19) * 11 * channels);
+      for (unsigned int f = 0; f < 4; ++f) {
+        vgl::RawImage* big = vgl::resize(&img, 45, 30, kFilters[f]);
+        vgl::RawImage* small = vgl::resize(&img, 6, 4, kFilters[f]);
+        CPPUNIT_ASSERT( big->getOrigin() == vgl::ORIGIN_TOP_LEFT && big->getType() == kTypes[t] );
+        for (size_t i = 0; i < size_t(45) * 30 * channels; ++i)
+          CPPUNIT_ASSERT( big->getPixels()[i] == 200 );
+        for (size_t i = 0; i < size_t(6) * 4 * channels; ++i)
+          CPPUNIT_ASSERT( small->getPixels()[i] == 200 );
+        delete big;
+        delete small;
+      }
+    }
+  }
+
+  void testBox() {
+    // Halving with a box filter averages each 2x2 block.
+    vgl::RawImage* img = makeNoise(GL_RGB, 16, 10);
+    vgl::RawImage* half = vgl::resize(img, 8, 5, vgl::FILTER_BOX);
+    const unsigned char* src = img->getPixels();
+    for (unsigned int y = 0; y < 5; ++y) {
+      for (unsigned int x = 0; x < 8; ++x) {
+        for (unsigned int c = 0; c < 3; ++c) {
+          size_t i = (size_t(y) * 2 * 16 + x * 2) * 3 + c;
+          int sum = src[i] + src[i + 3] + src[i + 16 * 3] + src[i + 16 * 3 + 3];
+          int actual = half->getPixels()[(y * 8 + x) * 3 + c];
+          CPPUNIT_ASSERT( abs(actual * 4 - sum) <= 2 );
+        }
+      }
+    }
+    delete half;
+    delete img;
+  }
+
+  void testSixteenBit() {
+    vgl::RawImage* img = makeNoise(GL_RGBA, 21, 13);
+    vgl::RawImage wide(*img);
+    wide.convertInPlace(GL_RGBA, GL_UNSIGNED_SHORT);
+    vgl::RawImage* big = vgl::resize(&wide, 40, 30, vgl::FILTER_LANCZOS3);
+    CPPUNIT_ASSERT( big->getPixelType() == GL_UNSIGNED_SHORT && big->getBytesPerPixel() == 8 );
+    big->convertInPlace(GL_RGBA, GL_UNSIGNED_BYTE);
+    vgl::RawImage* expected = resizeAsFloat(*img, 40, 30, vgl::FILTER_LANCZOS3);
+    CPPUNIT_ASSERT( maxDifference(*big, *expected) == 0 || maxDifference(*big, *expected) == 1 );
+    delete expected;
+    delete big;
+    delete img;
+  }
+
+  void testEmpty() {
+    vgl::RawImage* img = makeNoise(GL_RGB, 5, 5);
+    vgl::RawImage* none = vgl::resize(img, 0, 3);
+    CPPUNIT_ASSERT( none->getWidth() == 0 && none->getHeight() == 3 );
+    delete none;
+    delete img;
+
+    vgl::RawImage empty(GL_RGB, 3, 0, 0);
+    vgl::RawImage* black = vgl::resize(&empty, 2, 2);
+    for (unsigned int i = 0; i < 12; ++i)
+      CPPUNIT_ASSERT( black->getPixels()[i] == 0 );
+    delete black;
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestResize);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,347 @@
+#include "vgl_tiledimage.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cstring>
+#include <pthread.h>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+static unsigned char pattern(unsigned int x, unsigned int y, unsigned int channel)
+{
+  return (unsigned char)(x * 3 + y * 7 + channel * 85);
+}
+
+
+// Fills an RGB image with the pattern, a tile at a time. Pixels hanging off
+// the edge of the image are left alone.
+static void fillPattern(vgl::TiledImage& img)
+{
+  const unsigned int tw = img.getTileWidth(), th = img.getTileHeight();
+  for (unsigned int ty = 0; ty < img.getTilesY(); ++ty) {
+    for (unsigned int tx = 0; tx < img.getTilesX(); ++tx) {
+      unsigned char* tile = img.lockTileForWriting(tx, ty);
+      for (unsigned int y = 0; y < th && ty * th + y < img.getHeight(); ++y) {
+        for (unsigned int x = 0; x < tw && tx * tw + x < img.getWidth(); ++x) {
+          for (unsigned int c = 0; c < 3; ++c)
+            tile[(y * tw + x) * 3 + c] = pattern(tx * tw + x, ty * th + y, c);
+        }
+      }
+      img.unlockTile(tx, ty);
+    }
+  }
+}
+
+
+// The RGB pixel at x, y, which must be inside the tile the caller has locked.
+static const unsigned char* pixelAt(const vgl::TiledImage& img, const unsigned char* tile,
+    unsigned int x, unsigned int y)
+{
+  return tile + ((y % img.getTileHeight()) * img.getTileWidth() + x % img.getTileWidth()) * 3;
+}
+
+
+// Checks that every pixel of the image matches the pattern after mapping its
+// coordinates through the given downsampling.
+static bool hasPattern(vgl::TiledImage& img, unsigned int downsampleX = 1, unsigned int downsampleY = 1)
+{
+  const unsigned int tw = img.getTileWidth(), th = img.getTileHeight();
+  bool ok = true;
+  for (unsigned int ty = 0; ty < img.getTilesY(); ++ty) {
+    for (unsigned int tx = 0; tx < img.getTilesX(); ++tx) {
+      const unsigned char* tile = img.lockTile(tx, ty);
+      for (unsigned int y = ty * th; y < (ty + 1) * th && y < img.getHeight(); ++y) {
+        for (unsigned int x = tx * tw; x < (tx + 1) * tw && x < img.getWidth(); ++x) {
+          const unsigned char* p = pixelAt(img, tile, x, y);
+          for (unsigned int c = 0; c < 3; ++c)
+            ok = ok && p[c] == pattern(x * downsampleX, y * downsampleY, c);
+        }
+      }
+      img.unlockTile(tx, ty);
+    }
+  }
+  return ok;
+}
+
+
+struct Writer {
+  vgl::TiledImage* img;
+  unsigned int first, step;
+};
+
+
+// Writes every step'th tile, starting from first, with a value identifying
+// the tile.
+static void* writeTiles(void* arg)
+{
+  Writer* w = (Writer*)arg;
+  std::vector<unsigned char> data(w->img->getTileBytes());
+  unsigned int numTiles = w->img->getTilesX() * w->img->getTilesY();
+  for (unsigned int t = w->first; t < numTiles; t += w->step) {
+    memset(&data[0], int(t), data.size());
+    w->img->writeTile(t % w->img->getTilesX(), t / w->img->getTilesX(), &data[0]);
+  }
+  return NULL;
+}
+
+
+struct Checker {
+  vgl::TiledImage* img;
+  unsigned int first;
+  bool ok;
+};
+
+
+// Checks that every tile still holds the value writeTiles put there, starting
+// at a different tile in each thread. Every other tile is locked for writing,
+// though left alone, so the threads keep spilling and reading in the same
+// tiles as each other.
+static void* checkTiles(void* arg)
+{
+  Checker* c = (Checker*)arg;
+  unsigned int numTiles = c->img->getTilesX() * c->img->getTilesY();
+  for (unsigned int pass = 0; pass < 4; ++pass) {
+    for (unsigned int i = 0; i < numTiles; ++i) {
+      unsigned int t = (c->first + i) % numTiles;
+      unsigned int tx = t % c->img->getTilesX(), ty = t / c->img->getTilesX();
+      const unsigned char* data = ((t + pass) % 2 == 0) ? c->img->lockTileForWriting(tx, ty) :
+                                                          c->img->lockTile(tx, ty);
+      for (size_t j = 0; j < c->img->getTileBytes(); ++j)
+        c->ok = c->ok && data[j] == (unsigned char)t;
+      c->img->unlockTile(tx, ty);
+    }
+  }
+  return NULL;
+}
+
+
+//
+// TESTS
+//
+
+class TestTiledImage : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestTiledImage);
+  CPPUNIT_TEST(testLayout);
+  CPPUNIT_TEST(testBlank);
+  CPPUNIT_TEST(testRoundTrip);
+  CPPUNIT_TEST(testSpill);
+  CPPUNIT_TEST(testCacheBytes);
+  CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST(testSharedTiles);
+  CPPUNIT_TEST(testDownsample);
+  CPPUNIT_TEST(testConvert);
+  CPPUNIT_TEST(testErrors);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testLayout() {
+    vgl::TiledImage img(GL_RGBA, 8, 1000, 300, GL_UNSIGNED_SHORT, vgl::ORIGIN_TOP_LEFT, 64, 128);
+    CPPUNIT_ASSERT( img.getType() == GL_RGBA && img.getPixelType() == GL_UNSIGNED_SHORT );
+    CPPUNIT_ASSERT( img.getBytesPerPixel() == 8 );
+    CPPUNIT_ASSERT( img.getWidth() == 1000 && img.getHeight() == 300 );
+    CPPUNIT_ASSERT( img.getOrigin() == vgl::ORIGIN_TOP_LEFT );
+    CPPUNIT_ASSERT( img.getTilesX() == 16 && img.getTilesY() == 3 );
+    CPPUNIT_ASSERT( img.getTileBytes() == 64 * 128 * 8 );
+    CPPUNIT_ASSERT( img.getCacheBytes() == vgl::TiledImage::kDefaultCacheBytes );
+    CPPUNIT_ASSERT( img.getResidentBytes() == 0 );
+  }
+
+  void testBlank() {
+    vgl::TiledImage img(GL_RGB, 3, 20, 20, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16);
+    const unsigned char* tile = img.lockTile(1, 1);
+    for (size_t i = 0; i < img.getTileBytes(); ++i)
+      CPPUNIT_ASSERT( tile[i] == 0 );
+    CPPUNIT_ASSERT( img.getResidentBytes() == img.getTileBytes() );
+    img.unlockTile(1, 1);
+  }
+
+  void testRoundTrip() {
+    // Odd sizes, with tiles hanging off the right and top edges.
+    vgl::TiledImage img(GL_RGB, 3, 101, 77, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 32, 16);
+    fillPattern(img);
+    CPPUNIT_ASSERT( hasPattern(img) );
+
+    std::vector<unsigned char> data(img.getTileBytes()), copy(img.getTileBytes());
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = (unsigned char)(i * 13);
+    img.writeTile(3, 4, &data[0]);
+    img.readTile(3, 4, &copy[0]);
+    CPPUNIT_ASSERT( data == copy );
+  }
+
+  void testSpill() {
+    // Room for only three tiles, so modified tiles have to go out to the
+    // spill file and come back from it.
+    vgl::TiledImage img(GL_RGB, 3, 130, 70, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16,
+        3 * 16 * 16 * 3);
+    fillPattern(img);
+    CPPUNIT_ASSERT( img.getResidentBytes() <= img.getCacheBytes() );
+    CPPUNIT_ASSERT( hasPattern(img) );
+    CPPUNIT_ASSERT( hasPattern(img) );
+
+    // Locked tiles stay in memory even when that takes the cache over budget,
+    // and the excess goes once they're unlocked.
+    for (unsigned int tx = 0; tx < 5; ++tx)
+      img.lockTile(tx, 0);
+    CPPUNIT_ASSERT( img.getResidentBytes() == 5 * img.getTileBytes() );
+    for (unsigned int tx = 0; tx < 5; ++tx)
+      img.unlockTile(tx, 0);
+    CPPUNIT_ASSERT( img.getResidentBytes() <= img.getCacheBytes() );
+    CPPUNIT_ASSERT( hasPattern(img) );
+  }
+
+  void testCacheBytes() {
+    vgl::TiledImage img(GL_RGB, 3, 64, 64, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16);
+    fillPattern(img);
+    CPPUNIT_ASSERT( img.getResidentBytes() == 16 * img.getTileBytes() );
+    img.setCacheBytes(2 * img.getTileBytes());
+    CPPUNIT_ASSERT( img.getCacheBytes() == 2 * img.getTileBytes() );
+    CPPUNIT_ASSERT( img.getResidentBytes() == 2 * img.getTileBytes() );
+    img.setCacheBytes(0);
+    CPPUNIT_ASSERT( img.getResidentBytes() == 0 );
+    CPPUNIT_ASSERT( hasPattern(img) );
+  }
+
+  void testThreads() {
+    // Plain threads writing to interleaved tiles of an image whose cache is
+    // too small to hold them all.
+    const unsigned int kThreads = 6;
+    vgl::TiledImage img(GL_RGB, 3, 250, 250, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16,
+        10 * 16 * 16 * 3);
+    pthread_t threads[kThreads];
+    Writer writers[kThreads];
+    for (unsigned int i = 0; i < kThreads; ++i) {
+      writers[i].img = &img;
+      writers[i].first = i;
+      writers[i].step = kThreads;
+      CPPUNIT_ASSERT( pthread_create(&threads[i], NULL, writeTiles, &writers[i]) == 0 );
+    }
+    for (unsigned int i = 0; i < kThreads; ++i)
+      pthread_join(threads[i], NULL);
+
+    std::vector<unsigned char> data(img.getTileBytes());
+    for (unsigned int t = 0; t < img.getTilesX() * img.getTilesY(); ++t) {
+      img.readTile(t % img.getTilesX(), t / img.getTilesX(), &data[0]);
+      for (size_t i = 0; i < data.size(); ++i)
+        CPPUNIT_ASSERT( data[i] == (unsigned char)t );
+    }
+    CPPUNIT_ASSERT( img.getResidentBytes() <= img.getCacheBytes() );
+  }
+
+  void testSharedTiles() {
+    // Threads going after the same tiles of an image with room for only a
+    // few, so they have to wait for each other's reads and spills.
+    const unsigned int kThreads = 6;
+    vgl::TiledImage img(GL_RGB, 3, 100, 60, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16,
+        3 * 16 * 16 * 3);
+    Writer writer = { &img, 0, 1 };
+    writeTiles(&writer);
+
+    pthread_t threads[kThreads];
+    Checker checkers[kThreads];
+    for (unsigned int i = 0; i < kThreads; ++i) {
+      checkers[i].img = &img;
+      checkers[i].first = i * 5;
+      checkers[i].ok = true;
+      CPPUNIT_ASSERT( pthread_create(&threads[i], NULL, checkTiles, &checkers[i]) == 0 );
+    }
+    for (unsigned int i = 0; i < kThreads; ++i) {
+      pthread_join(threads[i], NULL);
+      CPPUNIT_ASSERT( checkers[i].ok );
+    }
+    CPPUNIT_ASSERT( img.getResidentBytes() <= img.getCacheBytes() );
+  }
+
+  void testDownsample() {
+    vgl::TiledImage img(GL_RGB, 3, 203, 97, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 32, 32,
+        8 * 32 * 32 * 3);
+    fillPattern(img);
+    vgl::TiledImage* small = vgl::downsample(&img, 3, 2);
+    CPPUNIT_ASSERT( small->getWidth() == 67 && small->getHeight() == 48 );
+    CPPUNIT_ASSERT( small->getTileWidth() == 32 && small->getCacheBytes() == img.getCacheBytes() );
+    CPPUNIT_ASSERT( hasPattern(*small, 3, 2) );
+    delete small;
+  }
+
+  void testConvert() {
+    vgl::TiledImage img(GL_RGB, 3, 45, 38, GL_UNSIGNED_BYTE, vgl::ORIGIN_TOP_LEFT, 16, 16);
+    fillPattern(img);
+    vgl::TiledImage* converted = vgl::convertTiled(&img, GL_RGBA, GL_UNSIGNED_SHORT);
+    CPPUNIT_ASSERT( converted->getType() == GL_RGBA && converted->getPixelType() == GL_UNSIGNED_SHORT );
+    CPPUNIT_ASSERT( converted->getBytesPerPixel() == 8 );
+    CPPUNIT_ASSERT( converted->getOrigin() == vgl::ORIGIN_TOP_LEFT );
+
+    bool ok = true;
+    for (unsigned int ty = 0; ty < converted->getTilesY(); ++ty) {
+      for (unsigned int tx = 0; tx < converted->getTilesX(); ++tx) {
+        const unsigned short* tile = (const unsigned short*)converted->lockTile(tx, ty);
+        for (unsigned int y = 0; y < 16 && ty * 16 + y < 38; ++y) {
+          for (unsigned int x = 0; x < 16 && tx * 16 + x < 45; ++x) {
+            const unsigned short* p = tile + (y * 16 + x) * 4;
+            for (unsigned int c = 0; c < 3; ++c)
+              ok = ok && p[c] == pattern(tx * 16 + x, ty * 16 + y, c) * 257;
+            ok = ok && p[3] == 65535;
+          }
+        }
+        converted->unlockTile(tx, ty);
+      }
+    }
+    CPPUNIT_ASSERT( ok );
+    delete converted;
+
+    CPPUNIT_ASSERT_THROW( vgl::convertTiled(&img, 0x1234, GL_UNSIGNED_BYTE), vgl::ImageException );
+  }
+
+  void testErrors() {
+    vgl::TiledImage img(GL_RGB, 3, 40, 40, GL_UNSIGNED_BYTE, vgl::ORIGIN_BOTTOM_LEFT, 16, 16);
+    CPPUNIT_ASSERT_THROW( img.lockTile(3, 0), vgl::ImageException );
+    CPPUNIT_ASSERT_THROW( img.lockTileForWriting(0, 3), vgl::ImageException );
+    CPPUNIT_ASSERT( img.getResidentBytes() == 0 );
+
+    // Unlocking a tile which isn't locked does nothing.
+    img.unlockTile(1, 1);
+    img.lockTile(1, 1);
+    img.unlockTile(1, 1);
+    img.unlockTile(1, 1);
+    CPPUNIT_ASSERT( img.getResidentBytes() == img.getTileBytes() );
+
+    CPPUNIT_ASSERT_THROW( vgl::TiledImage("does_not_exist.tif"), vgl::ImageException );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTiledImage);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include "vgl_triangle3.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+}
+
+
+// Rays from around z = -5 towards points scattered around the origin, some
+// of them backwards.
+static std::vector<vgl::Ray3f> makeRays(size_t count)
+{
+  std::vector<vgl::Ray3f> rays(count);
+  for (size_t i = 0; i < count; ++i) {
+    vgl::Vec3f o(std::sin(i * 1.3f) * 2.0f, std::cos(i * 0.7f) * 2.0f, -5.0f + std::sin(i * 0.3f));
+    vgl::Vec3f target(std::sin(i * 2.1f) * 1.5f, std::cos(i * 1.7f) * 1.5f, std::sin(i * 0.9f));
+    vgl::Vec3f d = target - o;
+    if (i % 7 == 3)
+      d = -d;
+    rays[i] = vgl::Ray3f(o, d);
+  }
+  return rays;
+}
+
+
+// Compares a precomputed triangle against intersectRayTriangle for lots of
+// rays, checking that enough of them hit for the test to mean something.
+template <typename Triangle>
+static bool matchesMollerTrumbore(const vgl::Vec3f& v0, const vgl::Vec3f& v1, const vgl::Vec3f& v2)
+{
+  Triangle tri(v0, v1, v2);
+  std::vector<vgl::Ray3f> rays = makeRays(1000);
+  size_t hits = 0;
+  for (size_t i = 0; i < rays.size(); ++i) {
+    float t, u, v, tTri, uTri, vTri;
+    bool expected = vgl::intersectRayTriangle(rays[i], v0, v1, v2, t, u, v);
+    if (vgl::intersectRayTriangle(rays[i], tri, tTri, uTri, vTri) != expected)
+      return false;
+    if (expected && !(close(tTri, t) && close(uTri, u) && close(vTri, v)))
+      return false;
+    hits += expected ? 1 : 0;
+  }
+  return hits > 100;
+}
+
+
+//
+// TESTS
+//
+
+class TestTriangle3 : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestTriangle3);
+  CPPUNIT_TEST(testWoop);
+  CPPUNIT_TEST(testPlucker);
+  CPPUNIT_TEST(testPluckerSharedEdges);
+  CPPUNIT_TEST(testDegenerate);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testWoop() {
+    vgl::Vec3f v0(-1.5f, -1, 0.2f), v1(1.2f, -0.8f, -0.3f), v2(0.1f, 1.4f, 0.5f);
+    CPPUNIT_ASSERT( matchesMollerTrumbore<vgl::TriangleWoopf>(v0, v1, v2) );
+    CPPUNIT_ASSERT( matchesMollerTrumbore<vgl::TriangleWoopf>(v0, v2, v1) );
+
+    // Straight down the z axis at the middle of a triangle in the z = 2 plane.
+    vgl::TriangleWoopf tri(vgl::Vec3f(0, 0, 2), vgl::Vec3f(3, 0, 2), vgl::Vec3f(0, 3, 2));
+    float t, u, v;
+    CPPUNIT_ASSERT( vgl::intersectRayTriangle(vgl::Ray3f(vgl::Vec3f(1, 1, 0), vgl::Vec3f(0, 0, 1)), tri, t, u, v) );
+    CPPUNIT_ASSERT( close(t, 2.0f) && close(u, 1.0f / 3.0f) && close(v, 1.0f / 3.0f) );
+  }
+
+  void testPlucker() {
+    vgl::Vec3f v0(-1.5f, -1, 0.2f), v1(1.2f, -0.8f, -0.3f), v2(0.1f, 1.4f, 0.5f);
+    CPPUNIT_ASSERT( matchesMollerTrumbore<vgl::TrianglePluckerf>(v0, v1, v2) );
+    CPPUNIT_ASSERT( matchesMollerTrumbore<vgl::TrianglePluckerf>(v0, v2, v1) );
+
+    vgl::TrianglePluckerf tri(vgl::Vec3f(0, 0, 2), vgl::Vec3f(3, 0, 2), vgl::Vec3f(0, 3, 2));
+    float t, u, v;
+    CPPUNIT_ASSERT( vgl::intersectRayTriangle(vgl::Ray3f(vgl::Vec3f(1, 1, 0), vgl::Vec3f(0, 0, 1)), tri, t, u, v) );
+    CPPUNIT_ASSERT( close(t, 2.0f) && close(u, 1.0f / 3.0f) && close(v, 1.0f / 3.0f) );
+    // Pointing away.
+    CPPUNIT_ASSERT( !vgl::intersectRayTriangle(vgl::Ray3f(vgl::Vec3f(1, 1, 0), vgl::Vec3f(0, 0, -1)), tri, t, u, v) );
+  }
+
+  void testPluckerSharedEdges() {
+    // A fan of triangles around a center point, with rays aimed exactly at
+    // the center and along the shared edges. Every ray should hit at least
+    // one of the triangles.
+    const unsigned int kTriangles = 7;
+    vgl::Vec3f center(0.13f, -0.07f, 0.31f);
+    std::vector<vgl::Vec3f> rim(kTriangles);
+    for (unsigned int k = 0; k < kTriangles; ++k) {
+      float angle = k * 2.0f * float(M_PI) / kTriangles + 0.1f;
+      rim[k] = vgl::Vec3f(std::cos(angle) * 1.7f, std::sin(angle) * 1.3f, 0.31f + 0.2f * std::sin(angle * 3.0f));
+    }
+    std::vector<vgl::TrianglePluckerf> fan;
+    for (unsigned int k = 0; k < kTriangles; ++k)
+      fan.push_back(vgl::TrianglePluckerf(center, rim[k], rim[(k + 1) % kTriangles]));
+
+    for (unsigned int i = 0; i < 64; ++i) {
+      vgl::Vec3f o(std::sin(i * 1.9f) * 3.0f, std::cos(i * 1.1f) * 3.0f, -4.0f - i * 0.1f);
+      vgl::Vec3f target = center + (rim[i % kTriangles] - center) * ((i % 4) * 0.23f);
+      vgl::Ray3f ray(o, target - o);
+      bool hit = false;
+      for (unsigned int k = 0; k < kTriangles; ++k) {
+        float t, u, v;
+        hit = hit || vgl::intersectRayTriangle(ray, fan[k], t, u, v);
+      }
+      CPPUNIT_ASSERT( hit );
+    }
+  }
+
+  void testDegenerate() {
+    // All three points on a line: nothing should hit.
+    vgl::Vec3f v0(0, 0, 1), v1(1, 1, 1), v2(2, 2, 1);
+    vgl::TriangleWoopf woop(v0, v1, v2);
+    vgl::TrianglePluckerf plucker(v0, v1, v2);
+    std::vector<vgl::Ray3f> rays = makeRays(100);
+    for (size_t i = 0; i < rays.size(); ++i) {
+      float t, u, v;
+      CPPUNIT_ASSERT( !vgl::intersectRayTriangle(rays[i], woop, t, u, v) );
+      CPPUNIT_ASSERT( !vgl::intersectRayTriangle(rays[i], plucker, t, u, v) );
+    }
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTriangle3);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}
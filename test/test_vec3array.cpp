@@ -0,0 +1,278 @@
+#include "vgl_vec3array.h"
+
+#include <cppunit/TestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+//
+// HELPER METHODS
+//
+
+// Sizes either side of the 8 and 16 wide kernels, and an empty array.
+static const size_t kSizes[] = { 0, 1, 7, 8, 9, 15, 16, 17, 33, 100 };
+static const size_t kNumSizes = sizeof(kSizes) / sizeof(kSizes[0]);
+
+
+static bool close(float a, float b)
+{
+  return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(b));
+}
+
+
+static bool close(const vgl::Vec3f& a, const vgl::Vec3f& b)
+{
+  return close(a.x, b.x) && close(a.y, b.y) && close(a.z, b.z);
+}
+
+
+static bool matches(const vgl::Vec3Array& a, const std::vector<vgl::Vec3f>& expected)
+{
+  if (a.getSize() != expected.size())
+    return false;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (!close(a.get(i), expected[i]))
+      return false;
+  }
+  return true;
+}
+
+
+static std::vector<vgl::Vec3f> makeVectors(size_t size, float offset)
+{
+  std::vector<vgl::Vec3f> v(size);
+  for (size_t i = 0; i < size; ++i)
+    v[i] = vgl::Vec3f(std::sin(i * 1.3f + offset), std::cos(i * 0.7f + offset) * 2.0f, i * 0.25f - 3.0f);
+  return v;
+}
+
+
+//
+// TESTS
+//
+
+class TestVec3Array : public CPPUNIT_NS::TestCase
+{
+  CPPUNIT_TEST_SUITE(TestVec3Array);
+  CPPUNIT_TEST(testConvert);
+  CPPUNIT_TEST(testResize);
+  CPPUNIT_TEST(testAlignment);
+  CPPUNIT_TEST(testAdd);
+  CPPUNIT_TEST(testScale);
+  CPPUNIT_TEST(testCross);
+  CPPUNIT_TEST(testNorm);
+  CPPUNIT_TEST(testDot);
+  CPPUNIT_TEST(testMinMax);
+  CPPUNIT_TEST(testTransformPoints);
+  CPPUNIT_TEST(testInPlace);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp() {}
+  void tearDown() {}
+
+protected:
+  void testConvert() {
+    std::vector<vgl::Vec3f> src = makeVectors(17, 0.0f);
+    vgl::Vec3Array a(src);
+    CPPUNIT_ASSERT( a.getSize() == 17 );
+    CPPUNIT_ASSERT( a.getX()[5] == src[5].x && a.getY()[5] == src[5].y && a.getZ()[5] == src[5].z );
+
+    std::vector<vgl::Vec3f> back;
+    a.toVector(back);
+    CPPUNIT_ASSERT( back.size() == 17 );
+    for (size_t i = 0; i < src.size(); ++i)
+      CPPUNIT_ASSERT( back[i].x == src[i].x && back[i].y == src[i].y && back[i].z == src[i].z );
+
+    vgl::Vec3Array copy(a);
+    CPPUNIT_ASSERT( matches(copy, src) );
+    vgl::Vec3Array assigned;
+    assigned = a;
+    CPPUNIT_ASSERT( matches(assigned, src) );
+  }
+
+  void testResize() {
+    std::vector<vgl::Vec3f> src = makeVectors(10, 1.0f);
+    vgl::Vec3Array a(src);
+    a.resize(40);
+    CPPUNIT_ASSERT( a.getSize() == 40 );
+    for (size_t i = 0; i < src.size(); ++i)
+      CPPUNIT_ASSERT( close(a.get(i), src[i]) );
+
+    a.resize(3);
+    a.set(2, vgl::Vec3f(1, 2, 3));
+    CPPUNIT_ASSERT( a.getSize() == 3 );
+    CPPUNIT_ASSERT( close(a.get(0), src[0]) && close(a.get(2), vgl::Vec3f(1, 2, 3)) );
+  }
+
+  void testAlignment() {
+    for (size_t s = 1; s < kNumSizes; ++s) {
+      vgl::Vec3Array a(kSizes[s]);
+      CPPUNIT_ASSERT( size_t(a.getX()) % vgl::Vec3Array::kAlignment == 0 );
+      CPPUNIT_ASSERT( size_t(a.getY()) % vgl::Vec3Array::kAlignment == 0 );
+      CPPUNIT_ASSERT( size_t(a.getZ()) % vgl::Vec3Array::kAlignment == 0 );
+    }
+  }
+
+  void testAdd() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.0f), vb = makeVectors(kSizes[s], 2.0f);
+      std::vector<vgl::Vec3f> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = va[i] + vb[i];
+      vgl::Vec3Array a(va), b(vb), dst;
+      vgl::add(a, b, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+  }
+
+  void testScale() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.5f);
+      std::vector<vgl::Vec3f> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = va[i] * -1.5f;
+      vgl::Vec3Array a(va), dst;
+      vgl::scale(a, -1.5f, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+  }
+
+  void testCross() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.0f), vb = makeVectors(kSizes[s], 4.0f);
+      std::vector<vgl::Vec3f> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = vgl::cross(va[i], vb[i]);
+      vgl::Vec3Array a(va), b(vb), dst;
+      vgl::cross(a, b, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+  }
+
+  void testNorm() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 3.0f);
+      std::vector<vgl::Vec3f> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = vgl::norm(va[i]);
+      vgl::Vec3Array a(va), dst;
+      vgl::norm(a, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+
+    // Zero vectors stay zero, and so does the padding after the last vector,
+    // rather than filling up with NaNs.
+    std::vector<vgl::Vec3f> va = makeVectors(21, 1.0f);
+    va[3] = va[20] = vgl::Vec3f(0.0f, 0.0f, 0.0f);
+    vgl::Vec3Array a(va), dst;
+    vgl::norm(a, dst);
+    CPPUNIT_ASSERT( close(dst.get(3), vgl::Vec3f(0.0f, 0.0f, 0.0f)) );
+    CPPUNIT_ASSERT( close(dst.get(20), vgl::Vec3f(0.0f, 0.0f, 0.0f)) );
+    CPPUNIT_ASSERT( close(dst.get(4), vgl::norm(va[4])) );
+    for (size_t i = 21; i < 32; ++i)
+      CPPUNIT_ASSERT( dst.getX()[i] == 0.0f && dst.getY()[i] == 0.0f && dst.getZ()[i] == 0.0f );
+  }
+
+  void testDot() {
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.0f), vb = makeVectors(kSizes[s], 1.0f);
+      vgl::Vec3Array a(va), b(vb);
+      // One extra, to check nothing gets written past the end.
+      std::vector<float> dst(kSizes[s] + 1, 42.0f);
+      vgl::dot(a, b, &dst[0]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        CPPUNIT_ASSERT( close(dst[i], vgl::dot(va[i], vb[i])) );
+      CPPUNIT_ASSERT( dst[kSizes[s]] == 42.0f );
+    }
+  }
+
+  void testMinMax() {
+    for (size_t s = 1; s < kNumSizes; ++s) {
+      // Values all well away from zero, so zeros in the padding would show.
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.0f);
+      for (size_t i = 0; i < va.size(); ++i)
+        va[i] += vgl::Vec3f(10.0f);
+      vgl::Vec3f low = va[0], high = va[0];
+      for (size_t i = 1; i < va.size(); ++i) {
+        low = vgl::pairwiseMin(low, va[i]);
+        high = vgl::pairwiseMax(high, va[i]);
+      }
+      vgl::Vec3Array a(va);
+      vgl::Vec3f resultLow, resultHigh;
+      vgl::reduceMinMax(a, resultLow, resultHigh);
+      CPPUNIT_ASSERT( resultLow.x == low.x && resultLow.y == low.y && resultLow.z == low.z );
+      CPPUNIT_ASSERT( resultHigh.x == high.x && resultHigh.y == high.y && resultHigh.z == high.z );
+
+      // The same values negated, so the maximum is the one near zero.
+      vgl::scale(a, -1.0f, a);
+      vgl::reduceMinMax(a, resultLow, resultHigh);
+      CPPUNIT_ASSERT( resultLow.x == -high.x && resultHigh.x == -low.x );
+    }
+
+    vgl::Vec3Array empty;
+    vgl::Vec3f low, high;
+    vgl::reduceMinMax(empty, low, high);
+    CPPUNIT_ASSERT( low.x == HUGE_VALF && high.z == -HUGE_VALF );
+  }
+
+  void testTransformPoints() {
+    vgl::Matrix4f m;
+    for (unsigned int i = 0; i < 16; ++i)
+      m.data[i] = std::sin(i * 1.7f) * 3.0f;
+    for (size_t s = 0; s < kNumSizes; ++s) {
+      std::vector<vgl::Vec3f> va = makeVectors(kSizes[s], 0.0f);
+      std::vector<vgl::Vec3f> expected(kSizes[s]);
+      for (size_t i = 0; i < kSizes[s]; ++i)
+        expected[i] = vgl::transformPoint<float>(m, va[i]);
+      vgl::Vec3Array a(va), dst;
+      vgl::transformPoints(m, a, dst);
+      CPPUNIT_ASSERT( matches(dst, expected) );
+    }
+  }
+
+  void testInPlace() {
+    std::vector<vgl::Vec3f> va = makeVectors(33, 0.0f), vb = makeVectors(33, 1.0f);
+    std::vector<vgl::Vec3f> expected(33);
+    for (size_t i = 0; i < 33; ++i)
+      expected[i] = vgl::cross(va[i] + vb[i], vb[i]);
+    vgl::Vec3Array a(va), b(vb);
+    vgl::add(a, b, a);
+    vgl::cross(a, b, a);
+    CPPUNIT_ASSERT( matches(a, expected) );
+
+    vgl::norm(b, b);
+    for (size_t i = 0; i < 33; ++i)
+      CPPUNIT_ASSERT( close(b.get(i), vgl::norm(vb[i])) );
+  }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestVec3Array);
+
+
+int main( int ac, char **av )
+{
+  //--- Create the event manager and test controller
+  CPPUNIT_NS::TestResult controller;
+
+  //--- Add a listener that colllects test result
+  CPPUNIT_NS::TestResultCollector result;
+  controller.addListener( &result );
+
+  //--- Add a listener that print dots as test run.
+  CPPUNIT_NS::BriefTestProgressListener progress;
+  controller.addListener( &progress );
+
+  //--- Add the top suite to the test runner
+  CPPUNIT_NS::TestRunner runner;
+  runner.addTest( CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest() );
+  runner.run( controller );
+
+  return result.wasSuccessful() ? 0 : 1;
+}